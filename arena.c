@@ -0,0 +1,117 @@
+#include "arena.h"
+
+/** \brief newBlock
+ * A function which allocates a block able to hold at least size bytes
+ * \param size_t size: The number of bytes wanted
+ * \return The new block
+ *
+ */
+static arenaBlock *newBlock(size_t size) {
+  arenaBlock *block;
+  if(size<ARENA_BLOCK_SIZE) {
+    size=ARENA_BLOCK_SIZE;
+  }
+  block=(arenaBlock *)malloc(sizeof(arenaBlock)+size);
+  block->next=NULL;
+  block->size=size;
+  block->used=0;
+  return block;
+}
+
+/** \brief arenaInit
+ * A function which initializes an empty arena, no memory is taken before the first allocation
+ * \param arena *a: A pointer which points to the arena
+ * \return None
+ *
+ */
+void arenaInit(arena *a) {
+  a->head=NULL;
+}
+
+/** \brief arenaAlloc
+ * A function which bumps size bytes out of the current block
+ * \param arena *a: A pointer which points to the arena
+ * \param size_t size: The number of bytes wanted
+ * \return The allocated memory, aligned like malloc's
+ *
+ */
+void *arenaAlloc(arena *a, size_t size) {
+  void *mem;
+  size=(size+sizeof(max_align_t)-1)&~(sizeof(max_align_t)-1);
+
+  if(a->head==NULL || a->head->size-a->head->used<size) {
+    // The new block is twice as big as the last one, so that long inputs need few blocks
+    arenaBlock *block=newBlock(a->head==NULL? size:(a->head->size*2>size? a->head->size*2:size));
+    block->next=a->head;
+    a->head=block;
+  }
+  mem=(char *)a->head->data+a->head->used;
+  a->head->used+=size;
+  return mem;
+}
+
+/** \brief arenaStrndup
+ * A function which copies the len first characters of a string into the arena
+ * \param arena *a: A pointer which points to the arena
+ * \param const char *s: The string
+ * \param size_t len: The number of characters to copy
+ * \return The NUL-terminated copy
+ *
+ */
+char *arenaStrndup(arena *a, const char *s, size_t len) {
+  char *copy=(char *)arenaAlloc(a, len+1);
+  memcpy(copy, s, len);
+  copy[len]='\0';
+  return copy;
+}
+
+/** \brief arenaStrdup
+ * A function which copies a string into the arena
+ * \param arena *a: A pointer which points to the arena
+ * \param const char *s: The string
+ * \return The copy
+ *
+ */
+char *arenaStrdup(arena *a, const char *s) {
+  return arenaStrndup(a, s, strlen(s));
+}
+
+/** \brief arenaReset
+ * A function which frees everything allocated since the last reset at once
+ * When several blocks were needed, they are merged into one big enough for
+ * all of them, so that a steady input never reaches malloc again
+ * \param arena *a: A pointer which points to the arena
+ * \return None
+ *
+ */
+void arenaReset(arena *a) {
+  size_t total=0;
+  arenaBlock *block;
+
+  if(a->head==NULL) {
+    return;
+  }
+  if(a->head->next==NULL) {
+    a->head->used=0;
+    return;
+  }
+  for(block=a->head; block!=NULL; block=block->next) {
+    total+=block->size;
+  }
+  arenaRelease(a);
+  a->head=newBlock(total);
+}
+
+/** \brief arenaRelease
+ * A function which gives all the blocks of the arena back to the system
+ * \param arena *a: A pointer which points to the arena
+ * \return None
+ *
+ */
+void arenaRelease(arena *a) {
+  while(a->head!=NULL) {
+    arenaBlock *next=a->head->next;
+    free(a->head);
+    a->head=next;
+  }
+}
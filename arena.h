@@ -0,0 +1,42 @@
+#ifndef MYSHELL_ARENA_H
+#define MYSHELL_ARENA_H
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+//Size of the first block of an arena
+#define ARENA_BLOCK_SIZE 4096
+
+typedef struct arenaBlock {
+    struct arenaBlock *next;
+
+    //usable bytes in data
+    size_t size;
+
+    //bytes already handed out
+    size_t used;
+
+    //the memory handed out, aligned like malloc's
+    max_align_t data[];
+} arenaBlock;
+
+typedef struct {
+    //the block allocations are taken from, followed by the full ones
+    arenaBlock *head;
+} arena;
+
+//Initializes an empty arena
+void arenaInit(arena *a);
+//Allocates memory which lives until the next reset
+void *arenaAlloc(arena *a, size_t size);
+//Copies the len first characters of a string into the arena
+char *arenaStrndup(arena *a, const char *s, size_t len);
+//Copies a string into the arena
+char *arenaStrdup(arena *a, const char *s);
+//Frees everything allocated since the last reset at once
+void arenaReset(arena *a);
+//Gives the memory of the arena back to the system
+void arenaRelease(arena *a);
+
+#endif
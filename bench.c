@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "shell_fct.h"
+#include "event.h"
+
+//Runs of each end-to-end benchmark, the latency percentiles come from them
+#define BENCH_SPAWN_RUNS 200
+//Bytes pushed through the pipe throughput benchmark
+#define BENCH_PIPE_BYTES "268435456"
+
+//Allocations made by the shell's code, counted through the linker's --wrap
+static unsigned long nbAllocs = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t nb, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size) {
+  nbAllocs++;
+  return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t nb, size_t size) {
+  nbAllocs++;
+  return __real_calloc(nb, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size) {
+  nbAllocs++;
+  return __real_realloc(ptr, size);
+}
+
+typedef struct {
+    const char *name;
+    const char *line;
+} benchShape;
+
+//Command lines as they are typed, from the simplest to the longest
+static const benchShape parseShapes[] = {
+    {"simple", "ls -la /tmp"},
+    {"pipeline", "cat access.log | grep -v healthcheck | cut -d ' ' -f 1 | sort | uniq -c | sort -rn | head -20"},
+    {"quoted", "grep -e 'not found' -e \"time out\" --color=never < app.log > errors.txt 2>&1"},
+    {"escaped", "printf '%s\\n' one\\ two \"three \\\"four\\\"\" 'five six' >> out.txt"},
+    {"long", "gcc -g -Wall -Wextra -O2 -D_GNU_SOURCE -I include -I src -I build/gen -o build/obj/shell_fct.o "
+             "-c src/shell_fct.c -MMD -MP -MF build/dep/shell_fct.d -fPIC -pipe -fno-omit-frame-pointer"},
+    {NULL, NULL}
+};
+
+//Pipelines run through exec_command, from one stage to eight, the paths keep the builtins out
+static const benchShape spawnShapes[] = {
+    {"1-stage", "/bin/true"},
+    {"2-stage", "/bin/true | /bin/cat"},
+    {"8-stage", "/bin/true | /bin/cat | /bin/cat | /bin/cat | /bin/cat | /bin/cat | /bin/cat | /bin/cat"},
+    {"2-stage-builtin", "true | cat"},
+    {"8-stage-builtin", "true | cat | cat | cat | cat | cat | cat | cat"},
+    {NULL, NULL}
+};
+
+/** \brief compareNs
+ * A function which orders two durations for qsort
+ * \return <0, 0 or >0 like strcmp
+ *
+ */
+static int compareNs(const void *a, const void *b) {
+  long long x=*(const long long *)a, y=*(const long long *)b;
+  return x<y? -1:(x>y);
+}
+
+/** \brief benchParse
+ * A function which measures parseMembers/freeCmd on one shape of line
+ * \param const benchShape *shape: The line
+ * \param long iterations: The number of times it's parsed
+ * \return None
+ *
+ */
+static void benchParse(const benchShape *shape, long iterations) {
+  cmd c;
+  long cpt;
+  long long begin, elapsed;
+  unsigned long allocs;
+
+  setupCmd(&c);
+  // The first parse sizes the arena, as the first line typed would
+  parseMembers((char *)shape->line, &c);
+  freeCmd(&c);
+
+  allocs=nbAllocs;
+  begin=evNow();
+  for(cpt=0; cpt<iterations; cpt++) {
+    parseMembers((char *)shape->line, &c);
+    freeCmd(&c);
+  }
+  elapsed=evNow()-begin;
+  allocs=nbAllocs-allocs;
+  releaseCmd(&c);
+
+  printf("{\"bench\":\"parse\",\"shape\":\"%s\",\"bytes\":%zu,\"iterations\":%ld,"
+         "\"ns_per_line\":%.1f,\"lines_per_s\":%.0f,\"allocs_per_line\":%.3f}\n",
+         shape->name, strlen(shape->line), iterations,
+         (double)elapsed/iterations, iterations*1e9/(double)elapsed, (double)allocs/iterations);
+}
+
+/** \brief runLine
+ * A function which parses and executes one command line, like the shell does
+ * \param const char *line: The command line
+ * \param cmd *c: The command reused from one line to the next
+ * \return The exit code of the command
+ *
+ */
+static int runLine(const char *line, cmd *c) {
+  int ret=-1;
+  if(!parseMembers((char *)line, c)) {
+    ret=exec_command(c);
+  }
+  freeCmd(c);
+  return ret;
+}
+
+/** \brief benchSpawn
+ * A function which measures the latency from the spawn of a pipeline to its exit
+ * \param const benchShape *shape: The pipeline
+ * \param int runs: The number of runs
+ * \return None
+ *
+ */
+static void benchSpawn(const benchShape *shape, int runs) {
+  long long *lat=(long long *)malloc(sizeof(long long)*(size_t)runs), total=0;
+  cmd c;
+  int cpt;
+
+  setupCmd(&c);
+  runLine(shape->line, &c);
+  for(cpt=0; cpt<runs; cpt++) {
+    long long begin=evNow();
+    runLine(shape->line, &c);
+    lat[cpt]=evNow()-begin;
+    total+=lat[cpt];
+  }
+  releaseCmd(&c);
+  qsort(lat, (size_t)runs, sizeof(long long), compareNs);
+
+  printf("{\"bench\":\"spawn\",\"shape\":\"%s\",\"backend\":\"%s\",\"runs\":%d,"
+         "\"mean_us\":%.1f,\"p50_us\":%.1f,\"p90_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f}\n",
+         shape->name, shellOptions.spawnMode==MYSHELL_SPAWN_POSIX? "posix":"fork", runs,
+         total/1000.0/runs, lat[runs/2]/1000.0, lat[runs*9/10]/1000.0,
+         lat[runs*99/100]/1000.0, lat[runs-1]/1000.0);
+  free(lat);
+}
+
+/** \brief benchPipe
+ * A function which measures how fast data goes through a pipe of the shell
+ * \return None
+ *
+ */
+static void benchPipe(void) {
+  cmd c;
+  long long begin, elapsed;
+
+  setupCmd(&c);
+  begin=evNow();
+  runLine("head -c " BENCH_PIPE_BYTES " /dev/zero | cat > /dev/null", &c);
+  elapsed=evNow()-begin;
+  releaseCmd(&c);
+
+  printf("{\"bench\":\"pipe\",\"shape\":\"head|cat\",\"backend\":\"%s\",\"bytes\":%s,\"mb_per_s\":%.1f}\n",
+         shellOptions.spawnMode==MYSHELL_SPAWN_POSIX? "posix":"fork",
+         BENCH_PIPE_BYTES, atof(BENCH_PIPE_BYTES)/1048576.0*1e9/(double)elapsed);
+}
+
+/** \brief main
+ * Runs every benchmark and prints one JSON object per line, so that
+ * two runs can be compared with any JSON tool
+ * "myshell_bench [iterations]" sets the number of parses per shape
+ */
+int main(int argc, char **argv) {
+  long iterations=argc>1? atol(argv[1]):200000;
+  const benchShape *shape;
+  int mode;
+
+  if(iterations<=0) {
+    fprintf(stderr, "usage: myshell_bench [iterations]\n");
+    return 2;
+  }
+  initVars();
+  initOptions();
+  initSession();
+  evInit();
+  initJobControl(0);
+
+  printf("{\"bench\":\"meta\",\"time\":%ld,\"cpus\":%ld}\n", (long)time(NULL), sysconf(_SC_NPROCESSORS_ONLN));
+  for(shape=parseShapes; shape->name!=NULL; shape++) {
+    benchParse(shape, iterations);
+  }
+  for(mode=MYSHELL_SPAWN_FORK; mode<=MYSHELL_SPAWN_POSIX; mode++) {
+    shellOptions.spawnMode=mode;
+    for(shape=spawnShapes; shape->name!=NULL; shape++) {
+      fflush(stdout);
+      benchSpawn(shape, BENCH_SPAWN_RUNS);
+    }
+    fflush(stdout);
+    benchPipe();
+  }
+  return 0;
+}
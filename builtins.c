@@ -0,0 +1,1096 @@
+#include <stdarg.h>
+#include <signal.h>
+#include <sys/eventfd.h>
+#include "shell_fct.h"
+
+//Stack of the threads running builtins, they need little
+#define BUILTIN_THREAD_STACK (256*1024)
+
+typedef struct builtinThread {
+    pthread_t tid;
+
+    //the member of the job it stands for
+    job *j;
+    unsigned int procNo;
+
+    //the builtin, its own copy of the arguments and of the fds
+    const builtinDesc *desc;
+    char **args;
+    unsigned int nbArgs;
+    int fds[3];
+
+    //the working directory when it was started
+    char *cwd;
+
+    //set by the thread once the builtin returned, with its exit code
+    int done;
+    int status;
+
+    struct builtinThread *next;
+} builtinThread;
+
+//Signaled by the threads when they're done, watched by the event loop
+static int threadDoneFd = -1;
+static builtinThread *threadList = NULL;
+
+//The working directory seen by a builtin on a thread, NULL in the shell itself
+static __thread const char *threadCwd = NULL;
+
+/** \brief outFlush
+ * A function which writes what a builtin has buffered
+ * \param outBuffer *out: The buffer
+ * \return None
+ *
+ */
+static void outFlush(outBuffer *out) {
+  size_t done=0;
+  while(done<out->len && !out->error) {
+    ssize_t nb=write(out->fd, out->buf+done, out->len-done);
+    if(nb<0) {
+      if(errno!=EINTR) {
+        out->error=errno;
+      }
+      continue;
+    }
+    done+=(size_t)nb;
+  }
+  out->len=0;
+}
+
+/** \brief outWrite
+ * A function which buffers the output of a builtin
+ * \param outBuffer *out: The buffer
+ * \param const char *s: The characters
+ * \param size_t len: The number of characters
+ * \return None
+ *
+ */
+void outWrite(outBuffer *out, const char *s, size_t len) {
+  while(len>0 && !out->error) {
+    size_t part=sizeof(out->buf)-out->len;
+    if(part>len) {
+      part=len;
+    }
+    memcpy(out->buf+out->len, s, part);
+    out->len+=part;
+    s+=part;
+    len-=part;
+    if(out->len==sizeof(out->buf)) {
+      outFlush(out);
+    }
+  }
+}
+
+/** \brief outDone
+ * A function which flushes the output of a builtin and gives its exit code
+ * \param outBuffer *out: The buffer
+ * \param int code: The exit code when the output went well
+ * \return The exit code; 128+SIGPIPE when the reader is gone, 1 on another error
+ *
+ */
+int outDone(outBuffer *out, int code) {
+  outFlush(out);
+  if(out->error==EPIPE) {
+    return 128+SIGPIPE;
+  }
+  return out->error? 1:code;
+}
+
+/** \brief builtinError
+ * A function which prints the error message of a builtin on its stderr
+ * \param const int *fds: The fds of the builtin
+ * \param const char *format: The message, as for printf
+ * \return None
+ *
+ */
+static void builtinError(const int *fds, const char *format, ...) {
+  va_list ap;
+  va_start(ap, format);
+  dprintf(fds[2], "-myshell: ");
+  vdprintf(fds[2], format, ap);
+  dprintf(fds[2], "\n");
+  va_end(ap);
+}
+
+/** \brief parseEscape
+ * A function which reads a backslash escape: \a \b \c \e \f \n \r \t \v \\,
+ * \0nnn or \nnn in octal and \xHH in hexadecimal
+ * \param const char *s: The character after the backslash
+ * \param int zeroOctal: Whether octal escapes start with \0, as for echo and %b
+ * \param char *c: Filled with the character
+ * \param int *stop: Set for \c, which ends the output
+ * \return The character after the escape; NULL when it's not an escape
+ *
+ */
+static const char *parseEscape(const char *s, int zeroOctal, char *c, int *stop) {
+  int value=0, cpt;
+
+  switch(*s) {
+  case 'a': *c='\a'; return s+1;
+  case 'b': *c='\b'; return s+1;
+  case 'e': *c='\033'; return s+1;
+  case 'f': *c='\f'; return s+1;
+  case 'n': *c='\n'; return s+1;
+  case 'r': *c='\r'; return s+1;
+  case 't': *c='\t'; return s+1;
+  case 'v': *c='\v'; return s+1;
+  case '\\': *c='\\'; return s+1;
+  case 'c': *stop=1; *c='\0'; return s+1;
+  case 'x':
+    for(cpt=1; cpt<=2 && strchr("0123456789abcdefABCDEF", s[cpt])!=NULL && s[cpt]!='\0'; cpt++) {
+      value=value*16+(s[cpt]<='9'? s[cpt]-'0':(s[cpt]|0x20)-'a'+10);
+    }
+    if(cpt==1) {
+      return NULL;
+    }
+    *c=(char)value;
+    return s+cpt;
+  default:
+    if(*s<'0' || *s>'7' || (zeroOctal && *s!='0')) {
+      return NULL;
+    }
+    if(zeroOctal) {
+      s++;
+    }
+    for(cpt=0; cpt<3 && *s>='0' && *s<='7'; cpt++, s++) {
+      value=value*8+(*s-'0');
+    }
+    *c=(char)value;
+    return s;
+  }
+}
+
+/** \brief writeEscaped
+ * A function which writes a string, interpreting its backslash escapes
+ * \param outBuffer *out: The output
+ * \param const char *s: The string
+ * \param int zeroOctal: Whether octal escapes start with \0
+ * \return 1: when \c was met; 0: otherwise
+ *
+ */
+static int writeEscaped(outBuffer *out, const char *s, int zeroOctal) {
+  int stop=0;
+  while(*s!='\0') {
+    const char *next;
+    char c;
+    if(*s=='\\' && (next=parseEscape(s+1, zeroOctal, &c, &stop))!=NULL) {
+      if(stop) {
+        return 1;
+      }
+      outWrite(out, &c, 1);
+      s=next;
+    } else {
+      outWrite(out, s++, 1);
+    }
+  }
+  return 0;
+}
+
+/** \brief echoBuiltin
+ * A function which realizes "echo [-neE] [arg...]"
+ * \param char **args: The arguments of the builtin
+ * \param unsigned int nbArgs: The number of arguments
+ * \param const int *fds: Its stdin, stdout and stderr
+ * \return The exit code
+ *
+ */
+static int echoBuiltin(char **args, unsigned int nbArgs, const int *fds) {
+  outBuffer out;
+  int newline=1, escapes=0;
+  unsigned int cpt;
+
+  out.fd=fds[1];
+  out.error=0;
+  out.len=0;
+  for(cpt=1; cpt<nbArgs && args[cpt][0]=='-' && args[cpt][1]!='\0'
+      && strspn(args[cpt]+1, "neE")==strlen(args[cpt]+1); cpt++) {
+    const char *opt;
+    for(opt=args[cpt]+1; *opt!='\0'; opt++) {
+      if(*opt=='n') {
+        newline=0;
+      } else {
+        escapes=*opt=='e';
+      }
+    }
+  }
+  for(; cpt<nbArgs; cpt++) {
+    if(escapes) {
+      if(writeEscaped(&out, args[cpt], 1)) {
+        return outDone(&out, 0);
+      }
+    } else {
+      outWrite(&out, args[cpt], strlen(args[cpt]));
+    }
+    if(cpt+1<nbArgs) {
+      outWrite(&out, " ", 1);
+    }
+  }
+  if(newline) {
+    outWrite(&out, "\n", 1);
+  }
+  return outDone(&out, 0);
+}
+
+/** \brief numericArg
+ * A function which reads the argument of a numeric conversion of printf,
+ * 'c and "c give the code of the character c
+ * \param const char *arg: The argument
+ * \param const int *fds: The fds of the builtin, for the error message
+ * \param int *failed: Set when the argument is not a number
+ * \return The number
+ *
+ */
+static long long numericArg(const char *arg, const int *fds, int *failed) {
+  char *end;
+  long long value;
+
+  if(arg[0]=='\'' || arg[0]=='"') {
+    return (unsigned char)arg[1];
+  }
+  errno=0;
+  value=strtoll(arg, &end, 0);
+  if(*arg=='\0' || *end!='\0' || errno!=0) {
+    // Values beyond LLONG_MAX are still fine for %u and %x
+    unsigned long long uvalue=strtoull(arg, &end, 0);
+    if(*arg=='\0' || *end!='\0') {
+      builtinError(fds, "printf: %s: invalid number", arg);
+      *failed=1;
+    }
+    return (long long)uvalue;
+  }
+  return value;
+}
+
+/** \brief printfOnce
+ * A function which goes once through the format of printf
+ * \param outBuffer *out: The output
+ * \param const char *format: The format
+ * \param char **args: The arguments of the builtin
+ * \param unsigned int nbArgs: The number of arguments
+ * \param unsigned int *next: A pointer which points to the next argument to use, updated
+ * \param const int *fds: The fds of the builtin
+ * \param int *failed: Set when an argument or the format is wrong
+ * \return 1: when the output must stop (\c or a wrong format); 0: otherwise
+ *
+ */
+static int printfOnce(outBuffer *out, const char *format, char **args, unsigned int nbArgs,
+                      unsigned int *next, const int *fds, int *failed) {
+  const char *cur=format;
+  char spec[64], small[128];
+  int stop=0;
+
+  while(*cur!='\0') {
+    const char *begin, *arg;
+    size_t specLen;
+    char *text=small;
+    int len;
+
+    if(*cur=='\\') {
+      const char *after;
+      char c;
+      if((after=parseEscape(cur+1, 0, &c, &stop))==NULL) {
+        outWrite(out, cur++, 1);
+        continue;
+      }
+      if(stop) {
+        return 1;
+      }
+      outWrite(out, &c, 1);
+      cur=after;
+      continue;
+    }
+    if(*cur!='%') {
+      begin=cur;
+      while(*cur!='\0' && *cur!='%' && *cur!='\\') {cur++;}
+      outWrite(out, begin, (size_t)(cur-begin));
+      continue;
+    }
+    if(cur[1]=='%') {
+      outWrite(out, "%", 1);
+      cur+=2;
+      continue;
+    }
+
+    // Flags, width and precision are handed to snprintf as they are
+    begin=cur++;
+    cur+=strspn(cur, "-+ #0");
+    cur+=strspn(cur, "0123456789");
+    if(*cur=='.') {
+      cur++;
+      cur+=strspn(cur, "0123456789");
+    }
+    specLen=(size_t)(cur-begin);
+    if(*cur=='\0' || specLen+4>sizeof(spec) || strchr("sbcdiouxXfFeEgGaA", *cur)==NULL) {
+      builtinError(fds, "printf: %.*s: invalid format", (int)(cur-begin+(*cur!='\0')), begin);
+      *failed=1;
+      return 1;
+    }
+    memcpy(spec, begin, specLen);
+    arg=*next<nbArgs? args[(*next)++]:NULL;
+
+    switch(*cur) {
+    case 'b':
+      // The escapes of the argument are expanded, the result is not padded
+      if(arg!=NULL && writeEscaped(out, arg, 1)) {
+        return 1;
+      }
+      cur++;
+      continue;
+    case 's':
+      strcpy(spec+specLen, "s");
+      len=snprintf(NULL, 0, spec, arg==NULL? "":arg);
+      if((size_t)len>=sizeof(small)) {
+        text=(char *)malloc((size_t)len+1);
+      }
+      snprintf(text, (size_t)len+1, spec, arg==NULL? "":arg);
+      break;
+    case 'c':
+      strcpy(spec+specLen, "c");
+      len=snprintf(small, sizeof(small), spec, arg==NULL? '\0':arg[0]);
+      break;
+    case 'd': case 'i': {
+      long long value=arg==NULL? 0:numericArg(arg, fds, failed);
+      spec[specLen]='l';
+      spec[specLen+1]='l';
+      spec[specLen+2]=*cur;
+      spec[specLen+3]='\0';
+      len=snprintf(NULL, 0, spec, value);
+      if((size_t)len>=sizeof(small)) {
+        text=(char *)malloc((size_t)len+1);
+      }
+      snprintf(text, (size_t)len+1, spec, value);
+      break;
+    }
+    case 'o': case 'u': case 'x': case 'X': {
+      unsigned long long value=arg==NULL? 0:(unsigned long long)numericArg(arg, fds, failed);
+      spec[specLen]='l';
+      spec[specLen+1]='l';
+      spec[specLen+2]=*cur;
+      spec[specLen+3]='\0';
+      len=snprintf(NULL, 0, spec, value);
+      if((size_t)len>=sizeof(small)) {
+        text=(char *)malloc((size_t)len+1);
+      }
+      snprintf(text, (size_t)len+1, spec, value);
+      break;
+    }
+    default: {
+      double value=0;
+      char *end;
+      if(arg!=NULL) {
+        value=strtod(arg, &end);
+        if(*arg=='\0' || *end!='\0') {
+          builtinError(fds, "printf: %s: invalid number", arg);
+          *failed=1;
+        }
+      }
+      spec[specLen]=*cur;
+      spec[specLen+1]='\0';
+      len=snprintf(NULL, 0, spec, value);
+      if((size_t)len>=sizeof(small)) {
+        text=(char *)malloc((size_t)len+1);
+      }
+      snprintf(text, (size_t)len+1, spec, value);
+    }
+    }
+    outWrite(out, text, (size_t)len);
+    if(text!=small) {
+      free(text);
+    }
+    cur++;
+  }
+  return 0;
+}
+
+/** \brief printfBuiltin
+ * A function which realizes "printf format [arg...]"
+ * The format is used again as long as arguments are left, as POSIX wants
+ * \param char **args: The arguments of the builtin
+ * \param unsigned int nbArgs: The number of arguments
+ * \param const int *fds: Its stdin, stdout and stderr
+ * \return The exit code
+ *
+ */
+static int printfBuiltin(char **args, unsigned int nbArgs, const int *fds) {
+  outBuffer *out;
+  unsigned int next=2, before;
+  int failed=0, code;
+
+  if(nbArgs<2) {
+    builtinError(fds, "printf: usage: printf format [arguments]");
+    return 2;
+  }
+  // The buffer is too big for the stack of a thread
+  out=(outBuffer *)malloc(sizeof(outBuffer));
+  out->fd=fds[1];
+  out->error=0;
+  out->len=0;
+  do {
+    before=next;
+    if(printfOnce(out, args[1], args, nbArgs, &next, fds, &failed)) {
+      break;
+    }
+  } while(next<nbArgs && next>before);
+  code=outDone(out, failed);
+  free(out);
+  return code;
+}
+
+/** \brief trueBuiltin
+ * A function which realizes "true"
+ * \return 0
+ *
+ */
+static int trueBuiltin(char **args, unsigned int nbArgs, const int *fds) {
+  return 0;
+}
+
+/** \brief falseBuiltin
+ * A function which realizes "false"
+ * \return 1
+ *
+ */
+static int falseBuiltin(char **args, unsigned int nbArgs, const int *fds) {
+  return 1;
+}
+
+typedef struct {
+    char **args;
+    unsigned int pos, nbArgs;
+
+    //set on a syntax error, with the fds for the message
+    int error;
+    const int *fds;
+} testState;
+
+static int testOr(testState *t);
+
+/** \brief testInteger
+ * A function which reads an integer operand of test
+ * \param testState *t: The state of the expression
+ * \param const char *s: The operand
+ * \return Its value
+ *
+ */
+static long long testInteger(testState *t, const char *s) {
+  char *end;
+  long long value=strtoll(s, &end, 10);
+  while(*end==' ' || *end=='\t') {end++;}
+  if(*s=='\0' || *end!='\0') {
+    builtinError(t->fds, "test: %s: integer expression expected", s);
+    t->error=1;
+  }
+  return value;
+}
+
+/** \brief testUnary
+ * A function which evaluates a unary operator of test
+ * \param testState *t: The state of the expression
+ * \param char op: The letter of the operator
+ * \param const char *arg: Its operand
+ * \return 1: when it's true; 0: otherwise
+ *
+ */
+static int testUnary(testState *t, char op, const char *arg) {
+  struct stat st;
+
+  switch(op) {
+  case 'n': return arg[0]!='\0';
+  case 'z': return arg[0]=='\0';
+  case 't': return isatty((int)testInteger(t, arg));
+  case 'L': case 'h': return !lstat(arg, &st) && S_ISLNK(st.st_mode);
+  case 'r': return !access(arg, R_OK);
+  case 'w': return !access(arg, W_OK);
+  case 'x': return !access(arg, X_OK);
+  }
+  if(stat(arg, &st)) {
+    return 0;
+  }
+  switch(op) {
+  case 'e': return 1;
+  case 'f': return S_ISREG(st.st_mode);
+  case 'd': return S_ISDIR(st.st_mode);
+  case 'b': return S_ISBLK(st.st_mode);
+  case 'c': return S_ISCHR(st.st_mode);
+  case 'p': return S_ISFIFO(st.st_mode);
+  case 'S': return S_ISSOCK(st.st_mode);
+  case 's': return st.st_size>0;
+  case 'g': return (st.st_mode&S_ISGID)!=0;
+  case 'u': return (st.st_mode&S_ISUID)!=0;
+  case 'k': return (st.st_mode&S_ISVTX)!=0;
+  default: return 0;
+  }
+}
+
+/** \brief testBinaryOp
+ * A function which tells whether a word is a binary operator of test
+ * \param const char *op: The word
+ * \return 1: when it is; 0: otherwise
+ *
+ */
+static int testBinaryOp(const char *op) {
+  static const char *const ops[]={"=", "==", "!=", "<", ">", "-eq", "-ne", "-lt", "-le",
+                                  "-gt", "-ge", "-nt", "-ot", "-ef", NULL};
+  int cpt;
+  for(cpt=0; ops[cpt]!=NULL; cpt++) {
+    if(!strcmp(ops[cpt], op)) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/** \brief testBinary
+ * A function which evaluates a binary operator of test
+ * \param testState *t: The state of the expression
+ * \param const char *a: The left operand
+ * \param const char *op: The operator
+ * \param const char *b: The right operand
+ * \return 1: when it's true; 0: otherwise
+ *
+ */
+static int testBinary(testState *t, const char *a, const char *op, const char *b) {
+  struct stat stA, stB;
+  int okA, okB;
+
+  if(op[0]!='-') {
+    int cmp=strcmp(a, b);
+    switch(op[0]) {
+    case '=': return cmp==0;
+    case '!': return cmp!=0;
+    case '<': return cmp<0;
+    default: return cmp>0;
+    }
+  }
+  if(op[1]=='n' && op[2]=='t') {
+    okA=!stat(a, &stA);
+    okB=!stat(b, &stB);
+    return okA && (!okB || stA.st_mtim.tv_sec>stB.st_mtim.tv_sec ||
+                   (stA.st_mtim.tv_sec==stB.st_mtim.tv_sec && stA.st_mtim.tv_nsec>stB.st_mtim.tv_nsec));
+  }
+  if(op[1]=='o' && op[2]=='t') {
+    return testBinary(t, b, "-nt", a);
+  }
+  if(op[1]=='e' && op[2]=='f') {
+    return !stat(a, &stA) && !stat(b, &stB) && stA.st_dev==stB.st_dev && stA.st_ino==stB.st_ino;
+  }
+  long long x=testInteger(t, a), y=testInteger(t, b);
+  if(!strcmp(op, "-eq")) return x==y;
+  if(!strcmp(op, "-ne")) return x!=y;
+  if(!strcmp(op, "-lt")) return x<y;
+  if(!strcmp(op, "-le")) return x<=y;
+  if(!strcmp(op, "-gt")) return x>y;
+  return x>=y;
+}
+
+/** \brief testPrimary
+ * A function which evaluates "( expr )", "-op arg", "arg op arg" or "arg"
+ * \param testState *t: The state of the expression
+ * \return 1: when it's true; 0: otherwise
+ *
+ */
+static int testPrimary(testState *t) {
+  char **args=t->args;
+  unsigned int pos=t->pos;
+  int value;
+
+  if(pos>=t->nbArgs) {
+    builtinError(t->fds, "test: argument expected");
+    t->error=1;
+    return 0;
+  }
+  // A binary operator wins over a unary one: test -n = -n
+  if(pos+2<t->nbArgs && testBinaryOp(args[pos+1])) {
+    t->pos+=3;
+    return testBinary(t, args[pos], args[pos+1], args[pos+2]);
+  }
+  if(!strcmp(args[pos], "(") && pos+1<t->nbArgs) {
+    t->pos++;
+    value=testOr(t);
+    if(t->pos>=t->nbArgs || strcmp(args[t->pos], ")")) {
+      builtinError(t->fds, "test: ')' expected");
+      t->error=1;
+      return 0;
+    }
+    t->pos++;
+    return value;
+  }
+  if(args[pos][0]=='-' && args[pos][1]!='\0' && args[pos][2]=='\0' &&
+     strchr("nztLhrwxefdbcpSsguk", args[pos][1])!=NULL && pos+1<t->nbArgs) {
+    t->pos+=2;
+    return testUnary(t, args[pos][1], args[pos+1]);
+  }
+  t->pos++;
+  return args[pos][0]!='\0';
+}
+
+/** \brief testNot
+ * A function which evaluates "! expr"
+ * \param testState *t: The state of the expression
+ * \return 1: when it's true; 0: otherwise
+ *
+ */
+static int testNot(testState *t) {
+  if(t->pos+1<t->nbArgs && !strcmp(t->args[t->pos], "!")) {
+    t->pos++;
+    return !testNot(t);
+  }
+  return testPrimary(t);
+}
+
+/** \brief testAnd
+ * A function which evaluates "expr -a expr", -a binds tighter than -o
+ * \param testState *t: The state of the expression
+ * \return 1: when it's true; 0: otherwise
+ *
+ */
+static int testAnd(testState *t) {
+  int value=testNot(t);
+  while(t->pos<t->nbArgs && !strcmp(t->args[t->pos], "-a")) {
+    t->pos++;
+    value=testNot(t) && value;
+  }
+  return value;
+}
+
+/** \brief testOr
+ * A function which evaluates "expr -o expr"
+ * \param testState *t: The state of the expression
+ * \return 1: when it's true; 0: otherwise
+ *
+ */
+static int testOr(testState *t) {
+  int value=testAnd(t);
+  while(t->pos<t->nbArgs && !strcmp(t->args[t->pos], "-o")) {
+    t->pos++;
+    value=testAnd(t) || value;
+  }
+  return value;
+}
+
+/** \brief testBuiltin
+ * A function which realizes "test expr" and "[ expr ]"
+ * \param char **args: The arguments of the builtin
+ * \param unsigned int nbArgs: The number of arguments
+ * \param const int *fds: Its stdin, stdout and stderr
+ * \return 0: when the expression is true; 1: when it's false; 2: on a syntax error
+ *
+ */
+static int testBuiltin(char **args, unsigned int nbArgs, const int *fds) {
+  testState t;
+  int value;
+
+  if(args[0][0]=='[') {
+    if(nbArgs<2 || strcmp(args[nbArgs-1], "]")) {
+      builtinError(fds, "[: missing ']'");
+      return 2;
+    }
+    nbArgs--;
+  }
+  if(nbArgs==1) {
+    return 1;
+  }
+  t.args=args;
+  t.pos=1;
+  t.nbArgs=nbArgs;
+  t.error=0;
+  t.fds=fds;
+  value=testOr(&t);
+  if(!t.error && t.pos<nbArgs) {
+    builtinError(fds, "test: %s: unexpected argument", args[t.pos]);
+    t.error=1;
+  }
+  return t.error? 2:!value;
+}
+
+/** \brief catBuiltin
+ * A function which realizes "cat [file...]", "-" being the standard input
+ * \param char **args: The arguments of the builtin
+ * \param unsigned int nbArgs: The number of arguments
+ * \param const int *fds: Its stdin, stdout and stderr
+ * \return The exit code
+ *
+ */
+static int catBuiltin(char **args, unsigned int nbArgs, const int *fds) {
+  char *buf=(char *)malloc(BUILTIN_BUFFER_SIZE);
+  unsigned int cpt=1;
+  int code=0;
+
+  do {
+    const char *name=cpt<nbArgs? args[cpt]:"-";
+    int in=strcmp(name, "-")? open(name, O_RDONLY | O_CLOEXEC):fds[0];
+    ssize_t nb;
+
+    if(in<0) {
+      builtinError(fds, "cat: %s: %s", name, strerror(errno));
+      code=1;
+      continue;
+    }
+    while((nb=read(in, buf, BUILTIN_BUFFER_SIZE))!=0) {
+      ssize_t done=0;
+      if(nb<0) {
+        if(errno==EINTR) {
+          continue;
+        }
+        builtinError(fds, "cat: %s: %s", name, strerror(errno));
+        code=1;
+        break;
+      }
+      while(done<nb) {
+        ssize_t written=write(fds[1], buf+done, (size_t)(nb-done));
+        if(written<0 && errno!=EINTR) {
+          if(in!=fds[0]) {
+            close(in);
+          }
+          free(buf);
+          return errno==EPIPE? 128+SIGPIPE:1;
+        }
+        done+=written>0? written:0;
+      }
+    }
+    if(in!=fds[0]) {
+      close(in);
+    }
+  } while(++cpt<nbArgs);
+  free(buf);
+  return code;
+}
+
+/** \brief pwdBuiltin
+ * A function which realizes "pwd [-L|-P]"
+ * \param char **args: The arguments of the builtin
+ * \param unsigned int nbArgs: The number of arguments
+ * \param const int *fds: Its stdin, stdout and stderr
+ * \return The exit code
+ *
+ */
+static int pwdBuiltin(char **args, unsigned int nbArgs, const int *fds) {
+  outBuffer out;
+  char *physical=NULL;
+  const char *cwd=threadCwd!=NULL? threadCwd:sessionCwd();
+
+  if(nbArgs>1 && !strcmp(args[1], "-P")) {
+    if((physical=getcwd(NULL, 0))==NULL) {
+      builtinError(fds, "pwd: %s", strerror(errno));
+      return 1;
+    }
+    cwd=physical;
+  } else if(nbArgs>1 && strcmp(args[1], "-L")) {
+    builtinError(fds, "pwd: %s: invalid option", args[1]);
+    return 2;
+  }
+  out.fd=fds[1];
+  out.error=0;
+  out.len=0;
+  outWrite(&out, cwd, strlen(cwd));
+  outWrite(&out, "\n", 1);
+  free(physical);
+  return outDone(&out, 0);
+}
+
+/** \brief readBuiltin
+ * A function which realizes "read [-r] [name...]": it reads a line,
+ * splits it with $IFS and sets the variables, the last name taking
+ * the rest of the line; $REPLY gets the line when no name is given
+ * On a thread, as a member of a pipeline, the line is only consumed
+ * \param char **args: The arguments of the builtin
+ * \param unsigned int nbArgs: The number of arguments
+ * \param const int *fds: Its stdin, stdout and stderr
+ * \return 0: when a line was read; 1: at the end of the input
+ *
+ */
+static int readBuiltin(char **args, unsigned int nbArgs, const int *fds) {
+  const char *ifs;
+  size_t len=0, cap=128;
+  char *line=(char *)malloc(cap), *cur, c;
+  unsigned int first=1, cpt;
+  int raw=0, gotAny=0;
+  ssize_t nb;
+
+  if(nbArgs>1 && !strcmp(args[1], "-r")) {
+    raw=1;
+    first=2;
+  }
+  for(cpt=first; cpt<nbArgs; cpt++) {
+    if(!validVarName(args[cpt], strlen(args[cpt]))) {
+      builtinError(fds, "read: %s: invalid name", args[cpt]);
+      free(line);
+      return 2;
+    }
+  }
+
+  // One byte at a time, so that nothing after the line is taken away from the next reader
+  while((nb=read(fds[0], &c, 1))!=0) {
+    if(nb<0) {
+      if(errno==EINTR) {
+        continue;
+      }
+      break;
+    }
+    gotAny=1;
+    if(!raw && c=='\\') {
+      if(read(fds[0], &c, 1)!=1) {
+        break;
+      }
+      if(c=='\n') {
+        continue;
+      }
+    } else if(c=='\n') {
+      break;
+    }
+    if(len+2>cap) {
+      cap*=2;
+      line=(char *)realloc(line, cap);
+    }
+    line[len++]=c;
+  }
+  line[len]='\0';
+
+  // Only the thread of the shell touches the variables
+  if(threadCwd==NULL) {
+    ifs=getVar("IFS")!=NULL? getVar("IFS"):" \t\n";
+    if(first==nbArgs) {
+      setVar("REPLY", line, 0);
+    }
+    cur=line;
+    for(cpt=first; cpt<nbArgs; cpt++) {
+      char *end;
+      cur+=strspn(cur, ifs);
+      if(cpt+1==nbArgs) {
+        // The last name takes the rest, without the trailing separators
+        end=cur+strlen(cur);
+        while(end>cur && strchr(ifs, end[-1])!=NULL) {end--;}
+        *end='\0';
+      } else {
+        end=cur+strcspn(cur, ifs);
+        if(*end!='\0') {
+          *end++='\0';
+        }
+      }
+      setVar(args[cpt], cur, 0);
+      cur=end;
+    }
+  }
+  free(line);
+  return gotAny? 0:1;
+}
+
+/** \brief exitBuiltin
+ * A function which realizes "exit [code]"
+ * \param char **args: The arguments of the builtin
+ * \param unsigned int nbArgs: The number of arguments
+ * \return Nothing, the shell ends
+ *
+ */
+static int exitBuiltin(char **args, unsigned int nbArgs) {
+  fflush(stdout);
+  exit(nbArgs>1? atoi(args[1])&0xff:0);
+}
+
+//Every builtin, sorted by name for bsearch
+static const builtinDesc builtinTable[] = {
+    {"[", NULL, testBuiltin, 0},
+    {"bg", bgCommand, NULL, 0},
+    {"cat", NULL, catBuiltin, BUILTIN_READS_STDIN | BUILTIN_NO_OPTIONS},
+    {"cd", sessionChdir, NULL, 0},
+    {"echo", NULL, echoBuiltin, 0},
+    {"exit", exitBuiltin, NULL, 0},
+    {"export", exportCommand, NULL, 0},
+    {"false", NULL, falseBuiltin, 0},
+    {"fg", fgCommand, NULL, 0},
+    {"hash", hashCommand, NULL, 0},
+    {"history", NULL, historyCommand, 0},
+    {"jobs", jobsCommand, NULL, 0},
+    {"kill", killCommand, NULL, 0},
+    {"parallel", parallelCommand, NULL, 0},
+    {"pipestatus", pipestatusCommand, NULL, 0},
+    {"printf", NULL, printfBuiltin, 0},
+    {"pwd", NULL, pwdBuiltin, 0},
+    {"read", NULL, readBuiltin, 0},
+    {"set", setOption, NULL, 0},
+    {"test", NULL, testBuiltin, 0},
+    {"true", NULL, trueBuiltin, 0},
+    {"unset", unsetCommand, NULL, 0},
+    {"wait", waitCommand, NULL, 0}
+};
+
+/** \brief compareBuiltin
+ * A function which compares a name to a builtin for bsearch
+ * \return <0, 0 or >0 like strcmp
+ *
+ */
+static int compareBuiltin(const void *name, const void *desc) {
+  return strcmp((const char *)name, ((const builtinDesc *)desc)->name);
+}
+
+/** \brief findBuiltin
+ * A function which looks a builtin up by name
+ * \param const char *name: The name of the command
+ * \return The builtin; NULL when it's not one
+ *
+ */
+const builtinDesc *findBuiltin(const char *name) {
+  return (const builtinDesc *)bsearch(name, builtinTable, sizeof(builtinTable)/sizeof(builtinTable[0]),
+                                      sizeof(builtinDesc), compareBuiltin);
+}
+
+/** \brief builtinName
+ * A function which gives the names of the builtins one after the other
+ * \param size_t index: The place of the builtin in the table
+ * \return Its name; NULL past the last one
+ *
+ */
+const char *builtinName(size_t index) {
+  return index<sizeof(builtinTable)/sizeof(builtinTable[0])? builtinTable[index].name:NULL;
+}
+
+/** \brief builtinUsable
+ * A function which tells whether a utility may stand for the real command
+ * \param const builtinDesc *desc: The utility
+ * \param char **args: The arguments of the command
+ * \param int in: The stdin the command would get
+ * \return 1: when the builtin can run it; 0: when the real command must be run
+ *
+ */
+int builtinUsable(const builtinDesc *desc, char **args, int in) {
+  unsigned int cpt;
+
+  if(desc->streamFunc==NULL) {
+    return 0;
+  }
+  // The shell ignores Ctrl-C: a builtin reading the terminal could not be stopped
+  if((desc->flags&BUILTIN_READS_STDIN) && shellInteractive && isatty(in)) {
+    return 0;
+  }
+  if(desc->flags&BUILTIN_NO_OPTIONS) {
+    for(cpt=1; args[cpt]!=NULL; cpt++) {
+      if(args[cpt][0]=='-' && args[cpt][1]!='\0') {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+/** \brief threadsDone
+ * An event handler which joins the threads whose builtin returned
+ * and records the end of their member
+ * \param int fd: The eventfd the threads signal
+ * \param unsigned int events: The EPOLL* flags
+ * \param void *data: Unused
+ * \return None
+ *
+ */
+static void threadsDone(int fd, unsigned int events, void *data) {
+  builtinThread **link=&threadList;
+  uint64_t count;
+
+  read(fd, &count, sizeof(count));
+  while(*link!=NULL) {
+    builtinThread *t=*link;
+    if(!__atomic_load_n(&t->done, __ATOMIC_ACQUIRE)) {
+      link=&t->next;
+      continue;
+    }
+    pthread_join(t->tid, NULL);
+    *link=t->next;
+    finishJobThread(t->j, t->procNo, t->status);
+    free(t->args);
+    free(t->cwd);
+    free(t);
+  }
+}
+
+/** \brief builtinThreadMain
+ * The body of a thread running a builtin
+ * Its fds are closed as soon as it returns, so that the next member sees the end of its input
+ * \param void *data: The thread
+ * \return NULL
+ *
+ */
+static void *builtinThreadMain(void *data) {
+  builtinThread *t=(builtinThread *)data;
+  uint64_t one=1;
+
+  threadCwd=t->cwd;
+  t->status=t->desc->streamFunc(t->args, t->nbArgs, t->fds);
+  close(t->fds[0]);
+  close(t->fds[1]);
+  close(t->fds[2]);
+  __atomic_store_n(&t->done, 1, __ATOMIC_RELEASE);
+  write(threadDoneFd, &one, sizeof(one));
+  return NULL;
+}
+
+/** \brief startBuiltinThread
+ * A function which runs a utility on a thread as a member of a job
+ * The thread gets copies of the arguments and of the fds, so that the
+ * command line and the pipes can be freed and closed meanwhile
+ * \param job *j: The job
+ * \param unsigned int procNo: The serial number of the member
+ * \param const builtinDesc *desc: The utility
+ * \param char **args: Its arguments, NULL terminated
+ * \param const int *fds: Its stdin, stdout and stderr
+ * \param const char *command: The text of the member
+ * \return None
+ *
+ */
+void startBuiltinThread(job *j, unsigned int procNo, const builtinDesc *desc,
+                        char **args, const int *fds, const char *command) {
+  builtinThread *t=(builtinThread *)calloc(1, sizeof(builtinThread));
+  size_t size=0;
+  unsigned int cpt, nbArgs;
+  pthread_attr_t attr;
+  sigset_t all, old;
+  char *strings;
+
+  if(threadDoneFd<0) {
+    threadDoneFd=eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    evAdd(threadDoneFd, EPOLLIN, threadsDone, NULL);
+  }
+
+  // The arguments are copied in one block: the array first, then the strings
+  for(nbArgs=0; args[nbArgs]!=NULL; nbArgs++) {
+    size+=strlen(args[nbArgs])+1;
+  }
+  t->args=(char **)malloc(sizeof(char *)*(nbArgs+1)+size);
+  strings=(char *)(t->args+nbArgs+1);
+  for(cpt=0; cpt<nbArgs; cpt++) {
+    t->args[cpt]=strings;
+    strings=stpcpy(strings, args[cpt])+1;
+  }
+  t->args[nbArgs]=NULL;
+  t->nbArgs=nbArgs;
+  for(cpt=0; cpt<3; cpt++) {
+    t->fds[cpt]=fcntl(fds[cpt], F_DUPFD_CLOEXEC, 3);
+  }
+  t->cwd=strdup(sessionCwd());
+  t->desc=desc;
+  t->j=j;
+  t->procNo=procNo;
+  setJobThread(j, procNo, command);
+  t->next=threadList;
+  threadList=t;
+
+  // Signals are left to the main thread
+  sigfillset(&all);
+  pthread_sigmask(SIG_SETMASK, &all, &old);
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, BUILTIN_THREAD_STACK);
+  if(pthread_create(&t->tid, &attr, builtinThreadMain, t)!=0) {
+    // Without a thread the builtin runs in place rather than not at all
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+    threadList=t->next;
+    t->status=desc->streamFunc(t->args, t->nbArgs, t->fds);
+    for(cpt=0; cpt<3; cpt++) {
+      close(t->fds[cpt]);
+    }
+    finishJobThread(j, procNo, t->status);
+    free(t->args);
+    free(t->cwd);
+    free(t);
+  } else {
+    pthread_sigmask(SIG_SETMASK, &old, NULL);
+  }
+  pthread_attr_destroy(&attr);
+}
@@ -0,0 +1,62 @@
+#ifndef MYSHELL_BUILTINS_H
+#define MYSHELL_BUILTINS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include "jobs.h"
+
+//Size of the output buffer of a builtin, and of the reads of cat
+#define BUILTIN_BUFFER_SIZE 65536
+
+//The builtin reads its standard input: the real command is run instead when it's the terminal
+#define BUILTIN_READS_STDIN 0x1
+//The builtin knows no option: the real command is run instead when one is given
+#define BUILTIN_NO_OPTIONS 0x2
+
+//Builtins which change the shell: they run alone, in the shell itself
+typedef int (*shellBuiltin)(char **args, unsigned int nbArgs);
+//Utilities which only read and write the fds they're given, fds[0..2]: stdin, stdout, stderr
+typedef int (*streamBuiltin)(char **args, unsigned int nbArgs, const int *fds);
+
+typedef struct {
+    const char *name;
+
+    //exactly one of them is set
+    shellBuiltin shellFunc;
+    streamBuiltin streamFunc;
+
+    //BUILTIN_* flags
+    int flags;
+} builtinDesc;
+
+//Buffered output of a utility to one of its fds
+typedef struct {
+    int fd;
+
+    //set once a write failed, with its errno
+    int error;
+
+    size_t len;
+    char buf[BUILTIN_BUFFER_SIZE];
+} outBuffer;
+
+//Buffers the output of a utility
+void outWrite(outBuffer *out, const char *s, size_t len);
+//Flushes it and gives the exit code of the utility, 128+SIGPIPE when the reader is gone
+int outDone(outBuffer *out, int code);
+
+//Looks a builtin up by name, NULL when there's none
+const builtinDesc *findBuiltin(const char *name);
+//Gives the name of the builtin at an index of the table, NULL past the last one
+const char *builtinName(size_t index);
+//Tells whether a utility can stand for the command given these arguments and this stdin
+int builtinUsable(const builtinDesc *desc, char **args, int in);
+//Runs a utility as a member of a job on a thread, which owns copies of the fds
+void startBuiltinThread(job *j, unsigned int procNo, const builtinDesc *desc,
+                        char **args, const int *fds, const char *command);
+
+#endif
@@ -1,335 +1,493 @@
 #include "cmd.h"
-
-/** \brief formatError
- * A function which processes the data of redirection and its type
- * when the input format has been detected an error
- * \author Y. LIN
- * \param char ***redirection: A pointer which points to the redirection
- * \param char ***redirectionType: A pointer which points to the redirectionType
- * \return None
+#include "vars.h"
+
+//Character classes of the lexer, 0 for the characters of a plain word
+#define CC_BLANK 0x01
+#define CC_PIPE 0x02
+#define CC_REDIR 0x04
+#define CC_AMP 0x08
+#define CC_QUOTE 0x10
+#define CC_ESCAPE 0x20
+#define CC_END 0x40
+#define CC_COMMENT 0x80
+#define CC_EXPAND 0x100
+#define CC_GLOB 0x200
+
+static const unsigned short charClass[256] = {
+  ['\0']=CC_END,
+  [' ']=CC_BLANK, ['\t']=CC_BLANK, ['\n']=CC_BLANK, ['\r']=CC_BLANK,
+  ['|']=CC_PIPE,
+  ['<']=CC_REDIR, ['>']=CC_REDIR,
+  ['&']=CC_AMP,
+  ['\'']=CC_QUOTE, ['"']=CC_QUOTE,
+  ['\\']=CC_ESCAPE,
+  ['#']=CC_COMMENT,
+  ['$']=CC_EXPAND,
+  ['*']=CC_GLOB, ['?']=CC_GLOB, ['[']=CC_GLOB
+};
+
+//What the pending redirection of stdin reads: a file, a here-document or a here-string
+#define LEX_DOC_NONE 0
+#define LEX_DOC_BODY 1
+#define LEX_DOC_STRIP 2
+#define LEX_DOC_STRING 3
+
+//A member of the pipeline while the line is being lexed
+typedef struct {
+  //index of its first argument in the argument table
+  size_t firstArg;
+
+  //number of arguments
+  unsigned int nbArgs;
+
+  //its redirections
+  cmdRedirection redirection;
+
+  //offsets of its text in the input
+  size_t textBegin, textEnd;
+
+  //the here-document its stdin reads plus one, 0 when it's not one
+  unsigned int heredoc;
+
+  //number of NAME=value words its arguments start with
+  unsigned int nbAssigns;
+} lexMember;
+
+//State of the lexer
+typedef struct {
+  arena *mem;
+
+  //the arguments of every member, separated by NULL
+  char **args;
+  size_t nbArgs, capArgs;
+
+  //the members of the pipeline
+  lexMember *members;
+  size_t nbMembers, capMembers;
+
+  //the redirection waiting for its file name, -1 when there's none
+  int pendingFd;
+  redirMode pendingMode;
+  int pendingDoc;
+
+  //the here-documents, their lines come after the line
+  cmdHeredoc *heredocs;
+  size_t nbHeredocs, capHeredocs;
+
+  //the command substitutions, run once the line is parsed
+  cmdSubstitution *substitutions;
+  size_t nbSubstitutions, capSubstitutions;
+
+  //the arguments which are patterns, and the offsets of the quoted characters
+  //of their pattern, those of the current word start at wordMetas
+  cmdGlob *globs;
+  size_t nbGlobs, capGlobs;
+  size_t *quotedMetas;
+  size_t nbQuotedMetas, capQuotedMetas, wordMetas;
+} lexState;
+
+/** \brief growArray
+ * A function which doubles the capacity of an array held by the arena
+ * \param arena *mem: The arena holding the array
+ * \param void *array: The array
+ * \param size_t used: The number of elements in use
+ * \param size_t *capacity: A pointer which points to the capacity, updated
+ * \param size_t eltSize: The size of an element
+ * \return The new array
  *
  */
-static void formatError(char ***redirection, char ***redirectionType) {
-  free((*redirection)[STDIN_FILENO]);
-  free((*redirection)[STDOUT_FILENO]);
-  free((*redirection)[STDERR_FILENO]);
-  free(*redirection);
-  *redirection=NULL;
-
-  free((*redirectionType)[0]);
-  free((*redirectionType)[1]);
-  free(*redirectionType);
-  *redirectionType=NULL;
+static void *growArray(arena *mem, void *array, size_t used, size_t *capacity, size_t eltSize) {
+  void *bigger;
+  *capacity=*capacity==0? 8:*capacity*2;
+  bigger=arenaAlloc(mem, *capacity*eltSize);
+  if(used!=0) {
+    memcpy(bigger, array, used*eltSize);
+  }
+  return bigger;
 }
 
-/** \brief detectDangerChar
- * A function which detects whether the current character is dangerous or not
- * \author Y. LIN
- * \param const char curChar: Current character
- * \return 0: when it's safe; 1: when it's dangerous
+/** \brief pushArg
+ * A function which appends an entry to the argument table
+ * \param lexState *lex: The state of the lexer
+ * \param char *arg: The argument, NULL to end a member
+ * \return None
  *
  */
-static int detectDangerChar(const char curChar) {
-    if((curChar==' ') ||
-       (curChar>=(char)46 && curChar<=(char)57) ||
-       (curChar>=(char)65 && curChar<=(char)90) ||
-       (curChar>=(char)97 && curChar<=(char)122)) {
-        // Safe char
-        // Space or number or alphphabet
-        return 0;
-    } else {
-        // Dangerous char
-        return 1;
-    }
+static void pushArg(lexState *lex, char *arg) {
+  if(lex->nbArgs==lex->capArgs) {
+    lex->args=(char **)growArray(lex->mem, lex->args, lex->nbArgs, &lex->capArgs, sizeof(char *));
+  }
+  lex->args[lex->nbArgs++]=arg;
 }
 
-/** \brief detectSpecialStd
- * A function which detects whether the current character is
- * a special std redirection input
- * \author Y. LIN
- * \param const char *curInput: Current input
- * \return 0: when it is not special; 1: when it's special; -1: when it is "2>&1"
+/** \brief beginMember
+ * A function which starts a new member of the pipeline
+ * \param lexState *lex: The state of the lexer
+ * \param size_t offset: The offset of the member in the input
+ * \return The new member
  *
  */
-static int detectSpecialStd(const char *curInput) {
-  if((*curInput)=='0') {
-        // 0<
-        if(*(curInput+1)=='<') {
-            return 1;
-        }
-    } else if((*curInput)=='1') {
-        // 1>
-        if(*(curInput+1)=='>') {
-            return 1;
-        }
-    } else if((*curInput)=='2') {
-        // 2>*
-        if(*(curInput+1)=='>') {
-            // 2>&1
-            if(!strncmp(curInput, "2>&1", 4)) {
-                return -1;
-            }
-            return 1;
-        }
-    } else if((*curInput)=='&') {
-        // &>
-        if(*(curInput+1)=='>') {
-            return 1;
-        }
-    }
-    return 0;
+static lexMember *beginMember(lexState *lex, size_t offset) {
+  lexMember *member;
+  if(lex->nbMembers==lex->capMembers) {
+    lex->members=(lexMember *)growArray(lex->mem, lex->members, lex->nbMembers, &lex->capMembers, sizeof(lexMember));
+  }
+  member=&lex->members[lex->nbMembers++];
+  memset(member, 0, sizeof(lexMember));
+  member->firstArg=lex->nbArgs;
+  member->textBegin=offset;
+  member->textEnd=offset;
+  return member;
 }
 
-/** \brief cmdInit
- * Initializes the pointer of the command
- * \author Y. LIN
- * \param cmd *cmd: A pointer which points to the command
- * \return None
+/** \brief isAssignment
+ * A function which tells whether a word is a NAME=value assignment:
+ * a name which no substitution is part of, then '='
+ * \param lexState *lex: The state of the lexer
+ * \param const char *word: The word
+ * \return 1: when it's an assignment; 0: otherwise
  *
  */
-static void cmdInit(cmd *cmd) {
-  cmd->initCmd=strdup("");
-  cmd->nbCmdMembers=0;
-  cmd->cmdMembers=NULL;
-  cmd->cmdMembersArgs=NULL;
-  cmd->redirection=NULL;
-  cmd->redirectionType=NULL;
+static int isAssignment(lexState *lex, const char *word) {
+  size_t len=strcspn(word, "="), sub=lex->nbSubstitutions;
+
+  if(word[len]!='=' || !validVarName(word, len)) {
+    return 0;
+  }
+  while(sub>0 && lex->substitutions[sub-1].word==word) {
+    if(lex->substitutions[--sub].offset<=len) {
+      return 0;
+    }
+  }
+  return 1;
 }
 
-/** \brief deleteBeginningBlank
- * A function which deletes the spaces in the beginning of current input
- * \author Y. LIN
- * \param const char *curInput: Current input
+/** \brief markQuoted
+ * A function which records the quoted characters of the current word
+ * which would be special in a pattern, they'll match themselves
+ * \param lexState *lex: The state of the lexer
+ * \param const char *word: The word
+ * \param const char *from: The first quoted character, unquoted in the word
+ * \param const char *to: The end of the quoted characters
  * \return None
  *
  */
-static void deleteBeginningBlank(char **curInput) {
-  while((**curInput)==' ') {(*curInput)++;}
+static void markQuoted(lexState *lex, const char *word, const char *from, const char *to) {
+  for(; from<to; from++) {
+    if(charClass[(unsigned char)*from]&(CC_GLOB|CC_ESCAPE)) {
+      if(lex->nbQuotedMetas==lex->capQuotedMetas) {
+        lex->quotedMetas=(size_t *)growArray(lex->mem, lex->quotedMetas, lex->nbQuotedMetas, &lex->capQuotedMetas, sizeof(size_t));
+      }
+      lex->quotedMetas[lex->nbQuotedMetas++]=(size_t)(from-word);
+    }
+  }
 }
 
-/** \brief deleteBackBlank
- * A function which deletes the spaces in the end of current input
- * \author Y. LIN
- * \param const char *curInput: Current input
+/** \brief addWord
+ * A function which gives a finished word to the current member,
+ * either as an argument or as the file of the pending redirection
+ * \param lexState *lex: The state of the lexer
+ * \param lexMember *member: The current member
+ * \param char *word: The word
+ * \param int wordQuoted: Whether the word held quotes or escapes
+ * \param int wordGlob: Whether the word held a *, ? or [ outside of quotes
  * \return None
  *
  */
-static void deleteBackBlank(char **curInput, size_t *memLen) {
-  (*curInput)--;
-  while((**curInput)==' ') {
-    (*memLen)--;
-    (*curInput)--;
+static void addWord(lexState *lex, lexMember *member, char *word, int wordQuoted, int wordGlob) {
+  size_t sub=lex->nbSubstitutions, firstMeta=lex->wordMetas;
+  int pattern=wordGlob;
+
+  // The substitutions of the word are the last ones
+  while(sub>0 && lex->substitutions[sub-1].word==word) {
+    cmdSubstitution *cur=&lex->substitutions[--sub];
+    cur->wordQuoted=wordQuoted;
+    // An output which is not quoted can hold a pattern
+    if(!cur->quoted && (cur->kind==SUBST_COMMAND || cur->kind==SUBST_VARIABLE)) {
+      pattern=1;
+    }
+  }
+
+  if(lex->pendingFd>=0 && lex->pendingDoc==LEX_DOC_STRING) {
+    // A here-string is the word and a newline
+    size_t len=strlen(word);
+    char *text=(char *)arenaAlloc(lex->mem, len+2);
+    memcpy(text, word, len);
+    text[len]='\n';
+    text[len+1]='\0';
+    for(; sub<lex->nbSubstitutions; sub++) {
+      lex->substitutions[sub].word=text;
+    }
+    member->redirection.file[STDIN_FILENO]=text;
+    member->redirection.mode[STDIN_FILENO]=HEREDOC;
+    member->heredoc=0;
+  } else if(lex->pendingFd>=0 && lex->pendingDoc!=LEX_DOC_NONE) {
+    // The word is the delimiter, the text comes with the next lines
+    cmdHeredoc *doc;
+    // Like in bash, the delimiter is not expanded
+    lex->nbSubstitutions=sub;
+    if(lex->nbHeredocs==lex->capHeredocs) {
+      lex->heredocs=(cmdHeredoc *)growArray(lex->mem, lex->heredocs, lex->nbHeredocs, &lex->capHeredocs, sizeof(cmdHeredoc));
+    }
+    doc=&lex->heredocs[lex->nbHeredocs++];
+    memset(doc, 0, sizeof(cmdHeredoc));
+    doc->member=(unsigned int)(member-lex->members);
+    doc->delimiter=word;
+    doc->stripTabs=lex->pendingDoc==LEX_DOC_STRIP;
+    doc->expand=!wordQuoted;
+    member->redirection.file[STDIN_FILENO]=NULL;
+    member->redirection.mode[STDIN_FILENO]=HEREDOC;
+    member->heredoc=(unsigned int)lex->nbHeredocs;
+  } else if(lex->pendingFd>=0) {
+    member->redirection.file[lex->pendingFd]=word;
+    member->redirection.mode[lex->pendingFd]=lex->pendingMode;
+    if(lex->pendingFd==STDIN_FILENO) {
+      member->heredoc=0;
+    }
+  } else {
+    // The assignments come before the command name
+    if(member->nbAssigns==member->nbArgs && isAssignment(lex, word)) {
+      member->nbAssigns++;
+    } else if(pattern) {
+      cmdGlob *glob;
+      if(lex->nbGlobs==lex->capGlobs) {
+        lex->globs=(cmdGlob *)growArray(lex->mem, lex->globs, lex->nbGlobs, &lex->capGlobs, sizeof(cmdGlob));
+      }
+      glob=&lex->globs[lex->nbGlobs++];
+      glob->word=word;
+      glob->firstQuoted=(unsigned int)firstMeta;
+      glob->nbQuoted=(unsigned int)(lex->nbQuotedMetas-firstMeta);
+      firstMeta=lex->nbQuotedMetas;
+    }
+    pushArg(lex, word);
+    member->nbArgs++;
   }
-  (*curInput)++;
+  // Only the quoted characters of a pattern are kept
+  lex->nbQuotedMetas=firstMeta;
+  lex->wordMetas=firstMeta;
+  lex->pendingFd=-1;
+  lex->pendingDoc=LEX_DOC_NONE;
 }
 
-/** \brief getMemberArg
- * A function which gets the member's arguments and updates the number of arguments
- * \author Y. LIN
- * \param char ***cmdMembersArgs: A pointer which points to the member's arguments
- * \param const char *cmdMembers: A pointer which points to the current member of command
- * \param unsigned int *nbMembersArgs: A pointer which points to the number of member's arguments
- * \return None
+/** \brief lexSubstitution
+ * A function which records the substitution starting at "$(", "<(" or ">(",
+ * the parentheses, quotes and escapes inside are matched to find its end
+ * \param lexState *lex: The state of the lexer
+ * \param lexMember *member: The current member
+ * \param char *word: The word it's part of
+ * \param char *out: Where its output goes in the word
+ * \param char *open: The "$(" in the input
+ * \param int quoted: Whether it's between double quotes
+ * \param substKind kind: What it's replaced by
+ * \return The character following its ')'; NULL when it's not closed
  *
  */
-static void getMemberArg(char ***cmdMembersArgs, const char *cmdMembers, unsigned int *nbMembersArgs) {
-  *cmdMembersArgs=(char **)malloc(sizeof(char *));
-  **cmdMembersArgs=NULL;
-  *nbMembersArgs=0;
-
-  while((*cmdMembers)!='<'&&(*cmdMembers)!='>'&&(*cmdMembers)!='\0') {
-      size_t argLen=0;
-      while((*cmdMembers)!=' '&&(*cmdMembers)!='<'&&(*cmdMembers)!='>'&&(*cmdMembers)!='\0') {
-          argLen++;
-          cmdMembers++;
-      }
-      *cmdMembersArgs=(char **)realloc(*cmdMembersArgs, (size_t)(*nbMembersArgs+2)*sizeof(char *));
-      (*cmdMembersArgs)[*nbMembersArgs]=strndup(cmdMembers-argLen, argLen);
-      (*cmdMembersArgs)[*nbMembersArgs+1]=NULL;
-      (*nbMembersArgs)++;
-      while(*cmdMembers==' ') {cmdMembers++;}
-      if(detectSpecialStd(cmdMembers)) {
-          // Beyond the special number
-          while((*cmdMembers)==' ') {cmdMembers++;}
-          cmdMembers++;
+static char *lexSubstitution(lexState *lex, lexMember *member, char *word, char *out, char *open, int quoted, substKind kind) {
+  cmdSubstitution *sub;
+  char *cur=open+2;
+  int depth=1;
+
+  for(; depth>0; cur++) {
+    if(*cur=='\0') {
+      return NULL;
+    } else if(*cur=='\\' && cur[1]!='\0') {
+      cur++;
+    } else if(*cur=='\'' || *cur=='"') {
+      char quote=*cur;
+      while(*++cur!=quote) {
+        if(*cur=='\0') {
+          return NULL;
+        }
+        if(quote=='"' && *cur=='\\' && cur[1]!='\0') {
+          cur++;
+        }
       }
+    } else if(*cur=='(') {
+      depth++;
+    } else if(*cur==')') {
+      depth--;
+    }
   }
+
+  if(lex->nbSubstitutions==lex->capSubstitutions) {
+    lex->substitutions=(cmdSubstitution *)growArray(lex->mem, lex->substitutions, lex->nbSubstitutions, &lex->capSubstitutions, sizeof(cmdSubstitution));
+  }
+  sub=&lex->substitutions[lex->nbSubstitutions++];
+  sub->kind=kind;
+  sub->member=(unsigned int)(member-lex->members);
+  sub->fd=-1;
+  sub->word=word;
+  sub->offset=(size_t)(out-word);
+  sub->quoted=quoted;
+  sub->wordQuoted=quoted;
+  // The text is ahead of out, it's copied before out writes over it
+  sub->text=arenaStrndup(lex->mem, open+2, (size_t)(cur-open-3));
+  return cur;
 }
 
-/** \brief getRedirection
- * A function which gets the member's redirection and updates the type of redirection
- * \author Y. LIN
- * \param char ***redirection: A pointer which points to the redirection
- * \param const char *cmdMembers: A pointer which points to the current member of command
- * \param char ***redirectionType: A pointer which points to the redirectionType
- * \return None
+/** \brief lexVariable
+ * A function which records the variable named after a '$': $NAME, ${NAME}, $? or $$
+ * \param lexState *lex: The state of the lexer
+ * \param lexMember *member: The current member
+ * \param char *word: The word it's part of
+ * \param char *out: Where its value goes in the word
+ * \param char *dollar: The '$' in the input
+ * \param int quoted: Whether it's between double quotes
+ * \return The character following the name; dollar itself when no name follows; NULL when ${ } is wrong
  *
  */
-static void getRedirection(char ***redirection, const char *cmdMembers, char ***redirectionType) {
-  //0: STDIN  1: STDOUT   2: STDERR
-  *redirection=(char **)malloc(3*sizeof(char *));
-  (*redirection)[0]=NULL;
-  (*redirection)[1]=NULL;
-  (*redirection)[2]=NULL;
-  //0: STDOUT  1: STDERR
-  *redirectionType=(char **)malloc(2*sizeof(char *));
-  (*redirectionType)[0]=NULL;
-  (*redirectionType)[1]=NULL;
-  int dirType=0;
-
-  while(*cmdMembers!='\0' && dirType!=-1) {
-    int spcStd = 0;
-    while((*cmdMembers)!='<' && (*cmdMembers)!='>' && (*cmdMembers)!='\0') {
-        spcStd=detectSpecialStd(cmdMembers);
-        if(spcStd) {
-            break;
-        } else {
-            cmdMembers++;
-        }
+static char *lexVariable(lexState *lex, lexMember *member, char *word, char *out, char *dollar, int quoted) {
+  char *name=dollar+1, *end;
+  cmdSubstitution *sub;
+
+  if(*name=='{') {
+    name++;
+    if((end=strchr(name, '}'))==NULL || end==name ||
+       !((end-name==1 && (*name=='?' || *name=='$')) || validVarName(name, (size_t)(end-name)))) {
+      return NULL;
     }
-    // If it hasn't redirection
-    if(*cmdMembers=='\0') {
-      free(*redirectionType);
-      *redirectionType=NULL;
-      break;
+  } else if(*name=='?' || *name=='$') {
+    end=name+1;
+  } else {
+    if(!validVarName(name, 1)) {
+      return dollar;
     }
+    for(end=name+1; validVarName(end, 1) || (*end>='0' && *end<='9'); end++) {}
+  }
 
-    dirType=-1;
-    size_t dirLen=0;
-    int dangerChar=0;
+  if(lex->nbSubstitutions==lex->capSubstitutions) {
+    lex->substitutions=(cmdSubstitution *)growArray(lex->mem, lex->substitutions, lex->nbSubstitutions, &lex->capSubstitutions, sizeof(cmdSubstitution));
+  }
+  sub=&lex->substitutions[lex->nbSubstitutions++];
+  sub->kind=SUBST_VARIABLE;
+  sub->member=(unsigned int)(member-lex->members);
+  sub->fd=-1;
+  sub->word=word;
+  sub->offset=(size_t)(out-word);
+  sub->quoted=quoted;
+  sub->wordQuoted=quoted;
+  sub->text=arenaStrndup(lex->mem, name, (size_t)(end-name));
+  return *end=='}'? end+1:end;
+}
 
-    // STDIN: <, 0<
-    if(!strncmp(cmdMembers, "<", 1) || !strncmp(cmdMembers, "0<", 2)) {
-        if(!strncmp(cmdMembers, "<", 1)) {
-          dangerChar=detectDangerChar(*(cmdMembers+1));
-        } else {
-          dangerChar=detectDangerChar(*(cmdMembers+2));
-        }
-        if(dangerChar) {
-          while((*cmdMembers)!=' '&&(*cmdMembers)!='\0') {cmdMembers++;}
-          dirType=-1;
-        } else {
-          dirType=STDIN_FILENO;
-        }
-    // STDOUT: >, >>, 1>
-    } else if(!strncmp(cmdMembers, ">", 1) ||
-              !strncmp(cmdMembers, ">>", 2) ||
-              !strncmp(cmdMembers, "1>", 2)) {
-
-        if(!strncmp(cmdMembers, ">>", 2) ||
-           !strncmp(cmdMembers, "1>", 2)) {
-          dangerChar=detectDangerChar(*(cmdMembers+2));
-        } else {
-          dangerChar=detectDangerChar(*(cmdMembers+1));
-        }
-        if(dangerChar) {
-          while((*cmdMembers)!=' '&&(*cmdMembers)!='\0') {cmdMembers++;}
-          dirType=-1;
-        } else {
-          dirType=STDOUT_FILENO;
-          free((*redirectionType)[0]);
-          if(!strncmp(cmdMembers, ">>", 2)) {
-            (*redirectionType)[0]=strdup("APPEND");
-          } else {
-            (*redirectionType)[0]=strdup("OVERRIDE");
-          }
-        }
-    // STDERR: 2>, 2>>, &>, 2>&1
-    } else if(!strncmp(cmdMembers, "2>>", 3) ||
-              !strncmp(cmdMembers, "2>", 2) ||
-              !strncmp(cmdMembers, ">&", 2) ||
-              !strncmp(cmdMembers, "2>&1", 4)) {
-        // 2>&1 and &> sends the output of the file descriptor 2, stderr
-        // to the same location as the file descriptor 1, stdout.
-        if(!strncmp(cmdMembers, "2>&1", 4)) {
-          dangerChar=!(*(cmdMembers+4)==' ');
-        } else if(!strncmp(cmdMembers, "2>>", 3)) {
-          dangerChar=detectDangerChar(*(cmdMembers+3));
-        } else {
-          dangerChar=detectDangerChar(*(cmdMembers+2));
-        }
-        if(dangerChar) {
-          while((*cmdMembers)!=' '&&(*cmdMembers)!='\0') {cmdMembers++;}
-          dirType=-1;
-        } else {
-          dirType=STDERR_FILENO;
-          free((*redirectionType)[1]);
-          if(!strncmp(cmdMembers, "2>>", 3)) {
-            (*redirectionType)[1]=strdup("APPEND");
-          } else {
-            (*redirectionType)[1]=strdup("OVERRIDE");
-            if(!strncmp(cmdMembers, "2>&1", 4) || !strncmp(cmdMembers, "&>", 2)) {
-              free((*redirectionType)[0]);
-              (*redirectionType)[0]=strdup("OVERRIDE");
-              dirType=3;
-            }
-          }
-        }
-    // Unrecognized redirection format
-    } else {
-      while((*cmdMembers)!=' '&&(*cmdMembers)!='\0') {cmdMembers++;}
-      dirType=-1;
-    }
+/** \brief lexRedirection
+ * A function which decodes a redirection operator
+ * <, <<, <<-, <<<, >, >>, n< n>, n>>, &>, &>>, 2>&1 and 1>&2 are recognized
+ * \param lexState *lex: The state of the lexer
+ * \param lexMember *member: The current member
+ * \param const char *op: The operator in the input
+ * \param int ioNumber: The fd written before the operator, -1 when there's none
+ * \return The number of characters of the operator; 0 when it's not recognized
+ *
+ */
+static int lexRedirection(lexState *lex, lexMember *member, const char *op, int ioNumber) {
+  int len=1;
 
-    // Arrive the beginning of the redir's name
-    if(1==spcStd) {
-      // Beyond the special number
-      while((*cmdMembers)==' ') {cmdMembers++;}
-      if(strlen(cmdMembers)>1) {
-        cmdMembers+=1;
-      } else {
-        dirType=-1;
-      }
-    } else if(-1==spcStd) {
-      // Beyond the special number -- "2>&1"
-      while((*cmdMembers)==' ') {cmdMembers++;}
-      if(strlen(cmdMembers)>4) {
-        cmdMembers+=4;
-      } else {
-        dirType=-1;
-      }
+  if(op[0]=='&') {
+    // &> and &>>
+    if(ioNumber>=0 || op[1]!='>') {
+      return 0;
     }
-    while((*cmdMembers)!='\0' &&
-          ((*cmdMembers)=='>'||(*cmdMembers)=='<'||(*cmdMembers)==' ')) {cmdMembers++;}
+    member->redirection.mode[STDERR_FILENO]=DUPLICATE;
+    member->redirection.file[STDERR_FILENO]=NULL;
+    lex->pendingFd=STDOUT_FILENO;
+    lex->pendingMode=op[2]=='>'? APPEND:OVERRIDE;
+    return op[2]=='>'? 3:2;
+  }
 
-    // Get the length of redir's name
-    while((*cmdMembers)!='\0'&&(*cmdMembers)!=' ') {
-      cmdMembers++;
-      dirLen++;
+  if(op[0]=='<') {
+    if(ioNumber>0 || op[1]=='>' || op[1]=='&') {
+      return 0;
     }
-
-    switch(dirType) {
-    // Wrong redirection
-    case -1:
-      formatError(redirection, redirectionType);
-      printf("Unrecognized redirection format\n");
-      break;
-    case STDIN_FILENO:
-      free((*redirection)[0]);
-      (*redirection)[0]=strndup(cmdMembers-dirLen, dirLen); break;
-    case STDOUT_FILENO:
-      free((*redirection)[1]);
-      (*redirection)[1]=strndup(cmdMembers-dirLen, dirLen); break;
-    case STDERR_FILENO:
-      free((*redirection)[2]);
-      (*redirection)[2]=strndup(cmdMembers-dirLen, dirLen); break;
-    // Stderr & stdout redirection
-    case 3:
-      free((*redirection)[1]);
-      free((*redirection)[2]);
-      (*redirection)[1]=strndup(cmdMembers-dirLen, dirLen);
-      (*redirection)[2]=strndup(cmdMembers-dirLen, dirLen);
-      break;
-    default: ;
+    lex->pendingFd=STDIN_FILENO;
+    lex->pendingMode=OVERRIDE;
+    if(op[1]!='<') {
+      return 1;
     }
+    if(op[2]=='<') {
+      lex->pendingDoc=LEX_DOC_STRING;
+      return 3;
+    }
+    if(op[2]=='-') {
+      lex->pendingDoc=LEX_DOC_STRIP;
+      return 3;
+    }
+    lex->pendingDoc=LEX_DOC_BODY;
+    return 2;
   }
 
-  // If the redirection don't have type
-  if((*redirectionType)!=NULL && (*redirectionType)[0]==NULL && (*redirectionType)[1]==NULL) {
-    free(*redirectionType);
-    *redirectionType=NULL;
+  // >, >>, >&
+  if(ioNumber==STDIN_FILENO) {
+    return 0;
   }
+  if(ioNumber<0) {
+    ioNumber=STDOUT_FILENO;
+  }
+  if(op[1]=='&') {
+    // 2>&1 and 1>&2 make an output follow the other one
+    if(op[2]!=(ioNumber==STDOUT_FILENO? '2':'1') || !(charClass[(unsigned char)op[3]]&(CC_BLANK|CC_PIPE|CC_END))) {
+      return 0;
+    }
+    member->redirection.mode[ioNumber]=DUPLICATE;
+    member->redirection.file[ioNumber]=NULL;
+    return 3;
+  }
+  if(op[1]=='>') {
+    len=2;
+    lex->pendingMode=APPEND;
+  } else if(op[1]=='<' || op[1]=='|') {
+    return 0;
+  } else {
+    lex->pendingMode=OVERRIDE;
+  }
+  lex->pendingFd=ioNumber;
+  return len;
+}
 
+/** \brief cmdInit
+ * Initializes the pointer of the command
+ * \author Y. LIN
+ * \param cmd *cmd: A pointer which points to the command
+ * \return None
+ *
+ */
+static void cmdInit(cmd *cmd) {
+  cmd->initCmd=NULL;
+  cmd->nbCmdMembers=0;
+  cmd->cmdMembers=NULL;
+  cmd->cmdMembersArgs=NULL;
+  cmd->nbMembersArgs=NULL;
+  cmd->cmdMembersAssigns=NULL;
+  cmd->nbMembersAssigns=NULL;
+  cmd->redirection=NULL;
+  cmd->background=0;
+  cmd->heredocs=NULL;
+  cmd->nbHeredocs=0;
+  cmd->nextHeredoc=0;
+  cmd->substitutions=NULL;
+  cmd->nbSubstitutions=0;
+  cmd->globs=NULL;
+  cmd->nbGlobs=0;
+  cmd->quotedMetas=NULL;
+  cmd->owned=NULL;
+  cmd->nbOwned=0;
+  cmd->capOwned=0;
+}
+
+/** \brief redirModeName
+ * A function which names a redirection mode
+ * \param redirMode mode: The redirection mode
+ * \return The name of the mode
+ *
+ */
+static const char *redirModeName(redirMode mode) {
+  switch(mode) {
+  case APPEND: return "APPEND";
+  case OVERRIDE: return "OVERRIDE";
+  case DUPLICATE: return "DUPLICATE";
+  case HEREDOC: return "HEREDOC";
+  default: return "NULL";
+  }
 }
 
 /** \brief printCmd
@@ -362,32 +520,49 @@ void printCmd(cmd *cmd) {
   for(cpt=0; cpt<cmd->nbCmdMembers; cpt++) {
     printf("nb_members_args [%d]: %d\n", cpt, cmd->nbMembersArgs[cpt]);
   }
+  // Prints commands's members' assignments
+  for(cpt=0; cpt<cmd->nbCmdMembers; cpt++) {
+    unsigned int cptAssign;
+    for(cptAssign=0; cptAssign<cmd->nbMembersAssigns[cpt]; cptAssign++) {
+      printf("cmd_members_assigns [%d][%d]: %s\n", cpt, cptAssign, cmd->cmdMembersAssigns[cpt][cptAssign]);
+    }
+  }
   // Prints commands's members' redirections
   for(cpt=0; cpt<cmd->nbCmdMembers; cpt++) {
     printf("redirection[%d][STDIN]: %s\n", cpt,
-         (cmd->redirection[cpt][STDIN_FILENO])==NULL? "NULL":cmd->redirection[cpt][STDIN_FILENO]);
+         (cmd->redirection[cpt].file[STDIN_FILENO])==NULL? "NULL":cmd->redirection[cpt].file[STDIN_FILENO]);
     printf("redirection[%d][STDOUT]: %s\n", cpt,
-         (cmd->redirection[cpt][STDOUT_FILENO])==NULL? "NULL":cmd->redirection[cpt][STDOUT_FILENO]);
+         (cmd->redirection[cpt].file[STDOUT_FILENO])==NULL? "NULL":cmd->redirection[cpt].file[STDOUT_FILENO]);
     printf("redirection[%d][STDERR]: %s\n", cpt,
-         (cmd->redirection[cpt][STDERR_FILENO])==NULL? "NULL":cmd->redirection[cpt][STDERR_FILENO]);
+         (cmd->redirection[cpt].file[STDERR_FILENO])==NULL? "NULL":cmd->redirection[cpt].file[STDERR_FILENO]);
   }
   // Prints commands's members' redirections' types
   for(cpt=0; cpt<cmd->nbCmdMembers; cpt++) {
-    if(cmd->redirectionType[cpt]!=NULL) {
-      printf("redirection_type[%d][STDOUT]: %s\n", cpt,
-             (cmd->redirectionType[cpt][0])==NULL? "NULL":cmd->redirectionType[cpt][0]);
-      printf("redirection_type[%d][STDERR]: %s\n", cpt,
-             (cmd->redirectionType[cpt][1])==NULL? "NULL":cmd->redirectionType[cpt][1]);
-    } else {
-      printf("redirection_type[%d]: NULL\n", cpt);
-    }
+    printf("redirection_type[%d][STDIN]: %s\n", cpt, redirModeName(cmd->redirection[cpt].mode[STDIN_FILENO]));
+    printf("redirection_type[%d][STDOUT]: %s\n", cpt, redirModeName(cmd->redirection[cpt].mode[STDOUT_FILENO]));
+    printf("redirection_type[%d][STDERR]: %s\n", cpt, redirModeName(cmd->redirection[cpt].mode[STDERR_FILENO]));
   }
   printf("*****************\n");
 }
 
+/** \brief setupCmd
+ * A function which prepares a command before its first parse
+ * The same command can then be parsed and freed again and again
+ * \param cmd *cmd: A pointer which points to the command
+ * \return None
+ *
+ */
+void setupCmd(cmd *cmd) {
+  cmdInit(cmd);
+  arenaInit(&cmd->mem);
+}
+
 /** \brief parseMembers
  * A function which parses the command's members of current input
  * Including initializing the initial_cmd, membres_cmd et nb_membres fields
+ * The input is lexed in a single pass driven by a character class table:
+ * the words are unquoted in place in a copy of the input held by the arena
+ * and the argument table points into it
  * \author Y. LIN
  * \param char *inputString: A pointer which points to the current input
  * \param cmd *cmd: A pointer which points to the command
@@ -395,123 +570,398 @@ void printCmd(cmd *cmd) {
  *
  */
 int parseMembers(char *inputString, cmd *cmd){
-    char *curIpt=inputString;
+    size_t inputLen=strlen(inputString);
+    char *buffer, *curIpt, *out, *word=NULL;
+    int wordQuoted=0, wordGlob=0, opLen;
     unsigned int cpt;
+    lexMember *member;
+    lexState lex;
     cmdInit(cmd);
 
-    free(cmd->initCmd);
-    cmd->initCmd=strdup(inputString);
-    cmd->nbCmdMembers=1;
+    cmd->initCmd=arenaStrndup(&cmd->mem, inputString, inputLen);
+
+    // The copy starts one character late: out, which writes the unquoted words,
+    // then always stays behind curIpt, which reads the input
+    buffer=(char *)arenaAlloc(&cmd->mem, inputLen+2);
+    memcpy(buffer+1, inputString, inputLen+1);
+    out=buffer;
+    curIpt=buffer+1;
+
+    memset(&lex, 0, sizeof(lex));
+    lex.mem=&cmd->mem;
+    lex.pendingFd=-1;
+    member=beginMember(&lex, 0);
+
+    while(1) {
+        unsigned short curClass=charClass[(unsigned char)*curIpt];
+        size_t offset=(size_t)(curIpt-buffer-1);
+
+        // A '#' starting a word comments the rest of the line out
+        if(curClass==CC_COMMENT) {
+            if(word==NULL) {
+                curClass=CC_END;
+            } else {
+                *out++=*curIpt++;
+                member->textEnd=(size_t)(curIpt-buffer-1);
+                continue;
+            }
+        }
+
+        // Plain characters, quotes, escapes and substitutions belong to the word
+        if((curClass&~(CC_QUOTE|CC_ESCAPE|CC_EXPAND|CC_GLOB))==0) {
+            if(word==NULL) {
+                word=out;
+            }
+            if(member->textEnd==member->textBegin) {
+                member->textBegin=offset;
+            }
+            if(curClass==0) {
+                char *run=curIpt;
+                while(charClass[(unsigned char)*curIpt]==0) {curIpt++;}
+                memmove(out, run, (size_t)(curIpt-run));
+                out+=curIpt-run;
+            } else if(curClass&CC_GLOB) {
+                wordGlob=1;
+                *out++=*curIpt++;
+            } else if(*curIpt=='$') {
+                // $( ) and $NAME are replaced by the output of the command and the value once the line is parsed
+                char *next;
+                if(curIpt[1]=='(') {
+                    next=lexSubstitution(&lex, member, word, out, curIpt, 0, SUBST_COMMAND);
+                } else if((next=lexVariable(&lex, member, word, out, curIpt, 0))==NULL) {
+                    fprintf(stderr, "Bad substitution.\n");
+                    return 1;
+                }
+                if(next==NULL) {
+                    fprintf(stderr, "Unmatched parenthesis.\n");
+                    return 1;
+                }
+                if(next==curIpt) {
+                    *out++=*curIpt++;
+                } else {
+                    curIpt=next;
+                }
+            } else if(*curIpt=='\\') {
+                wordQuoted=1;
+                curIpt++;
+                if(*curIpt!='\0') {
+                    *out++=*curIpt++;
+                } else {
+                    *out++='\\';
+                }
+                markQuoted(&lex, word, out-1, out);
+            } else if(*curIpt=='\'') {
+                char *close=strchr(curIpt+1, '\'');
+                wordQuoted=1;
+                if(close==NULL) {
+                    fprintf(stderr, "Unmatched quote.\n");
+                    return 1;
+                }
+                memmove(out, curIpt+1, (size_t)(close-curIpt-1));
+                markQuoted(&lex, word, out, out+(close-curIpt-1));
+                out+=close-curIpt-1;
+                curIpt=close+1;
+            } else {
+                char *quoted=out;
+                wordQuoted=1;
+                curIpt++;
+                while(*curIpt!='"') {
+                    if(*curIpt=='\0') {
+                        fprintf(stderr, "Unmatched quote.\n");
+                        return 1;
+                    }
+                    // Only \", \\, \$ and \` are escapes between double quotes
+                    if(*curIpt=='\\' && (curIpt[1]=='"' || curIpt[1]=='\\' || curIpt[1]=='$' || curIpt[1]=='`')) {
+                        curIpt++;
+                    } else if(*curIpt=='$' && curIpt[1]=='(') {
+                        if((curIpt=lexSubstitution(&lex, member, word, out, curIpt, 1, SUBST_COMMAND))==NULL) {
+                            fprintf(stderr, "Unmatched parenthesis.\n");
+                            return 1;
+                        }
+                        continue;
+                    } else if(*curIpt=='$') {
+                        char *next=lexVariable(&lex, member, word, out, curIpt, 1);
+                        if(next==NULL) {
+                            fprintf(stderr, "Bad substitution.\n");
+                            return 1;
+                        }
+                        if(next!=curIpt) {
+                            curIpt=next;
+                            continue;
+                        }
+                    }
+                    *out++=*curIpt++;
+                }
+                markQuoted(&lex, word, quoted, out);
+                curIpt++;
+            }
+            member->textEnd=(size_t)(curIpt-buffer-1);
+            continue;
+        }
+
+        // <( ) and >( ) are words, or parts of one, even as the file of a redirection
+        if((curClass&CC_REDIR) && curIpt[1]=='(') {
+            if(word==NULL) {
+                word=out;
+            }
+            if(member->textEnd==member->textBegin) {
+                member->textBegin=offset;
+            }
+            if((curIpt=lexSubstitution(&lex, member, word, out, curIpt, 0,
+                                       *curIpt=='<'? SUBST_PROCESS_IN:SUBST_PROCESS_OUT))==NULL) {
+                fprintf(stderr, "Unmatched parenthesis.\n");
+                return 1;
+            }
+            member->textEnd=(size_t)(curIpt-buffer-1);
+            continue;
+        }
 
-    //Get number of commands
-    while(*curIpt != '\0') {
-        if(*curIpt=='|') {
-            cmd->nbCmdMembers++;
+        // A delimiter ends the current word
+        if(word!=NULL) {
+            // A lone unquoted digit glued to a redirection is the redirected fd
+            if((curClass&CC_REDIR) && lex.pendingFd<0 && !wordQuoted &&
+               out-word==1 && *word>='0' && *word<='2' &&
+               (lex.nbSubstitutions==0 || lex.substitutions[lex.nbSubstitutions-1].word!=word)) {
+                if((opLen=lexRedirection(&lex, member, curIpt, *word-'0'))==0) {
+                    fprintf(stderr, "Unrecognized redirection format\n");
+                    return 1;
+                }
+                out=word;
+                word=NULL;
+                curIpt+=opLen;
+                member->textEnd=(size_t)(curIpt-buffer-1);
+                continue;
+            }
+            *out++='\0';
+            addWord(&lex, member, word, wordQuoted, wordGlob);
+            word=NULL;
+            wordQuoted=0;
+            wordGlob=0;
         }
+
+        if(curClass&CC_BLANK) {
+            curIpt++;
+        } else if((curClass&CC_AMP) && curIpt[1]!='>') {
+            // A trailing '&' runs the line in the background
+            char *rest=curIpt+1;
+            while(charClass[(unsigned char)*rest]&CC_BLANK) {rest++;}
+            if(lex.pendingFd>=0 || (*rest!='\0' && *rest!='#') || member->textEnd==member->textBegin) {
+                fprintf(stderr, "Syntax error near '&'\n");
+                return 1;
+            }
+            cmd->background=1;
+            pushArg(&lex, NULL);
+            break;
+        } else if(curClass&(CC_REDIR|CC_AMP)) {
+            if(lex.pendingFd>=0 || (opLen=lexRedirection(&lex, member, curIpt, -1))==0) {
+                fprintf(stderr, "Unrecognized redirection format\n");
+                return 1;
+            }
+            if(member->textEnd==member->textBegin) {
+                member->textBegin=offset;
+            }
+            curIpt+=opLen;
+            member->textEnd=(size_t)(curIpt-buffer-1);
+        } else {
+            // End of a member: '|' or the end of the input
+            if(lex.pendingFd>=0) {
+                fprintf(stderr, "Unrecognized redirection format\n");
+                return 1;
+            }
+            pushArg(&lex, NULL);
+            if(curClass&CC_END) {
+                break;
+            }
             curIpt++;
+            member=beginMember(&lex, offset+1);
+        }
     }
 
-    curIpt=inputString;
-    cmd->cmdMembers=(char **)malloc(sizeof(char *)*(size_t)cmd->nbCmdMembers);
+    // Lay the members out in the command
+    cmd->nbCmdMembers=(unsigned int)lex.nbMembers;
+    cmd->cmdMembers=(char **)arenaAlloc(&cmd->mem, sizeof(char *)*cmd->nbCmdMembers);
+    cmd->cmdMembersArgs=(char ***)arenaAlloc(&cmd->mem, sizeof(char **)*cmd->nbCmdMembers);
+    cmd->nbMembersArgs=(unsigned int *)arenaAlloc(&cmd->mem, sizeof(unsigned int)*cmd->nbCmdMembers);
+    cmd->cmdMembersAssigns=(char ***)arenaAlloc(&cmd->mem, sizeof(char **)*cmd->nbCmdMembers);
+    cmd->nbMembersAssigns=(unsigned int *)arenaAlloc(&cmd->mem, sizeof(unsigned int)*cmd->nbCmdMembers);
+    cmd->redirection=(cmdRedirection *)arenaAlloc(&cmd->mem, sizeof(cmdRedirection)*cmd->nbCmdMembers);
     for(cpt=0; cpt<cmd->nbCmdMembers; cpt++) {
-        size_t memLen=0;
-
-        //delete stared blank
-        deleteBeginningBlank(&curIpt);
-        while(*curIpt!='|' && *curIpt!='\0') {
-            memLen++;
-            curIpt++;
+        member=&lex.members[cpt];
+        cmd->cmdMembers[cpt]=arenaStrndup(&cmd->mem, cmd->initCmd+member->textBegin, member->textEnd-member->textBegin);
+        cmd->cmdMembersAssigns[cpt]=lex.args+member->firstArg;
+        cmd->nbMembersAssigns[cpt]=member->nbAssigns;
+        cmd->cmdMembersArgs[cpt]=lex.args+member->firstArg+member->nbAssigns;
+        cmd->nbMembersArgs[cpt]=member->nbArgs-member->nbAssigns;
+        cmd->redirection[cpt]=member->redirection;
+        // Only the last redirection of stdin is used
+        if(member->heredoc>0) {
+            lex.heredocs[member->heredoc-1].used=1;
         }
+    }
+    cmd->heredocs=lex.heredocs;
+    cmd->nbHeredocs=(unsigned int)lex.nbHeredocs;
+    cmd->substitutions=lex.substitutions;
+    cmd->nbSubstitutions=(unsigned int)lex.nbSubstitutions;
+    cmd->globs=lex.globs;
+    cmd->nbGlobs=(unsigned int)lex.nbGlobs;
+    cmd->quotedMetas=lex.quotedMetas;
 
-        //delete back blank
-        deleteBackBlank(&curIpt, &memLen);
-        curIpt-=memLen;
+    return 0;
+}
 
-        //Get cmdMembers
-        cmd->cmdMembers[cpt]=strndup(curIpt, memLen);
+/** \brief pendingHeredoc
+ * A function which tells whether a here-document still waits for its lines
+ * \param cmd *cmd: A pointer which points to the command
+ * \return The delimiter of the here-document; NULL when every one is complete
+ *
+ */
+const char *pendingHeredoc(cmd *cmd) {
+  return cmd->nextHeredoc<cmd->nbHeredocs? cmd->heredocs[cmd->nextHeredoc].delimiter:NULL;
+}
 
-        //Get redirection
-        if(cmd->redirection==NULL) {
-            cmd->redirection=(char ***)malloc(sizeof(char **));
-            cmd->redirectionType=(char ***)malloc(sizeof(char **));
-        } else {
-            cmd->redirection=(char ***)realloc(cmd->redirection, sizeof(char **)*(cpt+1));
-            cmd->redirectionType=(char ***)realloc(cmd->redirectionType, sizeof(char **)*(cpt+1));
-        }
-        getRedirection(&(cmd->redirection[cpt]), cmd->cmdMembers[cpt], &(cmd->redirectionType[cpt]));
+/** \brief addHeredocLine
+ * A function which gives the line following the command to the here-document
+ * waiting for it; the delimiter, or the end of the input, completes it
+ * \param cmd *cmd: A pointer which points to the command
+ * \param const char *line: The line, NULL at the end of the input
+ * \return None
+ *
+ */
+void addHeredocLine(cmd *cmd, const char *line) {
+  cmdHeredoc *doc;
+  size_t len;
 
-        //Get cmdMembersArgs
-        if(cmd->cmdMembersArgs==NULL) {
-            cmd->cmdMembersArgs=(char ***)malloc(sizeof(char **));
-            cmd->nbMembersArgs=(unsigned int *)malloc(sizeof(unsigned int));
-        } else {
-            cmd->cmdMembersArgs=(char ***)realloc(cmd->cmdMembersArgs, sizeof(char **)*(cpt+1));
-            cmd->nbMembersArgs=(unsigned int *)realloc(cmd->nbMembersArgs, sizeof(unsigned int)*(cpt+1));
-        }
-        getMemberArg(&(cmd->cmdMembersArgs[cpt]), cmd->cmdMembers[cpt], &(cmd->nbMembersArgs[cpt]));
+  if(cmd->nextHeredoc>=cmd->nbHeredocs) {
+    return;
+  }
+  doc=&cmd->heredocs[cmd->nextHeredoc];
+  if(line!=NULL && doc->stripTabs) {
+    while(*line=='\t') {line++;}
+  }
+  if(line==NULL || !strcmp(line, doc->delimiter)) {
+    if(doc->body==NULL) {
+      doc->body=(char *)calloc(1, 1);
+    }
+    if(doc->used) {
+      cmd->redirection[doc->member].file[STDIN_FILENO]=doc->body;
+    }
+    cmd->nextHeredoc++;
+    return;
+  }
 
-        //find next cmd (include blank)
-        curIpt=index(curIpt, '|');
-        if(curIpt!=NULL) {
-            curIpt++;
-        } else {
-            break;
+  // Large texts stay out of the arena, which would keep their size from one line to the next
+  len=strlen(line);
+  if(doc->len+len+2>doc->cap) {
+    while(doc->len+len+2>doc->cap) {
+      doc->cap=doc->cap==0? 256:doc->cap*2;
+    }
+    doc->body=(char *)realloc(doc->body, doc->cap);
+  }
+  memcpy(doc->body+doc->len, line, len);
+  doc->len+=len;
+  doc->body[doc->len++]='\n';
+  doc->body[doc->len]='\0';
+}
+
+/** \brief parseHeredocs
+ * A function which reads the text of the here-documents whose delimiter is
+ * not quoted like a word between double quotes: $NAME, ${NAME} and $( ) are
+ * recorded as substitutions of the text, which expandCmd runs, and \$, \`
+ * and \\ are unquoted in place; a backslash before a newline joins the lines
+ * \param cmd *cmd: A pointer which points to the command, its here-documents are complete
+ * \return 0: when every text is read; 1: when a substitution is wrong
+ *
+ */
+int parseHeredocs(cmd *cmd) {
+  unsigned int cpt, first;
+  lexMember docMember;
+  lexState lex;
+
+  memset(&lex, 0, sizeof(lex));
+  lex.mem=&cmd->mem;
+  lex.members=&docMember;
+  lex.substitutions=cmd->substitutions;
+  lex.nbSubstitutions=lex.capSubstitutions=cmd->nbSubstitutions;
+  for(cpt=0; cpt<cmd->nbHeredocs && cpt<cmd->nextHeredoc; cpt++) {
+    cmdHeredoc *doc=&cmd->heredocs[cpt];
+    char *cur=doc->body, *out=doc->body, *next;
+    if(!doc->expand || !doc->used) {
+      continue;
+    }
+    // Read once, expandCmd may be run again
+    doc->expand=0;
+    first=(unsigned int)lex.nbSubstitutions;
+    while(*cur!='\0') {
+      if(*cur=='\\' && (cur[1]=='$' || cur[1]=='`' || cur[1]=='\\')) {
+        cur++;
+      } else if(*cur=='\\' && cur[1]=='\n') {
+        cur+=2;
+        continue;
+      } else if(*cur=='$' && cur[1]=='(') {
+        if((cur=lexSubstitution(&lex, &docMember, doc->body, out, cur, 1, SUBST_COMMAND))==NULL) {
+          fprintf(stderr, "Unmatched parenthesis.\n");
+          return 1;
         }
-   }
-   for(cpt=0; cpt<cmd->nbCmdMembers; cpt++) {
-        if(cmd->redirection[cpt]==NULL) {
-            //Format has error
-            return 1;
+        continue;
+      } else if(*cur=='$') {
+        if((next=lexVariable(&lex, &docMember, doc->body, out, cur, 1))==NULL) {
+          fprintf(stderr, "Bad substitution.\n");
+          return 1;
         }
-   }
-
-   return 0;
+        if(next!=cur) {
+          cur=next;
+          continue;
+        }
+      }
+      *out++=*cur++;
+    }
+    *out='\0';
+    doc->len=(size_t)(out-doc->body);
+    for(; first<lex.nbSubstitutions; first++) {
+      lex.substitutions[first].member=doc->member;
+    }
+    cmd->substitutions=lex.substitutions;
+    cmd->nbSubstitutions=(unsigned int)lex.nbSubstitutions;
+  }
+  return 0;
 }
 
 /** \brief freeCmd
  * A function which frees memory associated to a command
+ * The whole command lives in its arena, which is reset at once,
+ * but for the texts of the here-documents and what the expansion made;
+ * the pipes of the process substitutions are closed
  * \author Y. LIN
  * \param cmd *cmd: A pointer which points to the command
  * \return None
  *
  */
 void freeCmd(cmd  *cmd){
-  // Frees commands
-  free(cmd->initCmd);
   unsigned int cpt;
-  for(cpt=0; cpt<cmd->nbCmdMembers; cpt++) {
-    free(cmd->cmdMembers[cpt]);
+  for(cpt=0; cpt<cmd->nbHeredocs; cpt++) {
+    free(cmd->heredocs[cpt].body);
   }
-  free(cmd->cmdMembers);
-  // Frees commands's members' arguments
-  for(cpt=0; cpt<cmd->nbCmdMembers; cpt++) {
-    cmd->nbMembersArgs[cpt]++;
-    while(cmd->nbMembersArgs[cpt]!=0) {
-      free(cmd->cmdMembersArgs[cpt][--cmd->nbMembersArgs[cpt]]);
+  for(cpt=0; cpt<cmd->nbSubstitutions; cpt++) {
+    if(cmd->substitutions[cpt].fd>=0) {
+      close(cmd->substitutions[cpt].fd);
     }
-    free(cmd->cmdMembersArgs[cpt]);
   }
-  free(cmd->nbMembersArgs);
-  free(cmd->cmdMembersArgs);
-  // Frees commands's members' redirections
-  for(cpt=0; cpt<cmd->nbCmdMembers; cpt++) {
-    if(cmd->redirection[cpt] != NULL) {
-      free(cmd->redirection[cpt][STDIN_FILENO]);
-      free(cmd->redirection[cpt][STDOUT_FILENO]);
-      free(cmd->redirection[cpt][STDERR_FILENO]);
-    }
-    free(cmd->redirection[cpt]);
-  }
-  free(cmd->redirection);
-  // Frees commands's members' redirections' types
-  for(cpt=0; cpt<cmd->nbCmdMembers; cpt++) {
-    if(cmd->redirectionType[cpt] != NULL) {
-      free(cmd->redirectionType[cpt][0]);
-      free(cmd->redirectionType[cpt][1]);
-    }
-    free(cmd->redirectionType[cpt]);
+  for(cpt=0; cpt<cmd->nbOwned; cpt++) {
+    free(cmd->owned[cpt]);
   }
-  free(cmd->redirectionType);
+  free(cmd->owned);
+  arenaReset(&cmd->mem);
+  cmdInit(cmd);
+}
 
-  cmd->nbCmdMembers=0;
+/** \brief releaseCmd
+ * A function which gives the memory kept by a command back to the system
+ * \param cmd *cmd: A pointer which points to the command
+ * \return None
+ *
+ */
+void releaseCmd(cmd *cmd) {
+  freeCmd(cmd);
+  arenaRelease(&cmd->mem);
+  cmdInit(cmd);
 }
@@ -5,11 +5,21 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include "arena.h"
 
 //Command is well-formed
 #define MYSHELL_CMD_OK 0
-#define APPEND 1
-#define OVERRIDE 2
+
+//Redirection modes
+typedef enum {
+    NOREDIR=0,
+    APPEND=1,
+    OVERRIDE=2,
+    //the output is a copy of the other one (2>&1, 1>&2)
+    DUPLICATE=3,
+    //the "file" of stdin is the text it's given (<<, <<-, <<<)
+    HEREDOC=4
+} redirMode;
 
 //To print the command
 #define __DEBUG__
@@ -23,6 +33,70 @@
 #define DEBUG(format,...)
 #endif
 
+typedef struct {
+    //redirection file of each std fd (STDIN_FILENO...), NULL when not redirected
+    char *file[3];
+
+    //the redirection mode (append vs. override) of each std fd
+    redirMode mode[3];
+} cmdRedirection;
+
+typedef struct {
+    //the member whose stdin it is, and whether it still is once the line is parsed
+    unsigned int member;
+    int used;
+
+    //the line which ends it, and whether its lines lose their leading tabs (<<-)
+    char *delimiter;
+    int stripTabs;
+
+    //whether its $NAME and $( ) are replaced: the delimiter holds no quotes
+    int expand;
+
+    //its text so far
+    char *body;
+    size_t len, cap;
+} cmdHeredoc;
+
+//What a substitution is replaced by
+typedef enum {
+    //the output of its command, $( )
+    SUBST_COMMAND=0,
+    //a /dev/fd path the member reads what its command writes from, <( )
+    SUBST_PROCESS_IN=1,
+    //a /dev/fd path the member writes what its command reads to, >( )
+    SUBST_PROCESS_OUT=2,
+    //the value of a variable, $NAME or ${NAME}
+    SUBST_VARIABLE=3
+} substKind;
+
+typedef struct {
+    substKind kind;
+
+    //the member it's part of, and the end of the pipe it gets as /dev/fd/N, -1 when there's none
+    unsigned int member;
+    int fd;
+
+    //the word it's part of, and where its output goes in that word
+    char *word;
+    size_t offset;
+
+    //whether it's between double quotes, and whether its word holds quotes
+    int quoted, wordQuoted;
+
+    //the command line between the parentheses, or the name of the variable
+    char *text;
+} cmdSubstitution;
+
+//An argument holding a *, ? or [ outside of quotes, or a substitution which can bring one
+typedef struct {
+    //the word as parsed
+    char *word;
+
+    //its quoted *, ?, [ and \ match themselves: their offsets are a range of quotedMetas
+    unsigned int firstQuoted, nbQuoted;
+} cmdGlob;
+
 typedef struct {
     //the command originally inputed by the user
     char *initCmd;
@@ -33,26 +107,59 @@ typedef struct {
     //each position holds a command member
     char **cmdMembers;
 
-    //cmd_members_args[i][j] holds the jth argument of the ith member
+    //cmd_members_args[i][j] holds the jth argument of the ith member,
+    //the rows are slices of one contiguous NULL-separated table
     char ***cmdMembersArgs;
 
     //number of arguments per member
     unsigned int *nbMembersArgs;
 
-    //the path to the redirection file
-    char ***redirection;
+    //the NAME=value words before the arguments of each member, and their number
+    char ***cmdMembersAssigns;
+    unsigned int *nbMembersAssigns;
+
+    //the redirections of each member
+    cmdRedirection *redirection;
+
+    //whether the line ends with '&'
+    int background;
+
+    //the here-documents of the line in order, those from nextHeredoc on wait for their lines
+    cmdHeredoc *heredocs;
+    unsigned int nbHeredocs, nextHeredoc;
+
+    //the command and process substitutions of the line in order, run by expandCmd
+    cmdSubstitution *substitutions;
+    unsigned int nbSubstitutions;
+
+    //the arguments which are patterns in order, replaced by the paths they match by expandCmd
+    cmdGlob *globs;
+    unsigned int nbGlobs;
+    size_t *quotedMetas;
+
+    //memory given by the expansion, kept out of the arena like the here-documents
+    void **owned;
+    unsigned int nbOwned, capOwned;
 
-    //the redirection type (append vs. override)
-    char ***redirectionType;
+    //holds every string and table above, reset at once by freeCmd
+    arena mem;
 } cmd;
 
+//Prepares a cmd before its first parse
+void setupCmd(cmd *cmd);
 //Prints the command
 void printCmd(cmd *cmd);
-//Frees memory associated to a cmd
+//Frees memory associated to a cmd, it can be parsed again afterwards
 void freeCmd(cmd *cmd);
-//Frees memory associated to a error cmd
-void freeErrorCmd(cmd *cmd);
+//Gives the memory kept by a cmd back to the system
+void releaseCmd(cmd *cmd);
 //Initializes the initial_cmd, membres_cmd et nb_membres fields
 int parseMembers(char *s, cmd *c);
+//Gives the delimiter of the here-document waiting for its lines, NULL when there's none
+const char *pendingHeredoc(cmd *c);
+//Gives the next line of the input to the here-document waiting for it, NULL at the end of the input
+void addHeredocLine(cmd *c, const char *line);
+//Records the substitutions of the complete here-documents whose delimiter is not quoted
+int parseHeredocs(cmd *c);
 
 #endif
@@ -0,0 +1,614 @@
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <readline/readline.h>
+#include "shell_fct.h"
+
+//Changes of a PATH directory which add or remove names
+#define COMPLETE_WATCH_MASK (IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF)
+
+typedef struct {
+    //the last character of the name the node stands for
+    char c;
+
+    //the first of its children, sorted by character, and its next sibling; -1 when none
+    int child, sibling;
+
+    //number of PATH directories (and builtins) which provide the name ending here
+    int count;
+} trieNode;
+
+typedef struct {
+    char *path;
+
+    //its inotify watch; -1 when it could not be watched, its mtime is checked instead
+    int wd;
+    struct timespec mtime;
+
+    //what it is, to read it once when PATH names it twice; 0 when it can't be read
+    dev_t dev;
+    ino_t ino;
+} pathDir;
+
+typedef struct {
+    //the absolute path of the directory
+    char *path;
+
+    //when it was listed
+    struct timespec mtime;
+    ino_t ino;
+
+    //the names, one after the other, a '/' ending those of the directories
+    char *names;
+    size_t size, nbNames;
+
+    //when it was used last, the least recently used one is dropped
+    unsigned long used;
+} dirListing;
+
+//The names of the commands, node 0 is the root
+static trieNode *trie = NULL;
+static int nbNodes = 0, capNodes = 0;
+
+//The PATH the trie was built from, and its directories
+static char *indexedPath = NULL;
+static pathDir *pathDirs = NULL;
+static size_t nbPathDirs = 0;
+static int inotifyFd = -1;
+
+static dirListing dirCache[COMPLETE_DIR_CACHE];
+static unsigned long dirClock = 0;
+
+//The matches of the completion in progress, given one at a time to readline
+static char **matches = NULL;
+static size_t nbMatches = 0, capMatches = 0, nextMatch = 0;
+
+/** \brief trieChild
+ * A function which finds the child of a node for a character, creating it if asked
+ * \param int node: The node
+ * \param char c: The character
+ * \param int create: Whether a missing child is created
+ * \return The child; -1 when it's missing
+ *
+ */
+static int trieChild(int node, char c, int create) {
+  int *link=&trie[node].child;
+
+  while(*link>=0 && trie[*link].c<c) {
+    link=&trie[*link].sibling;
+  }
+  if(*link>=0 && trie[*link].c==c) {
+    return *link;
+  }
+  if(!create) {
+    return -1;
+  }
+  if(nbNodes==capNodes) {
+    // The link points into the array, it's found again once it's moved
+    ptrdiff_t offset=(int *)link-(int *)trie;
+    capNodes=capNodes==0? 4096:capNodes*2;
+    trie=(trieNode *)realloc(trie, sizeof(trieNode)*(size_t)capNodes);
+    link=(int *)trie+offset;
+  }
+  trie[nbNodes].c=c;
+  trie[nbNodes].child=-1;
+  trie[nbNodes].sibling=*link;
+  trie[nbNodes].count=0;
+  *link=nbNodes;
+  return nbNodes++;
+}
+
+/** \brief trieUpdate
+ * A function which adds a name to the trie or takes it away
+ * \param const char *name: The name
+ * \param int delta: 1 when a directory provides it, -1 when it doesn't any more
+ * \return None
+ *
+ */
+static void trieUpdate(const char *name, int delta) {
+  int node=0;
+
+  for(; *name!='\0' && node>=0; name++) {
+    node=trieChild(node, *name, delta>0);
+  }
+  if(node>0) {
+    trie[node].count+=delta;
+    if(trie[node].count<0) {
+      trie[node].count=0;
+    }
+  }
+}
+
+/** \brief listDirectory
+ * A function which reads a directory with getdents64, a large buffer at a time
+ * \param int dirFd: The directory
+ * \param void (*visit)(const char *name, unsigned char type, void *data): Called for each entry but . and ..
+ * \param void *data: Given to visit
+ * \return 0: when the whole directory was read; -1: otherwise
+ *
+ */
+static int listDirectory(int dirFd, void (*visit)(const char *name, unsigned char type, void *data), void *data) {
+  char *buf=(char *)malloc(COMPLETE_DENTS_BUFFER);
+  ssize_t nb, pos;
+
+  while((nb=getdents64(dirFd, buf, COMPLETE_DENTS_BUFFER))>0) {
+    for(pos=0; pos<nb;) {
+      struct dirent64 *entry=(struct dirent64 *)(buf+pos);
+      pos+=entry->d_reclen;
+      if(entry->d_name[0]=='.' && (entry->d_name[1]=='\0' ||
+                                   (entry->d_name[1]=='.' && entry->d_name[2]=='\0'))) {
+        continue;
+      }
+      visit(entry->d_name, entry->d_type, data);
+    }
+  }
+  free(buf);
+  return nb<0? -1:0;
+}
+
+/** \brief addCommand
+ * A visitor which puts an entry of a PATH directory in the trie
+ * Only the subdirectories are left out: the other entries aren't checked
+ * with a stat each, which would be slow on network mounts
+ * \param const char *name: The entry
+ * \param unsigned char type: Its d_type
+ * \param void *data: Unused
+ * \return None
+ *
+ */
+static void addCommand(const char *name, unsigned char type, void *data) {
+  if(type!=DT_DIR) {
+    trieUpdate(name, 1);
+  }
+}
+
+/** \brief freeIndex
+ * A function which forgets the trie and stops watching the PATH directories
+ * \return None
+ *
+ */
+static void freeIndex(void) {
+  size_t cpt;
+  for(cpt=0; cpt<nbPathDirs; cpt++) {
+    if(pathDirs[cpt].wd>=0) {
+      inotify_rm_watch(inotifyFd, pathDirs[cpt].wd);
+    }
+    free(pathDirs[cpt].path);
+  }
+  free(pathDirs);
+  pathDirs=NULL;
+  nbPathDirs=0;
+  free(indexedPath);
+  indexedPath=NULL;
+  nbNodes=0;
+}
+
+/** \brief indexDirectory
+ * A function which reads a PATH directory into the trie
+ * \param pathDir *dir: The directory, its watch is already set
+ * \return None
+ *
+ */
+static void indexDirectory(pathDir *dir) {
+  struct stat st;
+  int fd=open(dir->path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+
+  if(fd<0) {
+    return;
+  }
+  if(fstat(fd, &st)==0) {
+    dir->mtime=st.st_mtim;
+  }
+  listDirectory(fd, addCommand, NULL);
+  close(fd);
+}
+
+/** \brief sameDirectory
+ * A function which tells whether a directory is already in the index,
+ * under its name or another one like /bin for /usr/bin
+ * \param const struct stat *st: What the directory is
+ * \return 1: when it's indexed; 0: otherwise
+ *
+ */
+static int sameDirectory(const struct stat *st) {
+  size_t cpt;
+  for(cpt=0; cpt<nbPathDirs; cpt++) {
+    if(pathDirs[cpt].ino==st->st_ino && pathDirs[cpt].dev==st->st_dev) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/** \brief watchedDirectory
+ * A function which gives the PATH directory an inotify watch belongs to
+ * \param int wd: The watch
+ * \return The directory; NULL when the watch is not one of the index
+ *
+ */
+static pathDir *watchedDirectory(int wd) {
+  size_t cpt;
+  for(cpt=0; cpt<nbPathDirs; cpt++) {
+    if(pathDirs[cpt].wd==wd) {
+      return &pathDirs[cpt];
+    }
+  }
+  return NULL;
+}
+
+/** \brief buildIndex
+ * A function which builds the trie of the commands from PATH and the builtins,
+ * watching every directory with inotify so that it's kept up to date
+ * \return None
+ *
+ */
+static void buildIndex(void) {
+  const char *path=getVar("PATH")!=NULL? getVar("PATH"):"";
+  const char *dir, *end;
+  size_t cpt;
+  const char *name;
+  struct stat st;
+
+  freeIndex();
+  if(capNodes==0) {
+    capNodes=4096;
+    trie=(trieNode *)malloc(sizeof(trieNode)*(size_t)capNodes);
+  }
+  trie[0].c='\0';
+  trie[0].child=trie[0].sibling=-1;
+  trie[0].count=0;
+  nbNodes=1;
+  indexedPath=strdup(path);
+
+  for(cpt=0; (name=builtinName(cpt))!=NULL; cpt++) {
+    trieUpdate(name, 1);
+  }
+  for(dir=path; ; dir=end+1) {
+    end=strchrnul(dir, ':');
+    // An empty element of PATH is the working directory, it's completed as files are
+    if(end>dir) {
+      char *dirPath=strndup(dir, (size_t)(end-dir));
+      int known=stat(dirPath, &st)==0;
+      // A directory read twice would provide its names twice, and one watch reports them once
+      if(known && sameDirectory(&st)) {
+        free(dirPath);
+      } else {
+        pathDirs=(pathDir *)realloc(pathDirs, sizeof(pathDir)*(nbPathDirs+1));
+        pathDirs[nbPathDirs].path=dirPath;
+        pathDirs[nbPathDirs].dev=known? st.st_dev:0;
+        pathDirs[nbPathDirs].ino=known? st.st_ino:0;
+        pathDirs[nbPathDirs].wd=inotifyFd<0? -1:
+          inotify_add_watch(inotifyFd, dirPath, COMPLETE_WATCH_MASK);
+        pathDirs[nbPathDirs].mtime.tv_sec=pathDirs[nbPathDirs].mtime.tv_nsec=0;
+        indexDirectory(&pathDirs[nbPathDirs]);
+        nbPathDirs++;
+      }
+    }
+    if(*end=='\0') {
+      break;
+    }
+  }
+}
+
+/** \brief pathChanged
+ * An event handler which follows the changes of the PATH directories:
+ * a name created or removed is put in the trie or taken away, and dropped
+ * from the cache of "hash" which may hold another directory for it
+ * The events of watches which are not in the index any more are ignored
+ * \param int fd: The inotify fd
+ * \param unsigned int events: The EPOLL* flags
+ * \param void *data: Unused
+ * \return None
+ *
+ */
+static void pathChanged(int fd, unsigned int events, void *data) {
+  char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+  ssize_t nb, pos;
+  int rebuild=0;
+
+  while((nb=read(fd, buf, sizeof(buf)))>0) {
+    for(pos=0; pos<nb;) {
+      struct inotify_event *ev=(struct inotify_event *)(buf+pos);
+      pos+=(ssize_t)sizeof(struct inotify_event)+ev->len;
+      if(ev->mask&IN_Q_OVERFLOW) {
+        rebuild=1;
+      } else if(indexedPath==NULL || watchedDirectory(ev->wd)==NULL) {
+        continue;
+      } else if(ev->mask&(IN_DELETE_SELF | IN_MOVE_SELF)) {
+        rebuild=1;
+      } else if(ev->len>0 && !(ev->mask&IN_ISDIR)) {
+        trieUpdate(ev->name, ev->mask&(IN_CREATE | IN_MOVED_TO)? 1:-1);
+        forgetCommand(ev->name);
+      }
+    }
+  }
+  if(rebuild && indexedPath!=NULL) {
+    buildIndex();
+  }
+}
+
+/** \brief checkIndex
+ * A function which makes sure the trie matches PATH before it's used:
+ * it's built again when PATH has changed, or when a directory which can't
+ * be watched has a new mtime
+ * \return None
+ *
+ */
+static void checkIndex(void) {
+  const char *path=getVar("PATH")!=NULL? getVar("PATH"):"";
+  struct stat st;
+  size_t cpt;
+
+  if(indexedPath==NULL || strcmp(indexedPath, path)) {
+    buildIndex();
+    return;
+  }
+  for(cpt=0; cpt<nbPathDirs; cpt++) {
+    if(pathDirs[cpt].wd<0 && stat(pathDirs[cpt].path, &st)==0 &&
+       (st.st_mtim.tv_sec!=pathDirs[cpt].mtime.tv_sec || st.st_mtim.tv_nsec!=pathDirs[cpt].mtime.tv_nsec)) {
+      buildIndex();
+      return;
+    }
+  }
+}
+
+/** \brief addMatch
+ * A function which adds a match to the completion in progress
+ * \param const char *prefix: What comes before the name, NULL for nothing
+ * \param size_t prefixLen: Its length
+ * \param const char *name: The name
+ * \param size_t nameLen: Its length
+ * \return None
+ *
+ */
+static void addMatch(const char *prefix, size_t prefixLen, const char *name, size_t nameLen) {
+  char *match=(char *)malloc(prefixLen+nameLen+1);
+  if(nbMatches==capMatches) {
+    capMatches=capMatches==0? 64:capMatches*2;
+    matches=(char **)realloc(matches, sizeof(char *)*capMatches);
+  }
+  memcpy(match, prefix, prefixLen);
+  memcpy(match+prefixLen, name, nameLen);
+  match[prefixLen+nameLen]='\0';
+  matches[nbMatches++]=match;
+}
+
+/** \brief collectCommands
+ * A function which adds every name below a node of the trie to the matches
+ * \param int node: The node
+ * \param char *name: The characters from the root to the node, with room for more
+ * \param size_t len: Their number
+ * \param size_t *cap: The size of name
+ * \return The buffer of the name, it may have been moved
+ *
+ */
+static char *collectCommands(int node, char *name, size_t len, size_t *cap) {
+  int child;
+
+  if(trie[node].count>0) {
+    addMatch(NULL, 0, name, len);
+  }
+  for(child=trie[node].child; child>=0; child=trie[child].sibling) {
+    if(len+1>=*cap) {
+      *cap*=2;
+      name=(char *)realloc(name, *cap);
+    }
+    name[len]=trie[child].c;
+    name=collectCommands(child, name, len+1, cap);
+  }
+  return name;
+}
+
+/** \brief findCommands
+ * A function which gathers the commands starting with what is typed
+ * \param const char *text: The beginning of the command
+ * \return None
+ *
+ */
+static void findCommands(const char *text) {
+  size_t len=strlen(text), cap=len+64;
+  char *name;
+  int node=0;
+  const char *c;
+
+  checkIndex();
+  for(c=text; *c!='\0' && node>=0; c++) {
+    node=trieChild(node, *c, 0);
+  }
+  if(node<0) {
+    return;
+  }
+  name=(char *)malloc(cap);
+  memcpy(name, text, len);
+  free(collectCommands(node, name, len, &cap));
+}
+
+/** \brief addListing
+ * A visitor which puts an entry in the listing of a directory
+ * \param const char *name: The entry
+ * \param unsigned char type: Its d_type
+ * \param void *data: The listing
+ * \return None
+ *
+ */
+static void addListing(const char *name, unsigned char type, void *data) {
+  dirListing *listing=(dirListing *)data;
+  size_t len=strlen(name);
+
+  listing->names=(char *)realloc(listing->names, listing->size+len+2);
+  memcpy(listing->names+listing->size, name, len);
+  listing->size+=len;
+  if(type==DT_DIR) {
+    listing->names[listing->size++]='/';
+  }
+  listing->names[listing->size++]='\0';
+  listing->nbNames++;
+}
+
+/** \brief listingOf
+ * A function which gives the listing of a directory, from the cache when
+ * the directory has not changed since it was read
+ * \param const char *path: The absolute path of the directory
+ * \return The listing; NULL when it can't be read
+ *
+ */
+static dirListing *listingOf(const char *path) {
+  dirListing *listing=NULL, *oldest=&dirCache[0];
+  struct stat st;
+  int cpt, fd;
+
+  if((fd=open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC))<0) {
+    return NULL;
+  }
+  fstat(fd, &st);
+  for(cpt=0; cpt<COMPLETE_DIR_CACHE; cpt++) {
+    if(dirCache[cpt].path!=NULL && !strcmp(dirCache[cpt].path, path)) {
+      listing=&dirCache[cpt];
+      break;
+    }
+    if(dirCache[cpt].used<oldest->used) {
+      oldest=&dirCache[cpt];
+    }
+  }
+  if(listing!=NULL && listing->ino==st.st_ino && listing->mtime.tv_sec==st.st_mtim.tv_sec &&
+     listing->mtime.tv_nsec==st.st_mtim.tv_nsec) {
+    close(fd);
+    listing->used=++dirClock;
+    return listing;
+  }
+
+  if(listing==NULL) {
+    listing=oldest;
+    free(listing->path);
+    listing->path=strdup(path);
+  }
+  free(listing->names);
+  listing->names=NULL;
+  listing->size=listing->nbNames=0;
+  listing->ino=st.st_ino;
+  listing->mtime=st.st_mtim;
+  listDirectory(fd, addListing, listing);
+  close(fd);
+  listing->used=++dirClock;
+  return listing;
+}
+
+/** \brief findFiles
+ * A function which gathers the files whose path starts with what is typed
+ * The directory part keeps the form it was typed in; a leading ~ is the
+ * home directory and a relative one is taken from the working directory
+ * \param const char *text: The beginning of the path
+ * \return None
+ *
+ */
+static void findFiles(const char *text) {
+  const char *slash=strrchr(text, '/'), *base=slash==NULL? text:slash+1, *name;
+  size_t dirLen=(size_t)(base-text), baseLen=strlen(base), cpt;
+  char *dir;
+  dirListing *listing;
+
+  if(text[0]=='~' && slash!=NULL && text+1==slash) {
+    const char *home=sessionHome();
+    dir=(char *)malloc(strlen(home)+dirLen+1);
+    sprintf(dir, "%s%.*s", home, (int)dirLen-1, text+1);
+  } else if(text[0]=='/') {
+    dir=strndup(text, dirLen);
+  } else {
+    const char *cwd=sessionCwd();
+    dir=(char *)malloc(strlen(cwd)+dirLen+2);
+    sprintf(dir, "%s/%.*s", cwd, (int)dirLen, text);
+  }
+  listing=listingOf(dir);
+  free(dir);
+  if(listing==NULL) {
+    return;
+  }
+  for(cpt=0, name=listing->names; cpt<listing->nbNames; cpt++, name+=strlen(name)+1) {
+    // Hidden files only when a dot is typed
+    if(!strncmp(name, base, baseLen) && (name[0]!='.' || base[0]=='.')) {
+      addMatch(text, dirLen, name, strlen(name));
+    }
+  }
+}
+
+/** \brief nextCompletion
+ * The generator given to rl_completion_matches: it hands over the matches
+ * gathered beforehand, one at a time
+ * \param const char *text: Unused, the matches are already found
+ * \param int state: 0 for the first call
+ * \return A match readline frees; NULL when there's no more
+ *
+ */
+static char *nextCompletion(const char *text, int state) {
+  if(nextMatch<nbMatches) {
+    return matches[nextMatch++];
+  }
+  return NULL;
+}
+
+/** \brief completeLine
+ * The completion function of readline: the first word of a command gets a
+ * command name from the trie, the other words get a path from the cache of
+ * directory listings
+ * \param const char *text: The word being completed
+ * \param int start: Where it starts in rl_line_buffer
+ * \param int end: Where it ends
+ * \return The matches as rl_completion_matches gives them; NULL when there's none
+ *
+ */
+static char **completeLine(const char *text, int start, int end) {
+  int pos=start, command;
+  char **found;
+
+  // A command follows the start of the line, a pipe or a "time"/"timeout" prefix is not considered
+  while(pos>0 && (rl_line_buffer[pos-1]==' ' || rl_line_buffer[pos-1]=='\t')) {
+    pos--;
+  }
+  command=pos==0 || rl_line_buffer[pos-1]=='|' || rl_line_buffer[pos-1]=='&' || rl_line_buffer[pos-1]==';';
+
+  nbMatches=nextMatch=0;
+  if(command && strchr(text, '/')==NULL) {
+    findCommands(text);
+  } else {
+    findFiles(text);
+    // Directories end with '/' already: no space after them
+    if(nbMatches==1 && matches[0][strlen(matches[0])-1]=='/') {
+      rl_completion_suppress_append=1;
+    }
+  }
+  rl_attempted_completion_over=1;
+  found=rl_completion_matches(text, nextCompletion);
+  // The matches readline did not take are its own no more
+  while(nextMatch<nbMatches) {
+    free(matches[nextMatch++]);
+  }
+  return found;
+}
+
+/** \brief buildLater
+ * A timer handler which builds the index of PATH while the first prompt
+ * waits, so that the first Tab finds it ready
+ * \param void *data: Unused
+ * \return None
+ *
+ */
+static void buildLater(void *data) {
+  if(indexedPath==NULL) {
+    buildIndex();
+  }
+}
+
+/** \brief initCompletion
+ * A function which registers the completion with readline, and watches the
+ * PATH directories with inotify
+ * \return None
+ *
+ */
+void initCompletion(void) {
+  rl_attempted_completion_function=completeLine;
+  if((inotifyFd=inotify_init1(IN_NONBLOCK | IN_CLOEXEC))>=0) {
+    evAdd(inotifyFd, EPOLLIN, pathChanged, NULL);
+  }
+  evAddTimer(0, buildLater, NULL);
+}
@@ -0,0 +1,19 @@
+#ifndef MYSHELL_COMPLETE_H
+#define MYSHELL_COMPLETE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+//Directories whose listing is kept for filename completion
+#define COMPLETE_DIR_CACHE 64
+
+//Size of the buffer given to getdents64
+#define COMPLETE_DENTS_BUFFER 65536
+
+//Registers the completion with readline, the index of PATH is built once the prompt is shown
+void initCompletion(void);
+
+#endif
@@ -0,0 +1,296 @@
+#include "event.h"
+
+//Number of events handled by one epoll_wait
+#define EV_BATCH 32
+
+typedef struct evWatch {
+    int fd;
+    eventHandler handler;
+    void *data;
+
+    //next watch removed while events were being dispatched
+    struct evWatch *nextRemoved;
+} evWatch;
+
+static int epollFd = -1;
+
+//Watches indexed by fd
+static evWatch **watches = NULL;
+static int nbWatches = 0;
+
+//Watches removed during a dispatch, they are freed once it's over
+static int dispatching = 0;
+static evWatch *removedWatches = NULL;
+
+//The timers in a binary heap ordered by deadline, the earliest arms the timerfd
+static int timerFd = -1;
+static evTimer **timerHeap = NULL;
+static size_t nbTimers = 0, capTimers = 0;
+
+/** \brief evInit
+ * A function which creates the epoll instance of the event loop
+ * \return None
+ *
+ */
+void evInit(void) {
+  if(epollFd<0 && (epollFd=epoll_create1(EPOLL_CLOEXEC))<0) {
+    perror("epoll_create1");
+    exit(errno);
+  }
+}
+
+/** \brief evAdd
+ * A function which watches an fd
+ * \param int fd: The fd
+ * \param unsigned int events: The EPOLL* flags wanted
+ * \param eventHandler handler: The function called when the fd is ready
+ * \param void *data: Given back to the handler
+ * \return 0: when the fd is watched; -1: when epoll refuses it
+ *
+ */
+int evAdd(int fd, unsigned int events, eventHandler handler, void *data) {
+  struct epoll_event ev;
+  evWatch *watch;
+
+  if(fd>=nbWatches) {
+    int newNb=nbWatches==0? 64:nbWatches;
+    while(newNb<=fd) {newNb*=2;}
+    watches=(evWatch **)realloc(watches, sizeof(evWatch *)*(size_t)newNb);
+    memset(watches+nbWatches, 0, sizeof(evWatch *)*(size_t)(newNb-nbWatches));
+    nbWatches=newNb;
+  }
+  if(watches[fd]!=NULL) {
+    evDel(fd);
+  }
+
+  watch=(evWatch *)malloc(sizeof(evWatch));
+  watch->fd=fd;
+  watch->handler=handler;
+  watch->data=data;
+  watch->nextRemoved=NULL;
+  memset(&ev, 0, sizeof(ev));
+  ev.events=events;
+  ev.data.ptr=watch;
+  if(epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev)<0) {
+    free(watch);
+    return -1;
+  }
+  watches[fd]=watch;
+  return 0;
+}
+
+/** \brief evDel
+ * A function which stops watching an fd, it must be called before the fd is closed
+ * \param int fd: The fd
+ * \return None
+ *
+ */
+void evDel(int fd) {
+  if(fd<0 || fd>=nbWatches || watches[fd]==NULL) {
+    return;
+  }
+  epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+  if(dispatching) {
+    // The watch may still be among the events being dispatched
+    watches[fd]->handler=NULL;
+    watches[fd]->nextRemoved=removedWatches;
+    removedWatches=watches[fd];
+  } else {
+    free(watches[fd]);
+  }
+  watches[fd]=NULL;
+}
+
+/** \brief evRunOnce
+ * A function which waits for events and runs their handlers
+ * \param int timeoutMs: The longest wait in milliseconds, -1 to wait forever
+ * \return The number of events handled; -1 on error
+ *
+ */
+int evRunOnce(int timeoutMs) {
+  struct epoll_event ev[EV_BATCH];
+  int nbEv, cpt;
+
+  nbEv=epoll_wait(epollFd, ev, EV_BATCH, timeoutMs);
+  if(nbEv<0) {
+    return errno==EINTR? 0:-1;
+  }
+  dispatching++;
+  for(cpt=0; cpt<nbEv; cpt++) {
+    evWatch *watch=(evWatch *)ev[cpt].data.ptr;
+    if(watch->handler!=NULL) {
+      watch->handler(watch->fd, ev[cpt].events, watch->data);
+    }
+  }
+  if(--dispatching==0) {
+    while(removedWatches!=NULL) {
+      evWatch *next=removedWatches->nextRemoved;
+      free(removedWatches);
+      removedWatches=next;
+    }
+  }
+  return nbEv;
+}
+
+/** \brief evNow
+ * A function which gives the current time of CLOCK_MONOTONIC, the clock
+ * of the timers
+ * \return The time in nanoseconds
+ *
+ */
+int64_t evNow(void) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (int64_t)now.tv_sec*1000000000+now.tv_nsec;
+}
+
+/** \brief placeTimer
+ * A function which puts a timer at a place of the heap
+ * \param evTimer *timer: The timer
+ * \param size_t index: The place
+ * \return None
+ *
+ */
+static void placeTimer(evTimer *timer, size_t index) {
+  timerHeap[index]=timer;
+  timer->index=index;
+}
+
+/** \brief siftTimer
+ * A function which moves a timer up or down the heap until it's in order
+ * \param size_t index: The place of the timer
+ * \return None
+ *
+ */
+static void siftTimer(size_t index) {
+  evTimer *timer=timerHeap[index];
+
+  while(index>0 && timerHeap[(index-1)/2]->deadline>timer->deadline) {
+    placeTimer(timerHeap[(index-1)/2], index);
+    index=(index-1)/2;
+  }
+  for(;;) {
+    size_t child=2*index+1;
+    if(child>=nbTimers) {
+      break;
+    }
+    if(child+1<nbTimers && timerHeap[child+1]->deadline<timerHeap[child]->deadline) {
+      child++;
+    }
+    if(timerHeap[child]->deadline>=timer->deadline) {
+      break;
+    }
+    placeTimer(timerHeap[child], index);
+    index=child;
+  }
+  placeTimer(timer, index);
+}
+
+/** \brief removeTimer
+ * A function which takes a timer out of the heap
+ * \param evTimer *timer: The timer
+ * \return None
+ *
+ */
+static void removeTimer(evTimer *timer) {
+  size_t index=timer->index;
+  evTimer *last=timerHeap[--nbTimers];
+  if(last!=timer) {
+    placeTimer(last, index);
+    siftTimer(index);
+  }
+}
+
+/** \brief armTimerFd
+ * A function which makes the timerfd expire with the earliest timer
+ * \return None
+ *
+ */
+static void armTimerFd(void) {
+  struct itimerspec spec;
+  memset(&spec, 0, sizeof(spec));
+  if(nbTimers>0) {
+    // A zero it_value would disarm it
+    int64_t deadline=timerHeap[0]->deadline>0? timerHeap[0]->deadline:1;
+    spec.it_value.tv_sec=deadline/1000000000;
+    spec.it_value.tv_nsec=deadline%1000000000;
+  }
+  timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, NULL);
+}
+
+/** \brief timersReady
+ * An event handler which runs the timers which have expired
+ * \param int fd: The timerfd
+ * \param unsigned int events: The EPOLL* flags
+ * \param void *data: Unused
+ * \return None
+ *
+ */
+static void timersReady(int fd, unsigned int events, void *data) {
+  uint64_t expirations;
+  int64_t now=evNow();
+
+  while(read(fd, &expirations, sizeof(expirations))>0) {}
+  // A handler may add or cancel timers, the heap is looked at again each time
+  while(nbTimers>0 && timerHeap[0]->deadline<=now) {
+    evTimer *timer=timerHeap[0];
+    removeTimer(timer);
+    timer->handler(timer->data);
+    free(timer);
+  }
+  armTimerFd();
+}
+
+/** \brief evAddTimer
+ * A function which starts a timer
+ * \param long delayMs: The delay in milliseconds
+ * \param timerHandler handler: The function called when it expires
+ * \param void *data: Given back to the handler
+ * \return The timer, valid until it expires or it's cancelled
+ *
+ */
+evTimer *evAddTimer(long delayMs, timerHandler handler, void *data) {
+  evTimer *timer;
+
+  if(timerFd<0) {
+    if((timerFd=timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC))<0) {
+      perror("timerfd_create");
+      exit(errno);
+    }
+    evAdd(timerFd, EPOLLIN, timersReady, NULL);
+  }
+  if(nbTimers==capTimers) {
+    capTimers=capTimers==0? 16:capTimers*2;
+    timerHeap=(evTimer **)realloc(timerHeap, sizeof(evTimer *)*capTimers);
+  }
+
+  timer=(evTimer *)malloc(sizeof(evTimer));
+  timer->deadline=evNow()+(int64_t)delayMs*1000000;
+  timer->handler=handler;
+  timer->data=data;
+  placeTimer(timer, nbTimers++);
+  siftTimer(timer->index);
+  if(timerHeap[0]==timer) {
+    armTimerFd();
+  }
+  return timer;
+}
+
+/** \brief evCancelTimer
+ * A function which forgets a timer which has not expired
+ * \param evTimer *timer: The timer, NULL does nothing
+ * \return None
+ *
+ */
+void evCancelTimer(evTimer *timer) {
+  int first;
+  if(timer==NULL) {
+    return;
+  }
+  first=timerHeap[0]==timer;
+  removeTimer(timer);
+  free(timer);
+  if(first) {
+    armTimerFd();
+  }
+}
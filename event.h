@@ -0,0 +1,45 @@
+#ifndef MYSHELL_EVENT_H
+#define MYSHELL_EVENT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <stdint.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+//Called when a watched fd is ready, events holds the EPOLL* flags
+typedef void (*eventHandler)(int fd, unsigned int events, void *data);
+//Called once when a timer expires, the timer is freed afterwards
+typedef void (*timerHandler)(void *data);
+
+typedef struct evTimer {
+    //when it expires, in nanoseconds of CLOCK_MONOTONIC
+    int64_t deadline;
+
+    timerHandler handler;
+    void *data;
+
+    //its place in the heap of the timers
+    size_t index;
+} evTimer;
+
+//Creates the event loop
+void evInit(void);
+//Watches an fd, events holds the EPOLL* flags wanted
+int evAdd(int fd, unsigned int events, eventHandler handler, void *data);
+//Stops watching an fd
+void evDel(int fd);
+//Calls handler after delayMs milliseconds, all the timers share one timerfd
+evTimer *evAddTimer(long delayMs, timerHandler handler, void *data);
+//Forgets a timer which has not expired yet
+void evCancelTimer(evTimer *timer);
+//Gives the current time of CLOCK_MONOTONIC in nanoseconds
+int64_t evNow(void);
+//Waits for events at most timeoutMs (-1: forever) and runs their handlers
+int evRunOnce(int timeoutMs);
+
+#endif
@@ -0,0 +1,617 @@
+#include "shell_fct.h"
+
+//The output of a substitution while it's read
+typedef struct {
+  char *data;
+  size_t len, cap;
+
+  //whether the end of the output was read
+  int done;
+} captureBuffer;
+
+//A word of the expanded command while it's built
+typedef struct {
+  //its text when it's a piece of one output, used in place
+  char *slice;
+  size_t sliceLen;
+
+  //its text otherwise
+  char *text;
+  size_t len, cap;
+
+  //whether it's a word even when it's empty
+  int started;
+
+  //the pattern its word is, NULL when it's none, and whether the text escapes
+  //the characters which match themselves
+  cmdGlob *glob;
+  int escaped;
+} fieldBuilder;
+
+//The arguments of every member, separated by NULL, like the lexer lays them out
+typedef struct {
+  char **args;
+  size_t nbArgs, capArgs;
+} argTable;
+
+/** \brief own
+ * A function which hands memory over to the command, it's freed with it
+ * \param cmd *cmd: A pointer which points to the command
+ * \param void *mem: The memory, from malloc
+ * \return None
+ *
+ */
+static void own(cmd *cmd, void *mem) {
+  if(cmd->nbOwned==cmd->capOwned) {
+    cmd->capOwned=cmd->capOwned==0? 8:cmd->capOwned*2;
+    cmd->owned=(void **)realloc(cmd->owned, cmd->capOwned*sizeof(void *));
+  }
+  cmd->owned[cmd->nbOwned++]=mem;
+}
+
+/** \brief pushArg
+ * A function which appends an entry to the argument table
+ * \param argTable *table: The table
+ * \param char *arg: The argument, NULL to end a member
+ * \return None
+ *
+ */
+static void pushArg(argTable *table, char *arg) {
+  if(table->nbArgs==table->capArgs) {
+    table->capArgs=table->capArgs==0? 16:table->capArgs*2;
+    table->args=(char **)realloc(table->args, table->capArgs*sizeof(char *));
+  }
+  table->args[table->nbArgs++]=arg;
+}
+
+/** \brief captureReady
+ * An event handler which reads what the command of a substitution wrote
+ * The reads go straight into the free end of the buffer, which doubles
+ * when it's full, so every byte is copied once however long the output is
+ * \param int fd: The read end of the pipe, non-blocking
+ * \param unsigned int events: The EPOLL* flags
+ * \param void *data: The buffer
+ * \return None
+ *
+ */
+static void captureReady(int fd, unsigned int events, void *data) {
+  captureBuffer *out=(captureBuffer *)data;
+  ssize_t nb;
+
+  for(;;) {
+    // One byte is kept for the final '\0'
+    if(out->cap-out->len<2) {
+      out->cap*=2;
+      out->data=(char *)realloc(out->data, out->cap);
+    }
+    nb=read(fd, out->data+out->len, out->cap-out->len-1);
+    if(nb>0) {
+      out->len+=(size_t)nb;
+    } else if(nb<0 && errno==EINTR) {
+      continue;
+    } else if(nb<0 && errno==EAGAIN) {
+      return;
+    } else {
+      evDel(fd);
+      out->done=1;
+      return;
+    }
+  }
+}
+
+/** \brief loadInner
+ * A function which parses and expands the command of a substitution
+ * \param cmd *inner: A pointer which points to the command, set up
+ * \param const char *text: The command line between the parentheses
+ * \param int *empty: A pointer which points to whether the line is blank, filled
+ * \return 0: when the command can be run; 1: otherwise
+ *
+ */
+static int loadInner(cmd *inner, const char *text, int *empty) {
+  unsigned int cpt;
+
+  *empty=0;
+  if(parseMembers((char *)text, inner)) {
+    return 1;
+  }
+  if(pendingHeredoc(inner)!=NULL) {
+    fprintf(stderr, "-myshell: here-documents can't be given to a substitution, use <<<\n");
+    return 1;
+  }
+  if(expandCmd(inner)) {
+    return 1;
+  }
+  if(inner->nbCmdMembers==1 && inner->nbMembersArgs[0]==0) {
+    *empty=1;
+    return 0;
+  }
+  for(cpt=0; cpt<inner->nbCmdMembers; cpt++) {
+    if(inner->nbMembersArgs[cpt]==0) {
+      fprintf(stderr, "Command's member is incomplete.\n");
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/** \brief runSubstitution
+ * A function which runs the command of a substitution as a hidden job and
+ * reads its stdout from the event loop, while the job is waited for
+ * \param cmd *owner: A pointer which points to the command holding the substitution
+ * \param cmdSubstitution *sub: The substitution
+ * \param size_t *len: A pointer which points to the length of the output, filled
+ * \return The output without its trailing newlines, owned by owner; NULL when the command is wrong
+ *
+ */
+static char *runSubstitution(cmd *owner, cmdSubstitution *sub, size_t *len) {
+  captureBuffer out;
+  int fds[2], io[3]={-1, -1, -1}, failed, empty;
+  cmd inner;
+
+  setupCmd(&inner);
+  failed=loadInner(&inner, sub->text, &empty);
+
+  out.cap=EXPAND_FIRST_READ;
+  out.data=(char *)malloc(out.cap);
+  out.len=0;
+  out.done=0;
+  if(!failed && !empty) {
+    if(pipe2(fds, O_CLOEXEC)) {
+      fprintf(stderr, "-myshell: %s\n", strerror(errno));
+      failed=1;
+    } else {
+      fcntl(fds[0], F_SETFL, O_NONBLOCK);
+      io[STDOUT_FILENO]=fds[1];
+      job *j=runPipeline(&inner, 1, io);
+      close(fds[1]);
+      evAdd(fds[0], EPOLLIN, captureReady, &out);
+      // The output can outlive the job: in the pipe, or in the children it left behind
+      if(waitForJob(j)!=128+SIGTSTP) {
+        while(!out.done && evRunOnce(-1)>=0) {}
+      }
+      if(!out.done) {
+        evDel(fds[0]);
+      }
+      close(fds[0]);
+    }
+  }
+  releaseCmd(&inner);
+  if(failed) {
+    free(out.data);
+    return NULL;
+  }
+
+  while(out.len>0 && out.data[out.len-1]=='\n') {
+    out.len--;
+  }
+  out.data[out.len]='\0';
+  own(owner, out.data);
+  *len=out.len;
+  return out.data;
+}
+
+/** \brief startProcess
+ * A function which starts the command of a process substitution in the
+ * background, on one end of a pipe; the member gets the other end as /dev/fd/N
+ * The command is started first, while both ends are still close-on-exec,
+ * so that it never holds the end of the member
+ * \param cmd *owner: A pointer which points to the command holding the substitution
+ * \param cmdSubstitution *sub: The substitution, its fd is set
+ * \param size_t *len: A pointer which points to the length of the path, filled
+ * \return The path of the end of the member; NULL when the command is wrong
+ *
+ */
+static char *startProcess(cmd *owner, cmdSubstitution *sub, size_t *len) {
+  int fds[2], io[3]={-1, -1, -1}, reads=sub->kind==SUBST_PROCESS_IN, empty;
+  char *path;
+  cmd inner;
+
+  setupCmd(&inner);
+  if(loadInner(&inner, sub->text, &empty)) {
+    releaseCmd(&inner);
+    return NULL;
+  }
+  if(pipe2(fds, O_CLOEXEC)) {
+    fprintf(stderr, "-myshell: %s\n", strerror(errno));
+    releaseCmd(&inner);
+    return NULL;
+  }
+  // <( ): the command writes, the member reads; >( ): the other way round
+  if(!empty) {
+    io[reads? STDOUT_FILENO:STDIN_FILENO]=fds[reads? 1:0];
+    inner.background=1;
+    job *j=runPipeline(&inner, 1, io);
+    j->detached=1;
+  }
+  close(fds[reads? 1:0]);
+  releaseCmd(&inner);
+
+  sub->fd=fds[reads? 0:1];
+  path=(char *)arenaAlloc(&owner->mem, 32);
+  *len=(size_t)snprintf(path, 32, "/dev/fd/%d", sub->fd);
+  return path;
+}
+
+/** \brief fieldAppend
+ * A function which appends a copy of some text to the word being built
+ * \param fieldBuilder *f: The word
+ * \param const char *s: The text
+ * \param size_t len: Its length
+ * \return None
+ *
+ */
+static void fieldAppend(fieldBuilder *f, const char *s, size_t len) {
+  if(f->slice!=NULL) {
+    // The word no longer is a piece of one output
+    char *slice=f->slice;
+    f->slice=NULL;
+    fieldAppend(f, slice, f->sliceLen);
+  }
+  if(f->len+len+1>f->cap) {
+    while(f->len+len+1>f->cap) {
+      f->cap=f->cap==0? 64:f->cap*2;
+    }
+    f->text=(char *)realloc(f->text, f->cap);
+  }
+  memcpy(f->text+f->len, s, len);
+  f->len+=len;
+  f->text[f->len]='\0';
+}
+
+/** \brief fieldEscape
+ * A function which appends a copy of some text to the word being built,
+ * a '\' before each character which would be special in a pattern
+ * \param fieldBuilder *f: The word
+ * \param const char *s: The text
+ * \param size_t len: Its length
+ * \return None
+ *
+ */
+static void fieldEscape(fieldBuilder *f, const char *s, size_t len) {
+  size_t run;
+
+  while(len>0) {
+    run=strcspn(s, EXPAND_GLOB_SPECIAL);
+    if(run>=len) {
+      fieldAppend(f, s, len);
+      return;
+    }
+    fieldAppend(f, s, run);
+    fieldAppend(f, "\\", 1);
+    fieldAppend(f, s+run, 1);
+    f->escaped=1;
+    s+=run+1;
+    len-=run+1;
+  }
+}
+
+/** \brief fieldLiteral
+ * A function which appends a literal part of a word to the word being built,
+ * its quoted characters are escaped when the word is a pattern
+ * \param cmd *cmd: A pointer which points to the command
+ * \param fieldBuilder *f: The word being built
+ * \param const char *word: The word as parsed
+ * \param size_t from: The offset of the part
+ * \param size_t to: The offset of its end
+ * \return None
+ *
+ */
+static void fieldLiteral(cmd *cmd, fieldBuilder *f, const char *word, size_t from, size_t to) {
+  unsigned int cpt;
+
+  if(f->glob!=NULL) {
+    for(cpt=f->glob->firstQuoted; cpt<f->glob->firstQuoted+f->glob->nbQuoted; cpt++) {
+      size_t at=cmd->quotedMetas[cpt];
+      if(at>=from && at<to) {
+        fieldAppend(f, word+from, at-from);
+        fieldAppend(f, "\\", 1);
+        f->escaped=1;
+        from=at;
+      }
+    }
+  }
+  fieldAppend(f, word+from, to-from);
+  f->started=1;
+}
+
+/** \brief globArgs
+ * A function which gives the paths a pattern matches to the argument table
+ * \param cmd *cmd: A pointer which points to the command, it owns the paths
+ * \param argTable *table: The table
+ * \param const char *pattern: The pattern
+ * \return The number of paths; 0 when it's no pattern or matches nothing
+ *
+ */
+static size_t globArgs(cmd *cmd, argTable *table, const char *pattern) {
+  globList list;
+  size_t cpt;
+
+  if(!globHasMeta(pattern) || globExpand(pattern, &list)==0) {
+    return 0;
+  }
+  for(cpt=0; cpt<list.nbPaths; cpt++) {
+    pushArg(table, list.paths[cpt]);
+  }
+  for(cpt=0; cpt<list.nbBlocks; cpt++) {
+    own(cmd, list.blocks[cpt]);
+  }
+  own(cmd, list.paths);
+  free(list.blocks);
+  return list.nbPaths;
+}
+
+/** \brief fieldSlice
+ * A function which appends a piece of an output to the word being built,
+ * the piece is used in place when it's the whole word
+ * \param fieldBuilder *f: The word
+ * \param char *s: The piece, its end is made a '\0' before the word is used
+ * \param size_t len: Its length
+ * \return None
+ *
+ */
+static void fieldSlice(fieldBuilder *f, char *s, size_t len) {
+  if(f->slice==NULL && f->text==NULL) {
+    f->slice=s;
+    f->sliceLen=len;
+  } else {
+    fieldAppend(f, s, len);
+  }
+}
+
+/** \brief fieldEnd
+ * A function which gives the word being built to the argument table
+ * \param cmd *cmd: A pointer which points to the command
+ * \param argTable *table: The table
+ * \param fieldBuilder *f: The word, emptied
+ * \return None
+ *
+ */
+static void fieldEnd(cmd *cmd, argTable *table, fieldBuilder *f) {
+  cmdGlob *glob=f->glob;
+
+  if(f->slice!=NULL) {
+    if(glob==NULL || globArgs(cmd, table, f->slice)==0) {
+      pushArg(table, f->slice);
+    }
+  } else if(f->text!=NULL) {
+    own(cmd, f->text);
+    // A pattern which matches nothing is left as it is
+    if(glob==NULL || globArgs(cmd, table, f->text)==0) {
+      if(f->escaped) {
+        globUnescape(f->text);
+      }
+      pushArg(table, f->text);
+    }
+  } else if(f->started) {
+    pushArg(table, arenaStrdup(&cmd->mem, ""));
+  }
+  // The next words of a split output are part of the same pattern
+  memset(f, 0, sizeof(fieldBuilder));
+  f->glob=glob;
+}
+
+/** \brief addOutput
+ * A function which appends an output to the word being built
+ * When it's split, its blanks end the word and start the next one
+ * \param cmd *cmd: A pointer which points to the command
+ * \param argTable *table: The table the finished words go to
+ * \param fieldBuilder *f: The word
+ * \param char *s: The output, split in place
+ * \param size_t len: Its length
+ * \param int split: Whether its blanks separate words
+ * \return None
+ *
+ */
+static void addOutput(cmd *cmd, argTable *table, fieldBuilder *f, char *s, size_t len, int split) {
+  size_t pos=0, run;
+
+  if(!split) {
+    // A quoted output matches itself
+    if(f->glob!=NULL) {
+      fieldEscape(f, s, len);
+    } else {
+      fieldSlice(f, s, len);
+    }
+    f->started=1;
+    return;
+  }
+  while(pos<len) {
+    run=strcspn(s+pos, EXPAND_BLANKS);
+    if(run>0) {
+      fieldSlice(f, s+pos, run);
+      f->started=1;
+      pos+=run;
+    }
+    // A piece at the end of the output stays open for the text following it
+    if(pos>=len) {
+      break;
+    }
+    s[pos++]='\0';
+    fieldEnd(cmd, table, f);
+    pos+=strspn(s+pos, EXPAND_BLANKS);
+  }
+}
+
+/** \brief expandWord
+ * A function which writes the outputs of the substitutions of a word
+ * between its literal parts
+ * \param cmd *cmd: A pointer which points to the command
+ * \param argTable *table: The table the finished words go to
+ * \param fieldBuilder *f: The word being built, left open
+ * \param char *word: The word as parsed
+ * \param unsigned int first: Its first substitution
+ * \param char **outputs: The output of each substitution
+ * \param size_t *lens: Their lengths
+ * \param int split: Whether the outputs which are not quoted are split
+ * \return None
+ *
+ */
+static void expandWord(cmd *cmd, argTable *table, fieldBuilder *f, char *word, unsigned int first,
+                       char **outputs, size_t *lens, int split) {
+  size_t done=0;
+  unsigned int cpt;
+
+  for(cpt=first; cpt<cmd->nbSubstitutions && cmd->substitutions[cpt].word==word; cpt++) {
+    cmdSubstitution *sub=&cmd->substitutions[cpt];
+    if(sub->offset>done) {
+      fieldLiteral(cmd, f, word, done, sub->offset);
+    }
+    addOutput(cmd, table, f, outputs[cpt], lens[cpt], split && !sub->quoted && sub->kind!=SUBST_PROCESS_IN && sub->kind!=SUBST_PROCESS_OUT);
+    done=sub->offset;
+  }
+  if(word[done]!='\0') {
+    fieldLiteral(cmd, f, word, done, done+strlen(word+done));
+  }
+}
+
+/** \brief joinWord
+ * A function which expands a word which is never split: an assignment,
+ * the file of a redirection, a here-string or a here-document
+ * \param cmd *cmd: A pointer which points to the command
+ * \param char *word: The word as parsed
+ * \param unsigned int first: Its first substitution
+ * \param char **outputs: The output of each substitution
+ * \param size_t *lens: Their lengths
+ * \return The expanded word
+ *
+ */
+static char *joinWord(cmd *cmd, char *word, unsigned int first, char **outputs, size_t *lens) {
+  fieldBuilder f;
+
+  memset(&f, 0, sizeof(fieldBuilder));
+  expandWord(cmd, NULL, &f, word, first, outputs, lens, 0);
+  if(f.slice!=NULL) {
+    return f.slice;
+  }
+  if(f.text!=NULL) {
+    own(cmd, f.text);
+    return f.text;
+  }
+  return arenaStrdup(&cmd->mem, "");
+}
+
+/** \brief findSubstitution
+ * A function which finds the first substitution of a word
+ * \param cmd *cmd: A pointer which points to the command
+ * \param const char *word: The word as parsed
+ * \return The index of the substitution; nbSubstitutions when the word has none
+ *
+ */
+static unsigned int findSubstitution(cmd *cmd, const char *word) {
+  unsigned int cpt;
+  for(cpt=0; cpt<cmd->nbSubstitutions && cmd->substitutions[cpt].word!=word; cpt++) {}
+  return cpt;
+}
+
+/** \brief findGlob
+ * A function which finds the pattern record of a word
+ * \param cmd *cmd: A pointer which points to the command
+ * \param const char *word: The word as parsed
+ * \return The record; NULL when the word is no pattern
+ *
+ */
+static cmdGlob *findGlob(cmd *cmd, const char *word) {
+  unsigned int cpt;
+  for(cpt=0; cpt<cmd->nbGlobs && cmd->globs[cpt].word!=word; cpt++) {}
+  return cpt<cmd->nbGlobs? &cmd->globs[cpt]:NULL;
+}
+
+/** \brief expandCmd
+ * A function which runs the substitutions of a parsed command, from left
+ * to right, and puts their output, or the path of their pipe, in its words
+ * Outside of double quotes an output is split on blanks into several arguments;
+ * the file of a redirection and the text of a here-document whose delimiter
+ * is not quoted are never split. The arguments which are a whole
+ * piece of an output point into it rather than being copied
+ * The arguments holding a pattern outside of quotes are then replaced by
+ * the paths it matches, sorted, or kept as they are when it matches none
+ * \param cmd *cmd: A pointer which points to the command
+ * \return 0: when every substitution was run; 1: otherwise
+ *
+ */
+int expandCmd(cmd *cmd) {
+  char **outputs;
+  size_t *lens, *firstArgs;
+  argTable table={NULL, 0, 0};
+  fieldBuilder f;
+  unsigned int cpt, arg, sub;
+  int fd;
+
+  if(parseHeredocs(cmd)) {
+    return 1;
+  }
+  if(cmd->nbSubstitutions==0 && cmd->nbGlobs==0) {
+    return 0;
+  }
+  outputs=(char **)arenaAlloc(&cmd->mem, sizeof(char *)*cmd->nbSubstitutions);
+  lens=(size_t *)arenaAlloc(&cmd->mem, sizeof(size_t)*cmd->nbSubstitutions);
+  for(sub=0; sub<cmd->nbSubstitutions; sub++) {
+    cmdSubstitution *cur=&cmd->substitutions[sub];
+    if(cur->kind==SUBST_VARIABLE) {
+      // A copy, the value may be split in place
+      const char *value=getVar(cur->text);
+      outputs[sub]=arenaStrdup(&cmd->mem, value==NULL? "":value);
+      lens[sub]=strlen(outputs[sub]);
+    } else if(cur->kind==SUBST_COMMAND) {
+      outputs[sub]=runSubstitution(cmd, cur, &lens[sub]);
+    } else {
+      outputs[sub]=startProcess(cmd, cur, &lens[sub]);
+    }
+    if(outputs[sub]==NULL) {
+      return 1;
+    }
+  }
+
+  memset(&f, 0, sizeof(fieldBuilder));
+  firstArgs=(size_t *)arenaAlloc(&cmd->mem, sizeof(size_t)*cmd->nbCmdMembers);
+  for(cpt=0; cpt<cmd->nbCmdMembers; cpt++) {
+    // The assignments are never split
+    for(arg=0; arg<cmd->nbMembersAssigns[cpt]; arg++) {
+      char *word=cmd->cmdMembersAssigns[cpt][arg];
+      if((sub=findSubstitution(cmd, word))<cmd->nbSubstitutions) {
+        cmd->cmdMembersAssigns[cpt][arg]=joinWord(cmd, word, sub, outputs, lens);
+      }
+    }
+
+    firstArgs[cpt]=table.nbArgs;
+    for(arg=0; arg<cmd->nbMembersArgs[cpt]; arg++) {
+      char *word=cmd->cmdMembersArgs[cpt][arg];
+      size_t before=table.nbArgs;
+      f.glob=findGlob(cmd, word);
+      if((sub=findSubstitution(cmd, word))==cmd->nbSubstitutions) {
+        if(f.glob!=NULL) {
+          // The pattern is the word with its quoted characters escaped
+          fieldLiteral(cmd, &f, word, 0, strlen(word));
+          fieldEnd(cmd, &table, &f);
+        } else {
+          pushArg(&table, word);
+        }
+        f.glob=NULL;
+        continue;
+      }
+      expandWord(cmd, &table, &f, word, sub, outputs, lens, 1);
+      fieldEnd(cmd, &table, &f);
+      f.glob=NULL;
+      // "" next to an empty output still makes an argument
+      if(table.nbArgs==before && cmd->substitutions[sub].wordQuoted) {
+        pushArg(&table, arenaStrdup(&cmd->mem, ""));
+      }
+    }
+    cmd->nbMembersArgs[cpt]=(unsigned int)(table.nbArgs-firstArgs[cpt]);
+    pushArg(&table, NULL);
+
+    for(fd=STDIN_FILENO; fd<=STDERR_FILENO; fd++) {
+      char *file=cmd->redirection[cpt].file[fd];
+      if(file!=NULL && (sub=findSubstitution(cmd, file))<cmd->nbSubstitutions) {
+        cmd->redirection[cpt].file[fd]=joinWord(cmd, file, sub, outputs, lens);
+      }
+    }
+  }
+
+  // The rows point into the table once it's done growing
+  own(cmd, table.args);
+  for(cpt=0; cpt<cmd->nbCmdMembers; cpt++) {
+    cmd->cmdMembersArgs[cpt]=table.args+firstArgs[cpt];
+  }
+  return 0;
+}
@@ -0,0 +1,24 @@
+#ifndef MYSHELL_EXPAND_H
+#define MYSHELL_EXPAND_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include "cmd.h"
+
+//Size of the first read of the output of a substitution, the buffer doubles afterwards
+#define EXPAND_FIRST_READ 4096
+
+//Characters which separate the words of an output which is not quoted
+#define EXPAND_BLANKS " \t\n"
+
+//Characters of a quoted output which are escaped when its word is a pattern
+#define EXPAND_GLOB_SPECIAL "*?[\\"
+
+//Replaces the substitutions of a parsed command by the output of their command, or by a /dev/fd path to it,
+//and its patterns by the paths they match
+int expandCmd(cmd *c);
+
+#endif
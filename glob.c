@@ -0,0 +1,836 @@
+#include <fcntl.h>
+#include <dirent.h>
+#include <limits.h>
+#include <ctype.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "glob.h"
+#include "arena.h"
+
+//Kinds of the tokens of a compiled component, each one matches one character
+#define GLOB_CHAR 0
+#define GLOB_ANY 1
+#define GLOB_SET 2
+
+//Kinds of the components of a pattern, the parts between its '/'
+#define GLOB_LITERAL 0
+#define GLOB_PATTERN 1
+#define GLOB_RECURSE 2
+
+typedef struct {
+  int kind;
+  unsigned char c;
+
+  //the characters a [...] matches, one bit each
+  unsigned char set[32];
+} globToken;
+
+//The tokens between two stars, they match as many characters as there are tokens
+typedef struct {
+  globToken *tokens;
+  size_t len;
+
+  //their text when they're all plain characters, found with memmem
+  char *literal;
+} globSegment;
+
+typedef struct {
+  int kind;
+
+  //the name of a literal component, escapes removed
+  char *name;
+  size_t nameLen;
+
+  //the segments of a pattern, one more than its stars: the first one is
+  //anchored at the start of the name and the last one at its end
+  globSegment *segments;
+  size_t nbSegments;
+
+  //whether it matches the names starting with '.'
+  int dots;
+} globComponent;
+
+//A directory left to read, its path ends with a '/' unless it's the current one
+typedef struct globTask {
+  struct globTask *next;
+  unsigned int comp;
+  size_t len;
+
+  //whether a ** walked into it, it's not a match of its own then
+  int nested;
+  char path[];
+} globTask;
+
+//What the workers share
+typedef struct {
+  globComponent *comps;
+  unsigned int nbComps;
+
+  //whether the pattern ends with a '/': only directories match, written with it
+  int dirsOnly;
+
+  pthread_mutex_t lock;
+  pthread_cond_t wake;
+
+  //the tasks nobody took yet, and those plus the running ones
+  globTask *tasks;
+  size_t pending;
+} globWalk;
+
+typedef struct {
+  globWalk *walk;
+  pthread_t thread;
+  char *dents;
+
+  //the paths it found, packed with their '\0', and where each starts
+  char *text;
+  size_t len, cap;
+  size_t *offsets;
+  size_t nbOffsets, capOffsets;
+} globWorker;
+
+//A path while the matches are sorted, with 8 of its characters in the order of strcmp
+typedef struct {
+  unsigned long long key;
+  char *path;
+} globKey;
+
+/** \brief setEnd
+ * A function which finds the end of a [...]
+ * \param const char *open: The '['
+ * \return The character following its ']'; NULL when it's not closed, it's a plain '[' then
+ *
+ */
+static const char *setEnd(const char *open) {
+  const char *cur=open+1;
+
+  if(*cur=='!' || *cur=='^') {
+    cur++;
+  }
+  // A ']' coming first is one of the characters
+  if(*cur==']') {
+    cur++;
+  }
+  for(; *cur!=']'; cur++) {
+    if(*cur=='\0' || *cur=='/') {
+      return NULL;
+    }
+    if(*cur=='\\' && cur[1]!='\0') {
+      cur++;
+    } else if(*cur=='[' && cur[1]==':') {
+      const char *close=strstr(cur+2, ":]");
+      if(close!=NULL && memchr(cur, '/', (size_t)(close-cur))==NULL) {
+        cur=close+1;
+      }
+    }
+  }
+  return cur+1;
+}
+
+/** \brief globHasMeta
+ * A function which tells whether a word is a pattern
+ * \param const char *pattern: The word, '\' escapes the character following it
+ * \return 1: when it holds a *, ? or [...] which is not escaped; 0: otherwise
+ *
+ */
+int globHasMeta(const char *pattern) {
+  const char *cur;
+
+  for(cur=pattern; (cur=strpbrk(cur, "*?[\\"))!=NULL; cur++) {
+    if(*cur=='\\') {
+      if(*++cur=='\0') {
+        return 0;
+      }
+    } else if(*cur!='[' || setEnd(cur)!=NULL) {
+      return 1;
+    }
+  }
+  return 0;
+}
+
+/** \brief globUnescape
+ * A function which removes the escapes of a pattern, in place
+ * \param char *pattern: The pattern
+ * \return None
+ *
+ */
+void globUnescape(char *pattern) {
+  char *in=strchr(pattern, '\\'), *out=in;
+
+  if(in==NULL) {
+    return;
+  }
+  while(*in!='\0') {
+    if(*in=='\\' && in[1]!='\0') {
+      in++;
+    }
+    *out++=*in++;
+  }
+  *out='\0';
+}
+
+/** \brief addToSet
+ * A function which adds a character to the set of a token
+ * \param globToken *tok: The token
+ * \param unsigned char c: The character
+ * \return None
+ *
+ */
+static void addToSet(globToken *tok, unsigned char c) {
+  tok->set[c>>3]|=(unsigned char)(1<<(c&7));
+}
+
+/** \brief addClass
+ * A function which adds the characters of a [:name:] class to the set of a token
+ * \param globToken *tok: The token
+ * \param const char *name: The name of the class
+ * \param size_t len: Its length
+ * \return None
+ *
+ */
+static void addClass(globToken *tok, const char *name, size_t len) {
+  static const struct {
+    const char *name;
+    int (*test)(int);
+  } classes[]={
+    {"alnum", isalnum}, {"alpha", isalpha}, {"blank", isblank}, {"cntrl", iscntrl},
+    {"digit", isdigit}, {"graph", isgraph}, {"lower", islower}, {"print", isprint},
+    {"punct", ispunct}, {"space", isspace}, {"upper", isupper}, {"xdigit", isxdigit}
+  };
+  unsigned int cpt;
+  int c;
+
+  for(cpt=0; cpt<sizeof(classes)/sizeof(classes[0]); cpt++) {
+    if(strlen(classes[cpt].name)==len && strncmp(classes[cpt].name, name, len)==0) {
+      for(c=1; c<256; c++) {
+        if(classes[cpt].test(c)) {
+          addToSet(tok, (unsigned char)c);
+        }
+      }
+      return;
+    }
+  }
+}
+
+/** \brief compileSet
+ * A function which turns a [...] into the set of a token
+ * \param globToken *tok: The token
+ * \param const char *open: The '['
+ * \param const char *end: The character following its ']'
+ * \return None
+ *
+ */
+static void compileSet(globToken *tok, const char *open, const char *end) {
+  const char *cur=open+1, *close=end-1;
+  int negate=0, cpt;
+
+  tok->kind=GLOB_SET;
+  memset(tok->set, 0, sizeof(tok->set));
+  if(*cur=='!' || *cur=='^') {
+    negate=1;
+    cur++;
+  }
+  while(cur<close) {
+    unsigned char lo, hi;
+    if(*cur=='[' && cur[1]==':') {
+      const char *nameEnd=strstr(cur+2, ":]");
+      if(nameEnd!=NULL && nameEnd<close) {
+        addClass(tok, cur+2, (size_t)(nameEnd-cur-2));
+        cur=nameEnd+2;
+        continue;
+      }
+    }
+    if(*cur=='\\' && cur+1<close) {
+      cur++;
+    }
+    lo=hi=(unsigned char)*cur++;
+    // A '-' at either end is one of the characters
+    if(*cur=='-' && cur+1<close) {
+      cur++;
+      if(*cur=='\\' && cur+1<close) {
+        cur++;
+      }
+      hi=(unsigned char)*cur++;
+    }
+    for(cpt=lo; cpt<=hi; cpt++) {
+      addToSet(tok, (unsigned char)cpt);
+    }
+  }
+  if(negate) {
+    for(cpt=0; cpt<32; cpt++) {
+      tok->set[cpt]=(unsigned char)~tok->set[cpt];
+    }
+  }
+  // A name never holds a '/' nor a '\0'
+  tok->set['/'>>3]&=(unsigned char)~(1<<('/'&7));
+  tok->set[0]&=(unsigned char)~1;
+}
+
+/** \brief compileComponent
+ * A function which compiles a part of a pattern between two '/' once, so
+ * that matching a name never goes back: each star only has to find the
+ * leftmost place of the segment following it
+ * \param arena *mem: Where the compiled component is allocated
+ * \param globComponent *comp: The component, filled
+ * \param const char *text: Its text
+ * \param size_t len: Its length
+ * \return None
+ *
+ */
+static void compileComponent(arena *mem, globComponent *comp, const char *text, size_t len) {
+  char *copy=arenaStrndup(mem, text, len);
+  globToken *tokens=(globToken *)arenaAlloc(mem, sizeof(globToken)*(len+1));
+  globSegment *seg;
+  size_t nbTokens=0, cpt;
+  const char *cur;
+
+  memset(comp, 0, sizeof(globComponent));
+  comp->dots=copy[0]=='.' || (copy[0]=='\\' && copy[1]=='.');
+  if(strcmp(copy, "**")==0) {
+    comp->kind=GLOB_RECURSE;
+    return;
+  }
+  if(!globHasMeta(copy)) {
+    globUnescape(copy);
+    comp->kind=GLOB_LITERAL;
+    comp->name=copy;
+    comp->nameLen=strlen(copy);
+    return;
+  }
+
+  comp->kind=GLOB_PATTERN;
+  comp->segments=(globSegment *)arenaAlloc(mem, sizeof(globSegment)*(len+1));
+  memset(comp->segments, 0, sizeof(globSegment)*(len+1));
+  seg=&comp->segments[0];
+  seg->tokens=tokens;
+  comp->nbSegments=1;
+  for(cur=copy; *cur!='\0';) {
+    globToken *tok=&tokens[nbTokens];
+    const char *end;
+    if(*cur=='*') {
+      // Stars in a row are one star
+      while(*cur=='*') {cur++;}
+      seg=&comp->segments[comp->nbSegments++];
+      seg->tokens=tokens+nbTokens;
+      continue;
+    }
+    if(*cur=='?') {
+      tok->kind=GLOB_ANY;
+      cur++;
+    } else if(*cur=='[' && (end=setEnd(cur))!=NULL) {
+      compileSet(tok, cur, end);
+      cur=end;
+    } else {
+      if(*cur=='\\' && cur[1]!='\0') {
+        cur++;
+      }
+      tok->kind=GLOB_CHAR;
+      tok->c=(unsigned char)*cur++;
+    }
+    nbTokens++;
+    seg->len++;
+  }
+
+  for(seg=comp->segments; seg<comp->segments+comp->nbSegments; seg++) {
+    for(cpt=0; cpt<seg->len && seg->tokens[cpt].kind==GLOB_CHAR; cpt++) {}
+    if(cpt==seg->len) {
+      seg->literal=(char *)arenaAlloc(mem, seg->len+1);
+      for(cpt=0; cpt<seg->len; cpt++) {
+        seg->literal[cpt]=(char)seg->tokens[cpt].c;
+      }
+      seg->literal[seg->len]='\0';
+    }
+  }
+}
+
+/** \brief segmentAt
+ * A function which tells whether a segment matches the text at some place
+ * \param const globSegment *seg: The segment
+ * \param const char *s: The place, at least as long as the segment
+ * \return 1: when it matches; 0: otherwise
+ *
+ */
+static int segmentAt(const globSegment *seg, const char *s) {
+  size_t cpt;
+
+  if(seg->literal!=NULL) {
+    return memcmp(seg->literal, s, seg->len)==0;
+  }
+  for(cpt=0; cpt<seg->len; cpt++) {
+    const globToken *tok=&seg->tokens[cpt];
+    unsigned char c=(unsigned char)s[cpt];
+    if((tok->kind==GLOB_CHAR && c!=tok->c) ||
+       (tok->kind==GLOB_SET && !(tok->set[c>>3]&(1<<(c&7))))) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/** \brief componentMatch
+ * A function which tells whether a name matches a compiled component
+ * The segments between stars are found leftmost first: a later place
+ * would only leave less room to the segments following it
+ * \param const globComponent *comp: The component
+ * \param const char *name: The name
+ * \param size_t len: Its length
+ * \return 1: when it matches; 0: otherwise
+ *
+ */
+static int componentMatch(const globComponent *comp, const char *name, size_t len) {
+  const globSegment *first=&comp->segments[0], *last=&comp->segments[comp->nbSegments-1];
+  const char *cur, *end;
+  size_t cpt;
+
+  if(name[0]=='.' && !comp->dots) {
+    return 0;
+  }
+  if(comp->nbSegments==1) {
+    return len==first->len && segmentAt(first, name);
+  }
+  if(len<first->len+last->len || !segmentAt(first, name) || !segmentAt(last, name+len-last->len)) {
+    return 0;
+  }
+  cur=name+first->len;
+  end=name+len-last->len;
+  for(cpt=1; cpt+1<comp->nbSegments; cpt++) {
+    const globSegment *seg=&comp->segments[cpt];
+    if(seg->literal!=NULL) {
+      if((cur=(const char *)memmem(cur, (size_t)(end-cur), seg->literal, seg->len))==NULL) {
+        return 0;
+      }
+    } else {
+      for(; cur+seg->len<=end && !segmentAt(seg, cur); cur++) {}
+      if(cur+seg->len>end) {
+        return 0;
+      }
+    }
+    cur+=seg->len;
+  }
+  return 1;
+}
+
+/** \brief pushTask
+ * A function which queues a directory for the workers
+ * \param globWalk *walk: The walk
+ * \param const char *path: The path of its parent, ending with a '/' or empty
+ * \param size_t len: Its length
+ * \param const char *name: Its name, NULL when the path is the directory itself
+ * \param size_t nameLen: The length of the name
+ * \param unsigned int comp: The component its entries are matched against
+ * \param int nested: Whether a ** walks into it
+ * \return None
+ *
+ */
+static void pushTask(globWalk *walk, const char *path, size_t len, const char *name, size_t nameLen,
+                     unsigned int comp, int nested) {
+  globTask *task;
+
+  if(len+nameLen+2>PATH_MAX) {
+    return;
+  }
+  task=(globTask *)malloc(sizeof(globTask)+len+nameLen+2);
+  memcpy(task->path, path, len);
+  task->len=len;
+  if(name!=NULL) {
+    memcpy(task->path+len, name, nameLen);
+    task->path[len+nameLen]='/';
+    task->len+=nameLen+1;
+  }
+  task->path[task->len]='\0';
+  task->comp=comp;
+  task->nested=nested;
+
+  pthread_mutex_lock(&walk->lock);
+  task->next=walk->tasks;
+  walk->tasks=task;
+  walk->pending++;
+  pthread_cond_signal(&walk->wake);
+  pthread_mutex_unlock(&walk->lock);
+}
+
+/** \brief addMatch
+ * A function which records a path the pattern matches
+ * \param globWorker *w: The worker which found it
+ * \param const char *path: Its directory, ending with a '/' or empty
+ * \param size_t len: Its length
+ * \param const char *name: Its name
+ * \param size_t nameLen: The length of the name
+ * \param int slash: Whether a '/' is appended
+ * \return None
+ *
+ */
+static void addMatch(globWorker *w, const char *path, size_t len, const char *name, size_t nameLen, int slash) {
+  size_t need=len+nameLen+2;
+
+  if(w->len+need>w->cap) {
+    while(w->len+need>w->cap) {
+      w->cap=w->cap==0? 4096:w->cap*2;
+    }
+    w->text=(char *)realloc(w->text, w->cap);
+  }
+  if(w->nbOffsets==w->capOffsets) {
+    w->capOffsets=w->capOffsets==0? 64:w->capOffsets*2;
+    w->offsets=(size_t *)realloc(w->offsets, w->capOffsets*sizeof(size_t));
+  }
+  w->offsets[w->nbOffsets++]=w->len;
+  memcpy(w->text+w->len, path, len);
+  memcpy(w->text+w->len+len, name, nameLen);
+  w->len+=len+nameLen;
+  if(slash) {
+    w->text[w->len++]='/';
+  }
+  w->text[w->len++]='\0';
+}
+
+/** \brief isDirectory
+ * A function which tells whether an entry is a directory, with a stat
+ * only when getdents64 didn't give its type
+ * \param int dirFd: Its directory
+ * \param const char *name: Its name
+ * \param unsigned char type: Its d_type
+ * \param int follow: Whether a symbolic link to a directory counts
+ * \return 1: when it's a directory; 0: otherwise
+ *
+ */
+static int isDirectory(int dirFd, const char *name, unsigned char type, int follow) {
+  struct stat st;
+
+  if(type==DT_DIR) {
+    return 1;
+  }
+  if(type!=DT_UNKNOWN && (type!=DT_LNK || !follow)) {
+    return 0;
+  }
+  return fstatat(dirFd, name, &st, follow? 0:AT_SYMLINK_NOFOLLOW)==0 && S_ISDIR(st.st_mode);
+}
+
+/** \brief matchEntry
+ * A function which handles an entry matching a pattern component: the
+ * last one makes it a match, the others make it a directory to read
+ * \param globWorker *w: The worker
+ * \param int dirFd: Its directory
+ * \param const char *path: The path of the directory
+ * \param size_t len: Its length
+ * \param struct dirent64 *entry: The entry
+ * \param size_t nameLen: The length of its name
+ * \param unsigned int comp: The component it matches
+ * \return None
+ *
+ */
+static void matchEntry(globWorker *w, int dirFd, const char *path, size_t len, struct dirent64 *entry,
+                       size_t nameLen, unsigned int comp) {
+  globWalk *walk=w->walk;
+
+  if(comp+1<walk->nbComps) {
+    // Files are left out without a stat, links and unknown types are found out when opened
+    if(entry->d_type==DT_DIR || entry->d_type==DT_LNK || entry->d_type==DT_UNKNOWN) {
+      pushTask(walk, path, len, entry->d_name, nameLen, comp+1, 0);
+    }
+  } else if(!walk->dirsOnly || isDirectory(dirFd, entry->d_name, entry->d_type, 1)) {
+    addMatch(w, path, len, entry->d_name, nameLen, walk->dirsOnly);
+  }
+}
+
+/** \brief walkFrom
+ * A function which matches the components of the pattern from one on,
+ * under a directory
+ * \param globWorker *w: The worker
+ * \param const char *path: The path of the directory, ending with a '/' or empty
+ * \param size_t len: Its length
+ * \param unsigned int comp: The first component
+ * \param int nested: Whether a ** walked into the directory
+ * \return None
+ *
+ */
+static void walkFrom(globWorker *w, const char *path, size_t len, unsigned int comp, int nested) {
+  globWalk *walk=w->walk;
+  globComponent *cur, *next;
+  char buf[PATH_MAX];
+  ssize_t nb, pos;
+  int dirFd;
+
+  // Literal components are appended without reading their directory
+  memcpy(buf, path, len);
+  for(; walk->comps[comp].kind==GLOB_LITERAL; comp++) {
+    cur=&walk->comps[comp];
+    if(len+cur->nameLen+2>PATH_MAX) {
+      return;
+    }
+    memcpy(buf+len, cur->name, cur->nameLen);
+    if(comp+1==walk->nbComps) {
+      struct stat st;
+      buf[len+cur->nameLen]='\0';
+      if(walk->dirsOnly? stat(buf, &st)==0 && S_ISDIR(st.st_mode):lstat(buf, &st)==0) {
+        addMatch(w, path, 0, buf, len+cur->nameLen, walk->dirsOnly);
+      }
+      return;
+    }
+    len+=cur->nameLen;
+    buf[len++]='/';
+  }
+  buf[len]='\0';
+
+  cur=&walk->comps[comp];
+  next=comp+1<walk->nbComps? &walk->comps[comp+1]:NULL;
+  if(cur->kind==GLOB_RECURSE) {
+    // ** also matches no directory at all: the next component is matched here too,
+    // within the same listing when it's a pattern
+    if(next!=NULL && next->kind!=GLOB_PATTERN) {
+      walkFrom(w, buf, len, comp+1, 0);
+    } else if(next==NULL && len>0 && !nested) {
+      addMatch(w, buf, len, "", 0, 0);
+    }
+  }
+
+  if((dirFd=open(len==0? ".":buf, O_RDONLY|O_DIRECTORY|O_CLOEXEC))<0) {
+    return;
+  }
+  while((nb=getdents64(dirFd, w->dents, GLOB_DENTS_BUFFER))>0) {
+    for(pos=0; pos<nb;) {
+      struct dirent64 *entry=(struct dirent64 *)(w->dents+pos);
+      size_t nameLen;
+      pos+=entry->d_reclen;
+      if(entry->d_name[0]=='.' && (entry->d_name[1]=='\0' ||
+                                   (entry->d_name[1]=='.' && entry->d_name[2]=='\0'))) {
+        continue;
+      }
+      nameLen=strlen(entry->d_name);
+      if(cur->kind==GLOB_PATTERN) {
+        if(componentMatch(cur, entry->d_name, nameLen)) {
+          matchEntry(w, dirFd, buf, len, entry, nameLen, comp);
+        }
+        continue;
+      }
+      // The hidden directories are not walked into, the links to directories neither
+      if(next==NULL) {
+        if(entry->d_name[0]!='.' && (!walk->dirsOnly || isDirectory(dirFd, entry->d_name, entry->d_type, 0))) {
+          addMatch(w, buf, len, entry->d_name, nameLen, walk->dirsOnly);
+        }
+      } else if(next->kind==GLOB_PATTERN && componentMatch(next, entry->d_name, nameLen)) {
+        matchEntry(w, dirFd, buf, len, entry, nameLen, comp+1);
+      }
+      if(entry->d_name[0]!='.' && isDirectory(dirFd, entry->d_name, entry->d_type, 0)) {
+        pushTask(walk, buf, len, entry->d_name, nameLen, comp, 1);
+      }
+    }
+  }
+  close(dirFd);
+}
+
+/** \brief runWorker
+ * A function which reads directories until none is left, in the thread of a worker
+ * \param void *data: The worker
+ * \return NULL
+ *
+ */
+static void *runWorker(void *data) {
+  globWorker *w=(globWorker *)data;
+  globWalk *walk=w->walk;
+  globTask *task;
+
+  w->dents=(char *)malloc(GLOB_DENTS_BUFFER);
+  pthread_mutex_lock(&walk->lock);
+  for(;;) {
+    while(walk->tasks==NULL && walk->pending>0) {
+      pthread_cond_wait(&walk->wake, &walk->lock);
+    }
+    if(walk->tasks==NULL) {
+      break;
+    }
+    task=walk->tasks;
+    walk->tasks=task->next;
+    pthread_mutex_unlock(&walk->lock);
+
+    walkFrom(w, task->path, task->len, task->comp, task->nested);
+    free(task);
+
+    pthread_mutex_lock(&walk->lock);
+    // The last task done wakes every worker up to stop
+    if(--walk->pending==0) {
+      pthread_cond_broadcast(&walk->wake);
+    }
+  }
+  pthread_mutex_unlock(&walk->lock);
+  free(w->dents);
+  return NULL;
+}
+
+/** \brief comparePaths
+ * A function which orders two paths for qsort
+ * \param const void *a: A pointer which points to the first path
+ * \param const void *b: A pointer which points to the second path
+ * \return The order of the paths, like strcmp
+ *
+ */
+static int comparePaths(const void *a, const void *b) {
+  return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+/** \brief sortPaths
+ * A function which sorts the matches like strcmp would
+ * Many matches are radix sorted on the 8 characters following the part
+ * every path shares, a byte per pass; only the paths those characters
+ * don't tell apart are compared afterwards
+ * \param char **paths: The paths
+ * \param size_t nb: Their number
+ * \return None
+ *
+ */
+static void sortPaths(char **paths, size_t nb) {
+  globKey *keys, *sorted, *swap;
+  size_t prefix, counts[256], cpt, run;
+  unsigned int shift, byte;
+
+  if(nb<GLOB_RADIX_MIN) {
+    qsort(paths, nb, sizeof(char *), comparePaths);
+    return;
+  }
+  prefix=strlen(paths[0]);
+  for(cpt=1; cpt<nb && prefix>0; cpt++) {
+    for(run=0; run<prefix && paths[cpt][run]==paths[0][run]; run++) {}
+    prefix=run;
+  }
+
+  keys=(globKey *)malloc(sizeof(globKey)*nb*2);
+  sorted=keys+nb;
+  for(cpt=0; cpt<nb; cpt++) {
+    const char *cur=paths[cpt]+prefix;
+    keys[cpt].key=0;
+    keys[cpt].path=paths[cpt];
+    // The key is padded with '\0' after the end of the path, which comes first like in strcmp
+    for(byte=0; byte<8; byte++) {
+      keys[cpt].key<<=8;
+      if(*cur!='\0') {
+        keys[cpt].key|=(unsigned char)*cur++;
+      }
+    }
+  }
+  for(shift=0; shift<64; shift+=8) {
+    size_t pos=0, count;
+    memset(counts, 0, sizeof(counts));
+    for(cpt=0; cpt<nb; cpt++) {
+      counts[(keys[cpt].key>>shift)&0xff]++;
+    }
+    // A byte every path has the same is no pass
+    if(counts[(keys[0].key>>shift)&0xff]==nb) {
+      continue;
+    }
+    for(byte=0; byte<256; byte++) {
+      count=counts[byte];
+      counts[byte]=pos;
+      pos+=count;
+    }
+    for(cpt=0; cpt<nb; cpt++) {
+      sorted[counts[(keys[cpt].key>>shift)&0xff]++]=keys[cpt];
+    }
+    swap=keys;
+    keys=sorted;
+    sorted=swap;
+  }
+
+  for(cpt=0; cpt<nb; cpt=run) {
+    for(run=cpt; run<nb && keys[run].key==keys[cpt].key; run++) {
+      paths[run]=keys[run].path;
+    }
+    // The paths are longer than their key
+    if(run-cpt>1 && (keys[cpt].key&0xff)!=0) {
+      qsort(paths+cpt, run-cpt, sizeof(char *), comparePaths);
+    }
+  }
+  free(keys<sorted? keys:sorted);
+}
+
+/** \brief globExpand
+ * A function which gives the paths a pattern matches
+ * Every component is compiled once, each directory the pattern goes
+ * through is read with getdents64, a large buffer at a time, and its names
+ * are matched without any stat. The directories of a ** pattern are read
+ * by a pool of threads sharing a queue, the calling one included
+ * \param const char *pattern: The pattern, '\' escapes the character following it
+ * \param globList *list: A pointer which points to the list, filled
+ * \return The number of paths
+ *
+ */
+size_t globExpand(const char *pattern, globList *list) {
+  globWorker *workers;
+  unsigned int nbWorkers=1, cpt;
+  size_t len=strlen(pattern), begin, end, nbPaths=0, off;
+  int recurse=0;
+  globWalk walk;
+  arena mem;
+
+  memset(list, 0, sizeof(globList));
+  memset(&walk, 0, sizeof(globWalk));
+  arenaInit(&mem);
+
+  // A trailing '/' only keeps the directories
+  while(len>1 && pattern[len-1]=='/') {
+    walk.dirsOnly=1;
+    len--;
+  }
+  walk.comps=(globComponent *)arenaAlloc(&mem, sizeof(globComponent)*(len/2+1));
+  for(begin=pattern[0]=='/'? 1:0; begin<len; begin=end+1) {
+    for(end=begin; end<len && pattern[end]!='/'; end++) {}
+    // "a//b" is "a/b"
+    if(end>begin) {
+      compileComponent(&mem, &walk.comps[walk.nbComps], pattern+begin, end-begin);
+      recurse|=walk.comps[walk.nbComps].kind==GLOB_RECURSE;
+      walk.nbComps++;
+    }
+  }
+  if(walk.nbComps==0) {
+    arenaRelease(&mem);
+    return 0;
+  }
+
+  if(recurse) {
+    long online=sysconf(_SC_NPROCESSORS_ONLN);
+    nbWorkers=online<1? 1:online>GLOB_WORKERS? GLOB_WORKERS:(unsigned int)online;
+  }
+  workers=(globWorker *)calloc(nbWorkers, sizeof(globWorker));
+  pthread_mutex_init(&walk.lock, NULL);
+  pthread_cond_init(&walk.wake, NULL);
+  pushTask(&walk, pattern[0]=='/'? "/":"", pattern[0]=='/'? 1:0, NULL, 0, 0, 0);
+  for(cpt=0; cpt<nbWorkers; cpt++) {
+    workers[cpt].walk=&walk;
+  }
+  // The threads which can't be started leave more work to the others
+  for(cpt=1; cpt<nbWorkers; cpt++) {
+    if(pthread_create(&workers[cpt].thread, NULL, runWorker, &workers[cpt])) {
+      workers[cpt].walk=NULL;
+    }
+  }
+  runWorker(&workers[0]);
+  for(cpt=1; cpt<nbWorkers; cpt++) {
+    if(workers[cpt].walk!=NULL) {
+      pthread_join(workers[cpt].thread, NULL);
+    }
+  }
+  pthread_cond_destroy(&walk.wake);
+  pthread_mutex_destroy(&walk.lock);
+  arenaRelease(&mem);
+
+  for(cpt=0; cpt<nbWorkers; cpt++) {
+    nbPaths+=workers[cpt].nbOffsets;
+  }
+  if(nbPaths>0) {
+    list->paths=(char **)malloc(sizeof(char *)*nbPaths);
+    list->blocks=(char **)malloc(sizeof(char *)*nbWorkers);
+  }
+  for(cpt=0; cpt<nbWorkers; cpt++) {
+    globWorker *w=&workers[cpt];
+    for(off=0; off<w->nbOffsets; off++) {
+      list->paths[list->nbPaths++]=w->text+w->offsets[off];
+    }
+    if(w->text!=NULL) {
+      list->blocks[list->nbBlocks++]=w->text;
+    }
+    free(w->offsets);
+  }
+  free(workers);
+  if(list->nbPaths>0) {
+    sortPaths(list->paths, list->nbPaths);
+  }
+  return list->nbPaths;
+}
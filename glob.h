@@ -0,0 +1,37 @@
+#ifndef MYSHELL_GLOB_H
+#define MYSHELL_GLOB_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+//Size of the buffer given to getdents64, each worker has its own
+#define GLOB_DENTS_BUFFER 131072
+
+//Most threads walking the directories of a ** pattern
+#define GLOB_WORKERS 8
+
+//Number of matches from which they're radix sorted rather than with qsort
+#define GLOB_RADIX_MIN 1024
+
+//The paths a pattern matches
+typedef struct {
+  //the paths, sorted
+  char **paths;
+  size_t nbPaths;
+
+  //the memory the paths point into, one block per worker
+  char **blocks;
+  unsigned int nbBlocks;
+} globList;
+
+//Whether a word holds a *, ? or [...] which is not escaped by a '\'
+int globHasMeta(const char *pattern);
+//Removes the '\' escaping the characters of a pattern, in place
+void globUnescape(char *pattern);
+//Gives the paths a pattern matches, sorted; 0 when it matches none and the list is left empty
+size_t globExpand(const char *pattern, globList *list);
+
+#endif
@@ -0,0 +1,825 @@
+#include <stdint.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <readline/history.h>
+#include "shell_fct.h"
+
+//Guards the file, its mapping and its index: "history" may run on a thread
+static pthread_mutex_t historyLock = PTHREAD_MUTEX_INITIALIZER;
+
+//The history file, opened for appending, -1 when there's none
+static char *historyPath = NULL;
+static int historyFd = -1;
+static int historyTried = 0;
+
+//The file mapped read-only, and where each of its complete lines starts
+static char *historyMap = NULL;
+static size_t mapSize = 0;
+static size_t *lineStarts = NULL;
+static size_t nbLines = 0, capLines = 0;
+//bytes of the mapping already split into lines
+static size_t indexedBytes = 0;
+
+//The lines sorted by their text, for "history -p": the first nbSorted lines are in it
+static size_t *sortedLines = NULL;
+static size_t nbSorted = 0;
+
+//The lines holding the trigrams of one hash, for "history -s"
+typedef struct {
+    //each line number as its distance to the previous one, in base 128 varints
+    unsigned char *deltas;
+    size_t len, size;
+
+    //the number of lines, and the last one
+    size_t nbRefs, last;
+} gramList;
+
+//HISTORY_GRAM_BUCKETS lists, allocated at the first search; the first nbGrammed lines are in them
+static gramList *grams = NULL;
+static size_t nbGrammed = 0;
+
+//The last line recorded, its repetitions are skipped
+static char *lastLine = NULL;
+//Whether this shell appended to the file
+static int appended = 0;
+//The shell which opened it: its forked children inherit the exit handler
+static pid_t historyPid = 0;
+
+/** \brief hashLine
+ * A function which hashes a line of the history (FNV-1a)
+ * \param const char *s: The line
+ * \param size_t len: Its length
+ * \return The hash of the line
+ *
+ */
+static size_t hashLine(const char *s, size_t len) {
+  size_t hash=(size_t)14695981039346656037ULL;
+  while(len-->0) {
+    hash^=(unsigned char)*s++;
+    hash*=(size_t)1099511628211ULL;
+  }
+  return hash;
+}
+
+/** \brief resetIndex
+ * A function which forgets the mapping of the file and its index
+ * \return None
+ *
+ */
+static void resetIndex(void) {
+  if(historyMap!=NULL) {
+    munmap(historyMap, mapSize);
+  }
+  historyMap=NULL;
+  mapSize=0;
+  nbLines=0;
+  indexedBytes=0;
+  free(sortedLines);
+  sortedLines=NULL;
+  nbSorted=0;
+  for(size_t bucket=0; grams!=NULL && bucket<HISTORY_GRAM_BUCKETS; bucket++) {
+    free(grams[bucket].deltas);
+  }
+  free(grams);
+  grams=NULL;
+  nbGrammed=0;
+}
+
+/** \brief openHistory
+ * A function which opens the history file the first time it's needed:
+ * $MYSHELL_HISTFILE, or ~/.myshell_history; an empty $MYSHELL_HISTFILE
+ * keeps the history in memory only
+ * \return 1: when the file is open; 0: when there's none
+ *
+ */
+static int openHistory(void) {
+  const char *path=getVar("MYSHELL_HISTFILE");
+
+  if(historyTried) {
+    return historyFd>=0;
+  }
+  historyTried=1;
+  if(path!=NULL) {
+    if(path[0]=='\0') {
+      return 0;
+    }
+    historyPath=strdup(path);
+  } else {
+    const char *home=sessionHome();
+    historyPath=(char *)malloc(strlen(home)+sizeof(HISTORY_DEFAULT_FILE)+1);
+    sprintf(historyPath, "%s/%s", home, HISTORY_DEFAULT_FILE);
+  }
+  if((historyFd=open(historyPath, O_RDWR|O_CREAT|O_APPEND|O_CLOEXEC, 0600))<0) {
+    fprintf(stderr, "-myshell: %s: %s\n", historyPath, strerror(errno));
+    return 0;
+  }
+  return 1;
+}
+
+/** \brief lockHistory
+ * A function which locks the history file against the other shells
+ * When one of them has compacted it meanwhile, the new file is opened
+ * \param int operation: LOCK_SH to append, LOCK_EX to compact
+ * \return 1: when the file is locked; 0: when it can't be opened any more
+ *
+ */
+static int lockHistory(int operation) {
+  struct stat byPath, byFd;
+
+  while(historyFd>=0) {
+    flock(historyFd, operation);
+    if(fstat(historyFd, &byFd)==0 && stat(historyPath, &byPath)==0 &&
+       byFd.st_dev==byPath.st_dev && byFd.st_ino==byPath.st_ino) {
+      return 1;
+    }
+    // Replaced by a compaction, or removed: what we mapped is stale
+    close(historyFd);
+    resetIndex();
+    historyFd=open(historyPath, O_RDWR|O_CREAT|O_APPEND|O_CLOEXEC, 0600);
+  }
+  return 0;
+}
+
+/** \brief mapHistory
+ * A function which maps the file again when it has grown
+ * The lines are never moved, so the offsets of the index stay valid
+ * \return None
+ *
+ */
+static void mapHistory(void) {
+  struct stat st;
+
+  if(fstat(historyFd, &st)<0 || (size_t)st.st_size==mapSize) {
+    return;
+  }
+  if((size_t)st.st_size<mapSize) {
+    resetIndex();
+  } else if(historyMap!=NULL) {
+    munmap(historyMap, mapSize);
+    historyMap=NULL;
+  }
+  if(st.st_size==0) {
+    return;
+  }
+  historyMap=(char *)mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, historyFd, 0);
+  if(historyMap==MAP_FAILED) {
+    historyMap=NULL;
+    resetIndex();
+    return;
+  }
+  mapSize=(size_t)st.st_size;
+}
+
+/** \brief indexHistory
+ * A function which maps the file and splits what was appended since the last
+ * time into lines; a line cut short by a writer is left for the next time
+ * \return None
+ *
+ */
+static void indexHistory(void) {
+  const char *nl;
+
+  mapHistory();
+  while(indexedBytes<mapSize &&
+        (nl=(const char *)memchr(historyMap+indexedBytes, '\n', mapSize-indexedBytes))!=NULL) {
+    if(nbLines==capLines) {
+      capLines=capLines==0? 1024:capLines*2;
+      lineStarts=(size_t *)realloc(lineStarts, sizeof(size_t)*capLines);
+    }
+    lineStarts[nbLines++]=indexedBytes;
+    indexedBytes=(size_t)(nl-historyMap)+1;
+  }
+}
+
+/** \brief lineLength
+ * A function which gives the length of a line of the index, without its newline
+ * \param size_t lineNo: The line
+ * \return Its length
+ *
+ */
+static size_t lineLength(size_t lineNo) {
+  size_t end=lineNo+1<nbLines? lineStarts[lineNo+1]:indexedBytes;
+  return end-lineStarts[lineNo]-1;
+}
+
+/** \brief compareLines
+ * A function which orders two lines of the index by their text
+ * \param size_t la: A line number
+ * \param size_t lb: Another one
+ * \return <0, 0 or >0 like strcmp
+ *
+ */
+static int compareLines(size_t la, size_t lb) {
+  size_t lenA=lineLength(la), lenB=lineLength(lb);
+  int diff=memcmp(historyMap+lineStarts[la], historyMap+lineStarts[lb], lenA<lenB? lenA:lenB);
+
+  if(diff!=0) {
+    return diff;
+  }
+  return lenA<lenB? -1:lenA>lenB;
+}
+
+/** \brief compareNumbers
+ * A function which orders line numbers for qsort
+ * \return <0, 0 or >0 like strcmp
+ *
+ */
+static int compareNumbers(const void *a, const void *b) {
+  size_t la=*(const size_t *)a, lb=*(const size_t *)b;
+  return la<lb? -1:la>lb;
+}
+
+//A line being sorted, kept small since the keys are swapped a lot; its first bytes are copied, read without a cache miss
+typedef struct {
+    uint32_t lineNo;
+    uint32_t len;
+    unsigned char head[HISTORY_SORT_HEAD];
+} sortKey;
+
+/** \brief keyChar
+ * A function which gives a character of a line being sorted
+ * \param const sortKey *key: The line
+ * \param size_t depth: The place of the character
+ * \return The character; -1 past the end of the line
+ *
+ */
+static int keyChar(const sortKey *key, size_t depth) {
+  if(depth>=key->len) {
+    return -1;
+  }
+  return depth<HISTORY_SORT_HEAD? key->head[depth]:(unsigned char)historyMap[lineStarts[key->lineNo]+depth];
+}
+
+/** \brief sortKeys
+ * A function which sorts lines sharing their first depth characters, a
+ * character at a time (multikey quicksort): the lines of a history share long
+ * prefixes, which a comparison sort would read again at every comparison
+ * \param sortKey *keys: The lines
+ * \param size_t nb: Their number
+ * \param size_t depth: The number of characters they share
+ * \return None
+ *
+ */
+static void sortKeys(sortKey *keys, size_t nb, size_t depth) {
+  sortKey swap;
+
+  while(nb>1) {
+    size_t lt=0, gt=nb, cpt=0;
+    int first=keyChar(&keys[0], depth), middle=keyChar(&keys[nb/2], depth), end=keyChar(&keys[nb-1], depth), pivot;
+
+    // The median of three characters
+    pivot=first<middle? (middle<end? middle:(first<end? end:first)):(first<end? first:(middle<end? end:middle));
+    while(cpt<gt) {
+      int c=keyChar(&keys[cpt], depth);
+      if(c<pivot) {
+        swap=keys[lt]; keys[lt++]=keys[cpt]; keys[cpt++]=swap;
+      } else if(c>pivot) {
+        swap=keys[--gt]; keys[gt]=keys[cpt]; keys[cpt]=swap;
+      } else {
+        cpt++;
+      }
+    }
+    sortKeys(keys, lt, depth);
+    sortKeys(keys+gt, nb-gt, depth);
+    // The lines which ended here are equal
+    if(pivot<0) {
+      return;
+    }
+    keys+=lt;
+    nb=gt-lt;
+    depth++;
+  }
+}
+
+/** \brief sortHistory
+ * A function which adds the lines indexed since the last time to the sorted
+ * table: they're sorted on their own and merged with the others
+ * Merging costs the whole table, so that the lines appended by the prompt
+ * are left out, and read one by one, until HISTORY_SORT_TAIL of them wait
+ * \return None
+ *
+ */
+static void sortHistory(void) {
+  size_t nbNew=nbLines-nbSorted, old=0, added=0, cpt, *merged;
+  sortKey *keys;
+
+  if(nbNew==0 || (nbSorted>0 && nbNew<HISTORY_SORT_TAIL)) {
+    return;
+  }
+  keys=(sortKey *)malloc(sizeof(sortKey)*nbNew);
+  for(cpt=0; cpt<nbNew; cpt++) {
+    size_t len=lineLength(nbSorted+cpt);
+    keys[cpt].lineNo=(uint32_t)(nbSorted+cpt);
+    keys[cpt].len=len<UINT32_MAX? (uint32_t)len:UINT32_MAX;
+    memcpy(keys[cpt].head, historyMap+lineStarts[nbSorted+cpt], len<HISTORY_SORT_HEAD? len:HISTORY_SORT_HEAD);
+  }
+  sortKeys(keys, nbNew, 0);
+  // The old lines are merged from the front, the new ones wait at the end of the same table
+  merged=(size_t *)malloc(sizeof(size_t)*nbLines);
+  for(cpt=0; cpt<nbNew; cpt++) {
+    merged[nbSorted+cpt]=keys[cpt].lineNo;
+  }
+  free(keys);
+  for(cpt=0; old<nbSorted || added<nbNew; cpt++) {
+    if(added==nbNew || (old<nbSorted && compareLines(sortedLines[old], merged[nbSorted+added])<=0)) {
+      merged[cpt]=sortedLines[old++];
+    } else {
+      merged[cpt]=merged[nbSorted+added++];
+    }
+  }
+  free(sortedLines);
+  sortedLines=merged;
+  nbSorted=nbLines;
+}
+
+/** \brief comparePrefix
+ * A function which compares a line with a prefix
+ * \param size_t lineNo: The line
+ * \param const char *prefix: The prefix
+ * \param size_t len: Its length
+ * \return <0: when the line sorts before the lines with the prefix; 0: when it starts with it; >0: otherwise
+ *
+ */
+static int comparePrefix(size_t lineNo, const char *prefix, size_t len) {
+  size_t lineLen=lineLength(lineNo);
+  int diff=memcmp(historyMap+lineStarts[lineNo], prefix, lineLen<len? lineLen:len);
+
+  if(diff!=0) {
+    return diff;
+  }
+  return lineLen<len? -1:0;
+}
+
+/** \brief gramHash
+ * A function which gives the list of a trigram
+ * \param const char *gram: Its three characters
+ * \return The number of its list, below HISTORY_GRAM_BUCKETS
+ *
+ */
+static size_t gramHash(const char *gram) {
+  uint32_t key=(uint32_t)(unsigned char)gram[0]<<16 | (uint32_t)(unsigned char)gram[1]<<8 | (unsigned char)gram[2];
+  return (size_t)((key*2654435761U)>>16)&(HISTORY_GRAM_BUCKETS-1);
+}
+
+/** \brief gramHistory
+ * A function which adds the lines indexed since the last time to the lists of
+ * their trigrams; a line is in a list once, whatever times it holds its trigrams
+ * \return None
+ *
+ */
+static void gramHistory(void) {
+  if(grams==NULL) {
+    grams=(gramList *)calloc(HISTORY_GRAM_BUCKETS, sizeof(gramList));
+  }
+  for(; nbGrammed<nbLines; nbGrammed++) {
+    const char *line=historyMap+lineStarts[nbGrammed];
+    size_t len=lineLength(nbGrammed);
+    for(size_t pos=0; pos+3<=len; pos++) {
+      gramList *list=&grams[gramHash(line+pos)];
+      size_t delta=nbGrammed-list->last;
+      if(list->nbRefs>0 && delta==0) {
+        continue;
+      }
+      if(list->size-list->len<sizeof(size_t)*8/7+1) {
+        list->size=list->size==0? 16:list->size*2;
+        list->deltas=(unsigned char *)realloc(list->deltas, list->size);
+      }
+      while(delta>=0x80) {
+        list->deltas[list->len++]=(unsigned char)(delta|0x80);
+        delta>>=7;
+      }
+      list->deltas[list->len++]=(unsigned char)delta;
+      list->last=nbGrammed;
+      list->nbRefs++;
+    }
+  }
+}
+
+/** \brief gramLines
+ * A function which keeps the candidates found in the list of a trigram
+ * \param const gramList *list: The list
+ * \param size_t *lines: The candidates, in order, updated
+ * \param size_t nbCandidates: Their number; 0 the first time, when the list gives them all
+ * \param int first: Whether it's the first list read
+ * \return The number of candidates left
+ *
+ */
+static size_t gramLines(const gramList *list, size_t *lines, size_t nbCandidates, int first) {
+  size_t pos=0, lineNo=0, kept=0, cand=0;
+
+  for(size_t ref=0; ref<list->nbRefs; ref++) {
+    size_t delta=0;
+    int shift=0;
+    while(list->deltas[pos]&0x80) {
+      delta|=(size_t)(list->deltas[pos++]&0x7f)<<shift;
+      shift+=7;
+    }
+    delta|=(size_t)list->deltas[pos++]<<shift;
+    lineNo+=delta;
+    if(first) {
+      lines[kept++]=lineNo;
+      continue;
+    }
+    while(cand<nbCandidates && lines[cand]<lineNo) {
+      cand++;
+    }
+    if(cand==nbCandidates) {
+      break;
+    }
+    if(lines[cand]==lineNo) {
+      lines[kept++]=lineNo;
+    }
+  }
+  return kept;
+}
+
+/** \brief lastLines
+ * A function which picks the most recent lines of a set, in the order of the
+ * file; a heap keeps the n most recent ones, so that a common prefix with few
+ * lines asked for doesn't sort all of them
+ * \param const size_t *lines: The line numbers, in any order
+ * \param size_t nb: Their number
+ * \param size_t n: How many are wanted
+ * \param size_t **picked: Filled with the lines picked, to be freed
+ * \return The number of lines picked
+ *
+ */
+static size_t lastLines(const size_t *lines, size_t nb, size_t n, size_t **picked) {
+  size_t *heap, size=nb<n? nb:n, cpt;
+
+  heap=(size_t *)malloc(sizeof(size_t)*(size+1));
+  memcpy(heap, lines, sizeof(size_t)*size);
+  if(size<nb) {
+    // A min-heap: its root is the oldest line kept
+    qsort(heap, size, sizeof(size_t), compareNumbers);
+    for(cpt=size; cpt<nb; cpt++) {
+      size_t parent=0, child;
+      if(size==0 || lines[cpt]<=heap[0]) {
+        continue;
+      }
+      while((child=2*parent+1)<size) {
+        if(child+1<size && heap[child+1]<heap[child]) {
+          child++;
+        }
+        if(heap[child]>=lines[cpt]) {
+          break;
+        }
+        heap[parent]=heap[child];
+        parent=child;
+      }
+      heap[parent]=lines[cpt];
+    }
+  }
+  qsort(heap, size, sizeof(size_t), compareNumbers);
+  *picked=heap;
+  return size;
+}
+
+/** \brief compactHistory
+ * A function which rewrites the file with its most recent distinct lines,
+ * at most "histfilesize" of them, the file being locked with LOCK_EX
+ * The new file replaces the old one with rename, so that a reader never
+ * sees it half written
+ * \return 0: when the file is compacted; -1: otherwise
+ *
+ */
+static int compactHistory(void) {
+  size_t keep=shellOptions.histFileSize>0? (size_t)shellOptions.histFileSize:nbLines;
+  size_t tableSize=1, nbKept=0, lineNo, *table, *kept;
+  char *tmpPath;
+  FILE *tmp;
+  int fd, failed;
+
+  if(keep>nbLines) {
+    keep=nbLines;
+  }
+  while(tableSize<2*keep+1) {
+    tableSize<<=1;
+  }
+  // The table holds line numbers plus one, 0 marks a free slot
+  table=(size_t *)calloc(tableSize, sizeof(size_t));
+  kept=(size_t *)malloc(sizeof(size_t)*(keep+1));
+  for(lineNo=nbLines; lineNo-->0 && nbKept<keep;) {
+    const char *line=historyMap+lineStarts[lineNo];
+    size_t len=lineLength(lineNo), slot=hashLine(line, len)&(tableSize-1);
+    if(len==0) {
+      continue;
+    }
+    while(table[slot]!=0 && (lineLength(table[slot]-1)!=len ||
+                             memcmp(historyMap+lineStarts[table[slot]-1], line, len))) {
+      slot=(slot+1)&(tableSize-1);
+    }
+    if(table[slot]==0) {
+      table[slot]=lineNo+1;
+      kept[nbKept++]=lineNo;
+    }
+  }
+  free(table);
+
+  tmpPath=(char *)malloc(strlen(historyPath)+8);
+  sprintf(tmpPath, "%s.XXXXXX", historyPath);
+  if((fd=mkostemp(tmpPath, O_CLOEXEC))<0 || (tmp=fdopen(fd, "w"))==NULL) {
+    fprintf(stderr, "-myshell: %s: %s\n", historyPath, strerror(errno));
+    if(fd>=0) {
+      close(fd);
+      unlink(tmpPath);
+    }
+    free(tmpPath);
+    free(kept);
+    return -1;
+  }
+  while(nbKept-->0) {
+    fwrite(historyMap+lineStarts[kept[nbKept]], 1, lineLength(kept[nbKept])+1, tmp);
+  }
+  failed=ferror(tmp);
+  if(fclose(tmp)!=0 || failed || rename(tmpPath, historyPath)<0) {
+    fprintf(stderr, "-myshell: %s: %s\n", historyPath, strerror(errno));
+    unlink(tmpPath);
+    failed=1;
+  }
+  free(tmpPath);
+  free(kept);
+  return failed? -1:0;
+}
+
+/** \brief closeHistory
+ * A function which compacts the file, when the shell exits, once it has gone
+ * a quarter beyond "histfilesize": it's not rewritten at every exit
+ * \return None
+ *
+ */
+static void closeHistory(void) {
+  size_t bound=(size_t)shellOptions.histFileSize;
+
+  // A child which calls exit() may have been forked while a thread held the lock
+  if(getpid()!=historyPid) {
+    return;
+  }
+  pthread_mutex_lock(&historyLock);
+  if(appended && bound>0 && lockHistory(LOCK_EX)) {
+    indexHistory();
+    if(nbLines>bound+bound/4) {
+      compactHistory();
+    }
+    flock(historyFd, LOCK_UN);
+  }
+  pthread_mutex_unlock(&historyLock);
+}
+
+/** \brief initHistory
+ * A function which maps the history file and gives readline its last
+ * "histsize" lines, found from the end of the file: the time it takes
+ * doesn't grow with the file
+ * \return None
+ *
+ */
+void initHistory(void) {
+  size_t want=shellOptions.histSize>0? (size_t)shellOptions.histSize:0, found=0, end;
+  size_t *starts, *lens;
+
+  if(shellOptions.histSize>0) {
+    stifle_history(shellOptions.histSize);
+  }
+  pthread_mutex_lock(&historyLock);
+  if(!openHistory()) {
+    pthread_mutex_unlock(&historyLock);
+    return;
+  }
+  historyPid=getpid();
+  atexit(closeHistory);
+  mapHistory();
+
+  starts=(size_t *)malloc(sizeof(size_t)*(want+1));
+  lens=(size_t *)malloc(sizeof(size_t)*(want+1));
+  end=mapSize;
+  // A line cut short by a writer is not taken
+  if(end>0 && historyMap[end-1]!='\n') {
+    const char *nl=(const char *)memrchr(historyMap, '\n', end);
+    end=nl==NULL? 0:(size_t)(nl-historyMap)+1;
+  }
+  while(found<want && end>0) {
+    const char *nl=end>1? (const char *)memrchr(historyMap, '\n', end-1):NULL;
+    size_t start=nl==NULL? 0:(size_t)(nl-historyMap)+1;
+    if(end-start>1) {
+      starts[found]=start;
+      lens[found++]=end-start-1;
+    }
+    end=start;
+  }
+  while(found-->0) {
+    char *line=strndup(historyMap+starts[found], lens[found]);
+    if(lastLine==NULL || strcmp(lastLine, line)) {
+      add_history(line);
+      free(lastLine);
+      lastLine=line;
+    } else {
+      free(line);
+    }
+  }
+  free(starts);
+  free(lens);
+  pthread_mutex_unlock(&historyLock);
+}
+
+/** \brief addHistory
+ * A function which records a line typed at the prompt, unless it repeats the
+ * previous one; it's appended to the file at once, with a single write, so
+ * that the shells sharing the file don't mix their lines
+ * \param const char *line: The line
+ * \return None
+ *
+ */
+void addHistory(const char *line) {
+  size_t len=strlen(line);
+  char *record;
+
+  if(lastLine!=NULL && !strcmp(lastLine, line)) {
+    return;
+  }
+  add_history(line);
+  free(lastLine);
+  lastLine=strdup(line);
+
+  pthread_mutex_lock(&historyLock);
+  if(openHistory() && strchr(line, '\n')==NULL && lockHistory(LOCK_SH)) {
+    record=(char *)malloc(len+1);
+    memcpy(record, line, len);
+    record[len]='\n';
+    if(write(historyFd, record, len+1)==(ssize_t)(len+1)) {
+      appended=1;
+    }
+    flock(historyFd, LOCK_UN);
+    free(record);
+  }
+  pthread_mutex_unlock(&historyLock);
+}
+
+/** \brief historyCommand
+ * A function which realizes "history [-p prefix | -s text] [n]": it prints
+ * the last n lines of the file, or of those which start with the prefix
+ * or hold the text; "history -w" compacts the file at once
+ * The lines are copied while the index is locked and printed once it's
+ * released, so that a slow reader doesn't hold up the prompt
+ * \param char **args: The arguments of the builtin
+ * \param unsigned int nbArgs: The number of arguments
+ * \param const int *fds: Its stdin, stdout and stderr
+ * \return The exit code
+ *
+ */
+int historyCommand(char **args, unsigned int nbArgs, const int *fds) {
+  const char *pattern=NULL;
+  size_t patternLen=0, last=SIZE_MAX, nbMatches=0, capMatches=0, *matches=NULL, cpt, size=0;
+  char mode=0, *text, *cur;
+  unsigned int argNo=1;
+  outBuffer out;
+
+  if(nbArgs==2 && !strcmp(args[1], "-w")) {
+    int ret=1;
+    pthread_mutex_lock(&historyLock);
+    if(openHistory() && lockHistory(LOCK_EX)) {
+      indexHistory();
+      ret=compactHistory()<0;
+      flock(historyFd, LOCK_UN);
+    }
+    pthread_mutex_unlock(&historyLock);
+    return ret;
+  }
+  if(argNo<nbArgs && (!strcmp(args[argNo], "-p") || !strcmp(args[argNo], "-s"))) {
+    if(argNo+1>=nbArgs) {
+      nbArgs=0;
+    } else {
+      mode=args[argNo][1];
+      pattern=args[argNo+1];
+      patternLen=strlen(pattern);
+      argNo+=2;
+    }
+  }
+  if(nbArgs>0 && argNo+1==nbArgs) {
+    char *end;
+    last=strtoul(args[argNo], &end, 10);
+    if(args[argNo][0]=='\0' || *end!='\0') {
+      nbArgs=0;
+    }
+  } else if(nbArgs>0 && argNo<nbArgs) {
+    nbArgs=0;
+  }
+  if(nbArgs==0) {
+    dprintf(fds[2], "-myshell: history: usage: history [-p prefix | -s text] [n] | history -w\n");
+    return 2;
+  }
+
+  pthread_mutex_lock(&historyLock);
+  // Locked a moment, to take the new file when another shell compacted it
+  if(!openHistory() || !lockHistory(LOCK_SH)) {
+    pthread_mutex_unlock(&historyLock);
+    return 1;
+  }
+  indexHistory();
+  flock(historyFd, LOCK_UN);
+  if(mode=='p') {
+    // The lines with the prefix are side by side in the sorted table, the recent ones are read after
+    size_t low=0, high, first, *found;
+    sortHistory();
+    high=nbSorted;
+    while(low<high) {
+      size_t middle=(low+high)/2;
+      if(comparePrefix(sortedLines[middle], pattern, patternLen)<0) {
+        low=middle+1;
+      } else {
+        high=middle;
+      }
+    }
+    for(first=low, high=nbSorted; low<high;) {
+      size_t middle=(low+high)/2;
+      if(comparePrefix(sortedLines[middle], pattern, patternLen)==0) {
+        low=middle+1;
+      } else {
+        high=middle;
+      }
+    }
+    found=(size_t *)malloc(sizeof(size_t)*(low-first+nbLines-nbSorted+1));
+    memcpy(found, sortedLines+first, sizeof(size_t)*(low-first));
+    nbMatches=low-first;
+    for(cpt=nbSorted; cpt<nbLines; cpt++) {
+      if(comparePrefix(cpt, pattern, patternLen)==0) {
+        found[nbMatches++]=cpt;
+      }
+    }
+    nbMatches=lastLines(found, nbMatches, last, &matches);
+    free(found);
+  } else if(mode=='s' && patternLen>=3) {
+    // The lines in the lists of all its trigrams, rarest first, then checked
+    size_t buckets[HISTORY_GRAM_MAX], nbBuckets=0, cand;
+    gramHistory();
+    for(cpt=0; cpt+3<=patternLen && nbBuckets<HISTORY_GRAM_MAX; cpt++) {
+      size_t bucket=gramHash(pattern+cpt), at=nbBuckets;
+      for(cand=0; cand<nbBuckets && buckets[cand]!=bucket; cand++) {}
+      if(cand<nbBuckets) {
+        continue;
+      }
+      while(at>0 && grams[buckets[at-1]].nbRefs>grams[bucket].nbRefs) {
+        buckets[at]=buckets[at-1];
+        at--;
+      }
+      buckets[at]=bucket;
+      nbBuckets++;
+    }
+    matches=(size_t *)malloc(sizeof(size_t)*(grams[buckets[0]].nbRefs+1));
+    cand=gramLines(&grams[buckets[0]], matches, 0, 1);
+    // A list much longer than the candidates costs more to read than to check them
+    for(cpt=1; cpt<nbBuckets && cand>0 && grams[buckets[cpt]].nbRefs<16*cand; cpt++) {
+      cand=gramLines(&grams[buckets[cpt]], matches, cand, 0);
+    }
+    for(cpt=0; cpt<cand; cpt++) {
+      if(memmem(historyMap+lineStarts[matches[cpt]], lineLength(matches[cpt]), pattern, patternLen)!=NULL) {
+        matches[nbMatches++]=matches[cpt];
+      }
+    }
+  } else if(mode=='s') {
+    // Too short for a trigram: memmem runs over the whole mapping, each hit is mapped back to its line
+    const char *from=historyMap, *hit, *end=historyMap+indexedBytes;
+    while(from<end && (hit=(const char *)memmem(from, (size_t)(end-from), pattern, patternLen))!=NULL) {
+      size_t low=0, high=nbLines;
+      while(high-low>1) {
+        size_t middle=(low+high)/2;
+        if(lineStarts[middle]<=(size_t)(hit-historyMap)) {
+          low=middle;
+        } else {
+          high=middle;
+        }
+      }
+      if(nbMatches==capMatches) {
+        capMatches=capMatches==0? 256:capMatches*2;
+        matches=(size_t *)realloc(matches, sizeof(size_t)*capMatches);
+      }
+      matches[nbMatches++]=low;
+      from=historyMap+lineStarts[low]+lineLength(low)+1;
+    }
+  } else {
+    matches=(size_t *)malloc(sizeof(size_t)*(nbLines+1));
+    for(cpt=0; cpt<nbLines; cpt++) {
+      matches[nbMatches++]=cpt;
+    }
+  }
+
+  // Only the last ones are printed, numbered by their place in the file
+  cpt=nbMatches>last? nbMatches-last:0;
+  for(size_t no=cpt; no<nbMatches; no++) {
+    size+=lineLength(matches[no])+24;
+  }
+  cur=text=(char *)malloc(size+1);
+  for(; cpt<nbMatches; cpt++) {
+    cur+=sprintf(cur, "%5zu  ", matches[cpt]+1);
+    memcpy(cur, historyMap+lineStarts[matches[cpt]], lineLength(matches[cpt])+1);
+    cur+=lineLength(matches[cpt])+1;
+  }
+  pthread_mutex_unlock(&historyLock);
+  free(matches);
+
+  out.fd=fds[1];
+  out.error=0;
+  out.len=0;
+  outWrite(&out, text, (size_t)(cur-text));
+  free(text);
+  return outDone(&out, 0);
+}
@@ -0,0 +1,32 @@
+#ifndef MYSHELL_HISTORY_H
+#define MYSHELL_HISTORY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+//History file, in the home directory, used when MYSHELL_HISTFILE is not set
+#define HISTORY_DEFAULT_FILE ".myshell_history"
+
+//Lists of lines of the trigram index, a power of two; trigrams sharing one are told apart by memmem
+#define HISTORY_GRAM_BUCKETS (1 << 16)
+
+//Bytes of a line copied next to it while the lines are sorted for the prefix index
+#define HISTORY_SORT_HEAD 24
+
+//Lines appended since the prefix index was sorted which are read one by one, beyond it they're merged in
+#define HISTORY_SORT_TAIL 4096
+
+//Trigrams of a searched text whose lists are read, the lines found are checked anyway
+#define HISTORY_GRAM_MAX 32
+
+//Opens the history file and gives its most recent lines to readline
+void initHistory(void);
+//Records a line typed at the prompt, in readline and at the end of the file
+void addHistory(const char *line);
+//Realizes the "history" builtin
+int historyCommand(char **args, unsigned int nbArgs, const int *fds);
+
+#endif
@@ -0,0 +1,138 @@
+#include "input.h"
+
+/** \brief openReader
+ * A function which prepares a buffered reader on a file
+ * \param inputReader *reader: A pointer which points to the reader
+ * \param int fd: The file to read
+ * \return None
+ *
+ */
+void openReader(inputReader *reader, int fd) {
+  reader->fd=fd;
+  reader->size=INPUT_BUFFER_SIZE;
+  reader->buf=(char *)malloc(reader->size);
+  reader->start=0;
+  reader->end=0;
+  reader->eof=0;
+}
+
+/** \brief openStringReader
+ * A function which prepares a reader giving the lines of a string
+ * \param inputReader *reader: A pointer which points to the reader
+ * \param const char *s: The string
+ * \return None
+ *
+ */
+void openStringReader(inputReader *reader, const char *s) {
+  size_t len=strlen(s);
+  reader->fd=-1;
+  reader->size=len+1;
+  reader->buf=(char *)malloc(reader->size);
+  memcpy(reader->buf, s, len);
+  reader->start=0;
+  reader->end=len;
+  reader->eof=1;
+}
+
+/** \brief fillReader
+ * A function which reads more data at the end of the buffer
+ * The unconsumed data is first moved to the beginning of the buffer,
+ * which is doubled when it's full of a single line
+ * \param inputReader *reader: A pointer which points to the reader
+ * \return The number of bytes read; 0 at the end of the file
+ *
+ */
+static size_t fillReader(inputReader *reader) {
+  ssize_t got;
+
+  if(reader->eof) {
+    return 0;
+  }
+  if(reader->start!=0) {
+    memmove(reader->buf, reader->buf+reader->start, reader->end-reader->start);
+    reader->end-=reader->start;
+    reader->start=0;
+  }
+  // Keep a byte for the terminating NUL of the last line
+  if(reader->size-reader->end<2) {
+    reader->size*=2;
+    reader->buf=(char *)realloc(reader->buf, reader->size);
+  }
+
+  do {
+    got=read(reader->fd, reader->buf+reader->end, reader->size-reader->end-1);
+  } while(got<0 && errno==EINTR);
+  if(got<=0) {
+    reader->eof=1;
+    return 0;
+  }
+  reader->end+=(size_t)got;
+  return (size_t)got;
+}
+
+/** \brief readLine
+ * A function which gives the next line of the input
+ * The line is terminated in place in the buffer, it's never copied
+ * \param inputReader *reader: A pointer which points to the reader
+ * \return The line without its newline, valid until the next readLine or readerAtEnd;
+ * NULL at the end of the input
+ *
+ */
+char *readLine(inputReader *reader) {
+  size_t scanned=0;
+  char *line, *newline;
+
+  while(1) {
+    newline=(char *)memchr(reader->buf+reader->start+scanned, '\n', reader->end-reader->start-scanned);
+    if(newline!=NULL) {
+      break;
+    }
+    scanned=reader->end-reader->start;
+    if(fillReader(reader)==0) {
+      break;
+    }
+  }
+
+  line=reader->buf+reader->start;
+  if(newline!=NULL) {
+    *newline='\0';
+    reader->start=(size_t)(newline-reader->buf)+1;
+    return line;
+  }
+
+  // The last line has no newline
+  if(reader->start==reader->end) {
+    return NULL;
+  }
+  reader->buf[reader->end]='\0';
+  reader->start=reader->end;
+  return line;
+}
+
+/** \brief readerAtEnd
+ * A function which tells whether the input is over, reading ahead if needed
+ * \param inputReader *reader: A pointer which points to the reader
+ * \return 1: when there are no more lines; 0: otherwise
+ *
+ */
+int readerAtEnd(inputReader *reader) {
+  if(reader->start<reader->end) {
+    return 0;
+  }
+  return fillReader(reader)==0;
+}
+
+/** \brief closeReader
+ * A function which frees the buffer of a reader and closes its file
+ * \param inputReader *reader: A pointer which points to the reader
+ * \return None
+ *
+ */
+void closeReader(inputReader *reader) {
+  free(reader->buf);
+  reader->buf=NULL;
+  if(reader->fd>STDERR_FILENO) {
+    close(reader->fd);
+  }
+  reader->fd=-1;
+}
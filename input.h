@@ -0,0 +1,36 @@
+#ifndef MYSHELL_INPUT_H
+#define MYSHELL_INPUT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+//Size of the first buffer of a reader
+#define INPUT_BUFFER_SIZE 65536
+
+typedef struct {
+    //the file read, -1 when the reader holds a string
+    int fd;
+
+    //the buffered input, buf[start..end) is not consumed yet
+    char *buf;
+    size_t size, start, end;
+
+    //set once the file has no more data
+    int eof;
+} inputReader;
+
+//Reads the lines of a file
+void openReader(inputReader *reader, int fd);
+//Reads the lines of a string, as given to -c
+void openStringReader(inputReader *reader, const char *s);
+//Gives the next line, valid until the next readLine or readerAtEnd; NULL at the end of the input
+char *readLine(inputReader *reader);
+//Tells whether the input is over, it may read ahead
+int readerAtEnd(inputReader *reader);
+//Frees the buffer of a reader and closes its file
+void closeReader(inputReader *reader);
+
+#endif
@@ -0,0 +1,1154 @@
+#include "jobs.h"
+#include "trace.h"
+#include "vars.h"
+
+int shellInteractive = 0;
+int shellTerminal = -1;
+
+//The process group of the shell and its terminal modes
+static pid_t shellPgid = 0;
+static struct termios shellTmodes;
+
+//Receives SIGCHLD
+static int sigchldFd = -1;
+
+//The jobs, in the order they were started
+static job *jobList = NULL;
+
+//The last foreground job which finished, kept for "pipestatus"
+static job *lastJob = NULL;
+
+typedef struct {
+    const char *name;
+    int signo;
+} signalName;
+
+static const signalName signalNames[] = {
+    {"HUP", SIGHUP}, {"INT", SIGINT}, {"QUIT", SIGQUIT}, {"KILL", SIGKILL},
+    {"USR1", SIGUSR1}, {"SEGV", SIGSEGV}, {"USR2", SIGUSR2}, {"PIPE", SIGPIPE},
+    {"ALRM", SIGALRM}, {"TERM", SIGTERM}, {"CHLD", SIGCHLD}, {"CONT", SIGCONT},
+    {"STOP", SIGSTOP}, {"TSTP", SIGTSTP}, {"TTIN", SIGTTIN}, {"TTOU", SIGTTOU},
+    {NULL, 0}
+};
+
+/** \brief statusCode
+ * A function which turns a wait status into an exit code
+ * \param int status: The wait status
+ * \return The exit code, 128+n when the process was killed by the signal n
+ *
+ */
+static int statusCode(int status) {
+  if(WIFEXITED(status)) {
+    return WEXITSTATUS(status);
+  }
+  if(WIFSIGNALED(status)) {
+    return 128+WTERMSIG(status);
+  }
+  return 0;
+}
+
+/** \brief updateJobState
+ * A function which computes the state of a job from the state of its members
+ * \param job *j: The job
+ * \return None
+ *
+ */
+static void updateJobState(job *j) {
+  unsigned int cpt;
+  int running=0, stopped=0, threads=0;
+
+  for(cpt=0; cpt<j->nbProcs; cpt++) {
+    if(j->procs[cpt].state==JOB_RUNNING) {
+      // A builtin on a thread can't be stopped, it waits on its pipes instead
+      if(j->procs[cpt].pid==0) {
+        threads=1;
+      } else {
+        running=1;
+      }
+    } else if(j->procs[cpt].state==JOB_STOPPED) {
+      stopped=1;
+    }
+  }
+  if(running || (threads && !stopped)) {
+    j->state=JOB_RUNNING;
+  } else if(stopped) {
+    if(j->state!=JOB_STOPPED) {
+      j->notified=0;
+    }
+    j->state=JOB_STOPPED;
+  } else {
+    if(j->state!=JOB_DONE) {
+      j->notified=0;
+    }
+    j->state=JOB_DONE;
+  }
+}
+
+/** \brief recordProcess
+ * A function which records the new state of a member of a job
+ * \param job *j: The job
+ * \param unsigned int procNo: The serial number of the member
+ * \param int status: Its wait status
+ * \param const struct rusage *usage: What it used, meaningful once it's done
+ * \return None
+ *
+ */
+static void recordProcess(job *j, unsigned int procNo, int status, const struct rusage *usage) {
+  jobProc *proc=&j->procs[procNo];
+
+  if(WIFSTOPPED(status)) {
+    proc->state=JOB_STOPPED;
+  } else if(WIFCONTINUED(status)) {
+    proc->state=JOB_RUNNING;
+  } else {
+    proc->state=JOB_DONE;
+    proc->status=status;
+    proc->usage=*usage;
+    proc->endNs=evNow();
+    TRACE(TRACE_REAP, proc->pid, statusCode(status), proc->command);
+    if(proc->pidfd>=0) {
+      evDel(proc->pidfd);
+      close(proc->pidfd);
+      proc->pidfd=-1;
+    }
+  }
+  updateJobState(j);
+}
+
+/** \brief reapProcess
+ * A function which collects the change of state of one member, without blocking
+ * \param job *j: The job
+ * \param unsigned int procNo: The serial number of the member
+ * \param int options: WUNTRACED and WCONTINUED to see stops as well as the exit
+ * \return None
+ *
+ */
+static void reapProcess(job *j, unsigned int procNo, int options) {
+  struct rusage usage;
+  int status;
+  if(wait4(j->procs[procNo].pid, &status, WNOHANG|options, &usage)>0) {
+    recordProcess(j, procNo, status, &usage);
+  }
+}
+
+/** \brief pollJobs
+ * A function which reaps every member of the jobs which changed state, without blocking
+ * wait4 gives the resources each member used along with its status
+ * \return None
+ *
+ */
+void pollJobs(void) {
+  job *j, *next;
+  unsigned int cpt;
+  for(j=jobList; j!=NULL; j=next) {
+    next=j->next;
+    for(cpt=0; cpt<j->nbProcs; cpt++) {
+      if(j->procs[cpt].pid>0 && j->procs[cpt].state!=JOB_DONE) {
+        reapProcess(j, cpt, WUNTRACED|WCONTINUED);
+      }
+    }
+  }
+}
+
+/** \brief processExited
+ * The event handler of the pidfd of a member: it is reaped as soon as it exits,
+ * whatever the order in which the members of the pipeline end
+ * \param int fd: The pidfd
+ * \param unsigned int events: The epoll events
+ * \param void *data: The job
+ * \return None
+ *
+ */
+static void processExited(int fd, unsigned int events, void *data) {
+  job *j=(job *)data;
+  unsigned int cpt;
+  for(cpt=0; cpt<j->nbProcs; cpt++) {
+    if(j->procs[cpt].pidfd==fd) {
+      reapProcess(j, cpt, 0);
+      return;
+    }
+  }
+}
+
+/** \brief findProcess
+ * A function which finds the member of a job which has a pid
+ * \param pid_t pid: The pid
+ * \param unsigned int *procNo: Filled with the serial number of the member
+ * \return The job; NULL when no job has this process
+ *
+ */
+static job *findProcess(pid_t pid, unsigned int *procNo) {
+  job *j;
+  for(j=jobList; j!=NULL; j=j->next) {
+    for(*procNo=0; *procNo<j->nbProcs; (*procNo)++) {
+      if(j->procs[*procNo].pid==pid) {
+        return j;
+      }
+    }
+  }
+  return NULL;
+}
+
+/** \brief reapChildren
+ * The event handler of the SIGCHLD signalfd
+ * Exits come through the pidfds, only the stops and continues are looked
+ * for here: waitid without WEXITED leaves every exit status in place, so
+ * no child the shell waits for elsewhere is stolen
+ * \param int fd: The signalfd
+ * \param unsigned int events: The epoll events
+ * \param void *data: Unused
+ * \return None
+ *
+ */
+static void reapChildren(int fd, unsigned int events, void *data) {
+  struct signalfd_siginfo sig;
+  siginfo_t info;
+  job *j, *next;
+  unsigned int cpt;
+
+  // Several SIGCHLD may have been merged into one, waitid finds them all
+  while(read(fd, &sig, sizeof(sig))==sizeof(sig)) {}
+  for(;;) {
+    info.si_pid=0;
+    if(waitid(P_ALL, 0, &info, WSTOPPED|WCONTINUED|WNOHANG)<0 || info.si_pid==0) {
+      break;
+    }
+    if((j=findProcess(info.si_pid, &cpt))!=NULL && j->procs[cpt].state!=JOB_DONE) {
+      j->procs[cpt].state=info.si_code==CLD_CONTINUED? JOB_RUNNING:JOB_STOPPED;
+      updateJobState(j);
+    }
+  }
+
+  // Members without a pidfd are reaped the old way
+  for(j=jobList; j!=NULL; j=next) {
+    next=j->next;
+    for(cpt=0; cpt<j->nbProcs; cpt++) {
+      if(j->procs[cpt].pid>0 && j->procs[cpt].pidfd<0 && j->procs[cpt].state!=JOB_DONE) {
+        reapProcess(j, cpt, 0);
+      }
+    }
+  }
+}
+
+/** \brief initJobControl
+ * A function which blocks SIGCHLD to receive it through a signalfd watched by
+ * the event loop, and when the shell is interactive, puts it in its own process
+ * group in the foreground of the terminal
+ * \param int interactive: Whether the shell reads from a terminal
+ * \return None
+ *
+ */
+void initJobControl(int interactive) {
+  sigset_t chld;
+
+  sigemptyset(&chld);
+  sigaddset(&chld, SIGCHLD);
+  sigprocmask(SIG_BLOCK, &chld, NULL);
+  if((sigchldFd=signalfd(-1, &chld, SFD_NONBLOCK|SFD_CLOEXEC))<0) {
+    perror("signalfd");
+    exit(errno);
+  }
+  evAdd(sigchldFd, EPOLLIN, reapChildren, NULL);
+
+  // Builtins run on threads of the shell get EPIPE instead of killing it
+  signal(SIGPIPE, SIG_IGN);
+
+  if(!interactive || !isatty(STDIN_FILENO)) {
+    return;
+  }
+  shellTerminal=STDIN_FILENO;
+  shellInteractive=1;
+
+  // Wait to be in the foreground
+  while(tcgetpgrp(shellTerminal)!=(shellPgid=getpgrp())) {
+    kill(-shellPgid, SIGTTIN);
+  }
+
+  signal(SIGINT, SIG_IGN);
+  signal(SIGQUIT, SIG_IGN);
+  signal(SIGTSTP, SIG_IGN);
+  signal(SIGTTIN, SIG_IGN);
+  signal(SIGTTOU, SIG_IGN);
+
+  // A session leader can't move, it already leads its group
+  shellPgid=getpid();
+  setpgid(shellPgid, shellPgid);
+  shellPgid=getpgrp();
+  tcsetpgrp(shellTerminal, shellPgid);
+  tcgetattr(shellTerminal, &shellTmodes);
+}
+
+/** \brief jobChildSignals
+ * A function which gives the signal mask and the signals set back to
+ * their default disposition in a child, before it executes a command
+ * \param sigset_t *mask: Filled with the signal mask of the child
+ * \param sigset_t *defaults: Filled with the signals to reset
+ * \return None
+ *
+ */
+void jobChildSignals(sigset_t *mask, sigset_t *defaults) {
+  sigemptyset(mask);
+  sigemptyset(defaults);
+  sigaddset(defaults, SIGINT);
+  sigaddset(defaults, SIGQUIT);
+  sigaddset(defaults, SIGTSTP);
+  sigaddset(defaults, SIGTTIN);
+  sigaddset(defaults, SIGTTOU);
+  sigaddset(defaults, SIGCHLD);
+  sigaddset(defaults, SIGPIPE);
+}
+
+/** \brief newJob
+ * A function which registers a new pipeline
+ * \param const char *text: The command line
+ * \param unsigned int nbProcs: The number of members
+ * \param int background: Whether it runs in the background
+ * \param int hidden: Whether the shell runs it for itself, it gets no number then
+ * \return The job
+ *
+ */
+job *newJob(const char *text, unsigned int nbProcs, int background, int hidden) {
+  job *j=(job *)calloc(1, sizeof(job));
+  job **link=&jobList;
+  int maxId=0;
+  unsigned int cpt;
+
+  while(*link!=NULL) {
+    if((*link)->id>maxId) {
+      maxId=(*link)->id;
+    }
+    link=&(*link)->next;
+  }
+  *link=j;
+
+  j->id=hidden? 0:maxId+1;
+  j->text=strdup(text);
+  if(background) {
+    // The trailing '&' is printed back by "jobs" according to the state
+    char *end=strrchr(j->text, '&');
+    if(end!=NULL) {
+      while(end>j->text && (end[-1]==' ' || end[-1]=='\t')) {end--;}
+      *end='\0';
+    }
+  }
+  j->nbProcs=nbProcs;
+  j->procs=(jobProc *)calloc(nbProcs, sizeof(jobProc));
+  // 0 is a valid fd: the members which never start must not look like they have one
+  for(cpt=0; cpt<nbProcs; cpt++) {
+    j->procs[cpt].pidfd=-1;
+  }
+  j->background=background;
+  j->notified=1;
+  return j;
+}
+
+/** \brief setJobProcess
+ * A function which records the pid of a member of a job
+ * \param job *j: The job
+ * \param unsigned int procNo: The serial number of the member
+ * \param pid_t pid: Its pid; -1 when it could not be started
+ * \param const char *command: The text of the member
+ * \return None
+ *
+ */
+void setJobProcess(job *j, unsigned int procNo, pid_t pid, const char *command) {
+  j->procs[procNo].pid=pid;
+  j->procs[procNo].pidfd=-1;
+  j->procs[procNo].command=strdup(command);
+  j->procs[procNo].startNs=j->procs[procNo].endNs=evNow();
+  if(pid>0) {
+    j->procs[procNo].state=JOB_RUNNING;
+    // Without pidfds (before Linux 5.3) the SIGCHLD handler reaps it
+    if((j->procs[procNo].pidfd=pidfd_open(pid, 0))>=0) {
+      evAdd(j->procs[procNo].pidfd, EPOLLIN, processExited, j);
+    }
+    if(j->pgid==0) {
+      j->pgid=pid;
+    }
+  } else {
+    // Like a shell which could not exec the command
+    j->procs[procNo].state=JOB_DONE;
+    j->procs[procNo].status=127<<8;
+  }
+}
+
+/** \brief setJobThread
+ * A function which records a member run by a builtin on a thread of the shell
+ * \param job *j: The job
+ * \param unsigned int procNo: The serial number of the member
+ * \param const char *command: The text of the member
+ * \return None
+ *
+ */
+void setJobThread(job *j, unsigned int procNo, const char *command) {
+  j->procs[procNo].pid=0;
+  j->procs[procNo].pidfd=-1;
+  j->procs[procNo].command=strdup(command);
+  j->procs[procNo].startNs=j->procs[procNo].endNs=evNow();
+  j->procs[procNo].state=JOB_RUNNING;
+}
+
+/** \brief finishJobThread
+ * A function which records the end of a member run on a thread
+ * \param job *j: The job
+ * \param unsigned int procNo: The serial number of the member
+ * \param int code: The exit code of the builtin
+ * \return None
+ *
+ */
+void finishJobThread(job *j, unsigned int procNo, int code) {
+  j->procs[procNo].state=JOB_DONE;
+  j->procs[procNo].status=W_EXITCODE(code, 0);
+  j->procs[procNo].endNs=evNow();
+  updateJobState(j);
+}
+
+/** \brief startJob
+ * A function which computes the state of a job once its members are started
+ * \param job *j: The job
+ * \return None
+ *
+ */
+void startJob(job *j) {
+  updateJobState(j);
+  j->notified=1;
+}
+
+/** \brief signalJob
+ * A function which sends a signal to every member of a job,
+ * through its process group when the shell does job control
+ * \param job *j: The job
+ * \param int signo: The signal
+ * \return 0: when the signal is sent; -1: otherwise
+ *
+ */
+int signalJob(job *j, int signo) {
+  unsigned int cpt;
+  int ret=-1;
+
+  if(shellInteractive && j->pgid>0) {
+    return kill(-j->pgid, signo);
+  }
+  for(cpt=0; cpt<j->nbProcs; cpt++) {
+    if(j->procs[cpt].pid>0 && j->procs[cpt].state!=JOB_DONE && !kill(j->procs[cpt].pid, signo)) {
+      ret=0;
+    }
+  }
+  return ret;
+}
+
+/** \brief currentJob
+ * A function which gives the job "%+" (or "%-") stands for: the most recent ones
+ * \param int previous: 0 for "%+", 1 for "%-"
+ * \return The job; NULL when there's none
+ *
+ */
+static job *currentJob(int previous) {
+  job *j, *cur=NULL, *prev=NULL;
+  for(j=jobList; j!=NULL; j=j->next) {
+    if(j->id!=0) {
+      prev=cur;
+      cur=j;
+    }
+  }
+  return previous? prev:cur;
+}
+
+/** \brief jobMark
+ * A function which gives the mark printed next to the number of a job
+ * \param job *j: The job
+ * \return '+' for the current job, '-' for the previous one, ' ' otherwise
+ *
+ */
+static char jobMark(job *j) {
+  if(j==currentJob(0)) {
+    return '+';
+  }
+  return j==currentJob(1)? '-':' ';
+}
+
+/** \brief printJob
+ * A function which prints a job like "jobs" does
+ * \param job *j: The job
+ * \param int withPgid: Whether to print its process group
+ * \return None
+ *
+ */
+static void printJob(job *j, int withPgid) {
+  char state[32];
+  unsigned int last=j->nbProcs-1;
+
+  if(j->state==JOB_RUNNING) {
+    strcpy(state, "Running");
+  } else if(j->state==JOB_STOPPED) {
+    strcpy(state, "Stopped");
+  } else if(j->timedOut || j->procs[last].timedOut) {
+    strcpy(state, "Timed out");
+  } else if(statusCode(j->procs[last].status)==0) {
+    strcpy(state, "Done");
+  } else if(WIFSIGNALED(j->procs[last].status)) {
+    snprintf(state, sizeof(state), "%s", strsignal(WTERMSIG(j->procs[last].status)));
+  } else {
+    sprintf(state, "Exit %d", statusCode(j->procs[last].status));
+  }
+  if(withPgid) {
+    printf("[%d]%c %d %-22s %s%s\n", j->id, jobMark(j), j->pgid, state, j->text,
+           j->state==JOB_RUNNING? " &":"");
+  } else {
+    printf("[%d]%c  %-22s %s%s\n", j->id, jobMark(j), state, j->text,
+           j->state==JOB_RUNNING? " &":"");
+  }
+}
+
+/** \brief unlinkJob
+ * A function which takes a job out of the list and cancels its deadlines
+ * \param job *j: The job
+ * \return None
+ *
+ */
+static void unlinkJob(job *j) {
+  job **link=&jobList;
+  while(j->timers!=NULL) {
+    jobTimer *next=j->timers->next;
+    evCancelTimer(j->timers->timer);
+    free(j->timers);
+    j->timers=next;
+  }
+  while(*link!=NULL && *link!=j) {
+    link=&(*link)->next;
+  }
+  if(*link!=NULL) {
+    *link=j->next;
+  }
+}
+
+/** \brief freeJob
+ * A function which frees a job taken out of the list
+ * \param job *j: The job, NULL does nothing
+ * \return None
+ *
+ */
+static void freeJob(job *j) {
+  unsigned int cpt;
+  if(j==NULL) {
+    return;
+  }
+  for(cpt=0; cpt<j->nbProcs; cpt++) {
+    if(j->procs[cpt].pidfd>=0) {
+      evDel(j->procs[cpt].pidfd);
+      close(j->procs[cpt].pidfd);
+    }
+    free(j->procs[cpt].command);
+  }
+  free(j->text);
+  free(j->procs);
+  free(j);
+}
+
+/** \brief deleteJob
+ * A function which forgets a job
+ * \param job *j: The job
+ * \return None
+ *
+ */
+void deleteJob(job *j) {
+  unlinkJob(j);
+  freeJob(j);
+}
+
+/** \brief jobDeadline
+ * A timer handler which signals a job, or one of its members, whose deadline passed
+ * SIGTERM (or the signal asked for) comes first, SIGKILL follows if it's still alive
+ * \param void *data: The deadline
+ * \return None
+ *
+ */
+static void jobDeadline(void *data) {
+  jobTimer *jt=(jobTimer *)data;
+  job *j=jt->j;
+
+  jt->timer=NULL;
+  if(jt->procNo<0) {
+    if(j->state==JOB_DONE) {
+      return;
+    }
+    if(!j->timedOut) {
+      fprintf(stderr, "-myshell: timed out: %s\n", j->text);
+    }
+    j->timedOut=1;
+    signalJob(j, jt->signo);
+    signalJob(j, SIGCONT);
+  } else {
+    jobProc *proc=&j->procs[jt->procNo];
+    if(proc->state==JOB_DONE || proc->pid<=0) {
+      return;
+    }
+    proc->timedOut=1;
+    kill(proc->pid, jt->signo);
+    kill(proc->pid, SIGCONT);
+  }
+  if(jt->signo!=SIGKILL && jt->killAfterMs>0) {
+    jt->signo=SIGKILL;
+    jt->timer=evAddTimer(jt->killAfterMs, jobDeadline, jt);
+  }
+}
+
+/** \brief setJobTimeout
+ * A function which gives a deadline to a job or to one of its members
+ * \param job *j: The job
+ * \param int procNo: The serial number of the member; -1 for the whole job
+ * \param long timeoutMs: The time the job may run, in milliseconds
+ * \param long killAfterMs: The time left after the signal before SIGKILL; 0 for never
+ * \param int signo: The signal sent first
+ * \return None
+ *
+ */
+void setJobTimeout(job *j, int procNo, long timeoutMs, long killAfterMs, int signo) {
+  jobTimer *jt=(jobTimer *)malloc(sizeof(jobTimer));
+  jt->j=j;
+  jt->procNo=procNo;
+  jt->signo=signo;
+  jt->killAfterMs=killAfterMs;
+  jt->timer=evAddTimer(timeoutMs, jobDeadline, jt);
+  jt->next=j->timers;
+  j->timers=jt;
+}
+
+/** \brief jobThreadsRunning
+ * A function which tells whether a member of a job still runs on a thread of the shell
+ * \return 1: when one does; 0: otherwise
+ *
+ */
+int jobThreadsRunning(void) {
+  job *j;
+  for(j=jobList; j!=NULL; j=j->next) {
+    for(unsigned int cpt=0; cpt<j->nbProcs; cpt++) {
+      if(j->procs[cpt].pid==0 && j->procs[cpt].state==JOB_RUNNING) {
+        return 1;
+      }
+    }
+  }
+  return 0;
+}
+
+/** \brief jobStatus
+ * A function which gives the exit code of a finished job
+ * \param job *j: The job
+ * \return The exit code of its last member
+ *
+ */
+int jobStatus(job *j) {
+  if(j->timedOut || j->procs[j->nbProcs-1].timedOut) {
+    return JOB_TIMEOUT_CODE;
+  }
+  return statusCode(j->procs[j->nbProcs-1].status);
+}
+
+/** \brief seconds
+ * A function which turns a struct timeval into seconds
+ * \param struct timeval tv: The time
+ * \return The seconds
+ *
+ */
+static double seconds(struct timeval tv) {
+  return (double)tv.tv_sec+tv.tv_usec/1e6;
+}
+
+/** \brief printStages
+ * A function which prints what each member of a finished job used
+ * \param job *j: The job
+ * \return None
+ *
+ */
+static void printStages(job *j) {
+  unsigned int cpt;
+
+  fprintf(stderr, "%5s %6s %9s %9s %9s %9s %7s %6s %7s %7s  %s\n", "stage", "status", "real", "user",
+          "sys", "maxrss", "minflt", "majflt", "nvcsw", "nivcsw", "command");
+  for(cpt=0; cpt<j->nbProcs; cpt++) {
+    jobProc *proc=&j->procs[cpt];
+    fprintf(stderr, "%5u %6d %8.3fs %8.3fs %8.3fs %7ldkB %7ld %6ld %7ld %7ld  %s\n", cpt,
+            proc->timedOut? JOB_TIMEOUT_CODE:statusCode(proc->status),
+            (proc->endNs-proc->startNs)/1e9, seconds(proc->usage.ru_utime), seconds(proc->usage.ru_stime),
+            proc->usage.ru_maxrss, proc->usage.ru_minflt, proc->usage.ru_majflt,
+            proc->usage.ru_nvcsw, proc->usage.ru_nivcsw, proc->command);
+  }
+}
+
+/** \brief printJobTimes
+ * A function which prints the report of the "time" prefix on stderr:
+ * the real, user and system times of the job, then a line per member
+ * when it's a pipeline, to find out which stage is the slow one
+ * \param job *j: The job, done
+ * \param int format: JOB_TIME_FULL, or JOB_TIME_POSIX for "time -p"
+ * \return None
+ *
+ */
+static void printJobTimes(job *j, int format) {
+  int64_t begin=j->procs[0].startNs, end=j->procs[0].endNs;
+  double user=0, sys=0, real;
+  unsigned int cpt;
+
+  for(cpt=0; cpt<j->nbProcs; cpt++) {
+    if(j->procs[cpt].startNs<begin) {begin=j->procs[cpt].startNs;}
+    if(j->procs[cpt].endNs>end) {end=j->procs[cpt].endNs;}
+    user+=seconds(j->procs[cpt].usage.ru_utime);
+    sys+=seconds(j->procs[cpt].usage.ru_stime);
+  }
+  real=(end-begin)/1e9;
+
+  if(format==JOB_TIME_POSIX) {
+    fprintf(stderr, "real %.2f\nuser %.2f\nsys %.2f\n", real, user, sys);
+    return;
+  }
+  fprintf(stderr, "\nreal\t%dm%.3fs\nuser\t%dm%.3fs\nsys\t%dm%.3fs\n",
+          (int)(real/60), real-60*(int)(real/60), (int)(user/60), user-60*(int)(user/60),
+          (int)(sys/60), sys-60*(int)(sys/60));
+  if(j->nbProcs>1) {
+    printStages(j);
+  }
+}
+
+/** \brief reportSignals
+ * A function which tells on stderr which members of a finished job were killed
+ * by a signal; SIGINT was sent from the terminal and SIGPIPE is how a producer
+ * learns that its consumer is gone, like "yes | head": both are left silent
+ * \param job *j: The job
+ * \return None
+ *
+ */
+static void reportSignals(job *j) {
+  unsigned int cpt;
+  for(cpt=0; cpt<j->nbProcs; cpt++) {
+    jobProc *proc=&j->procs[cpt];
+    int signo;
+    if(proc->pid<=0 || proc->timedOut || !WIFSIGNALED(proc->status)) {
+      continue;
+    }
+    signo=WTERMSIG(proc->status);
+    if(signo!=SIGINT && signo!=SIGPIPE) {
+      fprintf(stderr, "-myshell: %s: %s%s\n", proc->command, strsignal(signo),
+              WCOREDUMP(proc->status)? " (core dumped)":"");
+    }
+  }
+}
+
+/** \brief recordPipestatus
+ * A function which gives the exit codes of the members of a foreground job
+ * to $PIPESTATUS, separated by spaces, once it's done
+ * \param job *j: The job, waited for by waitForJob
+ * \return None
+ *
+ */
+void recordPipestatus(job *j) {
+  char *codes;
+  size_t len=0;
+  unsigned int cpt;
+
+  if(j->state!=JOB_DONE || (codes=malloc(j->nbProcs*4+1))==NULL) {
+    return;
+  }
+  codes[0]='\0';
+  for(cpt=0; cpt<j->nbProcs; cpt++) {
+    len+=sprintf(codes+len, cpt==0? "%d":" %d",
+                 j->procs[cpt].timedOut? JOB_TIMEOUT_CODE:statusCode(j->procs[cpt].status));
+  }
+  setPipeStatus(codes);
+  free(codes);
+}
+
+/** \brief waitForJob
+ * A function which gives the terminal to a foreground job and runs
+ * the event loop until the job is done or stopped
+ * A finished job is forgotten, a stopped one is kept in the background
+ * \param job *j: The job
+ * \return The exit code of its last member; 128+SIGTSTP when it's stopped
+ *
+ */
+int waitForJob(job *j) {
+  int code;
+
+  // A job made of builtins only has no process group
+  if(shellInteractive && j->pgid>0) {
+    tcsetpgrp(shellTerminal, j->pgid);
+  }
+  while(j->state==JOB_RUNNING) {
+    if(evRunOnce(-1)<0) {
+      break;
+    }
+  }
+  if(shellInteractive) {
+    tcsetpgrp(shellTerminal, shellPgid);
+    tcsetattr(shellTerminal, TCSADRAIN, &shellTmodes);
+  }
+
+  if(j->state==JOB_STOPPED) {
+    j->background=1;
+    if(j->id==0) {
+      // A job the shell runs for itself can't be resumed: it gets a number
+      job *other;
+      for(other=jobList; other!=NULL; other=other->next) {
+        if(other->id>=j->id) {
+          j->id=other->id+1;
+        }
+      }
+    }
+    printf("\n");
+    printJob(j, 0);
+    j->notified=1;
+    return 128+SIGTSTP;
+  }
+  code=jobStatus(j);
+  if(!j->timedOut) {
+    reportSignals(j);
+  }
+  if(j->timeReport!=JOB_TIME_NONE) {
+    printJobTimes(j, j->timeReport);
+  }
+  // Kept until the next foreground job is done, for "pipestatus"
+  unlinkJob(j);
+  freeJob(lastJob);
+  lastJob=j;
+  return code;
+}
+
+/** \brief notifyJobs
+ * A function which reports the background jobs which changed state,
+ * when the shell is interactive, and forgets the finished ones,
+ * like the detached jobs nobody reports
+ * \return None
+ *
+ */
+void notifyJobs(void) {
+  job *j=jobList, *next;
+  for(; j!=NULL; j=next) {
+    next=j->next;
+    if(j->detached && j->state==JOB_DONE) {
+      deleteJob(j);
+      continue;
+    }
+    if(j->id==0 || !j->background || j->notified) {
+      continue;
+    }
+    if(shellInteractive) {
+      printJob(j, 0);
+    }
+    j->notified=1;
+    if(j->state==JOB_DONE) {
+      if(j->timeReport!=JOB_TIME_NONE) {
+        printJobTimes(j, j->timeReport);
+      }
+      deleteJob(j);
+    }
+  }
+}
+
+/** \brief findJob
+ * A function which finds the job named by a job spec:
+ * %n, n, %%, %+, %- or %prefix of the command line
+ * \param const char *spec: The job spec, NULL for the current job
+ * \param const char *builtin: The builtin, for the error message
+ * \return The job; NULL when there's none
+ *
+ */
+static job *findJob(const char *spec, const char *builtin) {
+  job *j=NULL;
+
+  if(spec==NULL || !strcmp(spec, "%%") || !strcmp(spec, "%+") || !strcmp(spec, "%")) {
+    j=currentJob(0);
+  } else if(!strcmp(spec, "%-")) {
+    j=currentJob(1);
+  } else {
+    const char *name=spec[0]=='%'? spec+1:spec;
+    char *end;
+    long id=strtol(name, &end, 10);
+    for(j=jobList; j!=NULL; j=j->next) {
+      if(j->id==0) {
+        continue;
+      }
+      if(*name!='\0' && *end=='\0') {
+        if(j->id==id) {
+          break;
+        }
+      } else if(spec[0]=='%' && !strncmp(j->text, name, strlen(name))) {
+        break;
+      }
+    }
+  }
+  if(j==NULL) {
+    fprintf(stderr, "-myshell: %s: %s: no such job\n", builtin, spec==NULL? "current":spec);
+  }
+  return j;
+}
+
+/** \brief continueJob
+ * A function which resumes a job, in the foreground or in the background
+ * \param job *j: The job
+ * \param int foreground: Whether the job gets the terminal
+ * \return The exit code of the job in the foreground; 0 in the background
+ *
+ */
+static int continueJob(job *j, int foreground) {
+  unsigned int cpt;
+
+  for(cpt=0; cpt<j->nbProcs; cpt++) {
+    if(j->procs[cpt].state==JOB_STOPPED) {
+      j->procs[cpt].state=JOB_RUNNING;
+    }
+  }
+  if(j->state!=JOB_DONE) {
+    j->state=JOB_RUNNING;
+  }
+  j->background=!foreground;
+  j->notified=1;
+  if(foreground) {
+    if(shellInteractive) {
+      tcsetpgrp(shellTerminal, j->pgid);
+    }
+    signalJob(j, SIGCONT);
+    return waitForJob(j);
+  }
+  signalJob(j, SIGCONT);
+  return 0;
+}
+
+/** \brief jobsCommand
+ * A function which realizes the "jobs" builtin: "jobs [-l|-p]"
+ * \param char **args: The arguments of the builtin
+ * \param unsigned int nbArgs: The number of arguments
+ * \return 0
+ *
+ */
+int jobsCommand(char **args, unsigned int nbArgs) {
+  job *j;
+  int withPgid=nbArgs>1 && !strcmp(args[1], "-l");
+  int pgidOnly=nbArgs>1 && !strcmp(args[1], "-p");
+
+  pollJobs();
+  for(j=jobList; j!=NULL; j=j->next) {
+    if(j->id==0) {
+      continue;
+    }
+    if(pgidOnly) {
+      printf("%d\n", j->pgid);
+    } else {
+      printJob(j, withPgid);
+      j->notified=1;
+    }
+  }
+  // The finished jobs have been shown, they can go
+  for(j=jobList; j!=NULL;) {
+    job *next=j->next;
+    if(j->id!=0 && j->state==JOB_DONE && j->notified) {
+      deleteJob(j);
+    }
+    j=next;
+  }
+  return 0;
+}
+
+/** \brief fgCommand
+ * A function which realizes the "fg" builtin: "fg [job]"
+ * \param char **args: The arguments of the builtin
+ * \param unsigned int nbArgs: The number of arguments
+ * \return The exit code of the job; 1 when there's no such job
+ *
+ */
+int fgCommand(char **args, unsigned int nbArgs) {
+  job *j=findJob(nbArgs>1? args[1]:NULL, "fg");
+  if(j==NULL) {
+    return 1;
+  }
+  printf("%s\n", j->text);
+  return continueJob(j, 1);
+}
+
+/** \brief bgCommand
+ * A function which realizes the "bg" builtin: "bg [job...]"
+ * \param char **args: The arguments of the builtin
+ * \param unsigned int nbArgs: The number of arguments
+ * \return 0: when the jobs are resumed; 1: when one is not found
+ *
+ */
+int bgCommand(char **args, unsigned int nbArgs) {
+  unsigned int cpt=1;
+  int ret=0;
+
+  do {
+    job *j=findJob(nbArgs>1? args[cpt]:NULL, "bg");
+    if(j==NULL) {
+      ret=1;
+      continue;
+    }
+    continueJob(j, 0);
+    printf("[%d]%c %s &\n", j->id, jobMark(j), j->text);
+  } while(++cpt<nbArgs);
+  return ret;
+}
+
+/** \brief waitCommand
+ * A function which realizes the "wait" builtin: "wait [job|pid...]"
+ * Without arguments it waits for every job; the event loop keeps running meanwhile
+ * \param char **args: The arguments of the builtin
+ * \param unsigned int nbArgs: The number of arguments
+ * \return The exit code of the last job waited for
+ *
+ */
+int waitCommand(char **args, unsigned int nbArgs) {
+  unsigned int cpt;
+  int code=0;
+
+  if(nbArgs==1) {
+    job *j;
+    do {
+      for(j=jobList; j!=NULL && (j->id==0 || j->state!=JOB_RUNNING); j=j->next) {}
+    } while(j!=NULL && evRunOnce(-1)>=0);
+    for(j=jobList; j!=NULL;) {
+      job *next=j->next;
+      if(j->id!=0 && j->state==JOB_DONE) {
+        deleteJob(j);
+      }
+      j=next;
+    }
+    return 0;
+  }
+
+  for(cpt=1; cpt<nbArgs; cpt++) {
+    job *j=NULL;
+    unsigned int procNo=0;
+
+    if(args[cpt][0]=='%') {
+      if((j=findJob(args[cpt], "wait"))==NULL) {
+        code=127;
+        continue;
+      }
+      procNo=j->nbProcs-1;
+    } else {
+      pid_t pid=(pid_t)atoi(args[cpt]);
+      for(j=jobList; j!=NULL; j=j->next) {
+        for(procNo=0; procNo<j->nbProcs && j->procs[procNo].pid!=pid; procNo++) {}
+        if(procNo<j->nbProcs) {
+          break;
+        }
+      }
+      if(j==NULL) {
+        fprintf(stderr, "-myshell: wait: pid %s is not a child of this shell\n", args[cpt]);
+        code=127;
+        continue;
+      }
+    }
+    while(j->procs[procNo].state==JOB_RUNNING && evRunOnce(-1)>=0) {}
+    code=statusCode(j->procs[procNo].status);
+    if(j->id!=0 && j->state==JOB_DONE) {
+      deleteJob(j);
+    }
+  }
+  return code;
+}
+
+/** \brief parseSignal
+ * A function which reads a signal given by number or by name, with or without "SIG"
+ * \param const char *name: The signal
+ * \return The signal number; -1 when it's unknown
+ *
+ */
+int parseSignal(const char *name) {
+  const signalName *sig;
+  char *end;
+  long signo=strtol(name, &end, 10);
+
+  if(*name!='\0' && *end=='\0') {
+    return signo>=0 && signo<NSIG? (int)signo:-1;
+  }
+  if(!strncmp(name, "SIG", 3)) {
+    name+=3;
+  }
+  for(sig=signalNames; sig->name!=NULL; sig++) {
+    if(!strcmp(sig->name, name)) {
+      return sig->signo;
+    }
+  }
+  return -1;
+}
+
+/** \brief killCommand
+ * A function which realizes the "kill" builtin:
+ * "kill [-s sig | -sig] job|pid..." and "kill -l"
+ * \param char **args: The arguments of the builtin
+ * \param unsigned int nbArgs: The number of arguments
+ * \return 0: when every target is signaled; 1: otherwise
+ *
+ */
+int killCommand(char **args, unsigned int nbArgs) {
+  unsigned int cpt=1;
+  int signo=SIGTERM, ret=0;
+
+  if(nbArgs>1 && !strcmp(args[1], "-l")) {
+    const signalName *sig;
+    for(sig=signalNames; sig->name!=NULL; sig++) {
+      printf("%2d) SIG%s\n", sig->signo, sig->name);
+    }
+    return 0;
+  }
+  if(nbArgs>2 && !strcmp(args[1], "-s")) {
+    signo=parseSignal(args[2]);
+    cpt=3;
+  } else if(nbArgs>1 && args[1][0]=='-') {
+    signo=parseSignal(args[1]+1);
+    cpt=2;
+  }
+  if(signo<0 || cpt>=nbArgs) {
+    fprintf(stderr, "-myshell: kill: usage: kill [-s sigspec | -sigspec] pid | jobspec ... or kill -l\n");
+    return 1;
+  }
+
+  for(; cpt<nbArgs; cpt++) {
+    if(args[cpt][0]=='%') {
+      job *j=findJob(args[cpt], "kill");
+      if(j==NULL || signalJob(j, signo)<0) {
+        ret=1;
+        continue;
+      }
+      // A stopped job must run to handle the signal
+      if(j->state==JOB_STOPPED && signo!=SIGKILL && signo!=SIGCONT) {
+        signalJob(j, SIGCONT);
+      }
+    } else if(kill((pid_t)atoi(args[cpt]), signo)<0) {
+      fprintf(stderr, "-myshell: kill: (%s) - %s\n", args[cpt], strerror(errno));
+      ret=1;
+    }
+  }
+  return ret;
+}
+
+/** \brief pipestatusCommand
+ * A function which realizes the "pipestatus" builtin: it prints the exit
+ * codes of the members of the last foreground pipeline, like $PIPESTATUS,
+ * and with -v what each of them used
+ * \param char **args: The arguments of the builtin
+ * \param unsigned int nbArgs: The number of arguments
+ * \return 0: when there's a pipeline to report; 1: otherwise
+ *
+ */
+int pipestatusCommand(char **args, unsigned int nbArgs) {
+  unsigned int cpt;
+  int verbose=nbArgs>1 && !strcmp(args[1], "-v");
+
+  if(nbArgs>2 || (nbArgs==2 && !verbose)) {
+    fprintf(stderr, "-myshell: pipestatus: usage: pipestatus [-v]\n");
+    return 2;
+  }
+  if(lastJob==NULL) {
+    return 1;
+  }
+  if(verbose) {
+    fflush(stdout);
+    printStages(lastJob);
+    return 0;
+  }
+  for(cpt=0; cpt<lastJob->nbProcs; cpt++) {
+    printf(cpt==0? "%d":" %d", lastJob->procs[cpt].timedOut? JOB_TIMEOUT_CODE:statusCode(lastJob->procs[cpt].status));
+  }
+  printf("\n");
+  return 0;
+}
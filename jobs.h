@@ -0,0 +1,155 @@
+#ifndef MYSHELL_JOBS_H
+#define MYSHELL_JOBS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <signal.h>
+#include <termios.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/pidfd.h>
+#include "event.h"
+
+//Exit code of a job killed because its deadline passed
+#define JOB_TIMEOUT_CODE 124
+
+//Reports printed by the "time" prefix
+#define JOB_TIME_NONE 0
+#define JOB_TIME_FULL 1
+#define JOB_TIME_POSIX 2
+
+//States of a process or a job
+#define JOB_RUNNING 0
+#define JOB_STOPPED 1
+#define JOB_DONE 2
+
+typedef struct {
+    //0 while the member is not started or when it runs on a thread, -1 when it could not be
+    pid_t pid;
+
+    //becomes readable when the process exits, -1 when SIGCHLD is relied on instead
+    int pidfd;
+
+    //JOB_RUNNING, JOB_STOPPED or JOB_DONE
+    int state;
+
+    //the wait status once it's done
+    int status;
+
+    //whether it was killed because its deadline passed
+    int timedOut;
+
+    //the text of the member
+    char *command;
+
+    //when it was started and reaped, in nanoseconds of CLOCK_MONOTONIC, and what it used
+    int64_t startNs, endNs;
+    struct rusage usage;
+} jobProc;
+
+//A deadline of a job or of one of its members
+typedef struct jobTimer {
+    struct job *j;
+
+    //the member it applies to, -1 for the whole job
+    int procNo;
+
+    //sent when the deadline passes, SIGKILL follows killAfterMs later (0: never)
+    int signo;
+    long killAfterMs;
+
+    //NULL once the last signal is sent
+    evTimer *timer;
+
+    struct jobTimer *next;
+} jobTimer;
+
+typedef struct job {
+    //the number given by %n, 0 for the jobs the shell runs for itself
+    int id;
+
+    //the process group of the pipeline
+    pid_t pgid;
+
+    //the command line
+    char *text;
+
+    //the members of the pipeline
+    unsigned int nbProcs;
+    jobProc *procs;
+
+    //JOB_RUNNING, JOB_STOPPED or JOB_DONE
+    int state;
+
+    //whether the job runs in the background
+    int background;
+
+    //whether the user knows the job's last state
+    int notified;
+
+    //whether nobody waits for it: it's forgotten once done
+    int detached;
+
+    //its deadlines, and whether the one of the whole job passed
+    jobTimer *timers;
+    int timedOut;
+
+    //what "time" prints once it's done: JOB_TIME_NONE, JOB_TIME_FULL or JOB_TIME_POSIX
+    int timeReport;
+
+    struct job *next;
+} job;
+
+//Whether the shell controls a terminal
+extern int shellInteractive;
+//The terminal of the shell, -1 when it's not interactive
+extern int shellTerminal;
+
+//Sets the signals and the terminal up, and starts reaping children through a signalfd
+void initJobControl(int interactive);
+//Registers a new pipeline, hidden jobs are not listed by "jobs"
+job *newJob(const char *text, unsigned int nbProcs, int background, int hidden);
+//Records the pid of a member, the first one gives its process group to the job
+void setJobProcess(job *j, unsigned int procNo, pid_t pid, const char *command);
+//Records a member run by a builtin on a thread, and its end
+void setJobThread(job *j, unsigned int procNo, const char *command);
+void finishJobThread(job *j, unsigned int procNo, int code);
+//Updates the state of a job once its members are started
+void startJob(job *j);
+//Sends signo to a job (procNo -1) or one member after timeoutMs, then SIGKILL after killAfterMs
+void setJobTimeout(job *j, int procNo, long timeoutMs, long killAfterMs, int signo);
+//Reads a signal given by number or by name, -1 when it's unknown
+int parseSignal(const char *name);
+//Sends a signal to every member of a job
+int signalJob(job *j, int signo);
+//Gives the exit code of a finished job
+int jobStatus(job *j);
+//Whether a builtin of a job still runs on a thread of the shell
+int jobThreadsRunning(void);
+//Waits until a foreground job is done or stopped, gives back the status of its last member
+int waitForJob(job *j);
+//Gives the exit codes of the members of a finished foreground job to $PIPESTATUS
+void recordPipestatus(job *j);
+//Forgets a job
+void deleteJob(job *j);
+//Reaps the children which changed state without waiting
+void pollJobs(void);
+//Reports the background jobs which changed state and forgets the finished ones
+void notifyJobs(void);
+//Signal mask and dispositions a child must get back before exec
+void jobChildSignals(sigset_t *mask, sigset_t *defaults);
+//Realizes the "jobs", "fg", "bg", "wait" and "kill" builtins
+int jobsCommand(char **args, unsigned int nbArgs);
+int fgCommand(char **args, unsigned int nbArgs);
+int bgCommand(char **args, unsigned int nbArgs);
+int waitCommand(char **args, unsigned int nbArgs);
+int killCommand(char **args, unsigned int nbArgs);
+//Realizes the "pipestatus" builtin: the exit codes and the usage of the stages of the last pipeline
+int pipestatusCommand(char **args, unsigned int nbArgs);
+
+#endif
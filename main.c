@@ -1,4 +1,4 @@
-#include <pwd.h>
+#include <fcntl.h>
 #include <readline/readline.h>
 #include <readline/history.h>
 #include <stdio.h>
@@ -6,60 +6,278 @@
 #include <string.h>
 #include <sys/types.h>
 #include <unistd.h>
+#include "input.h"
 #include "shell_fct.h"
 
+//Gives the next line of the input to a here-document, NULL at its end
+typedef char *(*nextLineFunc)(void *data);
+//Tells whether the input has no line left
+typedef int (*atEndFunc)(void *data);
+
+/** \brief runLine
+ * A function which parses and executes one command line
+ * \param char *line: The command line
+ * \param cmd *my_cmd: The command reused from one line to the next
+ * \param int interactive: Whether the line was typed at the prompt
+ * \param nextLineFunc nextLine: Reads the lines of the here-documents, they follow the command
+ * \param atEndFunc atEnd: Tells whether the line is the last thing the shell does, NULL when it goes on anyway
+ * \param void *data: Given to nextLine and atEnd
+ * \return None
+ *
+ */
+static void runLine(char *line, cmd *my_cmd, int interactive, nextLineFunc nextLine, atEndFunc atEnd, void *data) {
+  const char *delimiter;
+  int failed;
+  //"set -o trace" applies from the next line on
+  traceSync();
+  //Parse the comand
+  TRACE(TRACE_PARSE_BEGIN, 0, 0, line);
+  failed=parseMembers(line, my_cmd);
+  TRACE(TRACE_PARSE_END, 0, failed, NULL);
+  if(failed) {
+    setLastStatus(2);
+  } else {
+    while((delimiter=pendingHeredoc(my_cmd))!=NULL) {
+      char *docLine=nextLine(data);
+      if(docLine==NULL) {
+        fprintf(stderr, "-myshell: warning: here-document delimited by end-of-file (wanted `%s')\n", delimiter);
+      }
+      addHeredocLine(my_cmd, docLine);
+      if(interactive) {
+        free(docLine);
+      }
+    }
+    //Run the substitutions, a blank or comment line does nothing
+    if(expandCmd(my_cmd)) {
+      setLastStatus(1);
+    } else if(my_cmd->nbCmdMembers>1 || my_cmd->nbMembersArgs[0]>0 || my_cmd->nbMembersAssigns[0]>0) {
+      if(ISDEBUG && interactive){
+        printCmd(my_cmd);
+      }
+      //Execute the comand, the last one may replace the shell
+      if(atEnd!=NULL && atEnd(data)) {
+        setLastStatus(execFinalCommand(my_cmd));
+      } else {
+        setLastStatus(exec_command(my_cmd));
+      }
+    }
+  }
+  fflush(stdout);
+  //Clean the house
+  freeCmd(my_cmd);
+  traceSync();
+}
+
+/** \brief readerLine
+ * A function which reads a line of a here-document from a non-interactive input
+ * \param void *data: The reader
+ * \return The line, valid until the next one is read; NULL at the end of the input
+ *
+ */
+static char *readerLine(void *data) {
+  return readLine((inputReader *)data);
+}
+
+/** \brief readerDone
+ * A function which tells whether a non-interactive input has no line left
+ * \param void *data: The reader
+ * \return 1: when it's over; 0: otherwise
+ *
+ */
+static int readerDone(void *data) {
+  return readerAtEnd((inputReader *)data);
+}
+
+/** \brief runReader
+ * A function which executes every line of a non-interactive input,
+ * without prompt nor history
+ * \param inputReader *reader: A pointer which points to the reader of the input
+ * \param cmd *my_cmd: The command reused from one line to the next
+ * \param int execLast: Whether the last command replaces the shell; a stream on
+ * stdin is not read ahead, the next line may not be written yet
+ * \return None
+ *
+ */
+static void runReader(inputReader *reader, cmd *my_cmd, int execLast) {
+  char *line;
+  while((line=readLine(reader))!=NULL) {
+    runLine(line, my_cmd, 0, readerLine, execLast? readerDone:NULL, reader);
+    //Reap the background jobs finished meanwhile
+    pollJobs();
+    notifyJobs();
+  }
+}
+
+//The line given by readline, waiting to be executed
+static char *pendingLine = NULL;
+//Whether the end of the input was reached
+static int inputClosed = 0;
+
+/** \brief lineHandler
+ * A function which is called by readline once a whole line is typed
+ * \param char *line: The line, NULL at the end of the input
+ * \return None
+ *
+ */
+static void lineHandler(char *line) {
+  if(line == NULL) {
+    inputClosed = 1;
+  }
+  pendingLine = line;
+}
+
+/** \brief terminalReady
+ * An event handler which gives the typed characters to readline
+ * \param int fd: The terminal
+ * \param unsigned int events: The EPOLL* flags
+ * \param void *data: Unused
+ * \return None
+ *
+ */
+static void terminalReady(int fd, unsigned int events, void *data) {
+  rl_callback_read_char();
+}
+
+/** \brief promptLine
+ * A function which shows a prompt and lets readline read the terminal
+ * from the event loop, so that children are reaped while the user types
+ * \param const char *prompt: The prompt
+ * \return The line typed, to be freed; NULL at the end of the input
+ *
+ */
+static char *promptLine(const char *prompt) {
+  char *line;
+
+  rl_callback_handler_install(prompt, lineHandler);
+  evAdd(STDIN_FILENO, EPOLLIN, terminalReady, NULL);
+  while(pendingLine == NULL && !inputClosed) {
+    evRunOnce(-1);
+  }
+  //The terminal belongs to the command while it runs
+  evDel(STDIN_FILENO);
+  rl_callback_handler_remove();
+  line = pendingLine;
+  pendingLine = NULL;
+  return line;
+}
+
+/** \brief continuationLine
+ * A function which reads a line of a here-document at the secondary prompt
+ * \param void *data: Unused
+ * \return The line typed, to be freed; NULL at the end of the input
+ *
+ */
+static char *continuationLine(void *data) {
+  return inputClosed? NULL:promptLine("> ");
+}
+
+/** \brief usage
+ * A function which prints how to start the shell and exits
+ * \return None
+ *
+ */
+static void usage(void) {
+  fprintf(stderr, "usage: myshell [-c cmdline | script | --serve socket | --client socket cmdline...]\n");
+  exit(2);
+}
+
 int main(int argc, char** argv)
 {
   //Initialize
   DEBUG("Initializing my shell");
-  int ret = MYSHELL_CMD_OK;
   char* readlineptr = NULL;
-  struct passwd* infos = NULL;
-  char str[1024] = {'\0'};
-  char hostname[256] = {'\0'};
-  char workingdirectory[256] = {'\0'};
   int sigBoot = 0;
+  int interactive;
+  cmd my_cmd;
+  inputReader reader;
 
-  //..........
-  while(ret != MYSHELL_FCT_EXIT) {
-    //Get your session info
-    infos=getpwuid(getuid());
-    gethostname(hostname, 256);
-    getcwd(workingdirectory, 256);
+  //The zygote is forked before the shell allocates anything
+  if(argc == 3 && !strcmp(argv[1], "--serve")) {
+    startZygote();
+  }
+  initVars();
+  initOptions();
+  initSession();
+  setupCmd(&my_cmd);
+  evInit();
 
+  //Non-interactive modes: -c, a script or a stream on stdin
+  if(argc > 1) {
+    if(!strcmp(argv[1], "--serve")) {
+      if(argc != 3) {
+        usage();
+      }
+      initJobControl(0);
+      return runServer(argv[2]);
+    } else if(!strcmp(argv[1], "--client")) {
+      if(argc < 4) {
+        usage();
+      }
+      return runClient(argv[2], argv + 3, argc - 3);
+    } else if(!strcmp(argv[1], "-c")) {
+      if(argc < 3) {
+        usage();
+      }
+      openStringReader(&reader, argv[2]);
+    } else if(argv[1][0] == '-') {
+      usage();
+    } else {
+      int fd = open(argv[1], O_RDONLY | O_CLOEXEC);
+      if(fd < 0) {
+        fprintf(stderr, "-myshell: %s: %s\n", argv[1], strerror(errno));
+        return 127;
+      }
+      openReader(&reader, fd);
+    }
+  } else if(!isatty(STDIN_FILENO)) {
+    openReader(&reader, STDIN_FILENO);
+  } else {
+    reader.buf = NULL;
+  }
+  interactive = reader.buf == NULL;
+  initJobControl(interactive);
+  if(!interactive) {
+    runReader(&reader, &my_cmd, argc > 1);
+    closeReader(&reader);
+    releaseCmd(&my_cmd);
+    //Like other shells, the exit code of the last command, blank lines left aside
+    return atoi(getVar("?"));
+  }
+  initHistory();
+  initCompletion();
+
+  //..........
+  while(!inputClosed) {
     if(sigBoot == 0) {
       DEBUG("My shell is ready");
       sigBoot = 1;
     }
 
-    //Print it to the console
-    sprintf(str, "\n{myshell}%s@%s:%s$ ", infos->pw_name, hostname, workingdirectory);
-    fflush(stdin);
-    readlineptr = readline(str);
+    //Print it to the console, the session info is cached between prompts
+    readlineptr = promptLine(sessionPrompt());
+
+    //End of the input (Ctrl-D)
+    if(readlineptr == NULL) {
+      printf("exit\n");
+      break;
+    }
 
     /* If the line has any text in it, save it on the history. */
     // \author Y. LIN
-    if(readlineptr!=NULL && strcmp(readlineptr, "")) {
-      add_history(readlineptr);
+    if(strcmp(readlineptr, "")) {
+      addHistory(readlineptr);
 
       //Your code goes here.......
-      cmd my_cmd;
-      //Parse the comand
-      if(!parseMembers(readlineptr, &my_cmd)) {
-        if(ISDEBUG){
-          printCmd(&my_cmd);
-        }
-        //Execute the comand
-        exec_command(&my_cmd);
-      }
-      //Clean the house
-      freeCmd(&my_cmd);
+      runLine(readlineptr, &my_cmd, 1, continuationLine, NULL, NULL);
     } else {
       printf("Command is null.\n");
     }
     free(readlineptr);
+    //Tell the user about the background jobs which changed state
+    notifyJobs();
     //..........
   }
   //..........
+  releaseCmd(&my_cmd);
   return 0;
 }
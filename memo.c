@@ -0,0 +1,473 @@
+#include <dirent.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include "shell_fct.h"
+
+//An FNV-1a hash on 128 bits, the key of a line
+typedef unsigned __int128 memoHash;
+
+//What an entry starts with, its stdout and its stderr follow
+typedef struct {
+    char magic[8];
+    int status;
+    uint64_t outLen, errLen;
+} memoHeader;
+
+//An entry met while the cache is trimmed
+typedef struct {
+    char *name;
+
+    //its last use, in nanoseconds since the epoch
+    long long lastUse;
+    off_t size;
+} memoEntry;
+
+/** \brief hashBytes
+ * A function which adds bytes to a hash
+ * \param memoHash *h: A pointer which points to the hash, updated
+ * \param const void *data: The bytes
+ * \param size_t len: Their number
+ * \return None
+ *
+ */
+static void hashBytes(memoHash *h, const void *data, size_t len) {
+  const memoHash prime = ((memoHash)1 << 88) + 0x13b;
+  const unsigned char *p = (const unsigned char *)data;
+
+  for(size_t cpt = 0;cpt < len;cpt++) {
+    *h = (*h ^ p[cpt]) * prime;
+  }
+}
+
+/** \brief hashString
+ * A function which adds a string and its terminating NUL to a hash,
+ * so that "ab" "c" and "a" "bc" differ
+ * \param memoHash *h: A pointer which points to the hash, updated
+ * \param const char *s: The string, NULL is told apart from ""
+ * \return None
+ *
+ */
+static void hashString(memoHash *h, const char *s) {
+  static const char unset = 1;
+
+  if(s == NULL) {
+    hashBytes(h, &unset, 1);
+  } else {
+    hashBytes(h, s, strlen(s) + 1);
+  }
+}
+
+/** \brief hashFile
+ * A function which adds the state of a file to a hash: where it is, its size
+ * and when it was modified, so that a changed input misses the cache
+ * \param memoHash *h: A pointer which points to the hash, updated
+ * \param const char *path: The file
+ * \return None
+ *
+ */
+static void hashFile(memoHash *h, const char *path) {
+  struct stat st;
+  long long state[5];
+
+  hashString(h, path);
+  if(stat(path, &st) < 0) {
+    state[0] = -errno;
+    hashBytes(h, state, sizeof(state[0]));
+    return;
+  }
+  state[0] = (long long)st.st_dev;
+  state[1] = (long long)st.st_ino;
+  state[2] = (long long)st.st_size;
+  state[3] = (long long)st.st_mtim.tv_sec;
+  state[4] = (long long)st.st_mtim.tv_nsec;
+  hashBytes(h, state, sizeof(state));
+}
+
+/** \brief memoKey
+ * A function which computes the key of a line: its words, assignments,
+ * redirections and substitutions, the working directory, the variables
+ * and the state of the files it reads
+ * \param cmd *cmd: A pointer which points to the command, "memo" and its options taken off
+ * \param char **names: The variables given with -e
+ * \param unsigned int nbNames: Their number
+ * \param char **files: The files given with -f
+ * \param unsigned int nbFiles: Their number
+ * \param char *hex: Filled with the key in hexadecimal, MEMO_KEY_LEN characters and a NUL
+ * \return None
+ *
+ */
+static void memoKey(cmd *cmd, char **names, unsigned int nbNames, char **files, unsigned int nbFiles, char *hex) {
+  memoHash h = ((memoHash)0x6c62272e07bb0142ULL << 64) | 0x62b821756295c58dULL;
+  unsigned int cpt, arg;
+
+  hashString(&h, MEMO_MAGIC);
+  hashString(&h, sessionCwd());
+  for(cpt = 0;cpt < cmd->nbCmdMembers;cpt++) {
+    hashBytes(&h, &cmd->nbMembersArgs[cpt], sizeof(cmd->nbMembersArgs[cpt]));
+    for(arg = 0;arg < cmd->nbMembersArgs[cpt];arg++) {
+      hashString(&h, cmd->cmdMembersArgs[cpt][arg]);
+    }
+    hashBytes(&h, &cmd->nbMembersAssigns[cpt], sizeof(cmd->nbMembersAssigns[cpt]));
+    for(arg = 0;arg < cmd->nbMembersAssigns[cpt];arg++) {
+      hashString(&h, cmd->cmdMembersAssigns[cpt][arg]);
+    }
+    for(int fd = STDIN_FILENO;fd <= STDERR_FILENO;fd++) {
+      hashBytes(&h, &cmd->redirection[cpt].mode[fd], sizeof(cmd->redirection[cpt].mode[fd]));
+      hashString(&h, cmd->redirection[cpt].file[fd]);
+    }
+    /*A here-document is its own text, a file is its state*/
+    if(cmd->redirection[cpt].file[STDIN_FILENO] != NULL && cmd->redirection[cpt].mode[STDIN_FILENO] != HEREDOC) {
+      hashFile(&h, cmd->redirection[cpt].file[STDIN_FILENO]);
+    }
+  }
+  /*The /dev/fd paths are the same whatever runs behind them*/
+  for(cpt = 0;cpt < cmd->nbSubstitutions;cpt++) {
+    if(cmd->substitutions[cpt].kind == SUBST_PROCESS_IN || cmd->substitutions[cpt].kind == SUBST_PROCESS_OUT) {
+      hashBytes(&h, &cmd->substitutions[cpt].kind, sizeof(cmd->substitutions[cpt].kind));
+      hashBytes(&h, &cmd->substitutions[cpt].member, sizeof(cmd->substitutions[cpt].member));
+      hashString(&h, cmd->substitutions[cpt].text);
+    }
+  }
+  for(cpt = 0;cpt < nbNames;cpt++) {
+    hashString(&h, names[cpt]);
+    hashString(&h, getVar(names[cpt]));
+  }
+  for(cpt = 0;cpt < nbFiles;cpt++) {
+    hashFile(&h, files[cpt]);
+  }
+
+  for(cpt = 0;cpt < MEMO_KEY_LEN;cpt++) {
+    hex[cpt] = "0123456789abcdef"[(unsigned int)(h >> (4 * (MEMO_KEY_LEN - 1 - cpt))) & 0xf];
+  }
+  hex[MEMO_KEY_LEN] = '\0';
+}
+
+/** \brief memoDir
+ * A function which gives the directory of the cache, created when needed:
+ * $MYSHELL_MEMODIR, or ~/.myshell_memo; an empty $MYSHELL_MEMODIR caches nothing
+ * \return The newly allocated path; NULL when there's no cache
+ *
+ */
+static char *memoDir(void) {
+  const char *path = getVar("MYSHELL_MEMODIR");
+  char *dir;
+
+  if(path != NULL) {
+    if(path[0] == '\0') {
+      return NULL;
+    }
+    dir = strdup(path);
+  } else {
+    const char *home = sessionHome();
+    dir = (char *)malloc(strlen(home) + sizeof(MEMO_DEFAULT_DIR) + 1);
+    sprintf(dir, "%s/%s", home, MEMO_DEFAULT_DIR);
+  }
+  if(mkdir(dir, 0700) < 0 && errno != EEXIST) {
+    fprintf(stderr, "-myshell: memo: %s: %s\n", dir, strerror(errno));
+    free(dir);
+    return NULL;
+  }
+  return dir;
+}
+
+/** \brief copyRange
+ * A function which copies a part of a file to an fd, with sendfile so that
+ * the bytes never come to the shell
+ * \param int from: The file
+ * \param off_t offset: Where the part starts
+ * \param off_t len: Its length
+ * \param int to: The fd written
+ * \return 0: when every byte is written; 1: otherwise
+ *
+ */
+static int copyRange(int from, off_t offset, off_t len, int to) {
+  off_t end = offset + len;
+  char buf[8192];
+  ssize_t nb;
+
+  while(offset < end) {
+    if(sendfile(to, from, &offset, (size_t)(end - offset)) <= 0) {
+      break;
+    }
+  }
+  // sendfile refuses outputs opened with O_APPEND
+  while(offset < end && (nb = pread(from, buf, sizeof(buf) < (size_t)(end - offset) ? sizeof(buf) : (size_t)(end - offset), offset)) > 0) {
+    if(write(to, buf, (size_t)nb) != nb) {
+      break;
+    }
+    offset += nb;
+  }
+  return offset < end;
+}
+
+/** \brief memoReplay
+ * A function which writes the output of a cached entry and marks it as used
+ * \param const char *path: The entry
+ * \param int outFd: Where its stdout goes
+ * \param int errFd: Where its stderr goes
+ * \param int *status: Filled with its exit code
+ * \return 0: when the entry is replayed; 1: when there's none
+ *
+ */
+static int memoReplay(const char *path, int outFd, int errFd, int *status) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  memoHeader header;
+  struct stat st;
+
+  if(fd < 0) {
+    return 1;
+  }
+  /*A damaged entry is a miss, the next store replaces it*/
+  if(pread(fd, &header, sizeof(header), 0) != sizeof(header) || memcmp(header.magic, MEMO_MAGIC, sizeof(MEMO_MAGIC)) ||
+     fstat(fd, &st) < 0 || (uint64_t)st.st_size != sizeof(header) + header.outLen + header.errLen) {
+    close(fd);
+    return 1;
+  }
+  fflush(stdout);
+  copyRange(fd, sizeof(header), (off_t)header.outLen, outFd);
+  copyRange(fd, (off_t)(sizeof(header) + header.outLen), (off_t)header.errLen, errFd);
+  /*Its modification time is its last use, the order of the eviction*/
+  futimens(fd, NULL);
+  close(fd);
+  *status = header.status;
+  return 0;
+}
+
+/** \brief compareEntries
+ * A function which orders the entries from the least recently used
+ * \param const void *a: An entry
+ * \param const void *b: Another one
+ * \return <0, 0 or >0 like strcmp
+ *
+ */
+static int compareEntries(const void *a, const void *b) {
+  const memoEntry *ea = (const memoEntry *)a, *eb = (const memoEntry *)b;
+  return ea->lastUse < eb->lastUse ? -1 : ea->lastUse > eb->lastUse;
+}
+
+/** \brief memoTrim
+ * A function which removes the least recently used entries
+ * until the cache holds "set -o memosize=" MiB at most
+ * \param const char *dir: The directory of the cache
+ * \return None
+ *
+ */
+static void memoTrim(const char *dir) {
+  off_t limit = (off_t)shellOptions.memoSize << 20, total = 0;
+  size_t nbEntries = 0, capEntries = 64, cpt;
+  memoEntry *entries;
+  struct dirent *ent;
+  struct stat st;
+  DIR *d;
+
+  if(limit == 0 || (d = opendir(dir)) == NULL) {
+    return;
+  }
+  entries = (memoEntry *)malloc(capEntries * sizeof(memoEntry));
+  while((ent = readdir(d)) != NULL) {
+    /*The files being written start with a dot*/
+    if(ent->d_name[0] == '.' || fstatat(dirfd(d), ent->d_name, &st, AT_SYMLINK_NOFOLLOW) < 0 || !S_ISREG(st.st_mode)) {
+      continue;
+    }
+    if(nbEntries == capEntries) {
+      capEntries *= 2;
+      entries = (memoEntry *)realloc(entries, capEntries * sizeof(memoEntry));
+    }
+    entries[nbEntries].name = strdup(ent->d_name);
+    entries[nbEntries].lastUse = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    entries[nbEntries].size = st.st_size;
+    total += st.st_size;
+    nbEntries++;
+  }
+  if(total > limit) {
+    qsort(entries, nbEntries, sizeof(memoEntry), compareEntries);
+    for(cpt = 0;cpt < nbEntries && total > limit;cpt++) {
+      /*Another shell may have removed it already*/
+      if(unlinkat(dirfd(d), entries[cpt].name, 0) == 0 || errno == ENOENT) {
+        total -= entries[cpt].size;
+      }
+    }
+  }
+  closedir(d);
+  for(cpt = 0;cpt < nbEntries;cpt++) {
+    free(entries[cpt].name);
+  }
+  free(entries);
+}
+
+/** \brief memoStore
+ * A function which keeps the output of a line in the cache
+ * The entry is written aside and renamed, so that no shell reads it half done
+ * \param const char *dir: The directory of the cache
+ * \param const char *path: The entry
+ * \param int outFd: The file holding the stdout
+ * \param int errFd: The file holding the stderr
+ * \param int status: The exit code
+ * \return None
+ *
+ */
+static void memoStore(const char *dir, const char *path, int outFd, int errFd, int status) {
+  char *tmp = (char *)malloc(strlen(dir) + sizeof("/.tmp-XXXXXX"));
+  memoHeader header;
+  int fd;
+
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MEMO_MAGIC, sizeof(MEMO_MAGIC));
+  header.status = status;
+  header.outLen = (uint64_t)lseek(outFd, 0, SEEK_END);
+  header.errLen = (uint64_t)lseek(errFd, 0, SEEK_END);
+  sprintf(tmp, "%s/.tmp-XXXXXX", dir);
+  if((fd = mkostemp(tmp, O_CLOEXEC)) < 0) {
+    fprintf(stderr, "-myshell: memo: %s: %s\n", dir, strerror(errno));
+    free(tmp);
+    return;
+  }
+  if(write(fd, &header, sizeof(header)) != sizeof(header) || copyRange(outFd, 0, (off_t)header.outLen, fd) ||
+     copyRange(errFd, 0, (off_t)header.errLen, fd) || rename(tmp, path) < 0) {
+    fprintf(stderr, "-myshell: memo: %s: %s\n", path, strerror(errno));
+    unlink(tmp);
+  }
+  close(fd);
+  free(tmp);
+  memoTrim(dir);
+}
+
+/** \brief memoStarted
+ * A function which tells whether every member of a line was started:
+ * the shell reports the others itself, nothing of it is captured
+ * \param job *pipeline: The job of the line, once done
+ * \return 1: when every member was started; 0: otherwise
+ *
+ */
+static int memoStarted(job *pipeline) {
+  for(unsigned int cpt = 0;cpt < pipeline->nbProcs;cpt++) {
+    if(pipeline->procs[cpt].pid < 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/** \brief outputTarget
+ * A function which takes the redirection of an output of the last member
+ * over: the output is captured, then written to the file like when replayed
+ * \param cmd *cmd: A pointer which points to the command
+ * \param int fd: STDOUT_FILENO or STDERR_FILENO
+ * \return The file opened, the output of the shell when it's not redirected; -1 on error
+ *
+ */
+static int outputTarget(cmd *cmd, int fd) {
+  cmdRedirection *redir = &cmd->redirection[cmd->nbCmdMembers - 1];
+  int target;
+
+  if(redir->file[fd] == NULL) {
+    return fd;
+  }
+  if((target = open(redir->file[fd], O_WRONLY | O_CREAT | O_CLOEXEC | (redir->mode[fd] == APPEND ? O_APPEND : O_TRUNC), 0666)) < 0) {
+    fprintf(stderr, "-myshell: %s: %s\n", redir->file[fd], strerror(errno));
+    return -1;
+  }
+  redir->file[fd] = NULL;
+  redir->mode[fd] = NOREDIR;
+  return target;
+}
+
+/** \brief memoCommand
+ * A function which realizes the "memo" prefix:
+ * memo [-e name]... [-f file]... command
+ * The key of the line is computed from its words, the working directory,
+ * the variables given with -e and the state of the files it redirects its
+ * stdin from or given with -f. When the cache holds the key, the stdout of
+ * the last member, the stderr and the exit code are replayed; otherwise the
+ * line runs with its output captured, which is printed and kept once it's done.
+ * The line reads /dev/null unless its stdin is redirected: that's all the key knows
+ * \param cmd *cmd: A pointer which points to the command, its first word is "memo"
+ * \return The exit code of the line
+ *
+ */
+int memoCommand(cmd *cmd) {
+  char **args = cmd->cmdMembersArgs[0], **names, **files, hex[MEMO_KEY_LEN + 1], *dir, *path = NULL;
+  unsigned int nbArgs = cmd->nbMembersArgs[0], first, nbNames = 0, nbFiles = 0, cpt;
+  int status = 0, outTarget, errTarget, io[3];
+  const builtinDesc *desc;
+  job *pipeline;
+
+  names = (char **)arenaAlloc(&cmd->mem, nbArgs * sizeof(char *));
+  files = (char **)arenaAlloc(&cmd->mem, nbArgs * sizeof(char *));
+  for(first = 1;first < nbArgs && args[first][0] == '-';first++) {
+    if(!strcmp(args[first], "--")) {
+      first++;
+      break;
+    } else if(!strcmp(args[first], "-e") && first + 1 < nbArgs) {
+      names[nbNames++] = args[++first];
+    } else if(!strcmp(args[first], "-f") && first + 1 < nbArgs) {
+      files[nbFiles++] = args[++first];
+    } else {
+      break;
+    }
+  }
+  if(first == nbArgs || (args[first][0] == '-' && strcmp(args[first - 1], "--"))) {
+    fprintf(stderr, "-myshell: memo: usage: memo [-e name]... [-f file]... command\n");
+    return 2;
+  }
+  /*What changes the shell leaves no output to replay*/
+  for(cpt = 0;cpt < cmd->nbCmdMembers;cpt++) {
+    const char *name = cpt == 0 ? args[first] : cmd->cmdMembersArgs[cpt][0];
+    if((desc = findBuiltin(name)) != NULL && desc->shellFunc != NULL) {
+      fprintf(stderr, "-myshell: memo: %s: can't be memoized\n", name);
+      return 2;
+    }
+  }
+
+  /*The rest of the line is the command*/
+  cmd->cmdMembersArgs[0] += first;
+  cmd->nbMembersArgs[0] -= first;
+  memoKey(cmd, names, nbNames, files, nbFiles, hex);
+
+  if((outTarget = outputTarget(cmd, STDOUT_FILENO)) < 0) {
+    return 1;
+  }
+  if((errTarget = outputTarget(cmd, STDERR_FILENO)) < 0) {
+    if(outTarget != STDOUT_FILENO) {
+      close(outTarget);
+    }
+    return 1;
+  }
+
+  if((dir = memoDir()) != NULL) {
+    path = (char *)malloc(strlen(dir) + MEMO_KEY_LEN + 2);
+    sprintf(path, "%s/%s", dir, hex);
+  }
+  if(path == NULL || memoReplay(path, outTarget, errTarget, &status)) {
+    /*The output waits in memory files, like the items of "parallel"*/
+    io[STDIN_FILENO] = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    io[STDOUT_FILENO] = memfd_create("memo-out", MFD_CLOEXEC);
+    io[STDERR_FILENO] = memfd_create("memo-err", MFD_CLOEXEC);
+    pipeline = runPipeline(cmd, 0, io);
+    status = waitForJob(pipeline);
+    recordPipestatus(pipeline);
+    copyRange(io[STDOUT_FILENO], 0, lseek(io[STDOUT_FILENO], 0, SEEK_END), outTarget);
+    copyRange(io[STDERR_FILENO], 0, lseek(io[STDERR_FILENO], 0, SEEK_END), errTarget);
+    /*A line stopped, killed or timed out didn't say all it had to; one which
+     *could not start says nothing about its command, which may be installed later*/
+    if(path != NULL && status < 128 && status != JOB_TIMEOUT_CODE && status != 126 && status != 127 &&
+       memoStarted(pipeline)) {
+      memoStore(dir, path, io[STDOUT_FILENO], io[STDERR_FILENO], status);
+    }
+    for(int fd = STDIN_FILENO;fd <= STDERR_FILENO;fd++) {
+      close(io[fd]);
+    }
+  }
+
+  if(outTarget != STDOUT_FILENO) {
+    close(outTarget);
+  }
+  if(errTarget != STDERR_FILENO) {
+    close(errTarget);
+  }
+  cmd->cmdMembersArgs[0] -= first;
+  cmd->nbMembersArgs[0] += first;
+  free(path);
+  free(dir);
+  return status;
+}
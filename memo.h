@@ -0,0 +1,23 @@
+#ifndef MYSHELL_MEMO_H
+#define MYSHELL_MEMO_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include "cmd.h"
+
+//Directory of the cache under the home, unless $MYSHELL_MEMODIR is set
+#define MEMO_DEFAULT_DIR ".myshell_memo"
+
+//Characters of a key in hexadecimal, it names the entry of the cache
+#define MEMO_KEY_LEN 32
+
+//Written at the start of every entry, changed with the format
+#define MEMO_MAGIC "MYMEMO1"
+
+//Realizes the "memo" prefix: replays the output and exit code of a line when its key is cached
+int memoCommand(cmd *c);
+
+#endif
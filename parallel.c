@@ -0,0 +1,442 @@
+#include <sys/mman.h>
+#include <sys/sendfile.h>
+#include <sys/signalfd.h>
+#include "shell_fct.h"
+#include "input.h"
+
+//Characters escaped when the words of the template are joined back into a line
+#define PARALLEL_SPECIAL " \t|<>&'\"\\#$*?["
+
+//Exit code when the items failed, it's the number of failures up to this one
+#define PARALLEL_MAX_FAILED 101
+
+typedef struct {
+    //the job running in the slot, NULL when the slot is free
+    job *j;
+
+    //the output of the job, kept until it's done so that jobs never interleave
+    int outFd, errFd;
+} parallelSlot;
+
+typedef struct {
+    //the template, parsed once
+    cmd tmpl;
+
+    //its words and redirections as parsed, with the placeholders
+    char ***args;
+    cmdRedirection *redirections;
+
+    //whether a placeholder appears, otherwise the item is appended to the last member
+    int hasPlaceholder;
+
+    //the words of the current item
+    arena itemMem;
+} parallelTemplate;
+
+/** \brief joinTemplate
+ * A function which turns the words of the template back into a command line
+ * A single word is taken as a whole line, so that it may hold a pipeline;
+ * otherwise the special characters of each word are escaped
+ * \param char **words: The words
+ * \param unsigned int nbWords: The number of words
+ * \return The newly allocated line
+ *
+ */
+static char *joinTemplate(char **words, unsigned int nbWords) {
+  size_t len=1;
+  unsigned int cpt;
+  char *line, *out;
+  const char *cur;
+
+  if(nbWords==1) {
+    return strdup(words[0]);
+  }
+  for(cpt=0; cpt<nbWords; cpt++) {
+    len+=2*strlen(words[cpt])+1;
+  }
+  out=line=(char *)malloc(len);
+  for(cpt=0; cpt<nbWords; cpt++) {
+    if(cpt>0) {
+      *out++=' ';
+    }
+    for(cur=words[cpt]; *cur!='\0'; cur++) {
+      if(strchr(PARALLEL_SPECIAL, *cur)!=NULL) {
+        *out++='\\';
+      }
+      *out++=*cur;
+    }
+  }
+  *out='\0';
+  return line;
+}
+
+/** \brief substitute
+ * A function which replaces the placeholders of a word by the item
+ * \param arena *mem: Where the new word is allocated
+ * \param char *word: The word of the template
+ * \param const char *item: The item
+ * \return The word itself when it has no placeholder; the new word otherwise
+ *
+ */
+static char *substitute(arena *mem, char *word, const char *item) {
+  size_t phLen=strlen(PARALLEL_PLACEHOLDER), itemLen=strlen(item), len=0;
+  unsigned int nbFound=0;
+  const char *cur, *found;
+  char *result, *out;
+
+  for(cur=word; (found=strstr(cur, PARALLEL_PLACEHOLDER))!=NULL; cur=found+phLen) {
+    nbFound++;
+  }
+  if(nbFound==0) {
+    return word;
+  }
+  len=strlen(word)+nbFound*itemLen-nbFound*phLen;
+  out=result=(char *)arenaAlloc(mem, len+1);
+  for(cur=word; (found=strstr(cur, PARALLEL_PLACEHOLDER))!=NULL; cur=found+phLen) {
+    memcpy(out, cur, (size_t)(found-cur));
+    out+=found-cur;
+    memcpy(out, item, itemLen);
+    out+=itemLen;
+  }
+  strcpy(out, cur);
+  return result;
+}
+
+/** \brief loadTemplate
+ * A function which parses the template once and sets the tables
+ * its instances are written into up
+ * \param parallelTemplate *t: The template
+ * \param const char *line: The command line of the template
+ * \return 0: when the template can be run; 1: otherwise
+ *
+ */
+static int loadTemplate(parallelTemplate *t, const char *line) {
+  unsigned int cpt, arg;
+  int fd;
+
+  setupCmd(&t->tmpl);
+  arenaInit(&t->itemMem);
+  t->hasPlaceholder=0;
+  if(parseMembers((char *)line, &t->tmpl)) {
+    return 1;
+  }
+  if(pendingHeredoc(&t->tmpl)!=NULL) {
+    fprintf(stderr, "-myshell: parallel: here-documents can't be given to a template, use <<<\n");
+    return 1;
+  }
+  // The substitutions are run once, for every item: a process substitution would be read by one only
+  for(cpt=0; cpt<t->tmpl.nbSubstitutions; cpt++) {
+    if(t->tmpl.substitutions[cpt].kind!=SUBST_COMMAND) {
+      fprintf(stderr, "-myshell: parallel: process substitutions can't be given to a template\n");
+      return 1;
+    }
+  }
+  if(expandCmd(&t->tmpl)) {
+    return 1;
+  }
+  for(cpt=0; cpt<t->tmpl.nbCmdMembers; cpt++) {
+    if(t->tmpl.nbMembersArgs[cpt]==0) {
+      fprintf(stderr, "-myshell: parallel: the command is incomplete\n");
+      return 1;
+    }
+  }
+  // The items run beside each other, never in the foreground
+  t->tmpl.background=1;
+
+  // The parsed tables are kept, the command gets tables of its own which the items fill
+  t->args=t->tmpl.cmdMembersArgs;
+  t->redirections=(cmdRedirection *)arenaAlloc(&t->tmpl.mem, sizeof(cmdRedirection)*t->tmpl.nbCmdMembers);
+  memcpy(t->redirections, t->tmpl.redirection, sizeof(cmdRedirection)*t->tmpl.nbCmdMembers);
+  t->tmpl.cmdMembersArgs=(char ***)arenaAlloc(&t->tmpl.mem, sizeof(char **)*t->tmpl.nbCmdMembers);
+  for(cpt=0; cpt<t->tmpl.nbCmdMembers; cpt++) {
+    // One more slot for the item appended to the last member
+    t->tmpl.cmdMembersArgs[cpt]=(char **)arenaAlloc(&t->tmpl.mem, sizeof(char *)*(t->tmpl.nbMembersArgs[cpt]+2));
+    for(arg=0; arg<t->tmpl.nbMembersArgs[cpt]; arg++) {
+      if(strstr(t->args[cpt][arg], PARALLEL_PLACEHOLDER)!=NULL) {
+        t->hasPlaceholder=1;
+      }
+    }
+    for(fd=STDIN_FILENO; fd<=STDERR_FILENO; fd++) {
+      if(t->redirections[cpt].file[fd]!=NULL && strstr(t->redirections[cpt].file[fd], PARALLEL_PLACEHOLDER)!=NULL) {
+        t->hasPlaceholder=1;
+      }
+    }
+  }
+  return 0;
+}
+
+/** \brief instantiate
+ * A function which writes the command of an item into the template
+ * \param parallelTemplate *t: The template
+ * \param const char *item: The item
+ * \return None
+ *
+ */
+static void instantiate(parallelTemplate *t, const char *item) {
+  unsigned int cpt, arg, last=t->tmpl.nbCmdMembers-1;
+  int fd;
+
+  arenaReset(&t->itemMem);
+  for(cpt=0; cpt<t->tmpl.nbCmdMembers; cpt++) {
+    char **args=t->tmpl.cmdMembersArgs[cpt];
+    for(arg=0; arg<t->tmpl.nbMembersArgs[cpt]; arg++) {
+      args[arg]=substitute(&t->itemMem, t->args[cpt][arg], item);
+    }
+    args[arg]=NULL;
+    if(cpt==last && !t->hasPlaceholder) {
+      args[arg++]=arenaStrdup(&t->itemMem, item);
+      args[arg]=NULL;
+    }
+    for(fd=STDIN_FILENO; fd<=STDERR_FILENO; fd++) {
+      if(t->redirections[cpt].file[fd]!=NULL) {
+        t->tmpl.redirection[cpt].file[fd]=substitute(&t->itemMem, t->redirections[cpt].file[fd], item);
+      }
+    }
+  }
+}
+
+/** \brief flushOutput
+ * A function which copies what a job wrote to the output of the shell,
+ * and empties the file for the next job of the slot
+ * \param int from: The file the job wrote to
+ * \param int to: The output of the shell
+ * \return None
+ *
+ */
+static void flushOutput(int from, int to) {
+  off_t len=lseek(from, 0, SEEK_END), offset=0;
+  char buf[8192];
+  ssize_t nb;
+
+  while(offset<len) {
+    if(sendfile(to, from, &offset, (size_t)(len-offset))<=0) {
+      break;
+    }
+  }
+  // sendfile refuses outputs opened with O_APPEND
+  while(offset<len && (nb=pread(from, buf, sizeof(buf), offset))>0) {
+    if(write(to, buf, (size_t)nb)!=nb) {
+      break;
+    }
+    offset+=nb;
+  }
+  ftruncate(from, 0);
+  lseek(from, 0, SEEK_SET);
+}
+
+/** \brief collectSlots
+ * A function which prints the output of the finished jobs and frees their slots
+ * \param parallelSlot *slots: The slots
+ * \param long nbSlots: The number of slots
+ * \param unsigned long *nbFailed: A pointer which points to the number of failed items, updated
+ * \return A free slot; NULL when every slot is busy
+ *
+ */
+static parallelSlot *collectSlots(parallelSlot *slots, long nbSlots, unsigned long *nbFailed) {
+  parallelSlot *freeSlot=NULL;
+  long cpt;
+
+  for(cpt=0; cpt<nbSlots; cpt++) {
+    if(slots[cpt].j!=NULL && slots[cpt].j->state==JOB_DONE) {
+      if(jobStatus(slots[cpt].j)!=0) {
+        (*nbFailed)++;
+      }
+      deleteJob(slots[cpt].j);
+      slots[cpt].j=NULL;
+      flushOutput(slots[cpt].outFd, STDOUT_FILENO);
+      flushOutput(slots[cpt].errFd, STDERR_FILENO);
+    }
+    if(slots[cpt].j==NULL && freeSlot==NULL) {
+      freeSlot=&slots[cpt];
+    }
+  }
+  return freeSlot;
+}
+
+/** \brief interruptParallel
+ * An event handler which records a Ctrl-C typed while the items run
+ * \param int fd: The signalfd of SIGINT
+ * \param unsigned int events: The EPOLL* flags
+ * \param void *data: A pointer which points to the flag to set
+ * \return None
+ *
+ */
+static void interruptParallel(int fd, unsigned int events, void *data) {
+  struct signalfd_siginfo info;
+  while(read(fd, &info, sizeof(info))==sizeof(info)) {
+    *(int *)data=1;
+  }
+}
+
+/** \brief parallelCommand
+ * A function which realizes the "parallel" builtin:
+ * parallel [-j jobs] [-a file] command [::: items]
+ * The command is parsed once, then run for every item (a line of the file,
+ * of the standard input, or a word after :::) with at most "jobs" of them
+ * running at once, the number of cores by default; the item replaces {}
+ * or is appended to the command. The output of each item is printed
+ * as a whole once it's done
+ * \param char **args: The arguments of the builtin, args[0] is "parallel"
+ * \param unsigned int nbArgs: The number of arguments
+ * \return 0: when every item succeeded; the number of failed items (at most 101) otherwise; 130 when interrupted
+ *
+ */
+int parallelCommand(char **args, unsigned int nbArgs) {
+  long maxJobs=sysconf(_SC_NPROCESSORS_ONLN), cpt;
+  const char *inputFile=NULL;
+  unsigned int first, sep, nextArg;
+  unsigned long nbFailed=0;
+  int interrupted=0, intFd=-1, devNull, io[3];
+  sigset_t intMask, oldMask;
+  parallelSlot *slots, *slot;
+  parallelTemplate t;
+  inputReader reader;
+  char *line, *end;
+
+  for(first=1; first<nbArgs && args[first][0]=='-'; first++) {
+    if(!strcmp(args[first], "--")) {
+      first++;
+      break;
+    } else if(!strncmp(args[first], "-j", 2) && (args[first][2]!='\0' || first+1<nbArgs)) {
+      const char *value=args[first][2]!='\0'? args[first]+2:args[++first];
+      maxJobs=strtol(value, &end, 10);
+      if(*end!='\0' || maxJobs<=0) {
+        fprintf(stderr, "-myshell: parallel: %s: invalid number of jobs\n", value);
+        return 2;
+      }
+    } else if(!strcmp(args[first], "-a") && first+1<nbArgs) {
+      inputFile=args[++first];
+    } else {
+      break;
+    }
+  }
+  for(sep=first; sep<nbArgs && strcmp(args[sep], PARALLEL_ITEMS); sep++) {}
+  if(first==sep || (args[first][0]=='-' && strcmp(args[first-1], "--"))) {
+    fprintf(stderr, "-myshell: parallel: usage: parallel [-j jobs] [-a file] command [::: items]\n");
+    return 2;
+  }
+  if(maxJobs<=0) {
+    maxJobs=1;
+  }
+
+  // Where the items come from
+  reader.buf=NULL;
+  if(sep<nbArgs) {
+    nextArg=sep+1;
+  } else if(inputFile!=NULL) {
+    int fd=open(inputFile, O_RDONLY | O_CLOEXEC);
+    if(fd<0) {
+      fprintf(stderr, "-myshell: parallel: %s: %s\n", inputFile, strerror(errno));
+      return 1;
+    }
+    openReader(&reader, fd);
+  } else {
+    openReader(&reader, STDIN_FILENO);
+  }
+
+  line=joinTemplate(args+first, sep-first);
+  if(loadTemplate(&t, line)) {
+    free(line);
+    releaseCmd(&t.tmpl);
+    arenaRelease(&t.itemMem);
+    if(reader.buf!=NULL) {
+      closeReader(&reader);
+    }
+    return 2;
+  }
+
+  // The items don't read the terminal, and their output waits in memory files
+  devNull=open("/dev/null", O_RDONLY | O_CLOEXEC);
+  slots=(parallelSlot *)calloc((size_t)maxJobs, sizeof(parallelSlot));
+  for(cpt=0; cpt<maxJobs; cpt++) {
+    slots[cpt].outFd=slots[cpt].errFd=-1;
+  }
+
+  // Ctrl-C reaches the shell only: it's passed on to the running items
+  if(shellInteractive) {
+    sigemptyset(&intMask);
+    sigaddset(&intMask, SIGINT);
+    sigprocmask(SIG_BLOCK, &intMask, &oldMask);
+    intFd=signalfd(-1, &intMask, SFD_NONBLOCK | SFD_CLOEXEC);
+    evAdd(intFd, EPOLLIN, interruptParallel, &interrupted);
+  }
+
+  fflush(stdout);
+  while(!interrupted) {
+    const char *item;
+    if(reader.buf==NULL) {
+      item=nextArg<nbArgs? args[nextArg++]:NULL;
+    } else {
+      item=readLine(&reader);
+    }
+    if(item==NULL) {
+      break;
+    }
+    if(item[0]=='\0') {
+      continue;
+    }
+
+    while((slot=collectSlots(slots, maxJobs, &nbFailed))==NULL && !interrupted) {
+      evRunOnce(-1);
+    }
+    if(slot==NULL) {
+      break;
+    }
+    if(slot->outFd<0) {
+      slot->outFd=memfd_create("parallel-out", MFD_CLOEXEC);
+      slot->errFd=memfd_create("parallel-err", MFD_CLOEXEC);
+    }
+    instantiate(&t, item);
+    io[STDIN_FILENO]=devNull;
+    io[STDOUT_FILENO]=slot->outFd;
+    io[STDERR_FILENO]=slot->errFd;
+    slot->j=runPipeline(&t.tmpl, 1, io);
+  }
+
+  // Wait for the items still running
+  for(;;) {
+    int running=0;
+    collectSlots(slots, maxJobs, &nbFailed);
+    for(cpt=0; cpt<maxJobs; cpt++) {
+      if(slots[cpt].j!=NULL) {
+        running=1;
+        if(interrupted==1) {
+          signalJob(slots[cpt].j, SIGINT);
+        }
+      }
+    }
+    if(!running) {
+      break;
+    }
+    // The items are told only once
+    if(interrupted) {
+      interrupted=2;
+    }
+    evRunOnce(-1);
+  }
+
+  if(intFd>=0) {
+    evDel(intFd);
+    close(intFd);
+    sigprocmask(SIG_SETMASK, &oldMask, NULL);
+  }
+  for(cpt=0; cpt<maxJobs; cpt++) {
+    if(slots[cpt].outFd>=0) {
+      close(slots[cpt].outFd);
+      close(slots[cpt].errFd);
+    }
+  }
+  free(slots);
+  close(devNull);
+  free(line);
+  releaseCmd(&t.tmpl);
+  arenaRelease(&t.itemMem);
+  if(reader.buf!=NULL) {
+    closeReader(&reader);
+  }
+
+  if(interrupted) {
+    return 128+SIGINT;
+  }
+  return nbFailed>PARALLEL_MAX_FAILED? PARALLEL_MAX_FAILED:(int)nbFailed;
+}
@@ -0,0 +1,12 @@
+#ifndef MYSHELL_PARALLEL_H
+#define MYSHELL_PARALLEL_H
+
+//Replaced by the item in the words and the redirections of the template
+#define PARALLEL_PLACEHOLDER "{}"
+//Separates the template from the items given on the command line
+#define PARALLEL_ITEMS ":::"
+
+//Realizes the "parallel" builtin: runs a command template once per item, a few at a time
+int parallelCommand(char **args, unsigned int nbArgs);
+
+#endif
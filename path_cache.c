@@ -0,0 +1,290 @@
+#include "path_cache.h"
+#include "vars.h"
+
+//Initial number of buckets, always a power of two
+#define PATH_CACHE_BUCKETS 64
+
+typedef struct pathEntry {
+    //the command name as typed by the user
+    char *name;
+
+    //the absolute path found in PATH
+    char *path;
+
+    //number of times the entry has been used
+    unsigned int hits;
+
+    struct pathEntry *next;
+} pathEntry;
+
+static pathEntry **buckets = NULL;
+static size_t nbBuckets = 0;
+static size_t nbEntries = 0;
+
+//The PATH the cached entries were resolved with
+static char *cachedPath = NULL;
+
+/** \brief hashName
+ * A function which hashes a command name (FNV-1a)
+ * \param const char *name: The command name
+ * \return The hash of the name
+ *
+ */
+static size_t hashName(const char *name) {
+  size_t hash=(size_t)14695981039346656037ULL;
+  while(*name!='\0') {
+    hash^=(unsigned char)*name++;
+    hash*=(size_t)1099511628211ULL;
+  }
+  return hash;
+}
+
+/** \brief findEntry
+ * A function which looks for the cache entry of a name
+ * \param const char *name: The command name
+ * \return A pointer to the link pointing to the entry (or to the end of its chain)
+ *
+ */
+static pathEntry **findEntry(const char *name) {
+  pathEntry **link=&buckets[hashName(name)&(nbBuckets-1)];
+  while(*link!=NULL && strcmp((*link)->name, name)) {
+    link=&(*link)->next;
+  }
+  return link;
+}
+
+/** \brief growCache
+ * A function which doubles the number of buckets when the table gets crowded
+ * \return None
+ *
+ */
+static void growCache(void) {
+  size_t newNb=nbBuckets==0? PATH_CACHE_BUCKETS:nbBuckets*2;
+  pathEntry **newBuckets=(pathEntry **)calloc(newNb, sizeof(pathEntry *));
+  size_t cpt;
+
+  for(cpt=0; cpt<nbBuckets; cpt++) {
+    pathEntry *entry=buckets[cpt];
+    while(entry!=NULL) {
+      pathEntry *next=entry->next;
+      size_t slot=hashName(entry->name)&(newNb-1);
+      entry->next=newBuckets[slot];
+      newBuckets[slot]=entry;
+      entry=next;
+    }
+  }
+  free(buckets);
+  buckets=newBuckets;
+  nbBuckets=newNb;
+}
+
+/** \brief checkPath
+ * A function which empties the cache when PATH has changed since it was filled
+ * \return The current value of PATH
+ *
+ */
+static const char *checkPath(void) {
+  const char *path=getVar("PATH");
+  if(path==NULL) {
+    path="/usr/local/bin:/usr/bin:/bin";
+  }
+  if(cachedPath==NULL || strcmp(cachedPath, path)) {
+    clearCommandCache();
+    cachedPath=strdup(path);
+  }
+  if(nbBuckets==0) {
+    growCache();
+  }
+  return path;
+}
+
+/** \brief searchPath
+ * A function which walks PATH looking for an executable file
+ * \param const char *path: The value of PATH
+ * \param const char *name: The command name
+ * \return A newly allocated absolute path; NULL when it's not found
+ *
+ */
+static char *searchPath(const char *path, const char *name) {
+  size_t nameLen=strlen(name);
+  struct stat st;
+
+  while(1) {
+    const char *end=strchrnul(path, ':');
+    size_t dirLen=(size_t)(end-path);
+    char *candidate=(char *)malloc(dirLen+nameLen+3);
+
+    // An empty entry stands for the current directory
+    if(dirLen==0) {
+      candidate[0]='.';
+      dirLen=1;
+    } else {
+      memcpy(candidate, path, dirLen);
+    }
+    candidate[dirLen]='/';
+    memcpy(candidate+dirLen+1, name, nameLen+1);
+
+    if(!stat(candidate, &st) && S_ISREG(st.st_mode) && !access(candidate, X_OK)) {
+      return candidate;
+    }
+    free(candidate);
+    if(*end=='\0') {
+      return NULL;
+    }
+    path=end+1;
+  }
+}
+
+/** \brief resolveCommand
+ * A function which resolves a command name like execvp would,
+ * remembering the result so that PATH is walked only once per name
+ * \param const char *name: The command name
+ * \param unsigned int hit: 1 when the command is about to run, 0 when it's only looked up
+ * \return The path to execute; NULL when the command is not found
+ *
+ */
+static const char *resolveCommand(const char *name, unsigned int hit) {
+  const char *path;
+  pathEntry **link;
+  char *found;
+
+  // Names with a slash are never looked up
+  if(strchr(name, '/')!=NULL) {
+    return name;
+  }
+
+  path=checkPath();
+  link=findEntry(name);
+  if(*link!=NULL) {
+    (*link)->hits+=hit;
+    return (*link)->path;
+  }
+
+  if((found=searchPath(path, name))==NULL) {
+    return NULL;
+  }
+  *link=(pathEntry *)malloc(sizeof(pathEntry));
+  (*link)->name=strdup(name);
+  (*link)->path=found;
+  (*link)->hits=hit;
+  (*link)->next=NULL;
+  if(++nbEntries>nbBuckets) {
+    growCache();
+  }
+  return found;
+}
+
+/** \brief lookupCommand
+ * A function which resolves the name of a command about to run, it counts
+ * as a hit of its cache entry
+ * \param const char *name: The command name
+ * \return The path to execute; NULL when the command is not found
+ *
+ */
+const char *lookupCommand(const char *name) {
+  return resolveCommand(name, 1);
+}
+
+/** \brief forgetCommand
+ * A function which removes the cache entry of a name
+ * \param const char *name: The command name
+ * \return None
+ *
+ */
+void forgetCommand(const char *name) {
+  pathEntry **link;
+  pathEntry *entry;
+
+  if(nbBuckets==0) {
+    return;
+  }
+  link=findEntry(name);
+  if((entry=*link)!=NULL) {
+    *link=entry->next;
+    free(entry->name);
+    free(entry->path);
+    free(entry);
+    nbEntries--;
+  }
+}
+
+/** \brief clearCommandCache
+ * A function which empties the cache
+ * \return None
+ *
+ */
+void clearCommandCache(void) {
+  size_t cpt;
+  for(cpt=0; cpt<nbBuckets; cpt++) {
+    while(buckets[cpt]!=NULL) {
+      pathEntry *entry=buckets[cpt];
+      buckets[cpt]=entry->next;
+      free(entry->name);
+      free(entry->path);
+      free(entry);
+    }
+  }
+  nbEntries=0;
+  free(cachedPath);
+  cachedPath=NULL;
+}
+
+/** \brief hashCommand
+ * A function which realizes the "hash" builtin
+ * "hash" lists the cache, "hash -r" empties it, "hash -d name" forgets a name,
+ * "hash -t name" prints the path of a name and "hash name..." pre-warms it,
+ * with no hit: like in bash only the runs are counted
+ * \param char **args: The arguments of the builtin, args[0] is "hash"
+ * \param unsigned int nbArgs: The number of arguments
+ * \return 0: when it succeeds; 1: when a name is not found; 2: when the usage is wrong
+ *
+ */
+int hashCommand(char **args, unsigned int nbArgs) {
+  unsigned int cpt=1;
+  int ret=0;
+  char mode='\0';
+
+  if(nbArgs==1) {
+    size_t slot;
+    checkPath();
+    if(nbEntries==0) {
+      printf("hash: hash table empty\n");
+      return 0;
+    }
+    printf("hits\tcommand\n");
+    for(slot=0; slot<nbBuckets; slot++) {
+      pathEntry *entry;
+      for(entry=buckets[slot]; entry!=NULL; entry=entry->next) {
+        printf("%4u\t%s\n", entry->hits, entry->path);
+      }
+    }
+    return 0;
+  }
+
+  if(!strcmp(args[1], "-r")) {
+    clearCommandCache();
+    return 0;
+  } else if(!strcmp(args[1], "-d") || !strcmp(args[1], "-t")) {
+    mode=args[1][1];
+    cpt=2;
+  } else if(args[1][0]=='-') {
+    fprintf(stderr, "-myshell: hash: usage: hash [-r] [-d|-t] [name ...]\n");
+    return 2;
+  }
+
+  for(; cpt<nbArgs; cpt++) {
+    if(mode=='d') {
+      checkPath();
+      forgetCommand(args[cpt]);
+    } else {
+      const char *path=resolveCommand(args[cpt], 0);
+      if(path==NULL) {
+        fprintf(stderr, "-myshell: hash: %s: not found\n", args[cpt]);
+        ret=1;
+      } else if(mode=='t') {
+        printf("%s\n", path);
+      }
+    }
+  }
+  return ret;
+}
@@ -0,0 +1,19 @@
+#ifndef MYSHELL_PATH_CACHE_H
+#define MYSHELL_PATH_CACHE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+//Resolves a command name to the path given to exec, NULL when it's not found
+const char *lookupCommand(const char *name);
+//Drops a cached path which could not be executed any more
+void forgetCommand(const char *name);
+//Empties the cache
+void clearCommandCache(void);
+//Realizes the "hash" builtin
+int hashCommand(char **args, unsigned int nbArgs);
+
+#endif
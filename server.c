@@ -0,0 +1,848 @@
+#include "shell_fct.h"
+#include <malloc.h>
+#include <sched.h>
+#include <sys/prctl.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+
+int zygoteFd = -1;
+
+/*A request to the zygote, followed by the path, the arguments and
+ *the environment, each one ended by '\0'; the fds come with SCM_RIGHTS*/
+typedef struct {
+    unsigned int nbArgs;
+    unsigned int nbEnv;
+    unsigned int nbFds;
+
+    //the number each fd takes in the child
+    int targets[SERVER_MAX_FDS];
+} zygoteRequest;
+
+/*The room for SCM_RIGHTS, aligned like a cmsghdr*/
+typedef union {
+    char space[CMSG_SPACE(SERVER_MAX_FDS * sizeof(int))];
+    struct cmsghdr align;
+} fdsControl;
+
+/*A connection to the server*/
+typedef struct serverClient {
+    int fd;
+
+    //the fds the client passed for stdin, stdout and stderr, -1 for the ones it didn't
+    int io[3];
+
+    //what it sent and is not run yet, from start on
+    char *buf;
+    size_t start;
+    size_t len;
+    size_t size;
+
+    //the job of the line running, NULL when none; lineIo holds the fds given to it
+    job *running;
+    int lineIo[3];
+
+    //whether it hung up or asked to leave: it's freed once its lines are done
+    int closed;
+
+    //whether its next line waits for the text of its here-documents, until more comes
+    int waiting;
+
+    struct serverClient *next;
+} serverClient;
+
+static serverClient *clients = NULL;
+static int serverStopped = 0;
+
+//The command every line is parsed into, freed once its job is started
+static cmd serverCmd;
+
+/** \brief zygoteExec
+ * A function which puts the fds of a request in place and executes the command,
+ * in the child of the zygote
+ * \param const char *path: The path of the command
+ * \param char **argv: Its arguments
+ * \param char **envp: Its environment
+ * \param const int *fds: The fds received
+ * \param const int *targets: The number each one takes
+ * \param unsigned int nbFds: The number of fds
+ * \return None, it never returns
+ *
+ */
+static void zygoteExec(const char *path, char **argv, char **envp, const int *fds, const int *targets, unsigned int nbFds) {
+  int moved[SERVER_MAX_FDS], top = STDERR_FILENO + 1;
+  unsigned int i;
+
+  for(i = 0;i < nbFds;i++) {
+    if(targets[i] >= top) {
+      top = targets[i] + 1;
+    }
+  }
+  /*Above every target first, so that no dup2 overwrites an fd still to be placed*/
+  for(i = 0;i < nbFds;i++) {
+    if((moved[i] = fcntl(fds[i], F_DUPFD_CLOEXEC, top)) < 0) {
+      _exit(126);
+    }
+  }
+  /*The copies are close-on-exec, the targets are not*/
+  for(i = 0;i < nbFds;i++) {
+    dup2(moved[i], targets[i]);
+  }
+  execve(path, argv, envp);
+  dprintf(STDERR_FILENO, "-myshell: %s: %s\n", argv[0], strerror(errno));
+  _exit(errno == ENOENT ? 127 : 126);
+}
+
+/** \brief zygoteRun
+ * A function which checks a request and forks its command
+ * The child is made with CLONE_PARENT: it's a child of the server,
+ * which reaps it and opens its pidfd like the ones it forks itself
+ * \param char *buf: The request
+ * \param size_t len: Its length
+ * \param const int *fds: The fds received with it
+ * \param unsigned int nbFds: The number of fds
+ * \return The pid of the child; -errno on error
+ *
+ */
+static int zygoteRun(char *buf, size_t len, const int *fds, unsigned int nbFds) {
+  zygoteRequest req;
+  char **strings, *end = buf + len, *s = buf + sizeof(req);
+  unsigned int i, nbStrings;
+  long pid;
+
+  if(len < sizeof(req)) {
+    return -EINVAL;
+  }
+  memcpy(&req, buf, sizeof(req));
+  if(req.nbFds != nbFds || nbFds > SERVER_MAX_FDS || req.nbArgs == 0 || req.nbArgs + req.nbEnv >= SERVER_ZYGOTE_MESSAGE) {
+    return -EINVAL;
+  }
+  /*The path, the arguments and NULL, then the environment and NULL*/
+  nbStrings = 1 + req.nbArgs + 1 + req.nbEnv + 1;
+  if((strings = malloc(nbStrings * sizeof(char *))) == NULL) {
+    return -ENOMEM;
+  }
+  for(i = 0;i < nbStrings;i++) {
+    if(i == req.nbArgs + 1 || i == nbStrings - 1) {
+      strings[i] = NULL;
+      continue;
+    }
+    char *nul = s < end ? memchr(s, '\0', end - s) : NULL;
+    if(nul == NULL) {
+      free(strings);
+      return -EINVAL;
+    }
+    strings[i] = s;
+    s = nul + 1;
+  }
+
+  pid = syscall(SYS_clone, CLONE_PARENT | SIGCHLD, 0, NULL, NULL, 0);
+  if(pid == 0) {
+    zygoteExec(strings[0], strings + 1, strings + req.nbArgs + 2, fds, req.targets, nbFds);
+  }
+  free(strings);
+  return pid < 0 ? -errno : (int)pid;
+}
+
+/** \brief zygoteLoop
+ * A function which answers the requests of the server until it's gone
+ * \param int sock: The zygote's end of the socket
+ * \return None, it never returns
+ *
+ */
+static void zygoteLoop(int sock) {
+  char *buf = malloc(SERVER_ZYGOTE_MESSAGE);
+  fdsControl control;
+  struct cmsghdr *cmsg;
+  struct msghdr msg;
+  struct iovec iov;
+  int fds[SERVER_MAX_FDS], reply;
+  unsigned int nbFds, i;
+  ssize_t len;
+
+  if(buf == NULL) {
+    _exit(1);
+  }
+  for(;;) {
+    iov.iov_base = buf;
+    iov.iov_len = SERVER_ZYGOTE_MESSAGE;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.space;
+    msg.msg_controllen = sizeof(control.space);
+    if((len = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC)) < 0 && errno == EINTR) {
+      continue;
+    }
+    /*The server is gone*/
+    if(len <= 0) {
+      _exit(0);
+    }
+    nbFds = 0;
+    for(cmsg = CMSG_FIRSTHDR(&msg);cmsg != NULL;cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if(cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+        unsigned int nb = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for(i = 0;i < nb;i++) {
+          int fd;
+          memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+          if(nbFds < SERVER_MAX_FDS) {
+            fds[nbFds++] = fd;
+          } else {
+            close(fd);
+          }
+        }
+      }
+    }
+    reply = (msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)) ? -E2BIG : zygoteRun(buf, len, fds, nbFds);
+    for(i = 0;i < nbFds;i++) {
+      close(fds[i]);
+    }
+    send(sock, &reply, sizeof(reply), MSG_NOSIGNAL);
+  }
+}
+
+/** \brief startZygote
+ * A function which forks the zygote: a process kept small, which forks
+ * the members of the pipelines in server mode, so that a fork never
+ * copies the memory of the server
+ * \return None; zygoteFd stays -1 when it can't be started
+ *
+ */
+void startZygote(void) {
+  int sv[2], size = SERVER_ZYGOTE_MESSAGE;
+  pid_t pid;
+
+  if(socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv)) {
+    fprintf(stderr, "-myshell: zygote: %s\n", strerror(errno));
+    return;
+  }
+  setsockopt(sv[0], SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+  setsockopt(sv[1], SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+  if((pid = fork()) < 0) {
+    fprintf(stderr, "-myshell: zygote: %s\n", strerror(errno));
+    close(sv[0]);
+    close(sv[1]);
+    return;
+  }
+  if(pid == 0) {
+    /*Only the standard fds and the socket are kept*/
+    close(sv[0]);
+    if(sv[1] > STDERR_FILENO + 1) {
+      close_range(STDERR_FILENO + 1, sv[1] - 1, 0);
+    }
+    close_range(sv[1] + 1, ~0U, 0);
+    prctl(PR_SET_NAME, "myshell-zygote");
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    malloc_trim(0);
+    zygoteLoop(sv[1]);
+  }
+  close(sv[1]);
+  zygoteFd = sv[0];
+}
+
+/** \brief zygoteLost
+ * A function which stops using a zygote which doesn't answer anymore
+ * \param const char *why: What went wrong
+ * \return None
+ *
+ */
+static void zygoteLost(const char *why) {
+  fprintf(stderr, "-myshell: zygote: %s, the server spawns the commands itself\n", why);
+  close(zygoteFd);
+  zygoteFd = -1;
+}
+
+/** \brief zygoteSpawn
+ * A function which has the zygote fork and execute a command
+ * \param const char *path: The path of the command
+ * \param char **argv: Its arguments
+ * \param char **envp: Its environment
+ * \param const int *fds: The fds to give to the child
+ * \param const int *targets: The number each one takes in the child
+ * \param unsigned int nbFds: The number of fds, SERVER_MAX_FDS at most
+ * \return The pid of the child; -1 when it can't be started
+ *
+ */
+pid_t zygoteSpawn(const char *path, char **argv, char **envp, const int *fds, const int *targets, unsigned int nbFds) {
+  size_t size = sizeof(zygoteRequest) + strlen(path) + 1;
+  zygoteRequest req;
+  fdsControl control;
+  struct cmsghdr *cmsg;
+  struct msghdr msg;
+  struct iovec iov;
+  char *buf, *s;
+  int reply;
+  ssize_t len;
+
+  memset(&req, 0, sizeof(req));
+  for(req.nbArgs = 0;argv[req.nbArgs] != NULL;req.nbArgs++) {
+    size += strlen(argv[req.nbArgs]) + 1;
+  }
+  for(req.nbEnv = 0;envp[req.nbEnv] != NULL;req.nbEnv++) {
+    size += strlen(envp[req.nbEnv]) + 1;
+  }
+  if(size > SERVER_ZYGOTE_MESSAGE) {
+    fprintf(stderr, "-myshell: %s: %s\n", argv[0], strerror(E2BIG));
+    return -1;
+  }
+  req.nbFds = nbFds;
+  memcpy(req.targets, targets, nbFds * sizeof(int));
+  if((buf = malloc(size)) == NULL) {
+    fprintf(stderr, "-myshell: %s: %s\n", argv[0], strerror(ENOMEM));
+    return -1;
+  }
+  memcpy(buf, &req, sizeof(req));
+  s = stpcpy(buf + sizeof(req), path) + 1;
+  for(unsigned int i = 0;i < req.nbArgs;i++) {
+    s = stpcpy(s, argv[i]) + 1;
+  }
+  for(unsigned int i = 0;i < req.nbEnv;i++) {
+    s = stpcpy(s, envp[i]) + 1;
+  }
+
+  iov.iov_base = buf;
+  iov.iov_len = size;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.space;
+  msg.msg_controllen = CMSG_SPACE(nbFds * sizeof(int));
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(nbFds * sizeof(int));
+  memcpy(CMSG_DATA(cmsg), fds, nbFds * sizeof(int));
+
+  while((len = sendmsg(zygoteFd, &msg, MSG_NOSIGNAL)) < 0 && errno == EINTR);
+  free(buf);
+  if(len < 0) {
+    /*Larger than the buffer of the socket: only this command is refused*/
+    if(errno == EMSGSIZE || errno == ENOBUFS) {
+      fprintf(stderr, "-myshell: %s: %s\n", argv[0], strerror(E2BIG));
+    } else {
+      zygoteLost(strerror(errno));
+    }
+    return -1;
+  }
+  while((len = recv(zygoteFd, &reply, sizeof(reply), 0)) < 0 && errno == EINTR);
+  if(len != sizeof(reply)) {
+    zygoteLost(len < 0 ? strerror(errno) : "gone");
+    return -1;
+  }
+  if(reply < 0) {
+    fprintf(stderr, "-myshell: %s: %s\n", argv[0], strerror(-reply));
+    return -1;
+  }
+  return reply;
+}
+
+/** \brief closeIo
+ * A function which closes a set of stdin, stdout and stderr
+ * \param int *io: The fds, -1 for the ones not open; they're all -1 afterwards
+ * \return None
+ *
+ */
+static void closeIo(int *io) {
+  for(int fd = STDIN_FILENO;fd <= STDERR_FILENO;fd++) {
+    if(io[fd] >= 0) {
+      close(io[fd]);
+      io[fd] = -1;
+    }
+  }
+}
+
+/** \brief swapStdio
+ * A function which gives the fds 0, 1 and 2 of the server to a client for a while,
+ * so that the builtins and the messages of the shell go to it
+ * \param const int *io: The stdin, stdout and stderr of the client
+ * \param int *saved: Filled with copies of the fds of the server, -1 for the closed ones
+ * \return None
+ *
+ */
+static void swapStdio(const int *io, int *saved) {
+  fflush(stdout);
+  for(int fd = STDIN_FILENO;fd <= STDERR_FILENO;fd++) {
+    saved[fd] = fcntl(fd, F_DUPFD_CLOEXEC, STDERR_FILENO + 1);
+    dup2(io[fd], fd);
+  }
+}
+
+/** \brief restoreStdio
+ * A function which gives the fds 0, 1 and 2 back to the server
+ * \param int *saved: The copies made by swapStdio, closed
+ * \return None
+ *
+ */
+static void restoreStdio(int *saved) {
+  fflush(stdout);
+  for(int fd = STDIN_FILENO;fd <= STDERR_FILENO;fd++) {
+    if(saved[fd] >= 0) {
+      dup2(saved[fd], fd);
+      close(saved[fd]);
+    } else {
+      close(fd);
+    }
+  }
+}
+
+/** \brief dropClient
+ * A function which stops reading from a client
+ * \param serverClient *c: The client
+ * \return None
+ *
+ */
+static void dropClient(serverClient *c) {
+  if(!c->closed) {
+    evDel(c->fd);
+    c->closed = 1;
+  }
+}
+
+/** \brief clientReady
+ * An event handler which reads what a client sent, and the fds passed with it
+ * It only buffers: the lines are run by serveClients, out of any nested event loop
+ * \param int fd: The socket of the client
+ * \param unsigned int events: The EPOLL* flags
+ * \param void *data: The client
+ * \return None
+ *
+ */
+static void clientReady(int fd, unsigned int events, void *data) {
+  serverClient *c = (serverClient *)data;
+  fdsControl control;
+  struct cmsghdr *cmsg;
+  struct msghdr msg;
+  struct iovec iov;
+  unsigned int nb, i;
+  ssize_t len;
+  int passed;
+
+  if(c->size - c->len < SERVER_MAX_LINE / 16) {
+    c->size = 2 * c->size + SERVER_MAX_LINE / 16;
+    c->buf = realloc(c->buf, c->size);
+  }
+  iov.iov_base = c->buf + c->len;
+  iov.iov_len = c->size - c->len;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.space;
+  msg.msg_controllen = sizeof(control.space);
+  if((len = recvmsg(fd, &msg, MSG_DONTWAIT | MSG_CMSG_CLOEXEC)) < 0 && (errno == EAGAIN || errno == EINTR)) {
+    return;
+  }
+  /*The fds passed replace the ones of the lines to come, in the order stdin, stdout, stderr*/
+  for(cmsg = CMSG_FIRSTHDR(&msg);cmsg != NULL;cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+    if(cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) {
+      continue;
+    }
+    nb = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+    for(i = 0;i < nb;i++) {
+      memcpy(&passed, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+      if(i > STDERR_FILENO) {
+        close(passed);
+        continue;
+      }
+      if(c->io[i] >= 0) {
+        close(c->io[i]);
+      }
+      c->io[i] = passed;
+    }
+  }
+  c->waiting = 0;
+  if(len <= 0) {
+    dropClient(c);
+    return;
+  }
+  c->len += len;
+  if(c->len - c->start > SERVER_MAX_LINE && memchr(c->buf + c->start, '\n', c->len - c->start) == NULL) {
+    fprintf(stderr, "-myshell: server: line longer than %d bytes, client dropped\n", SERVER_MAX_LINE);
+    c->len = c->start;
+    dropClient(c);
+  }
+}
+
+/** \brief serverAccept
+ * An event handler which registers the new clients
+ * \param int fd: The listening socket
+ * \param unsigned int events: The EPOLL* flags
+ * \param void *data: Unused
+ * \return None
+ *
+ */
+static void serverAccept(int fd, unsigned int events, void *data) {
+  serverClient *c;
+  int sock;
+
+  /*The sockets accepted block: the commands writing to them must not get EAGAIN*/
+  while((sock = accept4(fd, NULL, NULL, SOCK_CLOEXEC)) >= 0) {
+    c = calloc(1, sizeof(serverClient));
+    c->fd = sock;
+    c->io[STDIN_FILENO] = c->io[STDOUT_FILENO] = c->io[STDERR_FILENO] = -1;
+    c->lineIo[STDIN_FILENO] = c->lineIo[STDOUT_FILENO] = c->lineIo[STDERR_FILENO] = -1;
+    c->next = clients;
+    clients = c;
+    evAdd(sock, EPOLLIN, clientReady, c);
+  }
+}
+
+/** \brief stopServer
+ * An event handler which stops the server on SIGTERM, SIGINT or SIGHUP
+ * \param int fd: The signalfd
+ * \param unsigned int events: The EPOLL* flags
+ * \param void *data: Unused
+ * \return None
+ *
+ */
+static void stopServer(int fd, unsigned int events, void *data) {
+  struct signalfd_siginfo info;
+
+  while(read(fd, &info, sizeof(info)) == sizeof(info)) {
+    serverStopped = 1;
+  }
+}
+
+/** \brief takeLine
+ * A function which takes the first complete line a client sent
+ * The buffer is only moved by serveClients, a line given back is taken again
+ * \param serverClient *c: The client
+ * \return The line without its '\n', to be freed; NULL when none is complete
+ *
+ */
+static char *takeLine(serverClient *c) {
+  char *begin = c->buf + c->start, *nl = memchr(begin, '\n', c->len - c->start);
+
+  if(nl == NULL) {
+    return NULL;
+  }
+  c->start += nl + 1 - begin;
+  return strndup(begin, nl - begin);
+}
+
+/** \brief finishLine
+ * A function which tells a client the exit code of its line
+ * \param serverClient *c: The client
+ * \param int status: The exit code
+ * \return None
+ *
+ */
+static void finishLine(serverClient *c, int status) {
+  char reply[32];
+  int len = snprintf(reply, sizeof(reply), "status %d\n", status);
+
+  closeIo(c->lineIo);
+  setLastStatus(status);
+  /*Nobody to tell when it's gone*/
+  send(c->fd, reply, len, MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+/** \brief serveLine
+ * A function which parses a line of a client and starts it, like runLine
+ * Every line is a background job of the server, which goes on with the others
+ * \param serverClient *c: The client
+ * \param char *line: The line
+ * \return 0: when the line is run; 1: when the text of its here-documents is not all there yet
+ *
+ */
+static int serveLine(serverClient *c, char *line) {
+  int saved[3], status = 0, failed, waiting = 0;
+  const char *delimiter;
+  job *j = NULL;
+
+  /*Copies, so that the client may pass other fds while the line runs*/
+  for(int fd = STDIN_FILENO;fd <= STDERR_FILENO;fd++) {
+    if(c->io[fd] >= 0) {
+      c->lineIo[fd] = fcntl(c->io[fd], F_DUPFD_CLOEXEC, STDERR_FILENO + 1);
+    } else if(fd == STDIN_FILENO) {
+      c->lineIo[fd] = open("/dev/null", O_RDONLY | O_CLOEXEC);
+    } else {
+      c->lineIo[fd] = fcntl(c->fd, F_DUPFD_CLOEXEC, STDERR_FILENO + 1);
+    }
+  }
+  swapStdio(c->lineIo, saved);
+
+  traceSync();
+  TRACE(TRACE_PARSE_BEGIN, 0, 0, line);
+  failed = parseMembers(line, &serverCmd);
+  TRACE(TRACE_PARSE_END, 0, failed, NULL);
+  if(failed) {
+    status = 2;
+  } else {
+    /*The text of the here-documents follows the line, until the client leaves it may still come*/
+    while((delimiter = pendingHeredoc(&serverCmd)) != NULL) {
+      char *docLine = takeLine(c);
+      if(docLine == NULL && !c->closed) {
+        waiting = c->len - c->start <= SERVER_MAX_HEREDOC;
+        if(!waiting) {
+          fprintf(stderr, "-myshell: server: here-document longer than %d bytes, client dropped\n", SERVER_MAX_HEREDOC);
+          c->len = c->start;
+          dropClient(c);
+          status = 1;
+        }
+        break;
+      }
+      if(docLine == NULL) {
+        fprintf(stderr, "-myshell: warning: here-document delimited by end-of-file (wanted `%s')\n", delimiter);
+      }
+      addHeredocLine(&serverCmd, docLine);
+      free(docLine);
+    }
+    if(waiting || delimiter != NULL) {
+      /*Parsed again once the rest is there*/
+    } else if(expandCmd(&serverCmd)) {
+      status = 1;
+    } else if(serverCmd.nbCmdMembers == 1 && serverCmd.nbMembersArgs[0] > 0 &&
+              !strcmp(serverCmd.cmdMembersArgs[0][0], "exit")) {
+      /*It ends the connection, not the server*/
+      status = serverCmd.nbMembersArgs[0] > 1 ? atoi(serverCmd.cmdMembersArgs[0][1]) & 0xff : 0;
+      c->len = c->start;
+      dropClient(c);
+    } else if(serverCmd.nbCmdMembers > 1 || serverCmd.nbMembersArgs[0] > 0 || serverCmd.nbMembersAssigns[0] > 0) {
+      serverCmd.background = 1;
+      j = startCommand(&serverCmd, 1, c->lineIo, &status);
+    }
+  }
+  restoreStdio(saved);
+  freeCmd(&serverCmd);
+  traceSync();
+
+  if(waiting) {
+    closeIo(c->lineIo);
+    return 1;
+  }
+  if((c->running = j) == NULL) {
+    finishLine(c, status);
+  }
+  return 0;
+}
+
+/** \brief serveClients
+ * A function which answers the clients whose job is done, runs their next
+ * lines and forgets the ones which left
+ * \return None
+ *
+ */
+static void serveClients(void) {
+  serverClient **link = &clients, *c;
+  int saved[3], status;
+  size_t begin;
+  char *line;
+
+  while((c = *link) != NULL) {
+    for(;;) {
+      /*A job whose members could not be started is done at once*/
+      if(c->running != NULL && c->running->state == JOB_DONE) {
+        /*Its signals and "time" are reported to the client*/
+        swapStdio(c->lineIo, saved);
+        status = waitForJob(c->running);
+        recordPipestatus(c->running);
+        restoreStdio(saved);
+        c->running = NULL;
+        finishLine(c, status);
+      }
+      begin = c->start;
+      if(c->running != NULL || c->waiting || (line = takeLine(c)) == NULL) {
+        break;
+      }
+      c->waiting = serveLine(c, line);
+      free(line);
+      if(c->waiting) {
+        c->start = begin;
+        break;
+      }
+    }
+    /*What was run leaves the buffer*/
+    if(c->start > 0) {
+      c->len -= c->start;
+      memmove(c->buf, c->buf + c->start, c->len);
+      c->start = 0;
+    }
+    if(c->closed && c->running == NULL) {
+      *link = c->next;
+      close(c->fd);
+      closeIo(c->io);
+      free(c->buf);
+      free(c);
+      continue;
+    }
+    link = &c->next;
+  }
+}
+
+/** \brief staleSocket
+ * A function which tells whether a socket file is left by a server which is gone
+ * \param const struct sockaddr_un *addr: The address of the socket
+ * \return 1: when nobody listens on it; 0: otherwise
+ *
+ */
+static int staleSocket(const struct sockaddr_un *addr) {
+  int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0), stale;
+
+  if(fd < 0) {
+    return 0;
+  }
+  stale = connect(fd, (const struct sockaddr *)addr, sizeof(*addr)) < 0 && errno == ECONNREFUSED;
+  close(fd);
+  return stale;
+}
+
+/** \brief socketAddress
+ * A function which fills the address of a Unix socket
+ * \param const char *path: The path of the socket
+ * \param struct sockaddr_un *addr: The address, filled
+ * \return 0: on success; 1: when the path is too long
+ *
+ */
+static int socketAddress(const char *path, struct sockaddr_un *addr) {
+  memset(addr, 0, sizeof(*addr));
+  addr->sun_family = AF_UNIX;
+  if(strlen(path) >= sizeof(addr->sun_path)) {
+    fprintf(stderr, "-myshell: %s: %s\n", path, strerror(ENAMETOOLONG));
+    return 1;
+  }
+  strcpy(addr->sun_path, path);
+  return 0;
+}
+
+/** \brief runServer
+ * A function which serves command lines on a Unix socket, see server.h
+ * \param const char *path: The path of the socket
+ * \return The exit code of the server
+ *
+ */
+int runServer(const char *path) {
+  struct sockaddr_un addr;
+  sigset_t stop;
+  int listenFd, sigFd;
+
+  if(socketAddress(path, &addr)) {
+    return 2;
+  }
+  if((listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0)) < 0) {
+    fprintf(stderr, "-myshell: socket: %s\n", strerror(errno));
+    return 1;
+  }
+  /*The file of a server which died is taken over, the one of a live server is not*/
+  if(bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) < 0 &&
+     (errno != EADDRINUSE || !staleSocket(&addr) || unlink(path) < 0 ||
+      bind(listenFd, (struct sockaddr *)&addr, sizeof(addr)) < 0)) {
+    fprintf(stderr, "-myshell: %s: %s\n", path, strerror(errno));
+    close(listenFd);
+    return 1;
+  }
+  if(listen(listenFd, SERVER_BACKLOG) < 0) {
+    fprintf(stderr, "-myshell: %s: %s\n", path, strerror(errno));
+    unlink(path);
+    close(listenFd);
+    return 1;
+  }
+
+  /*Stopped from the event loop, so that the socket file is removed*/
+  sigemptyset(&stop);
+  sigaddset(&stop, SIGTERM);
+  sigaddset(&stop, SIGINT);
+  sigaddset(&stop, SIGHUP);
+  sigprocmask(SIG_BLOCK, &stop, NULL);
+  if((sigFd = signalfd(-1, &stop, SFD_NONBLOCK | SFD_CLOEXEC)) >= 0) {
+    evAdd(sigFd, EPOLLIN, stopServer, NULL);
+  }
+  evAdd(listenFd, EPOLLIN, serverAccept, NULL);
+  setupCmd(&serverCmd);
+
+  while(!serverStopped) {
+    if(evRunOnce(-1) < 0) {
+      fprintf(stderr, "-myshell: server: %s\n", strerror(errno));
+      break;
+    }
+    serveClients();
+  }
+
+  evDel(listenFd);
+  close(listenFd);
+  unlink(path);
+  releaseCmd(&serverCmd);
+  return 0;
+}
+
+/** \brief runClient
+ * A function which sends command lines to a server with the fds 0, 1 and 2,
+ * and waits for their exit codes
+ * The lines all go at once and the socket is shut down for writing: the text
+ * of a here-document is there behind its line, and the server closes the
+ * connection once the last line is done
+ * \param const char *path: The path of the socket
+ * \param char **lines: The lines, the text of the here-documents following the line which reads it
+ * \param int nbLines: The number of lines
+ * \return The exit code of the last line; 1 when the server can't be reached
+ *
+ */
+int runClient(const char *path, char **lines, int nbLines) {
+  int stdio[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO}, fd, status = 0, answered = 0;
+  struct sockaddr_un addr;
+  fdsControl control;
+  struct cmsghdr *cmsg;
+  struct msghdr msg;
+  struct iovec iov;
+  char reply[256], *text, *s, *nl;
+  size_t size = 0, len = 0;
+  ssize_t nb;
+
+  if(socketAddress(path, &addr)) {
+    return 2;
+  }
+  if((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0 ||
+     connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+    fprintf(stderr, "-myshell: %s: %s\n", path, strerror(errno));
+    return 1;
+  }
+  for(int cpt = 0;cpt < nbLines;cpt++) {
+    size += strlen(lines[cpt]) + 1;
+  }
+  s = text = malloc(size + 1);
+  for(int cpt = 0;cpt < nbLines;cpt++) {
+    s = stpcpy(stpcpy(s, lines[cpt]), "\n");
+  }
+
+  /*The fds come with the first bytes, a blocking socket sends all the rest*/
+  iov.iov_base = text;
+  iov.iov_len = size;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.space;
+  msg.msg_controllen = CMSG_SPACE(sizeof(stdio));
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(stdio));
+  memcpy(CMSG_DATA(cmsg), stdio, sizeof(stdio));
+  nb = sendmsg(fd, &msg, MSG_NOSIGNAL);
+  free(text);
+  if(nb < 0 || shutdown(fd, SHUT_WR) < 0) {
+    fprintf(stderr, "-myshell: %s: %s\n", path, strerror(errno));
+    close(fd);
+    return 1;
+  }
+
+  /*"status N\n" once each line is done, the last one counts*/
+  while((nb = recv(fd, reply + len, sizeof(reply) - 1 - len, 0)) > 0 || (nb < 0 && errno == EINTR)) {
+    len += nb > 0 ? nb : 0;
+    reply[len] = '\0';
+    for(s = reply;(nl = strchr(s, '\n')) != NULL;s = nl + 1) {
+      answered += sscanf(s, "status %d", &status) == 1;
+    }
+    len -= s - reply;
+    memmove(reply, s, len);
+    /*Not a status: it can't be read*/
+    if(len == sizeof(reply) - 1) {
+      len = 0;
+    }
+  }
+  close(fd);
+  if(answered == 0) {
+    fprintf(stderr, "-myshell: %s: no status from the server\n", path);
+    return 1;
+  }
+  return status;
+}
@@ -0,0 +1,47 @@
+#ifndef MYSHELL_SERVER_H
+#define MYSHELL_SERVER_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+
+/*The protocol of "myshell --serve socket", over a Unix stream socket:
+ *a client sends command lines ended by '\n', the server answers "status N\n"
+ *once each one is done, in order. The text of a here-document follows its
+ *line, which waits for it until the delimiter comes or the client shuts the
+ *socket down for writing. The fds passed with SCM_RIGHTS become the
+ *stdin, stdout and stderr of the following lines; without them the commands
+ *read /dev/null and write to the socket itself, so socat is enough to try it.
+ *"exit [N]" answers N and closes the connection, so does the end of what the client sent.*/
+
+//Connections waiting to be accepted
+#define SERVER_BACKLOG 64
+
+//Longest command line a client may send
+#define SERVER_MAX_LINE 65536
+
+//Most bytes a line waits for while the text of its here-documents comes
+#define SERVER_MAX_HEREDOC (16 << 20)
+
+//Most fds the zygote puts in place in a child: stdin, stdout, stderr and process substitutions
+#define SERVER_MAX_FDS 16
+
+//Largest request given to the zygote: the path, the arguments and the environment
+#define SERVER_ZYGOTE_MESSAGE 131072
+
+//The socket to the zygote, -1 when the shell spawns its members itself
+extern int zygoteFd;
+
+//Forks the zygote, before the shell allocates anything its children would copy
+void startZygote(void);
+//Has the zygote fork and execute a command, fds[i] becoming targets[i] in the child
+pid_t zygoteSpawn(const char *path, char **argv, char **envp, const int *fds, const int *targets, unsigned int nbFds);
+//Serves command lines on a Unix socket until SIGTERM, SIGINT or SIGHUP
+int runServer(const char *path);
+//Sends command lines and their here-documents to a server with the fds 0, 1 and 2, gives the last exit code
+int runClient(const char *path, char **lines, int nbLines);
+
+#endif
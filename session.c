@@ -0,0 +1,290 @@
+#include "session.h"
+#include "vars.h"
+
+typedef struct {
+    //who and where, looked up once when the first prompt is built
+    char *userName;
+    char *hostName;
+    char *homeDir;
+
+    //the logical working directory and the previous one ($PWD, $OLDPWD)
+    char *cwd;
+    char *oldCwd;
+
+    //escapes: \u user, \h host, \w working directory, \W its last part, \$ # for root, \n, \\ .
+    char *promptTemplate;
+
+    //the last prompt built and whether it must be built again
+    char *prompt;
+    size_t promptCap;
+    int promptDirty;
+} sessionState;
+
+static sessionState session = {NULL, NULL, NULL, NULL, NULL, NULL, NULL, 0, 1};
+
+/** \brief sameFile
+ * A function which tells whether two paths name the same directory
+ * \param const char *a: The first path
+ * \param const char *b: The second path
+ * \return 1: when they are the same; 0: otherwise
+ *
+ */
+static int sameFile(const char *a, const char *b) {
+  struct stat stA, stB;
+  return !stat(a, &stA) && !stat(b, &stB) && stA.st_dev==stB.st_dev && stA.st_ino==stB.st_ino;
+}
+
+/** \brief setCwd
+ * A function which records a new working directory and exports it
+ * \param char *cwd: The new working directory, owned by the session afterwards
+ * \return None
+ *
+ */
+static void setCwd(char *cwd) {
+  free(session.oldCwd);
+  session.oldCwd=session.cwd;
+  session.cwd=cwd;
+  setVar("PWD", session.cwd, 1);
+  if(session.oldCwd!=NULL) {
+    setVar("OLDPWD", session.oldCwd, 1);
+  }
+  session.promptDirty=1;
+}
+
+/** \brief initSession
+ * A function which initializes the working directory of the session
+ * $PWD is trusted when it names the current directory, saving getcwd
+ * \return None
+ *
+ */
+void initSession(void) {
+  const char *pwd=getVar("PWD");
+  const char *oldPwd=getVar("OLDPWD");
+
+  if(pwd!=NULL && pwd[0]=='/' && sameFile(pwd, ".")) {
+    session.cwd=strdup(pwd);
+  } else if((session.cwd=getcwd(NULL, 0))==NULL) {
+    session.cwd=strdup(".");
+  }
+  setVar("PWD", session.cwd, 1);
+  if(oldPwd!=NULL) {
+    session.oldCwd=strdup(oldPwd);
+  }
+
+  if(getVar("MYSHELL_PROMPT")!=NULL) {
+    setPromptTemplate(getVar("MYSHELL_PROMPT"));
+  } else {
+    setPromptTemplate(SESSION_DEFAULT_PROMPT);
+  }
+}
+
+/** \brief loadIdentity
+ * A function which looks the user and the host up, once
+ * $USER and $HOME are preferred so that the user database is rarely queried
+ * \return None
+ *
+ */
+static void loadIdentity(void) {
+  char hostname[256]={'\0'};
+  struct passwd *infos=NULL;
+
+  if(session.hostName!=NULL) {
+    return;
+  }
+  if(getVar("USER")==NULL || getVar("HOME")==NULL) {
+    infos=getpwuid(getuid());
+  }
+  session.userName=strdup(getVar("USER")!=NULL? getVar("USER"):(infos!=NULL? infos->pw_name:"?"));
+  if(session.homeDir==NULL) {
+    session.homeDir=strdup(getVar("HOME")!=NULL? getVar("HOME"):(infos!=NULL? infos->pw_dir:"/"));
+  }
+  gethostname(hostname, sizeof(hostname)-1);
+  session.hostName=strdup(hostname);
+}
+
+/** \brief appendPrompt
+ * A function which appends characters to the prompt being built
+ * \param size_t *len: A pointer which points to the length of the prompt, updated
+ * \param const char *s: The characters
+ * \param size_t sLen: The number of characters
+ * \return None
+ *
+ */
+static void appendPrompt(size_t *len, const char *s, size_t sLen) {
+  if(*len+sLen+1>session.promptCap) {
+    session.promptCap=(*len+sLen+1)*2;
+    session.prompt=(char *)realloc(session.prompt, session.promptCap);
+  }
+  memcpy(session.prompt+*len, s, sLen);
+  *len+=sLen;
+  session.prompt[*len]='\0';
+}
+
+/** \brief sessionPrompt
+ * A function which gives the prompt
+ * It's built from the template only when the working directory
+ * or the template has changed since the last prompt
+ * \return The prompt
+ *
+ */
+const char *sessionPrompt(void) {
+  const char *cur;
+  size_t len=0;
+
+  if(!session.promptDirty) {
+    return session.prompt;
+  }
+  loadIdentity();
+  appendPrompt(&len, "", 0);
+  for(cur=session.promptTemplate; *cur!='\0'; cur++) {
+    const char *part;
+    if(*cur!='\\' || cur[1]=='\0') {
+      appendPrompt(&len, cur, 1);
+      continue;
+    }
+    switch(*++cur) {
+    case 'u': part=session.userName; break;
+    case 'h': part=session.hostName; break;
+    case 'w': part=session.cwd; break;
+    case 'W':
+      part=strrchr(session.cwd, '/');
+      part=(part==NULL || part[1]=='\0')? session.cwd:part+1;
+      break;
+    case '$': part=getuid()==0? "#":"$"; break;
+    case 'n': part="\n"; break;
+    case '\\': part="\\"; break;
+    default:
+      appendPrompt(&len, cur-1, 2);
+      continue;
+    }
+    appendPrompt(&len, part, strlen(part));
+  }
+  session.promptDirty=0;
+  return session.prompt;
+}
+
+/** \brief setPromptTemplate
+ * A function which replaces the template of the prompt
+ * \param const char *promptTemplate: The new template
+ * \return None
+ *
+ */
+void setPromptTemplate(const char *promptTemplate) {
+  free(session.promptTemplate);
+  session.promptTemplate=strdup(promptTemplate);
+  session.promptDirty=1;
+}
+
+/** \brief sessionCwd
+ * A function which gives the logical working directory, without any syscall
+ * \return The working directory
+ *
+ */
+const char *sessionCwd(void) {
+  return session.cwd;
+}
+
+/** \brief sessionHome
+ * A function which gives the home directory of the user
+ * \return The home directory
+ *
+ */
+const char *sessionHome(void) {
+  if(session.homeDir==NULL) {
+    if(getVar("HOME")!=NULL) {
+      session.homeDir=strdup(getVar("HOME"));
+    } else {
+      loadIdentity();
+    }
+  }
+  return session.homeDir;
+}
+
+/** \brief logicalPath
+ * A function which joins a directory to the working directory
+ * and folds its "." and ".." components, like cd does by default
+ * \param const char *dir: The directory, absolute or relative
+ * \return The newly allocated absolute path
+ *
+ */
+static char *logicalPath(const char *dir) {
+  size_t cwdLen=strlen(session.cwd), dirLen=strlen(dir);
+  char *path=(char *)malloc(cwdLen+dirLen+3);
+  size_t len=0;
+  const char *cur;
+
+  path[len++]='/';
+  if(dir[0]!='/') {
+    // The working directory is already folded
+    memcpy(path, session.cwd, cwdLen);
+    len=cwdLen;
+  }
+
+  for(cur=dir; *cur!='\0';) {
+    const char *end=strchrnul(cur, '/');
+    size_t partLen=(size_t)(end-cur);
+
+    if(partLen==0 || (partLen==1 && cur[0]=='.')) {
+      // Empty and "." components are dropped
+    } else if(partLen==2 && cur[0]=='.' && cur[1]=='.') {
+      while(len>1 && path[len-1]!='/') {len--;}
+      if(len>1) {len--;}
+    } else {
+      if(len>1 || path[0]!='/') {
+        path[len++]='/';
+      }
+      memcpy(path+len, cur, partLen);
+      len+=partLen;
+    }
+    cur=*end=='\0'? end:end+1;
+  }
+  path[len]='\0';
+  return path;
+}
+
+/** \brief sessionChdir
+ * A function which realizes the "cd" builtin
+ * "cd" and "cd ~" go home, "cd -" goes back to $OLDPWD; $PWD is
+ * updated from the path itself, so no getcwd is needed afterwards
+ * \param char **args: The arguments of the builtin, args[0] is "cd"
+ * \param unsigned int nbArgs: The number of arguments
+ * \return 0: when the directory is changed; 1: otherwise
+ *
+ */
+int sessionChdir(char **args, unsigned int nbArgs) {
+  const char *dir=nbArgs>1? args[1]:"~";
+  char *tilde=NULL, *path;
+  int back=0;
+
+  if(!strcmp(dir, "-")) {
+    if(session.oldCwd==NULL) {
+      fprintf(stderr, "-myshell: cd: OLDPWD not set\n");
+      return 1;
+    }
+    dir=session.oldCwd;
+    back=1;
+  } else if(dir[0]=='~' && (dir[1]=='\0' || dir[1]=='/')) {
+    const char *home=sessionHome();
+    tilde=(char *)malloc(strlen(home)+strlen(dir));
+    strcpy(tilde, home);
+    strcat(tilde, dir+1);
+    dir=tilde;
+  }
+
+  path=logicalPath(dir);
+  if(chdir(path)!=0) {
+    // The logical path may not exist physically (symbolic links), try the path as typed
+    free(path);
+    if(chdir(dir)!=0 || (path=getcwd(NULL, 0))==NULL) {
+      fprintf(stderr, "-myshell: cd: %s:%s\n", nbArgs>1? args[1]:dir, strerror(errno));
+      free(tilde);
+      return 1;
+    }
+  }
+  free(tilde);
+  setCwd(path);
+  if(back) {
+    printf("%s\n", session.cwd);
+  }
+  return 0;
+}
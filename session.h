@@ -0,0 +1,28 @@
+#ifndef MYSHELL_SESSION_H
+#define MYSHELL_SESSION_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pwd.h>
+#include <sys/stat.h>
+
+//Prompt used when MYSHELL_PROMPT is not set
+#define SESSION_DEFAULT_PROMPT "\\n{myshell}\\u@\\h:\\w$ "
+
+//Initializes the working directory of the session
+void initSession(void);
+//Gives the prompt, built again only when something it shows has changed
+const char *sessionPrompt(void);
+//Replaces the prompt template
+void setPromptTemplate(const char *promptTemplate);
+//Gives the working directory ($PWD)
+const char *sessionCwd(void);
+//Gives the home directory
+const char *sessionHome(void);
+//Realizes the "cd" builtin
+int sessionChdir(char **args, unsigned int nbArgs);
+
+#endif
@@ -13,278 +13,842 @@ static void fatalError(const char *msg) {
   exit(errno);
 }
 
-/** \brief fatalError
- * A function which processes error message and exit
- * when the program has detected a reboot error
- * \author Y. LIN
- * \param const char *msg: An error message
+/*What the prefixes of a member ask for*/
+typedef struct {
+    //the time it may run in milliseconds, 0 for no limit
+    long timeoutMs;
+
+    //the time left between signo and SIGKILL, 0 for no SIGKILL
+    long killAfterMs;
+    int signo;
+
+    //the report "time" prints for the pipeline, JOB_TIME_NONE when it's not timed
+    int timeReport;
+} memberLimits;
+
+/*The fds runPipeline gives to the ends of a pipeline, -1 when inherited*/
+static int pipelineIo[3] = {-1, -1, -1};
+
+/** \brief closeMemberFds
+ * A function which closes the fds opened by memberFds
+ * \param int *opened: The fds, -1 for the ones not opened
  * \return None
  *
  */
-static void rebootError(const char *msg) {
-  printf("%s\n", msg);
-  exit(0);
+static void closeMemberFds(int *opened) {
+  for(int fd = STDIN_FILENO;fd <= STDERR_FILENO;fd++) {
+    if(opened[fd] >= 0) {
+      close(opened[fd]);
+    }
+  }
 }
 
-int *pidChd = NULL;
-int cmdNbr = 0;
+/** \brief redirectionFlags
+ * A function which gives the open flags of a member's redirection
+ * \param cmd *cmd: A pointer which points to the command
+ * \param int cmdNo: The serial number of the member
+ * \param int fd: The redirected file descriptor
+ * \return The flags given to open
+ *
+ */
+static int redirectionFlags(cmd *cmd, int cmdNo, int fd) {
+  if(fd==STDIN_FILENO) {
+    return O_RDONLY;
+  }
+  /*The file is opened in append mode, otherwise it will be truncated to length 0*/
+  if(cmd->redirection[cmdNo].mode[fd] == APPEND) {
+    return O_RDWR | O_CREAT | O_APPEND;
+  }
+  return O_RDWR | O_CREAT | O_TRUNC;
+}
 
-/*Realizes shell builtin commands*/
-static int builtin_command(cmd *cmd){
-  char* username;
-  char workingdirectory[256] = "/home/";
-  unsigned int cpt;
+/** \brief heredocFd
+ * A function which gives the text of a here-document as an fd to read
+ * A text which fits in a pipe is written in one, a larger one goes to a
+ * memfd, so that nothing touches the disk and the reader can seek
+ * \param const char *text: The text
+ * \return The fd, close-on-exec; -1 on error
+ *
+ */
+static int heredocFd(const char *text) {
+  size_t len = strlen(text), done = 0;
+  int fds[2], fd;
+  ssize_t nb;
+
+  if(pipe2(fds, O_CLOEXEC) == 0) {
+    /*Written at once into the empty pipe, the writer never blocks*/
+    if((long)len <= (long)fcntl(fds[1], F_GETPIPE_SZ) && write(fds[1], text, len) == (ssize_t)len) {
+      close(fds[1]);
+      return fds[0];
+    }
+    close(fds[0]);
+    close(fds[1]);
+  }
+  if((fd = memfd_create("heredoc", MFD_CLOEXEC)) < 0) {
+    fprintf(stderr, "-myshell: here-document: %s\n", strerror(errno));
+    return -1;
+  }
+  while(done < len) {
+    if((nb = write(fd, text + done, len - done)) < 0) {
+      fprintf(stderr, "-myshell: here-document: %s\n", strerror(errno));
+      close(fd);
+      return -1;
+    }
+    done += (size_t)nb;
+  }
+  lseek(fd, 0, SEEK_SET);
+  return fd;
+}
 
-  // Upgrates for the exit/cd/pwd bugs
-  // \author Y. LIN
-  for(cpt=0; cpt<cmd->nbCmdMembers; cpt++) {
-    //Pwd is the highest
-    if(!strcmp(cmd->cmdMembersArgs[cpt][0], "pwd")) {
-      printf("%s\n", getcwd(workingdirectory, sizeof(workingdirectory)));
+/** \brief memberFds
+ * A function which opens the redirections of a member run by a builtin
+ * \param cmd *cmd: A pointer which points to the command
+ * \param int cmdNo: The serial number of the member
+ * \param int *fds: The stdin, stdout and stderr of the member, updated
+ * \param int *opened: Filled with the fds opened here, -1 for the others
+ * \return 0: when every file is opened; 1: otherwise
+ *
+ */
+static int memberFds(cmd *cmd, int cmdNo, int *fds, int *opened) {
+  int fd;
+
+  for(fd = STDIN_FILENO;fd <= STDERR_FILENO;fd++) {
+    opened[fd] = -1;
+  }
+  for(fd = STDIN_FILENO;fd <= STDERR_FILENO;fd++) {
+    if(cmd->redirection[cmdNo].file[fd] == NULL) {
+      continue;
+    }
+    if(cmd->redirection[cmdNo].mode[fd] == HEREDOC) {
+      opened[fd] = heredocFd(cmd->redirection[cmdNo].file[fd]);
+    } else if((opened[fd] = open(cmd->redirection[cmdNo].file[fd], redirectionFlags(cmd, cmdNo, fd) | O_CLOEXEC, 0666)) < 0) {
+      fprintf(stderr, "-myshell: %s: %s\n", cmd->redirection[cmdNo].file[fd], strerror(errno));
+    }
+    if(opened[fd] < 0) {
+      closeMemberFds(opened);
       return 1;
     }
+    fds[fd] = opened[fd];
   }
+  if(cmd->redirection[cmdNo].mode[STDERR_FILENO] == DUPLICATE) {
+    fds[STDERR_FILENO] = fds[STDOUT_FILENO];
+  } else if(cmd->redirection[cmdNo].mode[STDOUT_FILENO] == DUPLICATE) {
+    fds[STDOUT_FILENO] = fds[STDERR_FILENO];
+  }
+  return 0;
+}
 
-  // Upgrates for the exit/cd/pwd bugs
-  // \author Y. LIN
+/*Realizes shell builtin commands*/
+static int builtin_command(cmd *cmd, int *status){
+  const builtinDesc *desc;
+  unsigned int cpt;
+  int fds[3] = {STDIN_FILENO, STDOUT_FILENO, STDERR_FILENO}, opened[3];
+  char **saved;
+
+  *status = 0;
+
+  /*NAME=value alone sets variables of the shell*/
+  if(cmd->nbCmdMembers == 1 && cmd->nbMembersArgs[0] == 0) {
+    for(cpt = 0;cpt < cmd->nbMembersAssigns[0];cpt++) {
+      char *eq = strchr(cmd->cmdMembersAssigns[0][cpt], '=');
+      *eq = '\0';
+      setVar(cmd->cmdMembersAssigns[0][cpt], eq + 1, 0);
+      *eq = '=';
+    }
+    return 1;
+  }
+
+  /*The builtins which change the shell can't be part of a pipeline*/
   for(cpt=0; cpt<cmd->nbCmdMembers; cpt++) {
-    if(!strcmp(cmd->cmdMembersArgs[cpt][0], "exit")) {
+    desc = findBuiltin(cmd->cmdMembersArgs[cpt][0]);
+    if(desc != NULL && desc->shellFunc != NULL) {
       if(cmd->nbCmdMembers==1) {
-        exit(0);
+        /*Its assignments only last while it runs*/
+        saved = pushAssigns(cmd->cmdMembersAssigns[0], cmd->nbMembersAssigns[0]);
+        *status = desc->shellFunc(cmd->cmdMembersArgs[0], cmd->nbMembersArgs[0]);
+        popAssigns(cmd->cmdMembersAssigns[0], cmd->nbMembersAssigns[0], saved);
       } else {
-        printf("Command is wrong format.\n");
-        return 1;
-      }
-    } else if(!strcmp(cmd->cmdMembersArgs[cpt][0], "cd")) {
-      if(cmd->nbCmdMembers==1) {
-        /*To a user's home directory*/
-        if( cmd->nbMembersArgs[0]==1 || !strcmp(cmd->cmdMembersArgs[0][1], "~")) {
-          username = getenv("USER");
-          DEBUG("Getusername: %s\n", username);
-	        strcat(workingdirectory, username);
-	        DEBUG("Workingdirectory: %s\n", workingdirectory);
-	        chdir(workingdirectory);
-        }
-
-        else if(chdir(cmd->cmdMembersArgs[cpt][1]) != 0) {
-	        printf("-myshell: cd: %s:%s\n", cmd->cmdMembersArgs[0][1], strerror(errno));
-        }
-
-        return 1;
-      } else {
-        printf("Command has wrong format\n");
-        return 1;
+        fprintf(stderr, "Command has wrong format\n");
+        *status = 1;
       }
+      return 1;
     }
   }
 
+  /*A lone utility in the foreground runs right here, without a thread nor a job*/
+  if(cmd->nbCmdMembers != 1 || cmd->background ||
+     (desc = findBuiltin(cmd->cmdMembersArgs[0][0])) == NULL) {
+    return 0;
+  }
+  if(memberFds(cmd, 0, fds, opened)) {
+    *status = 1;
+    return 1;
+  }
+  if(!builtinUsable(desc, cmd->cmdMembersArgs[0], fds[STDIN_FILENO])) {
+    closeMemberFds(opened);
+    return 0;
+  }
+  fflush(stdout);
+  saved = pushAssigns(cmd->cmdMembersAssigns[0], cmd->nbMembersAssigns[0]);
+  *status = desc->streamFunc(cmd->cmdMembersArgs[0], cmd->nbMembersArgs[0], fds);
+  popAssigns(cmd->cmdMembersAssigns[0], cmd->nbMembersAssigns[0], saved);
+  closeMemberFds(opened);
+  return 1;
+}
+
+/** \brief parseDuration
+ * A function which reads a duration like "timeout" does: a number
+ * of seconds, maybe with decimals, followed by s, m, h or d
+ * \param const char *s: The duration
+ * \param long *ms: A pointer which points to the duration in milliseconds, filled
+ * \return 0: when the duration is valid; 1: otherwise
+ *
+ */
+static int parseDuration(const char *s, long *ms) {
+  char *end;
+  double value = strtod(s, &end);
+
+  if(end == s || value < 0) {
+    return 1;
+  }
+  switch(*end) {
+  case '\0': case 's': break;
+  case 'm': value *= 60; break;
+  case 'h': value *= 3600; break;
+  case 'd': value *= 86400; break;
+  default: return 1;
+  }
+  if(*end != '\0' && end[1] != '\0') {
+    return 1;
+  }
+  *ms = (long)(value * 1000);
   return 0;
 }
 
-/*Signal handler*/
-/** \brief my_alarm_handler
- * A signal handler which handles the following steps
- * after the alarm times up
- * \author Y. LIN
- * \param const char *msg: An error message
- * \return None
+/** \brief memberPrefixes
+ * A function which takes the prefixes off a member and records what they ask for:
+ * "time [-p] command..." on the first member times the whole pipeline,
+ * "timeout [-k duration] [-s signal] duration command..." limits the member,
+ * SIGKILL follows after "set -o killafter=" seconds unless -k is given
+ * \param char **argv: The arguments of the member
+ * \param int cmdNo: The serial number of the member
+ * \param memberLimits *limits: A pointer which points to the limits, filled
+ * \return The arguments of the command itself; NULL when a prefix is wrong
  *
  */
-static void my_alarm_handler(int signo) {
-  printf("Command executed time out.\n");
-  kill(pidChd[cmdNbr], SIGKILL);
+static char **memberPrefixes(char **argv, int cmdNo, memberLimits *limits) {
+  limits->timeoutMs = 0;
+  limits->killAfterMs = shellOptions.killAfter * 1000L;
+  limits->signo = SIGTERM;
+  limits->timeReport = JOB_TIME_NONE;
+
+  /*Like in other shells, "time" is a prefix only at the start of the pipeline*/
+  while(cmdNo == 0 && argv[0] != NULL && !strcmp(argv[0], "time")) {
+    argv++;
+    limits->timeReport = JOB_TIME_FULL;
+    if(argv[0] != NULL && !strcmp(argv[0], "-p")) {
+      argv++;
+      limits->timeReport = JOB_TIME_POSIX;
+    }
+    if(argv[0] == NULL) {
+      fprintf(stderr, "-myshell: time: usage: time [-p] command\n");
+      return NULL;
+    }
+  }
+
+  while(argv[0] != NULL && !strcmp(argv[0], "timeout")) {
+    argv++;
+    while(argv[0] != NULL && argv[0][0] == '-' && argv[1] != NULL) {
+      if(!strcmp(argv[0], "-k") && !parseDuration(argv[1], &limits->killAfterMs)) {
+        argv += 2;
+      } else if(!strcmp(argv[0], "-s") && (limits->signo = parseSignal(argv[1])) > 0) {
+        argv += 2;
+      } else {
+        fprintf(stderr, "-myshell: timeout: %s %s: invalid option\n", argv[0], argv[1]);
+        return NULL;
+      }
+    }
+    if(argv[0] == NULL || parseDuration(argv[0], &limits->timeoutMs) || argv[1] == NULL) {
+      fprintf(stderr, "-myshell: timeout: usage: timeout [-k duration] [-s signal] duration command\n");
+      return NULL;
+    }
+    argv++;
+  }
+  return argv;
 }
 
-int exec_command(cmd* cmd) {
-  /*The number of the cmd in execution*/
-  int cmdNo;
+/** \brief memberExec
+ * A function which wires the pipes and redirections of a member and executes it,
+ * from the process which becomes the command: a child of the shell, or the shell itself
+ * \param cmd *cmd: A pointer which points to the command
+ * \param int cmdNo: The serial number of the member
+ * \param char **argv: Its arguments, once the prefixes are taken off
+ * \param const char *path: The path of the command
+ * \param char **envp: Its environment
+ * \param int inFd: The stdin given by the pipeline, -1 when inherited
+ * \param int outFd: The stdout given by the pipeline, -1 when inherited
+ * \param int docFd: The text of its here-document, -1 when it has none
+ * \return None, it never returns
+ *
+ */
+static void memberExec(cmd *cmd, int cmdNo, char **argv, const char *path, char **envp, int inFd, int outFd, int docFd) {
+  sigset_t mask, defaults;
+  int fd, redirFd, err;
+
+  jobChildSignals(&mask, &defaults);
+  for(int signo = 1;signo < NSIG;signo++) {
+    if(sigismember(&defaults, signo) == 1) {
+      signal(signo, SIG_DFL);
+    }
+  }
+  sigprocmask(SIG_SETMASK, &mask, NULL);
 
-  /*Number of pipes*/
-  int pipe_num = cmd->nbCmdMembers - 1;
+  /*Every pipe is close-on-exec: only the two ends put in place survive execv*/
+  if(inFd >= 0) {
+    dup2(inFd, STDIN_FILENO);
+  }
+  if(outFd >= 0) {
+    dup2(outFd, STDOUT_FILENO);
+  }
+  if(pipelineIo[STDERR_FILENO] >= 0) {
+    dup2(pipelineIo[STDERR_FILENO], STDERR_FILENO);
+  }
 
-  /*Used to redirect input and output*/
-  int fd_in, fd_out, fd_err;
+  /*Redirections come after the pipes so that they take precedence*/
+  if(docFd >= 0) {
+    dup2(docFd, STDIN_FILENO);
+  }
+  for(fd = STDIN_FILENO;fd <= STDERR_FILENO;fd++) {
+    if(cmd->redirection[cmdNo].file[fd] != NULL && cmd->redirection[cmdNo].mode[fd] != HEREDOC) {
+      if((redirFd = open(cmd->redirection[cmdNo].file[fd], redirectionFlags(cmd, cmdNo, fd), 0666)) < 0) {
+        dprintf(STDERR_FILENO, "-myshell: %s: %s\n", cmd->redirection[cmdNo].file[fd], strerror(errno));
+        _exit(1);
+      }
+      dup2(redirFd, fd);
+      close(redirFd);
+    }
+  }
 
-  // Uses for cycles
-  unsigned int cpt;
+  /*2>&1 and 1>&2 copy the other output once it is in place*/
+  if(cmd->redirection[cmdNo].mode[STDERR_FILENO] == DUPLICATE) {
+    dup2(STDOUT_FILENO, STDERR_FILENO);
+  } else if(cmd->redirection[cmdNo].mode[STDOUT_FILENO] == DUPLICATE) {
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+  }
 
-  // Upgrates whether command's member is incomplete
-  // \author Y. LIN
-  for(cpt=0; cpt<cmd->nbCmdMembers; cpt++) {
-    if(!strcmp("", cmd->cmdMembers[cpt])) {
-      printf("Command's member is incomplete.\n");
-      return 0;
-    } else {
-      DEBUG("cmdMembers[cpt]: %s", cmd->cmdMembers[cpt]);
+  /*The pipes of its process substitutions survive execv, as /dev/fd/N*/
+  for(unsigned int sub = 0;sub < cmd->nbSubstitutions;sub++) {
+    if(cmd->substitutions[sub].fd >= 0 && cmd->substitutions[sub].member == (unsigned int)cmdNo) {
+      fcntl(cmd->substitutions[sub].fd, F_SETFD, 0);
     }
   }
 
-  /*It's a buildin command*/
-  if(builtin_command(cmd)) {
-    return 0;
+  /*The ring of the trace is shared: the child records its own exec*/
+  TRACE(TRACE_EXEC, getpid(), cmdNo, argv[0]);
+  // Already handled the situation of unrecognized file name
+  execve(path, argv, envp);
+  err = errno;
+  /*_exit: the atexit handlers and the buffers of the shell are not this process's*/
+  dprintf(STDERR_FILENO, "-myshell: %s: %s\n", argv[0], strerror(err));
+  _exit(err == ENOENT ? 127 : 126);
+}
+
+/** \brief forkMember
+ * A function which starts a member of the pipeline with fork
+ * The child wires its pipes and redirections itself before calling execv
+ * \param cmd *cmd: A pointer which points to the command
+ * \param int cmdNo: The serial number of the member
+ * \param char **argv: Its arguments, once the prefixes are taken off
+ * \param const int *pipe_fd: The pipes of the pipeline, the ends of pipe i at 2*i and 2*i+1
+ * \param int pipe_num: The number of pipes
+ * \param pid_t pgid: The process group of the pipeline, 0 for the first member
+ * \param int docFd: The text of its here-document, -1 when it has none
+ * \return The pid of the child; -1 when the command is not found
+ *
+ */
+static pid_t forkMember(cmd *cmd, int cmdNo, char **argv, const int *pipe_fd, int pipe_num, pid_t pgid, int docFd) {
+  const char *path = lookupCommand(argv[0]);
+  char **envp = varEnviron(&cmd->mem, cmd->cmdMembersAssigns[cmdNo], cmd->nbMembersAssigns[cmdNo]);
+  pid_t pid;
+
+  /*The cached binary may have disappeared since it was hashed*/
+  if(path != NULL && path != argv[0] && access(path, X_OK)) {
+    forgetCommand(argv[0]);
+    path = lookupCommand(argv[0]);
+  }
+  if(path == NULL) {
+    fprintf(stderr, "-myshell: %s: command not found\n", argv[0]);
+    return -1;
   }
 
-  /*Create 'cmd->nbCmdMembers - 1' pipes*/
-  int **pipe_fd = calloc(pipe_num, sizeof(int *));
-  for(int i = 0;i < pipe_num;i++) {
-    pipe_fd[i] = calloc(2, sizeof(int));
-    pipe(pipe_fd[i]);
+  if((pid = fork()) < 0) {
+    fatalError("Fork fail!");
+  }
+  if(pid != 0) {
+    /*Both sides set the group, whichever runs first*/
+    if(shellInteractive) {
+      setpgid(pid, pgid == 0 ? pid : pgid);
+    }
+    return pid;
   }
+  DEBUG("Child: cmdNo = %d", cmdNo);
 
-  //Create 'cmd->nbCmdMembers' pids
-  int *statusChd = (int *)calloc(cmd->nbCmdMembers, sizeof(int));
-  pidChd = (int *)calloc(cmd->nbCmdMembers, sizeof(int));
-  cmdNbr = 0;
+  /*Join the process group of the pipeline and take the terminal*/
+  if(shellInteractive) {
+    setpgid(0, pgid);
+    if(pgid == 0 && !cmd->background) {
+      tcsetpgrp(shellTerminal, getpid());
+    }
+  }
 
-  // Shell will finish If it's not responded more than 5 seconds
-  // \author Y. LIN
-  signal(SIGALRM, my_alarm_handler);
-  alarm(5);
-  DEBUG("Alarm set.");
+  /*The ends of the pipeline may be given by the caller*/
+  memberExec(cmd, cmdNo, argv, path, envp,
+             cmdNo > 0 ? pipe_fd[2 * (cmdNo - 1)] : pipelineIo[STDIN_FILENO],
+             cmdNo < pipe_num ? pipe_fd[2 * cmdNo + 1] : pipelineIo[STDOUT_FILENO], docFd);
+  return -1;
+}
 
-  /*Create child process for each cmd*/
-  for(cmdNo = 0; cmdNo < cmd->nbCmdMembers; cmdNo++) {
-    cmdNbr = cmdNo;
-    if((pidChd[cmdNo] = fork()) < 0) {
-      fatalError("Fork fail!");
+/** \brief spawnMember
+ * A function which starts a member of the pipeline with posix_spawn
+ * The pipes and redirections are already opened by the shell and given
+ * as dup2 actions, so that the parent's address space is never copied
+ * \param cmd *cmd: A pointer which points to the command
+ * \param int cmdNo: The serial number of the member
+ * \param char **argv: Its arguments, once the prefixes are taken off
+ * \param const int *fds: The fds it gets as stdin, stdout and stderr
+ * \param pid_t pgid: The process group of the pipeline, 0 for the first member
+ * \return The pid of the child; -1 when it can't be started
+ *
+ */
+static pid_t spawnMember(cmd *cmd, int cmdNo, char **argv, const int *fds, pid_t pgid) {
+  posix_spawn_file_actions_t actions;
+  posix_spawnattr_t attr;
+  sigset_t mask, defaults;
+  /*The cached environment, unless the member has assignments of its own*/
+  char **envp = varEnviron(&cmd->mem, cmd->cmdMembersAssigns[cmdNo], cmd->nbMembersAssigns[cmdNo]);
+  const char *path;
+  pid_t pid;
+  int fd, err;
+
+  posix_spawn_file_actions_init(&actions);
+  posix_spawnattr_init(&attr);
+
+  /*Signals the shell ignores or blocks are given back to the command*/
+  jobChildSignals(&mask, &defaults);
+  posix_spawnattr_setsigmask(&attr, &mask);
+  posix_spawnattr_setsigdefault(&attr, &defaults);
+  if(shellInteractive) {
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP);
+    posix_spawnattr_setpgroup(&attr, pgid);
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 35)
+    /*The leader of a foreground pipeline takes the terminal before exec*/
+    if(pgid == 0 && !cmd->background) {
+      posix_spawn_file_actions_addtcsetpgrp_np(&actions, shellTerminal);
     }
-    if(pidChd[cmdNo] == 0) {
-      break;//Child break and 'cmdNo' is the serial number
+#endif
+  } else {
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+  }
+
+  /*The pipes and files are close-on-exec, only their copies survive;
+   *an fd copied from 1 or 2 is always copied before being replaced*/
+  for(fd = STDIN_FILENO;fd <= STDERR_FILENO;fd++) {
+    if(fds[fd] != fd) {
+      posix_spawn_file_actions_adddup2(&actions, fds[fd], fd);
     }
   }
 
-  if(pidChd[cmdNbr] == 0) {
-    DEBUG("Child: cmdNo = %d", cmdNo);
+  /*A dup2 onto itself only clears close-on-exec: the pipes of its process substitutions stay open*/
+  for(unsigned int sub = 0;sub < cmd->nbSubstitutions;sub++) {
+    if(cmd->substitutions[sub].fd >= 0 && cmd->substitutions[sub].member == (unsigned int)cmdNo) {
+      posix_spawn_file_actions_adddup2(&actions, cmd->substitutions[sub].fd, cmd->substitutions[sub].fd);
+    }
+  }
 
-    /*Redirect input*/
-    if(cmd->redirection[cmdNo][STDIN_FILENO] != NULL) {
-      if((fd_in = open(cmd->redirection[cmdNo][STDIN_FILENO], O_RDONLY)) < 0) {
-        rebootError("Open fail!");
+  if((path = lookupCommand(argv[0])) == NULL) {
+    err = ENOENT;
+  } else {
+    err = posix_spawn(&pid, path, &actions, &attr, argv, envp);
+    /*The cached binary has disappeared: walk PATH again.
+     *A missing interpreter gives ENOENT too, the binary is still there then*/
+    if(err == ENOENT && path != argv[0] && access(path, X_OK)) {
+      forgetCommand(argv[0]);
+      if((path = lookupCommand(argv[0])) != NULL) {
+        err = posix_spawn(&pid, path, &actions, &attr, argv, envp);
       }
-      dup2(fd_in, 0);
-      close(fd_in);
     }
+  }
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attr);
+  if(path == NULL) {
+    fprintf(stderr, "-myshell: %s: command not found\n", argv[0]);
+    return -1;
+  }
+  if(err != 0) {
+    fprintf(stderr, "-myshell: %s: %s\n", argv[0], strerror(err));
+    return -1;
+  }
+  return pid;
+}
 
-    /*Redirect output*/
-    if(cmd->redirection[cmdNo][STDOUT_FILENO] != NULL) {
+/** \brief pipelineFds
+ * A function which gives the stdin, stdout and stderr a member gets from
+ * the pipeline, before its own redirections
+ * \param int cmdNo: The serial number of the member
+ * \param const int *pipe_fd: The pipes of the pipeline, the ends of pipe i at 2*i and 2*i+1
+ * \param int pipe_num: The number of pipes
+ * \param int *fds: Filled with the three fds
+ * \return None
+ *
+ */
+static void pipelineFds(int cmdNo, const int *pipe_fd, int pipe_num, int *fds) {
+  fds[STDIN_FILENO] = cmdNo > 0 ? pipe_fd[2 * (cmdNo - 1)] :
+                      (pipelineIo[STDIN_FILENO] >= 0 ? pipelineIo[STDIN_FILENO] : STDIN_FILENO);
+  fds[STDOUT_FILENO] = cmdNo < pipe_num ? pipe_fd[2 * cmdNo + 1] :
+                       (pipelineIo[STDOUT_FILENO] >= 0 ? pipelineIo[STDOUT_FILENO] : STDOUT_FILENO);
+  fds[STDERR_FILENO] = pipelineIo[STDERR_FILENO] >= 0 ? pipelineIo[STDERR_FILENO] : STDERR_FILENO;
+}
 
-      /*The file is opened in append mode*/
-      if(!strcmp((char*)cmd->redirectionType[cmdNo][0], "APPEND")) {
-	       if((fd_out = open(cmd->redirection[cmdNo][STDOUT_FILENO], O_RDWR | O_CREAT | O_APPEND, 0666)) < 0) {
-	          rebootError("Open fail!");
-	       }
-      } else {
+/** \brief threadMember
+ * A function which runs a member of the pipeline with a builtin on a thread
+ * \param cmd *cmd: A pointer which points to the command
+ * \param int cmdNo: The serial number of the member
+ * \param char **argv: Its arguments, once the prefixes are taken off
+ * \param const int *pipe_fd: The pipes of the pipeline, the ends of pipe i at 2*i and 2*i+1
+ * \param int pipe_num: The number of pipes
+ * \param job *pipeline: The job of the pipeline
+ * \return 0: when the thread is started; 1: when the real command must be run; -1: on a redirection error
+ *
+ */
+static int threadMember(cmd *cmd, int cmdNo, char **argv, const int *pipe_fd, int pipe_num, job *pipeline) {
+  const builtinDesc *desc = findBuiltin(argv[0]);
+  int fds[3], opened[3];
 
-	       /*The file will be truncated to length 0*/
-	        if((fd_out = open(cmd->redirection[cmdNo][STDOUT_FILENO], O_RDWR | O_CREAT | O_TRUNC, 0666)) < 0) {
-            rebootError("Open fail!");
-	        }
-      }
-      dup2(fd_out, 1);
-      close(fd_out);
+  /*A thread shares the variables of the shell: assignments need a process*/
+  if(desc == NULL || desc->streamFunc == NULL || cmd->nbMembersAssigns[cmdNo] > 0) {
+    return 1;
+  }
+  /*The pipes of process substitutions are closed once a background line is started,
+   *maybe before the thread opens them: a process keeps its own copy*/
+  for(unsigned int sub = 0;cmd->background && sub < cmd->nbSubstitutions;sub++) {
+    if(cmd->substitutions[sub].fd >= 0 && cmd->substitutions[sub].member == (unsigned int)cmdNo) {
+      return 1;
     }
+  }
+  pipelineFds(cmdNo, pipe_fd, pipe_num, fds);
+  if(memberFds(cmd, cmdNo, fds, opened)) {
+    return -1;
+  }
+  if(!builtinUsable(desc, argv, fds[STDIN_FILENO])) {
+    closeMemberFds(opened);
+    return 1;
+  }
+  startBuiltinThread(pipeline, cmdNo, desc, argv, fds, cmd->cmdMembers[cmdNo]);
+  closeMemberFds(opened);
+  return 0;
+}
 
-    /*Redirect error output*/
-    if(cmd->redirection[cmdNo][STDERR_FILENO] != NULL) {
+/** \brief zygoteMember
+ * A function which has a member of the pipeline forked by the zygote of the server
+ * Its fds are put side by side with the numbers they take in the child
+ * \param cmd *cmd: A pointer which points to the command
+ * \param int cmdNo: The serial number of the member
+ * \param char **argv: Its arguments, once the prefixes are taken off
+ * \param const int *stdio: The fds it gets as stdin, stdout and stderr
+ * \return The pid of the child; -1 when it can't be started
+ *
+ */
+static pid_t zygoteMember(cmd *cmd, int cmdNo, char **argv, const int *stdio) {
+  const char *path = lookupCommand(argv[0]);
+  char **envp = varEnviron(&cmd->mem, cmd->cmdMembersAssigns[cmdNo], cmd->nbMembersAssigns[cmdNo]);
+  int fds[SERVER_MAX_FDS], targets[SERVER_MAX_FDS];
+  unsigned int nbFds = 3;
+
+  if(path != NULL && path != argv[0] && access(path, X_OK)) {
+    forgetCommand(argv[0]);
+    path = lookupCommand(argv[0]);
+  }
+  if(path == NULL) {
+    fprintf(stderr, "-myshell: %s: command not found\n", argv[0]);
+    return -1;
+  }
 
-      /*The file is opened in append mode*/
-      if(!strcmp((char*)cmd->redirectionType[cmdNo][1], "APPEND")) {
-	       if((fd_err = open(cmd->redirection[cmdNo][STDERR_FILENO], O_RDWR | O_CREAT | O_APPEND, 0666)) < 0) {
-	          rebootError("Open fail!");
-	       }
-      } else {
+  for(int fd = STDIN_FILENO;fd <= STDERR_FILENO;fd++) {
+    fds[fd] = stdio[fd];
+    targets[fd] = fd;
+  }
+  /*The pipes of its process substitutions keep their number, as /dev/fd/N*/
+  for(unsigned int sub = 0;sub < cmd->nbSubstitutions && nbFds < SERVER_MAX_FDS;sub++) {
+    if(cmd->substitutions[sub].fd >= 0 && cmd->substitutions[sub].member == (unsigned int)cmdNo) {
+      fds[nbFds] = targets[nbFds] = cmd->substitutions[sub].fd;
+      nbFds++;
+    }
+  }
 
-	       /*The file will be truncated to length 0*/
-	        if((fd_err = open(cmd->redirection[cmdNo][STDERR_FILENO], O_RDWR | O_CREAT | O_TRUNC, 0666)) < 0) {
-            rebootError("Open fail!");
-	        }
-      }
-      dup2(fd_err, 2);
-      close(fd_err);
-    }
-
-    /*If there are pipes in the process*/
-    if(pipe_num) {
-
-      /*For the first cmd*/
-      if(cmdNo == 0) {
-        close(pipe_fd[cmdNo][0]);
-	      dup2(pipe_fd[cmdNo][1], 1);
-	      close(pipe_fd[cmdNo][1]);
-
-	      /*Close other pipes which it doesn't need*/
-	      for(int i = 1;i < pipe_num;i++) {
-	         close(pipe_fd[i][0]);
-	         close(pipe_fd[i][1]);
-         }
-       }
-
-      /*For the last cmd*/
-      else if(cmdNo == pipe_num) {
-        close(pipe_fd[cmdNo - 1][1]);
-        dup2(pipe_fd[cmdNo - 1][0], 0);
-        close(pipe_fd[cmdNo - 1][0]);
-
-	      /*Close other pipes which it doesn't need*/
-	      for(int i = 0;i < pipe_num - 1;i++) {
-	         close(pipe_fd[i][0]);
-	         close(pipe_fd[i][1]);
-	      }
-      }
+  return zygoteSpawn(path, argv, envp, fds, targets, nbFds);
+}
 
-      /*For other cmds in the middle*/
-      else {
-        dup2(pipe_fd[cmdNo - 1][0], 0);
-        close(pipe_fd[cmdNo - 1][0]);
-
-        dup2(pipe_fd[cmdNo][1], 1);
-	      close(pipe_fd[cmdNo][1]);
-
-	      /*Close other pipes which it doesn't need*/
-	      for(int i = 0;i < pipe_num;i++) {
-	         if((i != cmdNo - 1) || (i != cmdNo)) {
-	            close(pipe_fd[i][0]);
-	            close(pipe_fd[i][1]);
-	         }
-        }
-      }
+/** \brief setPipeSize
+ * A function which gives a pipe the capacity of "set -o pipesize="
+ * \param int fd: One end of the pipe
+ * \param int report: Whether a failure is printed
+ * \return None
+ *
+ */
+static void setPipeSize(int fd, int report) {
+  if(shellOptions.pipeSize > 0 && fcntl(fd, F_SETPIPE_SZ, (long)shellOptions.pipeSize * 1024) < 0 && report) {
+    /*Above /proc/sys/fs/pipe-max-size only root may go*/
+    fprintf(stderr, "-myshell: pipesize: %s\n", strerror(errno));
+  }
+}
+
+/** \brief runPipeline
+ * A function which starts every member of a command as one job
+ * \param cmd *cmd: A pointer which points to the command
+ * \param int hidden: Whether the job is left out of "jobs"
+ * \param const int *io: The fds given to the stdin of the first member, the stdout
+ * of the last one and the stderr of all of them, -1 or NULL when inherited
+ * \return The job, already started
+ *
+ */
+job *runPipeline(cmd *cmd, int hidden, const int *io) {
+  /*The number of the cmd in execution*/
+  int cmdNo;
+
+  /*Number of pipes*/
+  int pipe_num = cmd->nbCmdMembers - 1;
+
+  /*Used to measure the spawn latency*/
+  struct timespec spawnBegin, spawnEnd;
+  long spawnLat;
+
+  /*The children must not print what the shell has not written yet*/
+  fflush(stdout);
+
+  /*Create 'cmd->nbCmdMembers - 1' pipes, side by side*/
+  int *pipe_fd = calloc(2 * pipe_num + 1, sizeof(int));
+  for(int i = 0;i < pipe_num;i++) {
+    if(pipe2(pipe_fd + 2 * i, O_CLOEXEC)) {
+      fatalError("Pipe fail!");
+    }
+    setPipeSize(pipe_fd[2 * i + 1], i == 0);
+  }
+
+  job *pipeline = newJob(cmd->initCmd, cmd->nbCmdMembers, cmd->background, hidden);
+  for(int fd = STDIN_FILENO;fd <= STDERR_FILENO;fd++) {
+    pipelineIo[fd] = io == NULL ? -1 : io[fd];
+  }
+
+  /*Create child process for each cmd, the first one leads the process group*/
+  for(cmdNo = 0; cmdNo < cmd->nbCmdMembers; cmdNo++) {
+    memberLimits limits;
+    char **argv = memberPrefixes(cmd->cmdMembersArgs[cmdNo], cmdNo, &limits);
+    pid_t pid = -1;
+    int threaded = 1, docFd = -1, redirected = 1, fds[3], opened[3] = {-1, -1, -1};
+    TRACE(TRACE_SPAWN_BEGIN, 0, cmdNo, cmd->cmdMembersArgs[cmdNo][0]);
+    clock_gettime(CLOCK_MONOTONIC, &spawnBegin);
+    pipelineFds(cmdNo, pipe_fd, pipe_num, fds);
+    /*A thread can't be killed: members with a deadline are always processes*/
+    if(argv != NULL && limits.timeoutMs == 0) {
+      threaded = threadMember(cmd, cmdNo, argv, pipe_fd, pipe_num, pipeline);
+    }
+    if(argv == NULL) {
+      /*The member is not started, like a command which is not found*/
+    } else if(threaded < 0) {
+      redirected = 0;
+    } else if(threaded == 0) {
+      /*It runs on a thread of the shell*/
+    } else if((zygoteFd >= 0 || shellOptions.spawnMode == MYSHELL_SPAWN_POSIX) && memberFds(cmd, cmdNo, fds, opened)) {
+      /*Opened by the shell, a file which fails is told apart from the command*/
+      redirected = 0;
+    } else if(zygoteFd >= 0 && ((pid = zygoteMember(cmd, cmdNo, argv, fds)) >= 0 || zygoteFd >= 0)) {
+      /*In server mode the zygote forks it; once the zygote is lost the shell does*/
+    } else if(shellOptions.spawnMode == MYSHELL_SPAWN_POSIX) {
+      pid = spawnMember(cmd, cmdNo, argv, fds, pipeline->pgid);
+    } else if(cmd->redirection[cmdNo].mode[STDIN_FILENO] == HEREDOC &&
+              (docFd = heredocFd(cmd->redirection[cmdNo].file[STDIN_FILENO])) < 0) {
+      /*The text could not be given to it*/
+    } else {
+      pid = forkMember(cmd, cmdNo, argv, pipe_fd, pipe_num, pipeline->pgid, docFd);
+    }
+    closeMemberFds(opened);
+    if(docFd >= 0) {
+      close(docFd);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &spawnEnd);
+    TRACE(TRACE_SPAWN_END, 0, threaded == 0 ? 0 : pid, cmd->cmdMembersArgs[cmdNo][0]);
+    /*posix_spawn returns once the child has executed*/
+    if(pid > 0 && zygoteFd < 0 && shellOptions.spawnMode == MYSHELL_SPAWN_POSIX) {
+      TRACE(TRACE_EXEC, pid, cmdNo, argv[0]);
+    }
+    if(threaded != 0) {
+      setJobProcess(pipeline, cmdNo, pid, cmd->cmdMembers[cmdNo]);
+    }
+    /*Like other shells, a redirection which fails gives 1, not 127*/
+    if(!redirected) {
+      pipeline->procs[cmdNo].status = W_EXITCODE(1, 0);
+    }
+    if(cmdNo == 0) {
+      pipeline->timeReport = limits.timeReport;
+    }
+    if(pid > 0 && limits.timeoutMs > 0) {
+      setJobTimeout(pipeline, cmdNo, limits.timeoutMs, limits.killAfterMs, limits.signo);
+    }
+
+    /*Report how long each member took to be started*/
+    if(shellOptions.spawnStat) {
+      spawnLat = (spawnEnd.tv_sec - spawnBegin.tv_sec) * 1000000000L +
+                 (spawnEnd.tv_nsec - spawnBegin.tv_nsec);
+      fprintf(stderr, "spawn[%d] %s: %.1f us (%s)\n", cmdNo, threaded == 0? "thread":
+              zygoteFd >= 0? "zygote": shellOptions.spawnMode == MYSHELL_SPAWN_POSIX? "posix":"fork",
+              spawnLat / 1000.0, cmd->cmdMembersArgs[cmdNo][0]);
+    }
+  }
+  startJob(pipeline);
+
+  /*The deadline of the whole pipeline, from "set -o timeout="*/
+  if(shellOptions.timeout > 0 && pipeline->state == JOB_RUNNING) {
+    setJobTimeout(pipeline, -1, shellOptions.timeout * 1000L, shellOptions.killAfter * 1000L, SIGTERM);
+  }
+  pipelineIo[STDIN_FILENO] = pipelineIo[STDOUT_FILENO] = pipelineIo[STDERR_FILENO] = -1;
+
+  /*Watch for the first byte through each pipe*/
+  for(int i = 0;traceBuffer != NULL && i < pipe_num;i++) {
+    if(pipeline->procs[i].pid >= 0) {
+      tracePipe(pipe_fd[2 * i], pipeline->procs[i].pid, i);
     }
-    // Already handled the situation of unrecognized file name
-    execvp(cmd->cmdMembersArgs[cmdNo][0], cmd->cmdMembersArgs[cmdNo]);
   }
 
   /*Parent loves them*/
-  for(int i = 0;i < pipe_num;i++) {
-    close(pipe_fd[i][0]);
-    close(pipe_fd[i][1]);
+  for(int i = 0;i < 2 * pipe_num;i++) {
+    close(pipe_fd[i]);
   }
+  free(pipe_fd);
+
+  return pipeline;
+}
 
+/** \brief startCommand
+ * A function which starts a command without waiting for it
+ * \param cmd *cmd: A pointer which points to the command
+ * \param int hidden: Whether its job is left out of "jobs"
+ * \param const int *io: The fds given to the ends of the pipeline, NULL when inherited
+ * \param int *status: Filled with the exit code when the command is already done
+ * \return The job of the command; NULL when it's already done
+ *
+ */
+job *startCommand(cmd *cmd, int hidden, const int *io, int *status) {
+  // Uses for cycles
+  unsigned int cpt;
+
+  *status = 0;
+  // Upgrates whether command's member is incomplete
   // \author Y. LIN
-  for(int i = 0;i < cmd->nbCmdMembers;i++) {
-    waitpid(pidChd[i], &statusChd[i], 0);
-    if(WIFEXITED(statusChd[i])) {
-      if(errno!=0) {
-        // A error happens when it's executed
-        printf("An error happens when executes this command\n");
-        printf("The number of error's type is %d\n", errno);
-        exit(0);
-      } else {
-        DEBUG("Child process successfully completed");
-        alarm(0);
-      }
+  for(cpt=0; cpt<cmd->nbCmdMembers; cpt++) {
+    if(cmd->nbMembersArgs[cpt] == 0 && (cmd->nbCmdMembers > 1 || cmd->nbMembersAssigns[0] == 0)) {
+      fprintf(stderr, "Command's member is incomplete.\n");
+      *status = 2;
+      return NULL;
     } else {
-      DEBUG("Child process unsuccessfully completed");
+      DEBUG("cmdMembers[cpt]: %s", cmd->cmdMembers[cpt]);
     }
   }
-  DEBUG("Father: End all the waiting.");
 
-  /*free the array*/
-  for(int i = 0;i < pipe_num;i++) {
-    free(pipe_fd[i]);
+  /*"memo" runs the rest of the line once, then replays what it printed*/
+  if(cmd->nbMembersArgs[0] > 0 && !strcmp(cmd->cmdMembersArgs[0][0], "memo")) {
+    *status = memoCommand(cmd);
+    return NULL;
   }
-  free(pipe_fd);
-  free(pidChd);
-  free(statusChd);
 
-  return 0;
+  /*It's a buildin command*/
+  if(builtin_command(cmd, status)) {
+    return NULL;
+  }
+
+  return runPipeline(cmd, hidden, io);
+}
+
+int exec_command(cmd* cmd) {
+  /*The exit code of the command*/
+  int status = 0;
+
+  job *pipeline = startCommand(cmd, 0, NULL, &status);
+  if(pipeline == NULL) {
+    return status;
+  }
+
+  /*The children are reaped by the event loop as they change state*/
+  if(cmd->background) {
+    if(shellInteractive) {
+      printf("[%d] %d\n", pipeline->id, pipeline->pgid);
+    }
+    return 0;
+  }
+
+  /*Deadlines are kept by the event loop while the job is waited for*/
+  status = waitForJob(pipeline);
+  recordPipestatus(pipeline);
+  DEBUG("Father: End all the waiting.");
+
+  return status;
+}
+
+/** \brief execFinalCommand
+ * A function which executes the last command of a script or of -c
+ * Its last member replaces the shell, nothing is left to wait for it; the
+ * members before it run as a job of their own, writing into the pipe it reads.
+ * The command runs like exec_command when it needs the shell once started:
+ * in the background, with a builtin, "time", "memo", a deadline or a trace, or while
+ * a builtin runs on one of its threads
+ * \param cmd *cmd: A pointer which points to the command
+ * \return The exit code, when the shell is not replaced
+ *
+ */
+int execFinalCommand(cmd *cmd) {
+  int last = cmd->nbCmdMembers - 1, io[3] = {-1, -1, -1}, pipeFds[2] = {-1, -1}, docFd = -1;
+  char **argv = cmd->cmdMembersArgs[last], **envp;
+  const char *path;
+  unsigned int cpt;
+
+  /*A builtin runs on a thread of the shell, execve would take it away:
+   *the ones of process substitutions and background jobs too*/
+  if(cmd->background || zygoteFd >= 0 || traceBuffer != NULL || shellOptions.timeout > 0 || jobThreadsRunning()) {
+    return exec_command(cmd);
+  }
+  for(cpt = 0;cpt < cmd->nbCmdMembers;cpt++) {
+    if(cmd->nbMembersArgs[cpt] == 0 || findBuiltin(cmd->cmdMembersArgs[cpt][0]) != NULL ||
+       !strcmp(cmd->cmdMembersArgs[cpt][0], "time") || !strcmp(cmd->cmdMembersArgs[cpt][0], "timeout") ||
+       !strcmp(cmd->cmdMembersArgs[cpt][0], "memo")) {
+      return exec_command(cmd);
+    }
+  }
+  if((path = lookupCommand(argv[0])) != NULL && path != argv[0] && access(path, X_OK)) {
+    forgetCommand(argv[0]);
+    path = lookupCommand(argv[0]);
+  }
+  /*Not found: reported like any other member*/
+  if(path == NULL || (last > 0 && pipe2(pipeFds, O_CLOEXEC))) {
+    return exec_command(cmd);
+  }
+  if(cmd->redirection[last].mode[STDIN_FILENO] == HEREDOC &&
+     (docFd = heredocFd(cmd->redirection[last].file[STDIN_FILENO])) < 0) {
+    if(last > 0) {
+      close(pipeFds[0]);
+      close(pipeFds[1]);
+    }
+    return 1;
+  }
+  envp = varEnviron(&cmd->mem, cmd->cmdMembersAssigns[last], cmd->nbMembersAssigns[last]);
+
+  if(last > 0) {
+    setPipeSize(pipeFds[1], 1);
+    io[STDOUT_FILENO] = pipeFds[1];
+    cmd->nbCmdMembers--;
+    runPipeline(cmd, 1, io);
+    cmd->nbCmdMembers++;
+    close(pipeFds[1]);
+  }
+  fflush(stdout);
+  memberExec(cmd, last, argv, path, envp, pipeFds[0], -1, docFd);
+  return 127;
 }
@@ -2,18 +2,41 @@
 #define MYSHELL_SHELL_FCT_H
 
 #include "cmd.h"
+#include "shell_opt.h"
+#include "path_cache.h"
+#include "session.h"
+#include "jobs.h"
+#include "parallel.h"
+#include "builtins.h"
+#include "history.h"
+#include "complete.h"
+#include "expand.h"
+#include "vars.h"
+#include "glob.h"
+#include "trace.h"
+#include "server.h"
+#include "memo.h"
 #include <sys/types.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <fcntl.h>
 #include <wait.h>
 #include <signal.h>
 #include <unistd.h>
 #include <errno.h>
+#include <spawn.h>
+#include <time.h>
 
 //Terminate shell
 #define MYSHELL_FCT_EXIT 1
 
-//Execute a command
+//Execute a command, gives back its exit code
 int exec_command(cmd *c);
+//Executes the last command of a script or of -c, its last member replaces the shell when it can
+int execFinalCommand(cmd *c);
+//Starts a command, NULL when it's already done and status holds its exit code
+job *startCommand(cmd *c, int hidden, const int *io, int *status);
+//Starts the members of a command as one job, io gives the stdin, stdout and stderr (-1: inherited)
+job *runPipeline(cmd *c, int hidden, const int *io);
 
 #endif
@@ -0,0 +1,243 @@
+#include <limits.h>
+#include "shell_opt.h"
+#include "vars.h"
+
+//Kinds of shell options
+#define OPT_BOOL 0
+#define OPT_INT 1
+#define OPT_CHOICE 2
+
+typedef struct {
+    //name given to "set -o"
+    const char *name;
+
+    //OPT_BOOL, OPT_INT or OPT_CHOICE
+    int kind;
+
+    //where the value is stored
+    int *value;
+
+    //NULL-terminated names of the values of an OPT_CHOICE option
+    const char * const *choices;
+
+    //tells whether an OPT_INT option may take a number, NULL when any one goes
+    int (*accepts)(long num);
+} optionDesc;
+
+/** \brief acceptPipeSize
+ * A function which tells whether a pipe may get a capacity, in KiB:
+ * above /proc/sys/fs/pipe-max-size every pipe would fail to get it
+ * \param long num: The capacity
+ * \return 1: when it's not above the limit, or the limit is unknown; 0: otherwise
+ *
+ */
+static int acceptPipeSize(long num) {
+  FILE *limit=fopen("/proc/sys/fs/pipe-max-size", "r");
+  long maxBytes;
+  int known;
+
+  if(limit==NULL) {
+    return 1;
+  }
+  known=fscanf(limit, "%ld", &maxBytes)==1;
+  fclose(limit);
+  return !known || num<=maxBytes/1024;
+}
+
+static const char * const spawnChoices[] = {"fork", "posix", NULL};
+static const char * const traceChoices[] = {"chrome", "jsonl", NULL};
+
+shellOpt shellOptions = {
+    MYSHELL_SPAWN_POSIX,
+    0,
+    0,
+    5,
+    0,
+    1000,
+    100000,
+    0,
+    MYSHELL_TRACE_CHROME,
+    256
+};
+
+static const optionDesc optionTable[] = {
+    {"spawn", OPT_CHOICE, &shellOptions.spawnMode, spawnChoices, NULL},
+    {"spawnstat", OPT_BOOL, &shellOptions.spawnStat, NULL, NULL},
+    {"timeout", OPT_INT, &shellOptions.timeout, NULL, NULL},
+    {"killafter", OPT_INT, &shellOptions.killAfter, NULL, NULL},
+    {"pipesize", OPT_INT, &shellOptions.pipeSize, NULL, acceptPipeSize},
+    {"histsize", OPT_INT, &shellOptions.histSize, NULL, NULL},
+    {"histfilesize", OPT_INT, &shellOptions.histFileSize, NULL, NULL},
+    {"trace", OPT_BOOL, &shellOptions.trace, NULL, NULL},
+    {"traceformat", OPT_CHOICE, &shellOptions.traceFormat, traceChoices, NULL},
+    {"memosize", OPT_INT, &shellOptions.memoSize, NULL, NULL},
+    {NULL, 0, NULL, NULL, NULL}
+};
+
+/** \brief findOption
+ * A function which looks for an option by its name
+ * \param const char *name: The name of the option
+ * \param size_t nameLen: The length of the name
+ * \return The descriptor of the option; NULL when it's unknown
+ *
+ */
+static const optionDesc *findOption(const char *name, size_t nameLen) {
+  const optionDesc *opt;
+  for(opt=optionTable; opt->name!=NULL; opt++) {
+    if(strlen(opt->name)==nameLen && !strncmp(opt->name, name, nameLen)) {
+      return opt;
+    }
+  }
+  return NULL;
+}
+
+/** \brief assignOption
+ * A function which assigns a textual value to an option
+ * \param const optionDesc *opt: The option
+ * \param const char *value: The value, NULL to switch a boolean option on
+ * \return 0: when the value is accepted; 1: when it is not
+ *
+ */
+static int assignOption(const optionDesc *opt, const char *value) {
+  char *end;
+  long num;
+  int cpt;
+
+  switch(opt->kind) {
+  case OPT_BOOL:
+    if(value==NULL || !strcmp(value, "on") || !strcmp(value, "1")) {
+      *opt->value=1;
+    } else if(!strcmp(value, "off") || !strcmp(value, "0")) {
+      *opt->value=0;
+    } else {
+      return 1;
+    }
+    return 0;
+  case OPT_INT:
+    if(value==NULL) {
+      return 1;
+    }
+    num=strtol(value, &end, 10);
+    if(*value=='\0' || *end!='\0' || num<0 || num>INT_MAX || (opt->accepts!=NULL && !opt->accepts(num))) {
+      return 1;
+    }
+    *opt->value=(int)num;
+    return 0;
+  case OPT_CHOICE:
+    if(value==NULL) {
+      return 1;
+    }
+    for(cpt=0; opt->choices[cpt]!=NULL; cpt++) {
+      if(!strcmp(opt->choices[cpt], value)) {
+        *opt->value=cpt;
+        return 0;
+      }
+    }
+    return 1;
+  default:
+    return 1;
+  }
+}
+
+/** \brief printOptions
+ * A function which prints every option with its current value
+ * \return None
+ *
+ */
+static void printOptions(void) {
+  const optionDesc *opt;
+  for(opt=optionTable; opt->name!=NULL; opt++) {
+    switch(opt->kind) {
+    case OPT_BOOL:
+      printf("%-15s %s\n", opt->name, *opt->value? "on":"off");
+      break;
+    case OPT_INT:
+      printf("%-15s %d\n", opt->name, *opt->value);
+      break;
+    default:
+      printf("%-15s %s\n", opt->name, opt->choices[*opt->value]);
+    }
+  }
+}
+
+/** \brief initOptions
+ * A function which initializes the options from the environment
+ * MYSHELL_SPAWN selects the spawn backend ("fork" or "posix"),
+ * MYSHELL_HISTSIZE and MYSHELL_HISTFILESIZE bound the history: they
+ * are read before the history is loaded, which "set" comes too late for;
+ * MYSHELL_TRACE=on traces from the first line, in the MYSHELL_TRACEFORMAT format
+ * \return None
+ *
+ */
+void initOptions(void) {
+  const char *spawn=getVar("MYSHELL_SPAWN");
+  const char *histSize=getVar("MYSHELL_HISTSIZE");
+  const char *histFileSize=getVar("MYSHELL_HISTFILESIZE");
+  const char *trace=getVar("MYSHELL_TRACE");
+  const char *traceFormat=getVar("MYSHELL_TRACEFORMAT");
+  if(spawn!=NULL && assignOption(findOption("spawn", 5), spawn)) {
+    fprintf(stderr, "-myshell: MYSHELL_SPAWN: unknown backend %s\n", spawn);
+  }
+  if(histSize!=NULL && assignOption(findOption("histsize", 8), histSize)) {
+    fprintf(stderr, "-myshell: MYSHELL_HISTSIZE: invalid value %s\n", histSize);
+  }
+  if(histFileSize!=NULL && assignOption(findOption("histfilesize", 12), histFileSize)) {
+    fprintf(stderr, "-myshell: MYSHELL_HISTFILESIZE: invalid value %s\n", histFileSize);
+  }
+  if(trace!=NULL && assignOption(findOption("trace", 5), trace)) {
+    fprintf(stderr, "-myshell: MYSHELL_TRACE: invalid value %s\n", trace);
+  }
+  if(traceFormat!=NULL && assignOption(findOption("traceformat", 11), traceFormat)) {
+    fprintf(stderr, "-myshell: MYSHELL_TRACEFORMAT: unknown format %s\n", traceFormat);
+  }
+}
+
+/** \brief setOption
+ * A function which realizes the "set" builtin
+ * "set -o" lists the options, "set -o name[=value]" sets one
+ * and "set +o name" switches a boolean option off
+ * \param char **args: The arguments of the builtin, args[0] is "set"
+ * \param unsigned int nbArgs: The number of arguments
+ * \return 0: when the options are set; 1: when the usage is wrong
+ *
+ */
+int setOption(char **args, unsigned int nbArgs) {
+  unsigned int cpt;
+  int ret=0;
+
+  if(nbArgs==1 || (nbArgs==2 && !strcmp(args[1], "-o"))) {
+    printOptions();
+    return 0;
+  }
+  if(strcmp(args[1], "-o") && strcmp(args[1], "+o")) {
+    fprintf(stderr, "-myshell: set: usage: set [-o|+o] [name[=value]]...\n");
+    return 1;
+  }
+
+  for(cpt=2; cpt<nbArgs; cpt++) {
+    const char *value=strchr(args[cpt], '=');
+    size_t nameLen=value==NULL? strlen(args[cpt]):(size_t)(value-args[cpt]);
+    const optionDesc *opt=findOption(args[cpt], nameLen);
+
+    if(opt==NULL) {
+      fprintf(stderr, "-myshell: set: %s: invalid option name\n", args[cpt]);
+      ret=1;
+      continue;
+    }
+    if(value!=NULL) {
+      value++;
+    }
+    if(args[1][0]=='+') {
+      if(opt->kind!=OPT_BOOL || value!=NULL) {
+        fprintf(stderr, "-myshell: set: %s: not a boolean option\n", args[cpt]);
+        ret=1;
+        continue;
+      }
+      *opt->value=0;
+    } else if(assignOption(opt, value)) {
+      fprintf(stderr, "-myshell: set: %s: invalid value\n", args[cpt]);
+      ret=1;
+    }
+  }
+  return ret;
+}
@@ -0,0 +1,54 @@
+#ifndef MYSHELL_SHELL_OPT_H
+#define MYSHELL_SHELL_OPT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+//Backends used to start the members of a pipeline
+#define MYSHELL_SPAWN_FORK 0
+#define MYSHELL_SPAWN_POSIX 1
+
+//Formats of the trace file
+#define MYSHELL_TRACE_CHROME 0
+#define MYSHELL_TRACE_JSONL 1
+
+typedef struct {
+    //backend used to start pipeline members (fork vs. posix_spawn)
+    int spawnMode;
+
+    //prints the spawn latency of each pipeline member
+    int spawnStat;
+
+    //seconds a pipeline may run before it gets SIGTERM, 0 for no limit
+    int timeout;
+
+    //seconds between SIGTERM and SIGKILL, 0 for no SIGKILL
+    int killAfter;
+
+    //capacity of the pipes of a pipeline in KiB, 0 for the system's default
+    int pipeSize;
+
+    //lines of history given to readline at startup
+    int histSize;
+
+    //lines kept in the history file when it's compacted, 0 for no limit
+    int histFileSize;
+
+    //records the parses, spawns, execs, pipes and reaps in a trace file, and its format
+    int trace;
+    int traceFormat;
+
+    //MiB the cache of "memo" may hold before its least recently used entries go, 0 for no limit
+    int memoSize;
+} shellOpt;
+
+//The options of the running shell
+extern shellOpt shellOptions;
+
+//Initializes the options from the environment
+void initOptions(void);
+//Realizes the "set" builtin
+int setOption(char **args, unsigned int nbArgs);
+
+#endif
@@ -0,0 +1,381 @@
+#include <fcntl.h>
+#include <time.h>
+#include <sys/mman.h>
+#include "trace.h"
+#include "shell_opt.h"
+#include "vars.h"
+#include "event.h"
+
+typedef struct {
+  //the index of the event plus one once it's written, 0 before
+  unsigned long long seq;
+
+  //when it happened, in nanoseconds of CLOCK_MONOTONIC
+  long long ns;
+
+  int kind;
+
+  //the process it's about, and the thread which recorded it
+  pid_t pid, tid;
+
+  long long value;
+  char text[TRACE_TEXT];
+} traceEvent;
+
+//Lives in memory shared with the children: a child records its exec there before execve
+struct traceRing {
+  //the next index handed out, and the first one not written to the file yet
+  unsigned long long head, tail;
+
+  //the events lost because the ring was full
+  unsigned long long dropped;
+
+  traceEvent events[TRACE_RING];
+};
+
+struct traceRing *traceBuffer = NULL;
+
+//The ring stays mapped once it's made: a thread may still be recording when tracing stops
+static struct traceRing *ring = NULL;
+static int traceFd = -1, traceFormat = MYSHELL_TRACE_CHROME, atExitSet = 0, flushing = 0;
+static pid_t tracePid = 0;
+static long long startNs = 0;
+static unsigned long long nbWritten = 0, droppedWritten = 0;
+
+/** \brief jsonString
+ * A function which writes a text as the body of a JSON string
+ * \param char *out: Where it's written, 6 bytes per character of the text at most
+ * \param const char *text: The text
+ * \return The end of what's written
+ *
+ */
+static char *jsonString(char *out, const char *text) {
+  for(; *text!='\0'; text++) {
+    unsigned char c=(unsigned char)*text;
+    if(c=='"' || c=='\\') {
+      *out++='\\';
+      *out++=(char)c;
+    } else if(c<0x20) {
+      out+=sprintf(out, "\\u%04x", c);
+    } else {
+      *out++=(char)c;
+    }
+  }
+  return out;
+}
+
+/** \brief formatChrome
+ * A function which writes an event as the objects of the Chrome trace format:
+ * the shell's events on its own row, those of a member on the row of its pid,
+ * from its exec to its reap
+ * \param char *out: Where it's written
+ * \param const traceEvent *ev: The event
+ * \return The number of characters written
+ *
+ */
+static int formatChrome(char *out, const traceEvent *ev) {
+  char text[TRACE_TEXT*6];
+  long long us=(ev->ns-startNs)/1000, frac=(ev->ns-startNs)%1000;
+  pid_t member=ev->pid>0? ev->pid:tracePid;
+
+  if(frac<0) {
+    frac=0;
+  }
+  *jsonString(text, ev->text)='\0';
+  switch(ev->kind) {
+  case TRACE_PARSE_BEGIN:
+    return sprintf(out, "{\"name\":\"parse\",\"cat\":\"shell\",\"ph\":\"B\",\"ts\":%lld.%03lld,\"pid\":%d,\"tid\":%d,"
+                   "\"args\":{\"line\":\"%s\"}}", us, frac, tracePid, ev->tid, text);
+  case TRACE_PARSE_END:
+    return sprintf(out, "{\"name\":\"parse\",\"cat\":\"shell\",\"ph\":\"E\",\"ts\":%lld.%03lld,\"pid\":%d,\"tid\":%d}",
+                   us, frac, tracePid, ev->tid);
+  case TRACE_SPAWN_BEGIN:
+    return sprintf(out, "{\"name\":\"spawn %s\",\"cat\":\"shell\",\"ph\":\"B\",\"ts\":%lld.%03lld,\"pid\":%d,\"tid\":%d,"
+                   "\"args\":{\"member\":%lld}}", text, us, frac, tracePid, ev->tid, ev->value);
+  case TRACE_SPAWN_END:
+    return sprintf(out, "{\"name\":\"spawn %s\",\"cat\":\"shell\",\"ph\":\"E\",\"ts\":%lld.%03lld,\"pid\":%d,\"tid\":%d,"
+                   "\"args\":{\"pid\":%lld}}", text, us, frac, tracePid, ev->tid, ev->value);
+  case TRACE_EXEC:
+    return sprintf(out, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"%s\"}},\n"
+                   "{\"name\":\"%s\",\"cat\":\"member\",\"ph\":\"B\",\"ts\":%lld.%03lld,\"pid\":%d,\"tid\":%d}",
+                   member, member, text, text, us, frac, member, member);
+  case TRACE_FIRST_BYTE:
+    return sprintf(out, "{\"name\":\"first byte\",\"cat\":\"pipe\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%lld.%03lld,"
+                   "\"pid\":%d,\"tid\":%d,\"args\":{\"pipe\":%lld}}", us, frac, member, member, ev->value);
+  case TRACE_REAP:
+    return sprintf(out, "{\"name\":\"%s\",\"cat\":\"member\",\"ph\":\"E\",\"ts\":%lld.%03lld,\"pid\":%d,\"tid\":%d,"
+                   "\"args\":{\"status\":%lld}},\n"
+                   "{\"name\":\"reap\",\"cat\":\"shell\",\"ph\":\"i\",\"s\":\"t\",\"ts\":%lld.%03lld,\"pid\":%d,\"tid\":%d,"
+                   "\"args\":{\"pid\":%d,\"status\":%lld}}",
+                   text, us, frac, member, member, ev->value, us, frac, tracePid, ev->tid, member, ev->value);
+  default:
+    return 0;
+  }
+}
+
+/** \brief formatLine
+ * A function which writes an event as one line of JSON
+ * \param char *out: Where it's written
+ * \param const traceEvent *ev: The event
+ * \return The number of characters written
+ *
+ */
+static int formatLine(char *out, const traceEvent *ev) {
+  static const char * const names[] = {"parse_begin", "parse_end", "spawn_begin", "spawn_end", "exec", "first_byte", "reap"};
+  char text[TRACE_TEXT*6];
+
+  *jsonString(text, ev->text)='\0';
+  return sprintf(out, "{\"ts_ns\":%lld,\"event\":\"%s\",\"pid\":%d,\"tid\":%d,\"value\":%lld,\"text\":\"%s\"}",
+                 ev->ns, names[ev->kind], ev->pid>0? ev->pid:tracePid, ev->tid, ev->value, text);
+}
+
+/** \brief writeAll
+ * A function which writes a buffer to the trace file, whatever the interruptions
+ * \param const char *buf: The buffer
+ * \param size_t len: Its length
+ * \return None
+ *
+ */
+static void writeAll(const char *buf, size_t len) {
+  ssize_t nb;
+
+  while(len>0) {
+    if((nb=write(traceFd, buf, len))<0) {
+      if(errno==EINTR) {
+        continue;
+      }
+      return;
+    }
+    buf+=nb;
+    len-=(size_t)nb;
+  }
+}
+
+/** \brief flushRing
+ * A function which writes the events published so far to the file and
+ * gives their slots back; only one thread of the shell does it at a time
+ * \return None
+ *
+ */
+static void flushRing(void) {
+  char *buf, *out;
+  unsigned long long tail, head, dropped;
+
+  if(ring==NULL || traceFd<0 || __atomic_exchange_n(&flushing, 1, __ATOMIC_ACQUIRE)) {
+    return;
+  }
+  buf=(char *)malloc(TRACE_WRITE_BUFFER);
+  out=buf;
+  tail=ring->tail;
+  head=__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  for(; tail<head; tail++) {
+    traceEvent *ev=&ring->events[tail&(TRACE_RING-1)];
+    // A slot claimed but not written yet stops the flush, it'll come with the next one
+    if(__atomic_load_n(&ev->seq, __ATOMIC_ACQUIRE)!=tail+1) {
+      break;
+    }
+    if(TRACE_WRITE_BUFFER-(size_t)(out-buf)<TRACE_TEXT*24+512) {
+      writeAll(buf, (size_t)(out-buf));
+      out=buf;
+    }
+    if(nbWritten++>0) {
+      out+=sprintf(out, traceFormat==MYSHELL_TRACE_CHROME? ",\n":"\n");
+    }
+    out+=traceFormat==MYSHELL_TRACE_CHROME? formatChrome(out, ev):formatLine(out, ev);
+  }
+  __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+
+  dropped=__atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+  if(dropped!=droppedWritten) {
+    long long ns=evNow();
+    droppedWritten=dropped;
+    if(nbWritten++>0) {
+      out+=sprintf(out, traceFormat==MYSHELL_TRACE_CHROME? ",\n":"\n");
+    }
+    if(traceFormat==MYSHELL_TRACE_CHROME) {
+      out+=sprintf(out, "{\"name\":\"dropped\",\"ph\":\"C\",\"ts\":%lld.%03lld,\"pid\":%d,\"args\":{\"events\":%llu}}",
+                   (ns-startNs)/1000, (ns-startNs)%1000, tracePid, dropped);
+    } else {
+      out+=sprintf(out, "{\"ts_ns\":%lld,\"event\":\"dropped\",\"pid\":%d,\"value\":%llu}", ns, tracePid, dropped);
+    }
+  }
+  writeAll(buf, (size_t)(out-buf));
+  free(buf);
+  __atomic_store_n(&flushing, 0, __ATOMIC_RELEASE);
+}
+
+/** \brief traceRecord
+ * A function which records an event without any lock: a slot is claimed
+ * by moving the head forward with a compare-and-swap, then published by
+ * setting its sequence number, which the writer of the file waits for
+ * \param int kind: The TRACE_* kind of the event
+ * \param pid_t pid: The process it's about, 0 for the shell
+ * \param long long value: A number going with it
+ * \param const char *text: A text going with it, cut to TRACE_TEXT-1 characters; NULL for none
+ * \return None
+ *
+ */
+void traceRecord(int kind, pid_t pid, long long value, const char *text) {
+  struct traceRing *r=traceBuffer;
+  unsigned long long idx, tail;
+  traceEvent *ev;
+
+  if(r==NULL) {
+    return;
+  }
+  idx=__atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+  do {
+    tail=__atomic_load_n(&r->tail, __ATOMIC_ACQUIRE);
+    if(idx-tail>=TRACE_RING) {
+      __atomic_fetch_add(&r->dropped, 1, __ATOMIC_RELAXED);
+      return;
+    }
+  } while(!__atomic_compare_exchange_n(&r->head, &idx, idx+1, 1, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+  ev=&r->events[idx&(TRACE_RING-1)];
+  ev->ns=evNow();
+  ev->kind=kind;
+  ev->pid=pid;
+  ev->tid=gettid();
+  ev->value=value;
+  ev->text[0]='\0';
+  if(text!=NULL) {
+    strncat(ev->text, text, TRACE_TEXT-1);
+  }
+  __atomic_store_n(&ev->seq, idx+1, __ATOMIC_RELEASE);
+
+  // Half a ring waiting is written by whoever sees it, in the shell only
+  if(idx-tail>=TRACE_RING/2 && getpid()==tracePid) {
+    flushRing();
+  }
+}
+
+/** \brief traceStop
+ * A function which writes what's left, ends the file and stops recording
+ * \return None
+ *
+ */
+static void traceStop(void) {
+  if(traceBuffer==NULL || getpid()!=tracePid) {
+    return;
+  }
+  flushRing();
+  traceBuffer=NULL;
+  while(__atomic_exchange_n(&flushing, 1, __ATOMIC_ACQUIRE)) {}
+  writeAll(traceFormat==MYSHELL_TRACE_CHROME? "\n]\n":"\n", traceFormat==MYSHELL_TRACE_CHROME? 3:1);
+  close(traceFd);
+  traceFd=-1;
+  __atomic_store_n(&flushing, 0, __ATOMIC_RELEASE);
+}
+
+/** \brief traceStart
+ * A function which opens the trace file and starts recording
+ * The file is MYSHELL_TRACEFILE, /tmp/myshell-PID.json or .jsonl by default
+ * \return None
+ *
+ */
+static void traceStart(void) {
+  const char *file=getVar("MYSHELL_TRACEFILE");
+  char defaultFile[64];
+
+  traceFormat=shellOptions.traceFormat;
+  if(file==NULL || *file=='\0') {
+    snprintf(defaultFile, sizeof(defaultFile), "/tmp/myshell-%d.%s", getpid(),
+             traceFormat==MYSHELL_TRACE_CHROME? "json":"jsonl");
+    file=defaultFile;
+  }
+  if(ring==NULL) {
+    ring=(struct traceRing *)mmap(NULL, sizeof(struct traceRing), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+    if(ring==MAP_FAILED) {
+      ring=NULL;
+      fprintf(stderr, "-myshell: trace: %s\n", strerror(errno));
+      shellOptions.trace=0;
+      return;
+    }
+  }
+  if((traceFd=open(file, O_WRONLY|O_CREAT|O_TRUNC|O_CLOEXEC, 0644))<0) {
+    fprintf(stderr, "-myshell: trace: %s: %s\n", file, strerror(errno));
+    shellOptions.trace=0;
+    return;
+  }
+  if(!atExitSet) {
+    atexit(traceStop);
+    atExitSet=1;
+  }
+  memset(ring, 0, sizeof(struct traceRing));
+  tracePid=getpid();
+  startNs=evNow();
+  nbWritten=droppedWritten=0;
+  if(traceFormat==MYSHELL_TRACE_CHROME) {
+    writeAll("[\n", 2);
+  }
+  traceBuffer=ring;
+}
+
+/** \brief traceSync
+ * A function which starts or stops tracing as "set -o trace" says, and
+ * writes the events recorded so far; it's called between command lines
+ * \return None
+ *
+ */
+void traceSync(void) {
+  if(shellOptions.trace && traceBuffer==NULL) {
+    traceStart();
+  } else if(!shellOptions.trace && traceBuffer!=NULL) {
+    traceStop();
+  } else {
+    flushRing();
+  }
+}
+
+//The read end of a pipe watched for its first byte
+typedef struct {
+  pid_t writer;
+  int pipeNo;
+} pipeWatch;
+
+/** \brief pipeReady
+ * An event handler which records the first byte coming through a pipe,
+ * the shell's copy of the read end is closed at once so the readers are unchanged
+ * \param int fd: The copy of the read end
+ * \param unsigned int events: The EPOLL* flags
+ * \param void *data: The pipeWatch
+ * \return None
+ *
+ */
+static void pipeReady(int fd, unsigned int events, void *data) {
+  pipeWatch *watch=(pipeWatch *)data;
+
+  // A hang-up alone: the writer ended without writing anything
+  if(events&EPOLLIN) {
+    TRACE(TRACE_FIRST_BYTE, watch->writer, watch->pipeNo, NULL);
+  }
+  evDel(fd);
+  close(fd);
+  free(watch);
+}
+
+/** \brief tracePipe
+ * A function which watches a pipe of a pipeline until its first byte comes
+ * or its writer ends, through a copy of its read end which is never read
+ * \param int readFd: The read end
+ * \param pid_t writer: The member writing to it, 0 for a builtin on a thread
+ * \param int pipeNo: The serial number of the pipe
+ * \return None
+ *
+ */
+void tracePipe(int readFd, pid_t writer, int pipeNo) {
+  pipeWatch *watch;
+  int fd;
+
+  if(traceBuffer==NULL || (fd=fcntl(readFd, F_DUPFD_CLOEXEC, 0))<0) {
+    return;
+  }
+  watch=(pipeWatch *)malloc(sizeof(pipeWatch));
+  watch->writer=writer;
+  watch->pipeNo=pipeNo;
+  if(evAdd(fd, EPOLLIN, pipeReady, watch)) {
+    close(fd);
+    free(watch);
+  }
+}
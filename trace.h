@@ -0,0 +1,43 @@
+#ifndef MYSHELL_TRACE_H
+#define MYSHELL_TRACE_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/types.h>
+
+//Events the ring holds, a power of two; those recorded while it's full are counted and lost
+#define TRACE_RING 16384
+
+//Characters of text kept with an event
+#define TRACE_TEXT 64
+
+//Size of the buffer the events are formatted into before they're written
+#define TRACE_WRITE_BUFFER 65536
+
+//Kinds of events
+#define TRACE_PARSE_BEGIN 0
+#define TRACE_PARSE_END 1
+#define TRACE_SPAWN_BEGIN 2
+#define TRACE_SPAWN_END 3
+#define TRACE_EXEC 4
+#define TRACE_FIRST_BYTE 5
+#define TRACE_REAP 6
+
+//The ring shared with the children, NULL while the shell doesn't trace
+extern struct traceRing *traceBuffer;
+
+//Records an event when the shell traces, a test and nothing more when it doesn't
+#define TRACE(kind, pid, value, text) \
+  do { if(traceBuffer!=NULL) traceRecord((kind), (pid), (value), (text)); } while(0)
+
+//Records an event in the ring, from the shell, one of its threads or a child not yet executed
+void traceRecord(int kind, pid_t pid, long long value, const char *text);
+//Starts or stops tracing as "set -o trace" says, and writes the events recorded so far
+void traceSync(void);
+//Watches the read end of a pipe of a pipeline until its first byte comes
+void tracePipe(int readFd, pid_t writer, int pipeNo);
+
+#endif
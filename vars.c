@@ -0,0 +1,466 @@
+#include "vars.h"
+
+//The environment the shell was started with
+extern char **environ;
+
+typedef struct varEntry {
+    //"name=value", the value starts after the name and its '='
+    char *pair;
+    size_t nameLen;
+
+    //whether it's given to the commands, and its slot in their environment then
+    int exported;
+    size_t envIndex;
+
+    struct varEntry *next;
+} varEntry;
+
+static varEntry **buckets = NULL;
+static size_t nbBuckets = 0;
+static size_t nbEntries = 0;
+
+//The environment of the commands: the pairs of the exported variables, then NULL
+static char **envCache = NULL;
+static size_t nbEnv = 0;
+//whether a variable was exported, or stopped being, since it was built
+static int envDirty = 1;
+
+//The values of $? and $$
+static char lastStatus[16] = "0";
+static char shellPid[16] = "";
+//whether $PIPESTATUS was set by the pipeline whose exit code comes next
+static int pipeStatusSet = 0;
+
+/** \brief hashName
+ * A function which hashes a variable name (FNV-1a)
+ * \param const char *name: The name
+ * \param size_t len: Its length
+ * \return The hash of the name
+ *
+ */
+static size_t hashName(const char *name, size_t len) {
+  size_t hash=(size_t)14695981039346656037ULL;
+  while(len-->0) {
+    hash^=(unsigned char)*name++;
+    hash*=(size_t)1099511628211ULL;
+  }
+  return hash;
+}
+
+/** \brief findEntry
+ * A function which looks for the entry of a variable
+ * \param const char *name: The name, it may be followed by '=' and the value
+ * \param size_t len: The length of the name
+ * \return A pointer to the link pointing to the entry (or to the end of its chain)
+ *
+ */
+static varEntry **findEntry(const char *name, size_t len) {
+  varEntry **link=&buckets[hashName(name, len)&(nbBuckets-1)];
+  while(*link!=NULL && ((*link)->nameLen!=len || strncmp((*link)->pair, name, len))) {
+    link=&(*link)->next;
+  }
+  return link;
+}
+
+/** \brief lookupVar
+ * A function which finds the entry of a variable
+ * \param const char *name: The name, it may be followed by '=' and the value
+ * \param size_t len: The length of the name
+ * \return The entry; NULL when the variable is not set
+ *
+ */
+static varEntry *lookupVar(const char *name, size_t len) {
+  return nbBuckets==0? NULL:*findEntry(name, len);
+}
+
+/** \brief growVars
+ * A function which doubles the number of buckets when the table gets crowded
+ * \return None
+ *
+ */
+static void growVars(void) {
+  size_t newNb=nbBuckets==0? VARS_BUCKETS:nbBuckets*2;
+  varEntry **newBuckets=(varEntry **)calloc(newNb, sizeof(varEntry *));
+  size_t cpt;
+
+  for(cpt=0; cpt<nbBuckets; cpt++) {
+    varEntry *entry=buckets[cpt];
+    while(entry!=NULL) {
+      varEntry *next=entry->next;
+      size_t slot=hashName(entry->pair, entry->nameLen)&(newNb-1);
+      entry->next=newBuckets[slot];
+      newBuckets[slot]=entry;
+      entry=next;
+    }
+  }
+  free(buckets);
+  buckets=newBuckets;
+  nbBuckets=newNb;
+}
+
+/** \brief storeVar
+ * A function which sets a variable
+ * The value of an exported variable is replaced in the environment of the
+ * commands right away; it's only built again when a variable is exported
+ * \param const char *name: The name, it may be followed by '=' and the value
+ * \param size_t len: The length of the name
+ * \param const char *value: The value
+ * \param int exported: Whether the variable gets exported, it's never unexported here
+ * \return None
+ *
+ */
+static void storeVar(const char *name, size_t len, const char *value, int exported) {
+  size_t valueLen=strlen(value);
+  char *pair=(char *)malloc(len+valueLen+2);
+  varEntry **link, *entry;
+
+  memcpy(pair, name, len);
+  pair[len]='=';
+  memcpy(pair+len+1, value, valueLen+1);
+
+  if(nbEntries>=nbBuckets) {
+    growVars();
+  }
+  link=findEntry(name, len);
+  if((entry=*link)==NULL) {
+    entry=(varEntry *)calloc(1, sizeof(varEntry));
+    entry->nameLen=len;
+    *link=entry;
+    nbEntries++;
+  } else {
+    free(entry->pair);
+  }
+  entry->pair=pair;
+  if(exported && !entry->exported) {
+    entry->exported=1;
+    envDirty=1;
+  } else if(entry->exported && !envDirty) {
+    envCache[entry->envIndex]=pair;
+  }
+}
+
+/** \brief removeVar
+ * A function which removes a variable
+ * \param const char *name: The name, it may be followed by '=' and the value
+ * \param size_t len: The length of the name
+ * \return None
+ *
+ */
+static void removeVar(const char *name, size_t len) {
+  varEntry **link, *entry;
+
+  if(nbBuckets==0 || (entry=*(link=findEntry(name, len)))==NULL) {
+    return;
+  }
+  *link=entry->next;
+  nbEntries--;
+  if(entry->exported) {
+    envDirty=1;
+  }
+  free(entry->pair);
+  free(entry);
+}
+
+/** \brief initVars
+ * A function which gives the shell a variable for each entry of its
+ * environment, all of them exported
+ * \return None
+ *
+ */
+void initVars(void) {
+  char **cur;
+
+  for(cur=environ; cur!=NULL && *cur!=NULL; cur++) {
+    const char *eq=strchr(*cur, '=');
+    if(eq!=NULL && validVarName(*cur, (size_t)(eq-*cur))) {
+      storeVar(*cur, (size_t)(eq-*cur), eq+1, 1);
+    }
+  }
+  snprintf(shellPid, sizeof(shellPid), "%d", (int)getpid());
+}
+
+/** \brief getVar
+ * A function which gives the value of a variable
+ * \param const char *name: The name, "?" for the exit code of the last command and "$" for the pid of the shell
+ * \return The value, valid until the variable changes; NULL when it's not set
+ *
+ */
+const char *getVar(const char *name) {
+  varEntry *entry;
+
+  if(!strcmp(name, "?")) {
+    return lastStatus;
+  }
+  if(!strcmp(name, "$")) {
+    return shellPid;
+  }
+  entry=lookupVar(name, strlen(name));
+  return entry==NULL? NULL:entry->pair+entry->nameLen+1;
+}
+
+/** \brief setVar
+ * A function which sets a variable
+ * \param const char *name: The name
+ * \param const char *value: The value
+ * \param int exported: Whether the variable gets exported, it stays so when it already was
+ * \return None
+ *
+ */
+void setVar(const char *name, const char *value, int exported) {
+  storeVar(name, strlen(name), value, exported);
+}
+
+/** \brief unsetVar
+ * A function which removes a variable
+ * \param const char *name: The name
+ * \return None
+ *
+ */
+void unsetVar(const char *name) {
+  removeVar(name, strlen(name));
+}
+
+/** \brief validVarName
+ * A function which tells whether some characters make a variable name:
+ * letters, digits and '_', not starting with a digit
+ * \param const char *name: The characters
+ * \param size_t len: Their number
+ * \return 1: when they make a name; 0: otherwise
+ *
+ */
+int validVarName(const char *name, size_t len) {
+  size_t cpt;
+
+  if(len==0 || (name[0]>='0' && name[0]<='9')) {
+    return 0;
+  }
+  for(cpt=0; cpt<len; cpt++) {
+    char c=name[cpt];
+    if(!((c>='a' && c<='z') || (c>='A' && c<='Z') || (c>='0' && c<='9') || c=='_')) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/** \brief setLastStatus
+ * A function which records the exit code of the last command, $PIPESTATUS
+ * gets it too unless a pipeline gave the codes of its members
+ * \param int status: The exit code
+ * \return None
+ *
+ */
+void setLastStatus(int status) {
+  snprintf(lastStatus, sizeof(lastStatus), "%d", status);
+  if(!pipeStatusSet) {
+    setVar("PIPESTATUS", lastStatus, 0);
+  }
+  pipeStatusSet=0;
+}
+
+/** \brief setPipeStatus
+ * A function which records the exit codes of the members of the last
+ * foreground pipeline in $PIPESTATUS, until setLastStatus is called
+ * \param const char *codes: The codes, separated by spaces
+ * \return None
+ *
+ */
+void setPipeStatus(const char *codes) {
+  setVar("PIPESTATUS", codes, 0);
+  pipeStatusSet=1;
+}
+
+/** \brief rebuildEnviron
+ * A function which lays the exported variables out as an environment,
+ * when one was exported or removed since it was last done
+ * \return None
+ *
+ */
+static void rebuildEnviron(void) {
+  size_t slot;
+  varEntry *entry;
+
+  if(!envDirty) {
+    return;
+  }
+  nbEnv=0;
+  for(slot=0; slot<nbBuckets; slot++) {
+    for(entry=buckets[slot]; entry!=NULL; entry=entry->next) {
+      nbEnv+=entry->exported;
+    }
+  }
+  envCache=(char **)realloc(envCache, (nbEnv+1)*sizeof(char *));
+  nbEnv=0;
+  for(slot=0; slot<nbBuckets; slot++) {
+    for(entry=buckets[slot]; entry!=NULL; entry=entry->next) {
+      if(entry->exported) {
+        entry->envIndex=nbEnv;
+        envCache[nbEnv++]=entry->pair;
+      }
+    }
+  }
+  envCache[nbEnv]=NULL;
+  envDirty=0;
+}
+
+/** \brief varEnviron
+ * A function which gives the environment handed to a command
+ * Without assignments it's the cached one, which costs nothing per command;
+ * with some, a copy of it gets them in the slots of the variables they replace
+ * \param arena *mem: Where the copy is made
+ * \param char **assigns: The assignments of the command, NAME=value
+ * \param unsigned int nbAssigns: Their number
+ * \return The environment, valid until a variable changes
+ *
+ */
+char **varEnviron(arena *mem, char **assigns, unsigned int nbAssigns) {
+  char **envp;
+  size_t nb;
+  unsigned int cpt;
+
+  rebuildEnviron();
+  if(nbAssigns==0) {
+    return envCache;
+  }
+  envp=(char **)arenaAlloc(mem, (nbEnv+nbAssigns+1)*sizeof(char *));
+  memcpy(envp, envCache, nbEnv*sizeof(char *));
+  nb=nbEnv;
+  for(cpt=0; cpt<nbAssigns; cpt++) {
+    size_t len=strcspn(assigns[cpt], "="), other;
+    varEntry *entry=lookupVar(assigns[cpt], len);
+    if(entry!=NULL && entry->exported) {
+      envp[entry->envIndex]=assigns[cpt];
+      continue;
+    }
+    // The last assignment of a name wins
+    for(other=nbEnv; other<nb && (strncmp(envp[other], assigns[cpt], len+1)); other++) {}
+    envp[other]=assigns[cpt];
+    if(other==nb) {
+      nb++;
+    }
+  }
+  envp[nb]=NULL;
+  return envp;
+}
+
+/** \brief pushAssigns
+ * A function which gives variables the values of the assignments of a
+ * builtin run in the shell, like its environment would
+ * \param char **assigns: The assignments, NAME=value
+ * \param unsigned int nbAssigns: Their number
+ * \return The values they replaced, NULL for the variables which were not set
+ *
+ */
+char **pushAssigns(char **assigns, unsigned int nbAssigns) {
+  char **saved=(char **)malloc((nbAssigns+1)*sizeof(char *));
+  unsigned int cpt;
+
+  for(cpt=0; cpt<nbAssigns; cpt++) {
+    size_t len=strcspn(assigns[cpt], "=");
+    varEntry *entry=lookupVar(assigns[cpt], len);
+    saved[cpt]=entry==NULL? NULL:strdup(entry->pair+len+1);
+    storeVar(assigns[cpt], len, assigns[cpt]+len+1, 0);
+  }
+  return saved;
+}
+
+/** \brief popAssigns
+ * A function which gives the variables back the values pushAssigns replaced
+ * \param char **assigns: The assignments, NAME=value
+ * \param unsigned int nbAssigns: Their number
+ * \param char **saved: What pushAssigns gave back, freed
+ * \return None
+ *
+ */
+void popAssigns(char **assigns, unsigned int nbAssigns, char **saved) {
+  unsigned int cpt=nbAssigns;
+
+  // In reverse, for a name assigned twice
+  while(cpt-->0) {
+    size_t len=strcspn(assigns[cpt], "=");
+    if(saved[cpt]==NULL) {
+      removeVar(assigns[cpt], len);
+    } else {
+      storeVar(assigns[cpt], len, saved[cpt], 0);
+      free(saved[cpt]);
+    }
+  }
+  free(saved);
+}
+
+/** \brief comparePairs
+ * A function which sorts the variables by name for qsort
+ * \param const void *a: A pointer which points to a pair
+ * \param const void *b: A pointer which points to the other pair
+ * \return Like strcmp
+ *
+ */
+static int comparePairs(const void *a, const void *b) {
+  return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/** \brief exportCommand
+ * A function which realizes the "export" builtin
+ * "export" and "export -p" list the exported variables,
+ * "export name[=value]..." exports them, giving them a value first
+ * \param char **args: The arguments of the builtin, args[0] is "export"
+ * \param unsigned int nbArgs: The number of arguments
+ * \return 0: when it succeeds; 1: when a name is not valid
+ *
+ */
+int exportCommand(char **args, unsigned int nbArgs) {
+  unsigned int cpt;
+  int ret=0;
+
+  if(nbArgs==1 || (nbArgs==2 && !strcmp(args[1], "-p"))) {
+    char **sorted;
+    size_t nb;
+    rebuildEnviron();
+    sorted=(char **)malloc((nbEnv+1)*sizeof(char *));
+    memcpy(sorted, envCache, nbEnv*sizeof(char *));
+    qsort(sorted, nbEnv, sizeof(char *), comparePairs);
+    for(nb=0; nb<nbEnv; nb++) {
+      size_t len=strcspn(sorted[nb], "=");
+      printf("declare -x %.*s=\"%s\"\n", (int)len, sorted[nb], sorted[nb]+len+1);
+    }
+    free(sorted);
+    return 0;
+  }
+
+  for(cpt=1; cpt<nbArgs; cpt++) {
+    size_t len=strcspn(args[cpt], "=");
+    varEntry *entry;
+    if(!validVarName(args[cpt], len)) {
+      fprintf(stderr, "-myshell: export: `%s': not a valid identifier\n", args[cpt]);
+      ret=1;
+    } else if(args[cpt][len]=='=') {
+      storeVar(args[cpt], len, args[cpt]+len+1, 1);
+    } else if((entry=lookupVar(args[cpt], len))!=NULL && !entry->exported) {
+      entry->exported=1;
+      envDirty=1;
+    }
+  }
+  return ret;
+}
+
+/** \brief unsetCommand
+ * A function which realizes the "unset name..." builtin
+ * \param char **args: The arguments of the builtin, args[0] is "unset"
+ * \param unsigned int nbArgs: The number of arguments
+ * \return 0: when it succeeds; 1: when a name is not valid
+ *
+ */
+int unsetCommand(char **args, unsigned int nbArgs) {
+  unsigned int cpt;
+  int ret=0;
+
+  for(cpt=1; cpt<nbArgs; cpt++) {
+    if(!validVarName(args[cpt], strlen(args[cpt]))) {
+      fprintf(stderr, "-myshell: unset: `%s': not a valid identifier\n", args[cpt]);
+      ret=1;
+    } else {
+      unsetVar(args[cpt]);
+    }
+  }
+  return ret;
+}
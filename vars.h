@@ -0,0 +1,37 @@
+#ifndef MYSHELL_VARS_H
+#define MYSHELL_VARS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "arena.h"
+
+//Initial number of buckets, always a power of two
+#define VARS_BUCKETS 64
+
+//Imports the environment of the shell into its variables
+void initVars(void);
+//Gives the value of a variable, "?" and "$" included, NULL when it's not set
+const char *getVar(const char *name);
+//Sets a variable, exported when exported is set or when it already was
+void setVar(const char *name, const char *value, int exported);
+//Removes a variable
+void unsetVar(const char *name);
+//Whether the len first characters of a string make a variable name
+int validVarName(const char *name, size_t len);
+//Records the exit code of the last command, for $?
+void setLastStatus(int status);
+//Records the exit codes of the members of the last pipeline, for $PIPESTATUS
+void setPipeStatus(const char *codes);
+//Gives the environment of a command, NAME=value assignments of its own on top of the exported variables
+char **varEnviron(arena *mem, char **assigns, unsigned int nbAssigns);
+//Gives variables the values of assignments while a builtin runs in the shell, gives back the values replaced
+char **pushAssigns(char **assigns, unsigned int nbAssigns);
+//Gives back the values pushAssigns replaced
+void popAssigns(char **assigns, unsigned int nbAssigns, char **saved);
+//Realize the "export" and "unset" builtins
+int exportCommand(char **args, unsigned int nbArgs);
+int unsetCommand(char **args, unsigned int nbArgs);
+
+#endif